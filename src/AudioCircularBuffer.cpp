@@ -22,14 +22,17 @@
 
 #include "AudioCircularBuffer.hh"
 #include "Utils.hh"
+#include "AudioKernels.hh"
 #include <cstring>
 #include <iostream>
+#include <algorithm>
 
 #define MAX_DEVIATION_SAMPLES 64
 
-AudioCircularBuffer* AudioCircularBuffer::createNew(struct ConnectionData cData, unsigned ch, unsigned sRate, unsigned maxSamples, SampleFmt sFmt)
+AudioCircularBuffer* AudioCircularBuffer::createNew(struct ConnectionData cData, unsigned ch, unsigned sRate, unsigned maxSamples, SampleFmt sFmt,
+                                                    const StreamInfo *si)
 {
-    AudioCircularBuffer* b = new AudioCircularBuffer(cData, ch, sRate, maxSamples, sFmt);
+    AudioCircularBuffer* b = new AudioCircularBuffer(cData, ch, sRate, maxSamples, sFmt, si);
 
     if (!b->setup()) {
         utils::errorMsg("AudioCircularBuffer setup error!");
@@ -40,10 +43,14 @@ AudioCircularBuffer* AudioCircularBuffer::createNew(struct ConnectionData cData,
     return b;
 }
 
-AudioCircularBuffer::AudioCircularBuffer(struct ConnectionData cData, unsigned ch, unsigned sRate, unsigned maxSamples, SampleFmt sFmt)
-: FrameQueue(cData), channels(ch), sampleRate(sRate), bytesPerSample(0), chMaxSamples(maxSamples), channelMaxLength(0), 
+AudioCircularBuffer::AudioCircularBuffer(struct ConnectionData cData, unsigned ch, unsigned sRate, unsigned maxSamples, SampleFmt sFmt, const StreamInfo *si)
+: FrameQueue(cData, si), channels(ch), sampleRate(sRate), bytesPerSample(0), chMaxSamples(maxSamples), channelMaxLength(0), 
 sampleFormat(sFmt), fillNewFrame(true), inputFrame(NULL), outputFrame(NULL), dummyFrame(NULL), 
-synchronized(false), setupSuccess(false), tsDeviationThreshold(0), elements(0)
+synchronized(false), setupSuccess(false), tsDeviationThreshold(0), writeIdx(0), readIdx(0), 
+syncIdx(0), syncTimestamp(0), orgTime(0), outputSamples(0), driftEnabled(false), driftLatency(0),
+driftPpm(0), driftActive(false), driftTarget(0), driftLocked(false), driftFirstFill(true), driftElapsed(0), avgFill(0),
+targetFill(0), driftIntegral(0), compensatedSamples(0), resampler(NULL), floatInFrame(NULL),
+floatOutFrame(NULL), compensatedFrame(NULL), meter(ch, sRate)
 {
 
 }
@@ -58,6 +65,11 @@ AudioCircularBuffer::~AudioCircularBuffer()
         
         delete inputFrame;
         delete outputFrame;
+        delete dummyFrame;
+        delete resampler;
+        delete floatInFrame;
+        delete floatOutFrame;
+        delete compensatedFrame;
     }
 }
 
@@ -69,24 +81,47 @@ Frame* AudioCircularBuffer::getRear()
 Frame* AudioCircularBuffer::getFront()
 {
     std::chrono::microseconds ts;
-    unsigned frontSampleIdx;
-
-    std::lock_guard<std::mutex> guard(mtx);
+    std::chrono::microseconds pending;
+    size_t write;
+    size_t read;
+    size_t sync;
+    int64_t syncTs;
+    unsigned samples;
+    unsigned bytesRequested;
 
     if (!fillNewFrame) {
         return outputFrame;
     }
 
-    frontSampleIdx = front/bytesPerSample;
-    ts = std::chrono::microseconds(frontSampleIdx*std::micro::den/sampleRate) + syncTimestamp;
-    outputFrame->setPresentationTime(ts);
+    write = writeIdx.load(std::memory_order_acquire);
+
+    //NOTE: sync position and timestamp are updated together by the producer after a flush,
+    //      they are read again if the position changes in between
+    do {
+        sync = syncIdx.load(std::memory_order_acquire);
+        syncTs = syncTimestamp.load(std::memory_order_acquire);
+    } while (sync != syncIdx.load(std::memory_order_acquire));
+
+    read = std::max(readIdx.load(std::memory_order_relaxed), sync);
+    samples = outputSamples.load(std::memory_order_relaxed);
+    bytesRequested = samples*bytesPerSample;
 
-    if (!popFront(outputFrame->getPlanarDataBuf(), outputFrame->getSamples())) {
+    if (write < read + bytesRequested) {
         utils::debugMsg("There is not enough data to fill a frame. Impossible to get new frame!");
         return NULL;
     }
 
-    outputFrame->setOriginTime(orgTime - std::chrono::microseconds(elements*std::micro::den/(bytesPerSample*sampleRate)));
+    fillOutputBuffers(outputFrame->getPlanarDataBuf(), read, bytesRequested);
+    readIdx.store(read + bytesRequested, std::memory_order_release);
+
+    ts = std::chrono::microseconds((int64_t) ((read - sync)/bytesPerSample)*std::micro::den/sampleRate + syncTs);
+    pending = std::chrono::microseconds((int64_t) ((write - read - bytesRequested)/bytesPerSample)*std::micro::den/sampleRate);
+
+    outputFrame->setSamples(samples);
+    outputFrame->setLength(bytesRequested);
+    outputFrame->setPresentationTime(ts);
+    outputFrame->setOriginTime(std::chrono::system_clock::time_point(
+        std::chrono::microseconds(orgTime.load(std::memory_order_relaxed))) - pending);
     
     fillNewFrame = false;
     return outputFrame;
@@ -100,17 +135,29 @@ std::vector<int> AudioCircularBuffer::addFrame()
     std::chrono::microseconds deviation;
     std::vector<int> ret;
     unsigned paddingSamples;
-    unsigned rearSampleIdx;
+    int64_t rearSampleIdx;
+    bool pushed;
 
     inTs = inputFrame->getPresentationTime();
 
+    if (driftEnabled != driftActive) {
+        driftActive = driftEnabled;
+        driftTarget = driftLatency;
+        resetDriftCompensation();
+    } else if (driftActive && driftLatency != driftTarget) {
+        driftTarget = driftLatency;
+        unlockDriftCompensation();
+    }
+
     if (!synchronized) {
-        syncTimestamp = inTs;
+        syncTimestamp.store(inTs.count(), std::memory_order_release);
         synchronized = true;
     }
 
-    rearSampleIdx = rear/bytesPerSample;
-    rearTs = std::chrono::microseconds(rearSampleIdx*std::micro::den/sampleRate) + syncTimestamp;
+    //NOTE: samples added or removed by drift compensation do not count in the input timeline
+    rearSampleIdx = (writeIdx.load(std::memory_order_relaxed) - syncIdx.load(std::memory_order_relaxed))/bytesPerSample;
+    rearSampleIdx -= compensatedSamples;
+    rearTs = std::chrono::microseconds(rearSampleIdx*std::micro::den/sampleRate + syncTimestamp.load(std::memory_order_relaxed));
     deviation = inTs - rearTs;
 
     if (deviation.count() < -tsDeviationThreshold) {
@@ -135,15 +182,21 @@ std::vector<int> AudioCircularBuffer::addFrame()
         }
     }
 
-    if(!pushBack(inputFrame->getPlanarDataBuf(), inputFrame->getSamples())) {
+    orgTime.store(std::chrono::duration_cast<std::chrono::microseconds>(
+        inputFrame->getOriginTime().time_since_epoch()).count(), std::memory_order_relaxed);
+
+    if (driftActive) {
+        updateDriftCorrection(inputFrame->getSamples());
+        pushed = pushCompensated(inputFrame->getSamples());
+    } else {
+        pushed = pushBack(inputFrame->getPlanarDataBuf(), inputFrame->getSamples());
+    }
+
+    if(!pushed) {
         utils::warningMsg("[AudioCircularBuffer] Cannot push frame");
         return ret;
     }
     
-    std::lock_guard<std::mutex> guard(mtx);
-    
-    orgTime = inputFrame->getOriginTime();
-    
     for (auto& r : connectionData.readers){
         ret.push_back(r.rFilterId);
     }
@@ -159,11 +212,16 @@ int AudioCircularBuffer::removeFrame()
 
 void AudioCircularBuffer::doFlush()
 {
-    std::lock_guard<std::mutex> guard(mtx);
-    rear = 0;
-    front = 0;
-    elements = 0;
+    //NOTE: the producer cannot move the consumer position, stored data is discarded
+    //      moving the sync position, which is where the consumer restarts reading
+    syncIdx.store(writeIdx.load(std::memory_order_relaxed), std::memory_order_release);
     synchronized = false;
+    compensatedSamples = 0;
+    driftFirstFill = true;
+
+    if (resampler) {
+        resampler->reset();
+    }
 }
 
 
@@ -183,6 +241,11 @@ bool AudioCircularBuffer::setup()
         return false;
     }
 
+    if (channels > MAX_CHANNELS) {
+        utils::errorMsg("[Audio Circular Buffer] Number of channels not supported: " + std::to_string(channels));
+        return false;
+    }
+
     switch(sampleFormat) {
         case U8P:
             bytesPerSample = 1;
@@ -199,7 +262,7 @@ bool AudioCircularBuffer::setup()
             return false;
     }
 
-    channelMaxLength = chMaxSamples*(sampleRate/1000) * bytesPerSample;
+    channelMaxLength = chMaxSamples*bytesPerSample;
 
     for (unsigned i=0; i<channels; i++) {
         data[i] = new unsigned char [channelMaxLength]();
@@ -210,8 +273,20 @@ bool AudioCircularBuffer::setup()
     dummyFrame = PlanarAudioFrame::createNew(channels, sampleRate, AudioFrame::getMaxSamples(sampleRate), PCM, sampleFormat);
     dummyFrame->fillWithValue(0);
 
-    outputFrame->setSamples(AudioFrame::getDefaultSamples(sampleRate));
-    outputFrame->setLength(AudioFrame::getDefaultSamples(sampleRate)*bytesPerSample);
+    outputSamples = AudioFrame::getDefaultSamples(sampleRate);
+    outputFrame->setSamples(outputSamples);
+    outputFrame->setLength(outputSamples*bytesPerSample);
+
+    //NOTE: resampled output can be slightly longer than the input frame
+    if (sampleFormat == S16P || sampleFormat == FLTP) {
+        resampler = new FractionalResampler(channels);
+        compensatedFrame = PlanarAudioFrame::createNew(channels, sampleRate, 2*AudioFrame::getMaxSamples(sampleRate), PCM, sampleFormat);
+    }
+
+    if (sampleFormat == S16P) {
+        floatInFrame = PlanarAudioFrame::createNew(channels, sampleRate, AudioFrame::getMaxSamples(sampleRate), PCM, FLTP);
+        floatOutFrame = PlanarAudioFrame::createNew(channels, sampleRate, 2*AudioFrame::getMaxSamples(sampleRate), PCM, FLTP);
+    }
 
     tsDeviationThreshold = MAX_DEVIATION_SAMPLES*std::micro::den/sampleRate;
     setupSuccess = true;
@@ -223,83 +298,72 @@ bool AudioCircularBuffer::setup()
 bool AudioCircularBuffer::pushBack(unsigned char **buffer, int samplesRequested)
 {
     unsigned bytesRequested = samplesRequested * bytesPerSample;
+    size_t write = writeIdx.load(std::memory_order_relaxed);
+    size_t read = readIdx.load(std::memory_order_acquire);
     unsigned rearMod;
-    int firstCopiedBytes;
+    unsigned firstCopiedBytes;
 
-    if (bytesRequested > (channelMaxLength - elements)) {
+    //NOTE: flushed data still not skipped by the consumer is considered as used space,
+    //      it may be being read
+    if (bytesRequested > channelMaxLength - (write - read)) {
         return false;
     }
 
-    rearMod = rear % channelMaxLength;
-
-    if ((rearMod + bytesRequested) < channelMaxLength) {
-
-        for (unsigned i=0; i<channels; i++) {
-            memcpy(data[i] + rearMod, buffer[i], bytesRequested);
-        }
-
-    } else {
+    rearMod = write % channelMaxLength;
+    firstCopiedBytes = std::min(bytesRequested, channelMaxLength - rearMod);
 
-        firstCopiedBytes = channelMaxLength - rearMod;
-        
-        for (unsigned i=0; i<channels;  i++) {
-            memcpy(data[i] + rearMod, buffer[i], firstCopiedBytes);
-            memcpy(data[i], buffer[i] + firstCopiedBytes, bytesRequested - firstCopiedBytes);
-        }
+    for (unsigned i=0; i<channels; i++) {
+        memcpy(data[i] + rearMod, buffer[i], firstCopiedBytes);
+        memcpy(data[i], buffer[i] + firstCopiedBytes, bytesRequested - firstCopiedBytes);
     }
 
-    elements += bytesRequested;
-    rear += bytesRequested;
+    //NOTE: input is measured while it is still in cache after the copy
+    meter.process(buffer, sampleFormat, 0, samplesRequested);
+
+    writeIdx.store(write + bytesRequested, std::memory_order_release);
     return true;
 }
 
 bool AudioCircularBuffer::popFront(unsigned char **buffer, unsigned samplesRequested)
 {
     unsigned bytesRequested = samplesRequested * bytesPerSample;
+    size_t write = writeIdx.load(std::memory_order_acquire);
+    size_t read = std::max(readIdx.load(std::memory_order_relaxed), syncIdx.load(std::memory_order_acquire));
 
-    if (elements < bytesRequested) {
+    if (write < read + bytesRequested) {
         return false;
     }
 
-    fillOutputBuffers(buffer, bytesRequested);
+    fillOutputBuffers(buffer, read, bytesRequested);
+    readIdx.store(read + bytesRequested, std::memory_order_release);
 
     return true;
 }
 
-void AudioCircularBuffer::fillOutputBuffers(unsigned char **buffer, int bytesRequested)
+void AudioCircularBuffer::fillOutputBuffers(unsigned char **buffer, size_t position, unsigned bytesRequested)
 {
-    int firstCopiedBytes = 0;
-    unsigned frontMod;
-
-    frontMod = front % channelMaxLength;
+    unsigned frontMod = position % channelMaxLength;
+    unsigned firstCopiedBytes = std::min(bytesRequested, channelMaxLength - frontMod);
 
-    if (frontMod + bytesRequested < channelMaxLength) {
-        for (unsigned i=0; i<channels; i++) {
-            memcpy(buffer[i], data[i] + frontMod, bytesRequested);
-        }
-
-    } else {
-        firstCopiedBytes = channelMaxLength - frontMod;
-
-        for (unsigned i=0; i<channels;  i++) {
-            memcpy(buffer[i], data[i] + frontMod, firstCopiedBytes);
-            memcpy(buffer[i] + firstCopiedBytes, data[i], bytesRequested - firstCopiedBytes);
-        }
+    for (unsigned i=0; i<channels;  i++) {
+        memcpy(buffer[i], data[i] + frontMod, firstCopiedBytes);
+        memcpy(buffer[i] + firstCopiedBytes, data[i], bytesRequested - firstCopiedBytes);
     }
+}
 
-    elements -= bytesRequested;
-    front += bytesRequested;
+size_t AudioCircularBuffer::validElements() const
+{
+    size_t write = writeIdx.load(std::memory_order_acquire);
+    size_t read = std::max(readIdx.load(std::memory_order_acquire), syncIdx.load(std::memory_order_acquire));
+
+    return write > read ? write - read : 0;
 }
 
 int AudioCircularBuffer::getFreeSamples()
 {
-    int freeBytes = channelMaxLength - elements;
-
-    if (freeBytes == 0) {
-        return freeBytes;
-    }
+    size_t used = writeIdx.load(std::memory_order_acquire) - readIdx.load(std::memory_order_acquire);
 
-    return (freeBytes/bytesPerSample);
+    return (channelMaxLength - used)/bytesPerSample;
 }
 
 bool AudioCircularBuffer::forcePushBack(unsigned char **buffer, int samplesRequested)
@@ -315,19 +379,139 @@ bool AudioCircularBuffer::forcePushBack(unsigned char **buffer, int samplesReque
     return true;
 }
 
-void AudioCircularBuffer::setOutputFrameSamples(int samples) 
+bool AudioCircularBuffer::setOutputFrameSamples(int samples) 
 {
-    outputFrame->setSamples(samples);
-    outputFrame->setLength(samples*bytesPerSample);
+    if (samples <= 0 || (unsigned) samples > outputFrame->getMaxSamples()) {
+        utils::errorMsg("[AudioCircularBuffer] Invalid output frame samples");
+        return false;
+    }
+
+    outputSamples.store(samples, std::memory_order_relaxed);
+
+    //NOTE: a frame already delivered keeps its size until it is removed
+    if (fillNewFrame) {
+        outputFrame->setSamples(samples);
+        outputFrame->setLength(samples*bytesPerSample);
+    }
+
+    return true;
+}
+
+bool AudioCircularBuffer::setDriftCompensation(bool enable, unsigned targetLatency)
+{
+    if (enable && !resampler) {
+        utils::errorMsg("[AudioCircularBuffer] Drift compensation is only supported for S16P and FLTP");
+        return false;
+    }
+
+    driftLatency = targetLatency;
+    driftEnabled = enable;
+    return true;
+}
+
+void AudioCircularBuffer::resetDriftCompensation()
+{
+    driftLocked = false;
+    driftFirstFill = true;
+    driftElapsed = 0;
+    driftIntegral = 0;
+    driftPpm = 0;
+
+    if (resampler) {
+        resampler->setRatio(1);
+        resampler->reset();
+    }
+}
+
+//NOTE: the fill average and the resampler keep running, so the new target is reached without discontinuities
+void AudioCircularBuffer::unlockDriftCompensation()
+{
+    driftLocked = false;
+    driftElapsed = 0;
+    driftIntegral = 0;
+    driftPpm = 0;
+    resampler->setRatio(1);
+}
+
+void AudioCircularBuffer::updateDriftCorrection(unsigned samples)
+{
+    double fill = validElements()/bytesPerSample;
+    double dt = (double) samples/sampleRate;
+    double error;
+    double correction;
+
+    if (driftFirstFill) {
+        avgFill = fill;
+        driftFirstFill = false;
+    } else {
+        avgFill += (fill - avgFill)*std::min(1.0, dt/DRIFT_AVERAGE_TIME);
+    }
+
+    if (!driftLocked) {
+        driftElapsed += dt;
+
+        if (driftTarget > 0) {
+            targetFill = (double) driftTarget*sampleRate/1000;
+            driftLocked = true;
+        } else if (driftElapsed >= DRIFT_LOCK_TIME) {
+            targetFill = avgFill;
+            driftLocked = true;
+        }
+
+        return;
+    }
+
+    //NOTE: fill level error in seconds, a positive error means that the consumer is slower
+    //      than the producer, so fewer samples have to be produced
+    error = (avgFill - targetFill)/sampleRate;
+    driftIntegral += DRIFT_INTEGRAL_GAIN*error*dt;
+    driftIntegral = std::max(-DRIFT_MAX_CORRECTION, std::min(DRIFT_MAX_CORRECTION, driftIntegral));
+
+    correction = DRIFT_PROPORTIONAL_GAIN*error + driftIntegral;
+    correction = std::max(-DRIFT_MAX_CORRECTION, std::min(DRIFT_MAX_CORRECTION, correction));
+
+    resampler->setRatio(1 - correction);
+    driftPpm = -correction*1000000;
+}
+
+bool AudioCircularBuffer::pushCompensated(unsigned samples)
+{
+    unsigned char** in = inputFrame->getPlanarDataBuf();
+    unsigned char** out = compensatedFrame->getPlanarDataBuf();
+    unsigned maxSamples = compensatedFrame->getMaxSamples();
+    unsigned produced;
+
+    if (sampleFormat == S16P) {
+        for (unsigned i = 0; i < channels; i++) {
+            audiokernels::s16ToFloat((int16_t*) in[i], (float*) floatInFrame->getPlanarDataBuf()[i], samples);
+        }
+
+        in = floatInFrame->getPlanarDataBuf();
+        out = floatOutFrame->getPlanarDataBuf();
+    }
+
+    produced = resampler->process((float**) in, samples, (float**) out, maxSamples);
+
+    if (sampleFormat == S16P) {
+        for (unsigned i = 0; i < channels; i++) {
+            audiokernels::floatToS16((float*) out[i], (int16_t*) compensatedFrame->getPlanarDataBuf()[i], produced);
+        }
+    }
+
+    if (!pushBack(compensatedFrame->getPlanarDataBuf(), produced)) {
+        return false;
+    }
+
+    compensatedSamples += (int64_t) produced - samples;
+    return true;
 }
 
 unsigned AudioCircularBuffer::getElements() const
 {
-    return elements/(outputFrame->getSamples()*bytesPerSample);
+    return validElements()/(outputSamples.load(std::memory_order_relaxed)*bytesPerSample);
 }
 
 bool AudioCircularBuffer::isFull() const
 {
-    return ((float) elements)/chMaxSamples >= FULL_THRESHOLD;
+    return ((float) validElements())/channelMaxLength >= FULL_THRESHOLD;
 }
-
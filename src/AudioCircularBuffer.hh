@@ -26,17 +26,81 @@
 #include "Types.hh"
 #include "FrameQueue.hh"
 #include "AudioFrame.hh"
-#include <mutex>
+#include "FractionalResampler.hh"
+#include "AudioLevelMeter.hh"
+#include <atomic>
 
 #define DEFAULT_BUFFER_SIZE 32768 //samples (~600ms at 48KHz)
-
-
- class AudioCircularBuffer : public FrameQueue {
+#define DRIFT_MAX_CORRECTION 0.002      //2000 ppm
+#define DRIFT_AVERAGE_TIME 2.0          //s
+#define DRIFT_LOCK_TIME 5.0             //s
+#define DRIFT_PROPORTIONAL_GAIN 0.1     //1/s
+#define DRIFT_INTEGRAL_GAIN 0.003       //1/s^2
+
+/*! Planar audio FIFO between one producer (the writer filter, which uses getRear and
+    addFrame) and one consumer (the reader filter, which uses getFront and removeFrame).
+    The producer and the consumer positions are atomic counters of bytes per channel, so
+    neither side takes a lock. Samples are copied with memcpy in at most two spans split
+    at the wrap point. Output frames are built with the number of samples set by the
+    consumer (e.g. 1024 for AAC or 960 for Opus), independently of the input frame size.
+    Flushes can only be triggered from the producer side.
+
+    When drift compensation is enabled, the producer averages the buffer fill level and,
+    once it is locked to a target level, a PI controller drives a FractionalResampler applied
+    to the input samples. If the producer clock runs faster or slower than the consumer one,
+    the input is shrunk or stretched by up to DRIFT_MAX_CORRECTION, so latency stays bounded
+    without inserting silence or flushing. Timestamp checks take the added or removed samples
+    into account, so only real gaps and overlaps are padded or discarded.
+
+    The producer can also meter the pushed samples (see AudioLevelMeter), right after
+    copying them into the buffer, so levels can be polled from any thread.
+*/
+
+class AudioCircularBuffer : public FrameQueue {
 
 public:
-    static AudioCircularBuffer* createNew(struct ConnectionData cData, unsigned ch, unsigned sRate, unsigned maxSamples, SampleFmt sFmt);
+    static AudioCircularBuffer* createNew(struct ConnectionData cData, unsigned ch, unsigned sRate, unsigned maxSamples, SampleFmt sFmt,
+                                          const StreamInfo *si = NULL);
     ~AudioCircularBuffer();
-    void setOutputFrameSamples(int samples); 
+
+    /**
+    * Sets the number of samples of the output frames. It must be called from the consumer
+    * side and it is applied to the next output frame
+    * @param samples Samples per channel of each output frame
+    * @return true if succeeded and false if not
+    */
+    bool setOutputFrameSamples(int samples); 
+
+    /**
+    * @return samples per channel of the output frames
+    */
+    unsigned getOutputFrameSamples() const {return outputSamples;};
+
+    /**
+    * Enables or disables clock drift compensation. It can be called from any thread, it is
+    * applied by the producer with the next frame
+    * @param enable True to resample the input following the fill level
+    * @param targetLatency Fill level to keep in milliseconds, 0 to lock to the average level
+    * after DRIFT_LOCK_TIME seconds. Changing it while enabled relocks the controller
+    * @return false if the sample format is not supported (only S16P and FLTP are)
+    */
+    bool setDriftCompensation(bool enable, unsigned targetLatency = 0);
+
+    /**
+    * @return true if drift compensation is enabled
+    */
+    bool getDriftCompensation() const {return driftEnabled;};
+
+    /**
+    * @return current input rate correction in parts per million
+    */
+    int getDriftCorrection() const {return driftPpm;};
+
+    /**
+    * @return meter of the samples pushed by the producer, it is configured and polled from
+    * any thread
+    */
+    AudioLevelMeter& getLevelMeter() {return meter;};
 
     /**
     * See FrameQueue::getRear
@@ -95,12 +159,17 @@ public:
     bool isFull() const;
 
 private:
-    AudioCircularBuffer(struct ConnectionData cData, unsigned ch, unsigned sRate, unsigned maxSamples, SampleFmt sFmt);
+    AudioCircularBuffer(struct ConnectionData cData, unsigned ch, unsigned sRate, unsigned maxSamples, SampleFmt sFmt, const StreamInfo *si);
 
     bool pushBack(unsigned char **buffer, int samplesRequested);
     bool forcePushBack(unsigned char **buffer, int samplesRequested);
     bool popFront(unsigned char **buffer, unsigned samplesRequested);
-    void fillOutputBuffers(unsigned char **buffer, int bytesRequested);
+    void fillOutputBuffers(unsigned char **buffer, size_t position, unsigned bytesRequested);
+    size_t validElements() const;
+    bool pushCompensated(unsigned samples);
+    void updateDriftCorrection(unsigned samples);
+    void resetDriftCompensation();
+    void unlockDriftCompensation();
     bool setup();
 
     unsigned channels;
@@ -116,16 +185,39 @@ private:
     PlanarAudioFrame* outputFrame;
     PlanarAudioFrame* dummyFrame;
 
-    std::chrono::microseconds syncTimestamp;
     bool synchronized;
     bool setupSuccess;
-    
-    std::chrono::system_clock::time_point orgTime;
 
     int tsDeviationThreshold;
-    std::mutex mtx;
 
-    unsigned elements;
+    //NOTE: byte positions only grow, they are written by one side and read by the other
+    std::atomic<size_t> writeIdx;
+    std::atomic<size_t> readIdx;
+    //NOTE: position where syncTimestamp applies, data before it has been flushed
+    std::atomic<size_t> syncIdx;
+    std::atomic<int64_t> syncTimestamp;     //us
+    std::atomic<int64_t> orgTime;           //us since epoch
+    std::atomic<unsigned> outputSamples;
+
+    std::atomic<bool> driftEnabled;
+    std::atomic<unsigned> driftLatency;     //ms
+    std::atomic<int> driftPpm;
+    //NOTE: drift compensation state is only used by the producer
+    bool driftActive;
+    unsigned driftTarget;                   //ms, driftLatency the controller is locked to
+    bool driftLocked;
+    bool driftFirstFill;
+    double driftElapsed;
+    double avgFill;                         //samples
+    double targetFill;                      //samples
+    double driftIntegral;
+    int64_t compensatedSamples;             //resampler output minus input samples
+    FractionalResampler* resampler;
+    PlanarAudioFrame* floatInFrame;
+    PlanarAudioFrame* floatOutFrame;
+    PlanarAudioFrame* compensatedFrame;
+
+    AudioLevelMeter meter;
 };
 
 #endif
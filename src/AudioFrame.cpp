@@ -56,6 +56,11 @@ std::chrono::nanoseconds AudioFrame::getDuration() const
 
 InterleavedAudioFrame* InterleavedAudioFrame::createNew(int ch, int sRate, int maxSamples, ACodecType codec, SampleFmt sFmt)
 {
+    if (ch < 0 || ch > MAX_CHANNELS) {
+        utils::errorMsg("[InterleavedAudioFrame] Number of channels not supported: " + std::to_string(ch));
+        return NULL;
+    }
+
     if (sFmt != U8 && sFmt != S16 && sFmt != FLT) {
         utils::errorMsg("[InterleavedAudioFrame] Sample format not supported");
         return NULL;
@@ -67,7 +72,8 @@ InterleavedAudioFrame* InterleavedAudioFrame::createNew(int ch, int sRate, int m
 InterleavedAudioFrame::InterleavedAudioFrame(int ch, int sRate, int maxSamples, ACodecType codec, SampleFmt sFmt)
 : AudioFrame(ch, sRate, maxSamples, codec, sFmt)
 {
-    bufferMaxLen = bytesPerSample * maxSamples * MAX_CHANNELS;
+    //NOTE: coded streams may not signal their channels, the default layout size is reserved then
+    bufferMaxLen = bytesPerSample * maxSamples * (ch > 0 ? ch : DEFAULT_CHANNELS);
     frameBuff = new unsigned char [bufferMaxLen]();
 }
 
@@ -78,7 +84,7 @@ InterleavedAudioFrame::~InterleavedAudioFrame()
 
 void InterleavedAudioFrame::fillWithValue(int value)
 {
-    memset(frameBuff, value, bufferMaxLen*channels);
+    memset(frameBuff, value, bufferMaxLen);
 }    
 
 
@@ -89,6 +95,11 @@ void InterleavedAudioFrame::fillWithValue(int value)
 
 PlanarAudioFrame* PlanarAudioFrame::createNew(int ch, int sRate, int maxSamples, ACodecType codec, SampleFmt sFmt)
 {
+    if (ch <= 0 || ch > MAX_CHANNELS) {
+        utils::errorMsg("[PlanarAudioFrame] Number of channels not supported: " + std::to_string(ch));
+        return NULL;
+    }
+
      if (sFmt != U8P && sFmt != S16P && sFmt != FLTP) {
         utils::errorMsg("[PlanarAudioFrame] Sample format not supported");
         return NULL;
@@ -103,7 +114,7 @@ PlanarAudioFrame::PlanarAudioFrame(int ch, int sRate, int maxSamples, ACodecType
     bufferMaxLen = bytesPerSample * maxSamples;
 
     for (int i=0; i<MAX_CHANNELS; i++) {
-        frameBuff[i] = new unsigned char [bufferMaxLen]();
+        frameBuff[i] = i < ch ? new unsigned char [bufferMaxLen]() : NULL;
     }
 }
 
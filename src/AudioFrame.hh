@@ -28,7 +28,7 @@
 #include <string>
 
 #define DEFAULT_CHANNELS 2
-#define MAX_CHANNELS 2
+#define MAX_CHANNELS 16 //NOTE: buffers are allocated for the channels of each stream, this is just the upper bound
 #define DEFAULT_SAMPLE_RATE 48000
 #define MAX_FRAME_TIME 100 //ms
 #define DEFAULT_FRAME_TIME 20000 //us
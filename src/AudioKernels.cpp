@@ -0,0 +1,477 @@
+/*
+ *  AudioKernels.cpp - Block based audio sample processing kernels
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "AudioKernels.hh"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define S16_TO_FLOAT (1.0f/32768.0f)
+#define FLOAT_TO_S16 32768.0f
+
+namespace audiokernels
+{
+
+static inline int16_t floatToS16Sample(float value)
+{
+    value *= FLOAT_TO_S16;
+
+    if (value >= 32767.0f) {
+        return 32767;
+    }
+
+    if (value <= -32768.0f) {
+        return -32768;
+    }
+
+    return (int16_t) value;
+}
+
+static inline float compressSample(float value, float th, float ratio)
+{
+    float clamped = value > th ? th : (value < -th ? -th : value);
+    return clamped + ratio*(value - clamped);
+}
+
+void s16ToFloat(const int16_t* src, float* dst, unsigned samples)
+{
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    const __m128 scale = _mm_set1_ps(S16_TO_FLOAT);
+
+    for (; i + 8 <= samples; i += 8) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + i));
+        //NOTE: sign extension, unpacking into the high half and shifting back
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#endif
+
+    for (; i < samples; i++) {
+        dst[i] = src[i]*S16_TO_FLOAT;
+    }
+}
+
+void floatToS16(const float* src, int16_t* dst, unsigned samples)
+{
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    const __m128 scale = _mm_set1_ps(FLOAT_TO_S16);
+    const __m128 max = _mm_set1_ps(32767.0f);
+    const __m128 min = _mm_set1_ps(-32768.0f);
+
+    for (; i + 8 <= samples; i += 8) {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+        a = _mm_max_ps(_mm_min_ps(a, max), min);
+        b = _mm_max_ps(_mm_min_ps(b, max), min);
+        //NOTE: truncation as the scalar path, packs saturates anyway
+        __m128i packed = _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b));
+        _mm_storeu_si128((__m128i*)(dst + i), packed);
+    }
+#endif
+
+    for (; i < samples; i++) {
+        dst[i] = floatToS16Sample(src[i]);
+    }
+}
+
+void mulAdd(const float* src, float* acc, float gain, unsigned samples)
+{
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    const __m128 g = _mm_set1_ps(gain);
+
+    for (; i + 8 <= samples; i += 8) {
+        __m128 a = _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(src + i), g));
+        __m128 b = _mm_add_ps(_mm_loadu_ps(acc + i + 4), _mm_mul_ps(_mm_loadu_ps(src + i + 4), g));
+        _mm_storeu_ps(acc + i, a);
+        _mm_storeu_ps(acc + i + 4, b);
+    }
+#endif
+
+    for (; i < samples; i++) {
+        acc[i] += src[i]*gain;
+    }
+}
+
+void mulAddS16(const int16_t* src, float* acc, float gain, unsigned samples)
+{
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    const __m128 g = _mm_set1_ps(gain*S16_TO_FLOAT);
+
+    for (; i + 8 <= samples; i += 8) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+        __m128 a = _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_cvtepi32_ps(lo), g));
+        __m128 b = _mm_add_ps(_mm_loadu_ps(acc + i + 4), _mm_mul_ps(_mm_cvtepi32_ps(hi), g));
+        _mm_storeu_ps(acc + i, a);
+        _mm_storeu_ps(acc + i + 4, b);
+    }
+#endif
+
+    for (; i < samples; i++) {
+        acc[i] += src[i]*(gain*S16_TO_FLOAT);
+    }
+}
+
+void subtract(const float* a, const float* b, float* dst, unsigned samples)
+{
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    for (; i + 4 <= samples; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+#endif
+
+    for (; i < samples; i++) {
+        dst[i] = a[i] - b[i];
+    }
+}
+
+void compress(float* buffer, float th, unsigned samples)
+{
+    //NOTE: over the threshold, ((1-th)/(2-th))*x + th/(2-th) == th + ((1-th)/(2-th))*(x-th)
+    //      so the curve is the clamped value plus the scaled excess, with no branches
+    float ratio = (1 - th)/(2 - th);
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    const __m128 max = _mm_set1_ps(th);
+    const __m128 min = _mm_set1_ps(-th);
+    const __m128 r = _mm_set1_ps(ratio);
+
+    for (; i + 4 <= samples; i += 4) {
+        __m128 x = _mm_loadu_ps(buffer + i);
+        __m128 c = _mm_max_ps(_mm_min_ps(x, max), min);
+        _mm_storeu_ps(buffer + i, _mm_add_ps(c, _mm_mul_ps(r, _mm_sub_ps(x, c))));
+    }
+#endif
+
+    for (; i < samples; i++) {
+        buffer[i] = compressSample(buffer[i], th, ratio);
+    }
+}
+
+float peak(const float* src, unsigned samples)
+{
+    float max = 0;
+    float value;
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    float partial[4];
+    //NOTE: absolute value clearing the sign bit
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 acc = _mm_setzero_ps();
+
+    for (; i + 4 <= samples; i += 4) {
+        acc = _mm_max_ps(acc, _mm_and_ps(_mm_loadu_ps(src + i), mask));
+    }
+
+    _mm_storeu_ps(partial, acc);
+
+    for (int j = 0; j < 4; j++) {
+        max = partial[j] > max ? partial[j] : max;
+    }
+#endif
+
+    for (; i < samples; i++) {
+        value = src[i] < 0 ? -src[i] : src[i];
+        max = value > max ? value : max;
+    }
+
+    return max;
+}
+
+void gainRamp(float* buffer, float gain, float step, unsigned samples)
+{
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 s = _mm_set1_ps(step);
+    const __m128i four = _mm_set1_epi32(4);
+    __m128i idx = _mm_set_epi32(3, 2, 1, 0);
+
+    for (; i + 4 <= samples; i += 4) {
+        //NOTE: gains are computed from the sample index, as the scalar path, so
+        //      rounding errors are not accumulated along the block
+        __m128 ramp = _mm_add_ps(g, _mm_mul_ps(s, _mm_cvtepi32_ps(idx)));
+        _mm_storeu_ps(buffer + i, _mm_mul_ps(_mm_loadu_ps(buffer + i), ramp));
+        idx = _mm_add_epi32(idx, four);
+    }
+#endif
+
+    for (; i < samples; i++) {
+        buffer[i] *= gain + step*(float) i;
+    }
+}
+
+float sumSquares(const float* src, unsigned samples)
+{
+    float sum = 0;
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    float partial[4];
+    __m128 acc = _mm_setzero_ps();
+
+    for (; i + 4 <= samples; i += 4) {
+        __m128 x = _mm_loadu_ps(src + i);
+        acc = _mm_add_ps(acc, _mm_mul_ps(x, x));
+    }
+
+    _mm_storeu_ps(partial, acc);
+    sum = partial[0] + partial[1] + partial[2] + partial[3];
+#endif
+
+    for (; i < samples; i++) {
+        sum += src[i]*src[i];
+    }
+
+    return sum;
+}
+
+float sumSquaresS16(const int16_t* src, unsigned samples)
+{
+    float sum = 0;
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    float partial[4];
+    __m128 acc = _mm_setzero_ps();
+
+    for (; i + 8 <= samples; i += 8) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+        acc = _mm_add_ps(acc, _mm_add_ps(_mm_mul_ps(lo, lo), _mm_mul_ps(hi, hi)));
+    }
+
+    _mm_storeu_ps(partial, acc);
+    sum = partial[0] + partial[1] + partial[2] + partial[3];
+#endif
+
+    for (; i < samples; i++) {
+        sum += (float) (src[i]*src[i]);
+    }
+
+    return sum*S16_TO_FLOAT*S16_TO_FLOAT;
+}
+
+float peakSumSquares(const float* src, unsigned samples, float &sum)
+{
+    float max = 0;
+    float value;
+    unsigned i = 0;
+
+    sum = 0;
+
+#ifdef __SSE2__
+    float partialMax[4];
+    float partialSum[4];
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 accMax = _mm_setzero_ps();
+    __m128 accSum = _mm_setzero_ps();
+
+    for (; i + 4 <= samples; i += 4) {
+        __m128 x = _mm_loadu_ps(src + i);
+        accMax = _mm_max_ps(accMax, _mm_and_ps(x, mask));
+        accSum = _mm_add_ps(accSum, _mm_mul_ps(x, x));
+    }
+
+    _mm_storeu_ps(partialMax, accMax);
+    _mm_storeu_ps(partialSum, accSum);
+
+    for (int j = 0; j < 4; j++) {
+        max = partialMax[j] > max ? partialMax[j] : max;
+    }
+
+    sum = partialSum[0] + partialSum[1] + partialSum[2] + partialSum[3];
+#endif
+
+    for (; i < samples; i++) {
+        value = src[i] < 0 ? -src[i] : src[i];
+        max = value > max ? value : max;
+        sum += src[i]*src[i];
+    }
+
+    return max;
+}
+
+float peakSumSquaresS16(const int16_t* src, unsigned samples, float &sum)
+{
+    int max = 0;
+    int value;
+    unsigned i = 0;
+
+    sum = 0;
+
+#ifdef __SSE2__
+    int16_t partialMax[8];
+    float partialSum[4];
+    const __m128i zero = _mm_setzero_si128();
+    __m128i accMax = _mm_setzero_si128();
+    __m128 accSum = _mm_setzero_ps();
+
+    for (; i + 8 <= samples; i += 8) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + i));
+        //NOTE: saturated negation, so -32768 is measured as 32767
+        accMax = _mm_max_epi16(accMax, _mm_max_epi16(in, _mm_subs_epi16(zero, in)));
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+        accSum = _mm_add_ps(accSum, _mm_add_ps(_mm_mul_ps(lo, lo), _mm_mul_ps(hi, hi)));
+    }
+
+    _mm_storeu_si128((__m128i*) partialMax, accMax);
+    _mm_storeu_ps(partialSum, accSum);
+
+    for (int j = 0; j < 8; j++) {
+        max = partialMax[j] > max ? partialMax[j] : max;
+    }
+
+    sum = partialSum[0] + partialSum[1] + partialSum[2] + partialSum[3];
+#endif
+
+    for (; i < samples; i++) {
+        value = src[i] < 0 ? -src[i] : src[i];
+        max = value > max ? value : max;
+        sum += (float) (src[i]*src[i]);
+    }
+
+    sum *= S16_TO_FLOAT*S16_TO_FLOAT;
+    return max*S16_TO_FLOAT;
+}
+
+//NOTE: only the stereo layouts have vectorized paths, other channel numbers use the generic loops
+
+template <typename T>
+static inline void interleaveGeneric(const T* const* src, T* dst, unsigned channels,
+                                     unsigned first, unsigned samples)
+{
+    for (unsigned i = first; i < samples; i++) {
+        for (unsigned c = 0; c < channels; c++) {
+            dst[i*channels + c] = src[c][i];
+        }
+    }
+}
+
+template <typename T>
+static inline void deinterleaveGeneric(const T* src, T* const* dst, unsigned channels,
+                                       unsigned first, unsigned samples)
+{
+    for (unsigned i = first; i < samples; i++) {
+        for (unsigned c = 0; c < channels; c++) {
+            dst[c][i] = src[i*channels + c];
+        }
+    }
+}
+
+void interleaveS16(const int16_t* const* src, int16_t* dst, unsigned channels, unsigned samples)
+{
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    if (channels == 2) {
+        for (; i + 8 <= samples; i += 8) {
+            __m128i l = _mm_loadu_si128((const __m128i*)(src[0] + i));
+            __m128i r = _mm_loadu_si128((const __m128i*)(src[1] + i));
+            _mm_storeu_si128((__m128i*)(dst + 2*i), _mm_unpacklo_epi16(l, r));
+            _mm_storeu_si128((__m128i*)(dst + 2*i + 8), _mm_unpackhi_epi16(l, r));
+        }
+    }
+#endif
+
+    interleaveGeneric(src, dst, channels, i, samples);
+}
+
+void deinterleaveS16(const int16_t* src, int16_t* const* dst, unsigned channels, unsigned samples)
+{
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    if (channels == 2) {
+        for (; i + 8 <= samples; i += 8) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(src + 2*i));
+            __m128i b = _mm_loadu_si128((const __m128i*)(src + 2*i + 8));
+            //NOTE: left samples are sign extended from the low half of each pair and right ones
+            //      shifted from the high half, so packing back to 16 bits never saturates
+            __m128i l = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+                                        _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+            __m128i r = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+            _mm_storeu_si128((__m128i*)(dst[0] + i), l);
+            _mm_storeu_si128((__m128i*)(dst[1] + i), r);
+        }
+    }
+#endif
+
+    deinterleaveGeneric(src, dst, channels, i, samples);
+}
+
+void interleaveFloat(const float* const* src, float* dst, unsigned channels, unsigned samples)
+{
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    if (channels == 2) {
+        for (; i + 4 <= samples; i += 4) {
+            __m128 l = _mm_loadu_ps(src[0] + i);
+            __m128 r = _mm_loadu_ps(src[1] + i);
+            _mm_storeu_ps(dst + 2*i, _mm_unpacklo_ps(l, r));
+            _mm_storeu_ps(dst + 2*i + 4, _mm_unpackhi_ps(l, r));
+        }
+    }
+#endif
+
+    interleaveGeneric(src, dst, channels, i, samples);
+}
+
+void deinterleaveFloat(const float* src, float* const* dst, unsigned channels, unsigned samples)
+{
+    unsigned i = 0;
+
+#ifdef __SSE2__
+    if (channels == 2) {
+        for (; i + 4 <= samples; i += 4) {
+            __m128 a = _mm_loadu_ps(src + 2*i);
+            __m128 b = _mm_loadu_ps(src + 2*i + 4);
+            _mm_storeu_ps(dst[0] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(dst[1] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+    }
+#endif
+
+    deinterleaveGeneric(src, dst, channels, i, samples);
+}
+
+}
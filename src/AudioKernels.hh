@@ -0,0 +1,177 @@
+/*
+ *  AudioKernels.hh - Block based audio sample processing kernels
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _AUDIO_KERNELS_HH
+#define _AUDIO_KERNELS_HH
+
+#include <stdint.h>
+
+/*! Sample processing loops working on whole blocks of one audio channel. Each one has an
+    SSE2 implementation (used when the compiler targets it) and a plain C++ fallback.
+    Buffers do not need to be aligned. Float samples are in the [-1.0, 1.0] range and
+    S16 samples are native endian, as libav planar formats. */
+
+namespace audiokernels
+{
+    /**
+    * Converts S16 samples to float
+    * @param src Input samples
+    * @param dst Output samples
+    * @param samples Number of samples
+    */
+    void s16ToFloat(const int16_t* src, float* dst, unsigned samples);
+
+    /**
+    * Converts float samples to S16, saturating values out of range
+    * @param src Input samples
+    * @param dst Output samples
+    * @param samples Number of samples
+    */
+    void floatToS16(const float* src, int16_t* dst, unsigned samples);
+
+    /**
+    * Accumulates float samples multiplied by a gain (acc += src*gain)
+    * @param src Input samples
+    * @param acc Accumulation buffer
+    * @param gain Gain applied to the input samples
+    * @param samples Number of samples
+    */
+    void mulAdd(const float* src, float* acc, float gain, unsigned samples);
+
+    /**
+    * Accumulates S16 samples converted to float and multiplied by a gain
+    * @param src Input samples
+    * @param acc Accumulation buffer
+    * @param gain Gain applied to the input samples
+    * @param samples Number of samples
+    */
+    void mulAddS16(const int16_t* src, float* acc, float gain, unsigned samples);
+
+    /**
+    * Subtracts two blocks of float samples (dst = a - b)
+    * @param a Minuend samples
+    * @param b Subtrahend samples
+    * @param dst Output samples, it can be the same buffer as a
+    * @param samples Number of samples
+    */
+    void subtract(const float* a, const float* b, float* dst, unsigned samples);
+
+    /**
+    * Applies in place the static compression curve used by the mixer. Values over the
+    * threshold are scaled by (1-th)/(2-th), so 2.0 is mapped to 1.0
+    * @param buffer Samples to compress
+    * @param th Compression threshold
+    * @param samples Number of samples
+    */
+    void compress(float* buffer, float th, unsigned samples);
+
+    /**
+    * Computes the peak absolute value of float samples
+    * @param src Input samples
+    * @param samples Number of samples
+    * @return maximum absolute sample value
+    */
+    float peak(const float* src, unsigned samples);
+
+    /**
+    * Multiplies in place float samples by a linear gain ramp (buffer[i] *= gain + step*i)
+    * @param buffer Samples to scale
+    * @param gain Gain applied to the first sample
+    * @param step Gain increment between consecutive samples
+    * @param samples Number of samples
+    */
+    void gainRamp(float* buffer, float gain, float step, unsigned samples);
+
+    /**
+    * Computes the sum of squares of float samples, used for energy measures
+    * @param src Input samples
+    * @param samples Number of samples
+    * @return sum of the squared samples
+    */
+    float sumSquares(const float* src, unsigned samples);
+
+    /**
+    * Computes the sum of squares of S16 samples, normalized to the float range
+    * @param src Input samples
+    * @param samples Number of samples
+    * @return sum of the squared samples
+    */
+    float sumSquaresS16(const int16_t* src, unsigned samples);
+
+    /**
+    * Computes in a single pass the peak absolute value and the sum of squares of float
+    * samples, used by level meters
+    * @param src Input samples
+    * @param samples Number of samples
+    * @param sum (out) Sum of the squared samples
+    * @return maximum absolute sample value
+    */
+    float peakSumSquares(const float* src, unsigned samples, float &sum);
+
+    /**
+    * Computes in a single pass the peak absolute value and the sum of squares of S16
+    * samples, both normalized to the float range
+    * @param src Input samples
+    * @param samples Number of samples
+    * @param sum (out) Sum of the squared samples
+    * @return maximum absolute sample value
+    */
+    float peakSumSquaresS16(const int16_t* src, unsigned samples, float &sum);
+
+    /**
+    * Interleaves planar S16 samples (S16P to S16)
+    * @param src Input planes, one per channel
+    * @param dst Output interleaved samples
+    * @param channels Number of channels
+    * @param samples Number of samples per channel
+    */
+    void interleaveS16(const int16_t* const* src, int16_t* dst, unsigned channels, unsigned samples);
+
+    /**
+    * Deinterleaves S16 samples (S16 to S16P)
+    * @param src Input interleaved samples
+    * @param dst Output planes, one per channel
+    * @param channels Number of channels
+    * @param samples Number of samples per channel
+    */
+    void deinterleaveS16(const int16_t* src, int16_t* const* dst, unsigned channels, unsigned samples);
+
+    /**
+    * Interleaves planar float samples (FLTP to FLT)
+    * @param src Input planes, one per channel
+    * @param dst Output interleaved samples
+    * @param channels Number of channels
+    * @param samples Number of samples per channel
+    */
+    void interleaveFloat(const float* const* src, float* dst, unsigned channels, unsigned samples);
+
+    /**
+    * Deinterleaves float samples (FLT to FLTP)
+    * @param src Input interleaved samples
+    * @param dst Output planes, one per channel
+    * @param channels Number of channels
+    * @param samples Number of samples per channel
+    */
+    void deinterleaveFloat(const float* src, float* const* dst, unsigned channels, unsigned samples);
+}
+
+#endif
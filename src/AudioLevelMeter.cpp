@@ -0,0 +1,274 @@
+/*
+ *  AudioLevelMeter.cpp - Per-channel audio level meter
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "AudioLevelMeter.hh"
+#include "AudioKernels.hh"
+
+#include <algorithm>
+#include <cmath>
+
+#define U8_TO_FLOAT (1.0f/128.0f)
+#define S16_TO_FLOAT (1.0f/32768.0f)
+
+AudioLevelMeter::AudioLevelMeter(unsigned channels, unsigned sampleRate) :
+    enabled(false), loudnessEnabled(false), loudness(METER_FLOOR), active(false), loudnessActive(false)
+{
+    setup(channels, sampleRate);
+}
+
+void AudioLevelMeter::setup(unsigned channels, unsigned sampleRate)
+{
+    this->channels.store(std::min(channels, (unsigned) MAX_CHANNELS), std::memory_order_relaxed);
+    this->sampleRate = sampleRate;
+    windowSamples = std::max(sampleRate*METER_WINDOW/1000, 1u);
+
+    setFilters();
+    reset();
+}
+
+void AudioLevelMeter::configure(bool enable, bool loudness)
+{
+    loudnessEnabled = enable && loudness;
+    enabled = enable;
+}
+
+void AudioLevelMeter::reset()
+{
+    count = 0;
+    kEnergy = 0;
+    blockIdx = 0;
+    blocks = 0;
+
+    for (unsigned i = 0; i < MAX_CHANNELS; i++) {
+        maxPeak[i] = 0;
+        energy[i] = 0;
+        shelfState[i][0] = shelfState[i][1] = 0;
+        highPassState[i][0] = highPassState[i][1] = 0;
+        peaks[i] = METER_FLOOR;
+        rms[i] = METER_FLOOR;
+    }
+
+    loudness = METER_FLOOR;
+}
+
+void AudioLevelMeter::setFilters()
+{
+    double k;
+    double vh;
+    double vb;
+    double a0;
+    //NOTE: BS.1770 pre-filter (high shelf) and RLB filter (high pass) parameters, which
+    //      give the coefficients of the recommendation at 48KHz and work at any rate
+    const double shelfF0 = 1681.974450955533;
+    const double shelfGain = 3.999843853973347;
+    const double shelfQ = 0.7071752369554196;
+    const double highPassF0 = 38.13547087602444;
+    const double highPassQ = 0.5003270373238773;
+
+    k = std::tan(M_PI*shelfF0/sampleRate);
+    vh = std::pow(10.0, shelfGain/20);
+    vb = std::pow(vh, 0.4996667741545416);
+    a0 = 1 + k/shelfQ + k*k;
+    shelf.b0 = (vh + vb*k/shelfQ + k*k)/a0;
+    shelf.b1 = 2*(k*k - vh)/a0;
+    shelf.b2 = (vh - vb*k/shelfQ + k*k)/a0;
+    shelf.a1 = 2*(k*k - 1)/a0;
+    shelf.a2 = (1 - k/shelfQ + k*k)/a0;
+
+    k = std::tan(M_PI*highPassF0/sampleRate);
+    a0 = 1 + k/highPassQ + k*k;
+    highPass.b0 = 1;
+    highPass.b1 = -2;
+    highPass.b2 = 1;
+    highPass.a1 = 2*(k*k - 1)/a0;
+    highPass.a2 = (1 - k/highPassQ + k*k)/a0;
+}
+
+void AudioLevelMeter::process(unsigned char const* const* data, SampleFmt fmt, unsigned offset, unsigned samples)
+{
+    unsigned nChannels = channels.load(std::memory_order_relaxed);
+    unsigned len;
+    unsigned bytesPerSample;
+    unsigned char const* src;
+    float sum;
+    float peak;
+
+    if (!enabled.load(std::memory_order_relaxed)) {
+        active = false;
+        return;
+    }
+
+    if (!active || loudnessActive != loudnessEnabled.load(std::memory_order_relaxed)) {
+        reset();
+        active = true;
+        loudnessActive = loudnessEnabled.load(std::memory_order_relaxed);
+    }
+
+    switch (fmt) {
+        case U8P:
+            bytesPerSample = 1;
+            break;
+        case S16P:
+            bytesPerSample = 2;
+            break;
+        case FLTP:
+            bytesPerSample = 4;
+            break;
+        default:
+            return;
+    }
+
+    //NOTE: spans are split at window edges, so each window is published as soon as it is full
+    for (unsigned pos = 0; pos < samples; pos += len) {
+        len = std::min(samples - pos, windowSamples - count);
+
+        for (unsigned i = 0; i < nChannels; i++) {
+            src = data[i] + (offset + pos)*bytesPerSample;
+
+            switch (fmt) {
+                case FLTP:
+                    peak = audiokernels::peakSumSquares((const float*) src, len, sum);
+                    break;
+                case S16P:
+                    peak = audiokernels::peakSumSquaresS16((const int16_t*) src, len, sum);
+                    break;
+                default:
+                    peak = 0;
+                    sum = 0;
+                    for (unsigned j = 0; j < len; j++) {
+                        float value = ((int) src[j] - 128)*U8_TO_FLOAT;
+                        peak = std::max(peak, std::abs(value));
+                        sum += value*value;
+                    }
+                    break;
+            }
+
+            maxPeak[i] = std::max(maxPeak[i], peak);
+            energy[i] += sum;
+
+            if (loudnessActive) {
+                kEnergy += kWeightedEnergy(src, fmt, i, len);
+            }
+        }
+
+        count += len;
+
+        if (count == windowSamples) {
+            publish();
+        }
+    }
+}
+
+double AudioLevelMeter::kWeightedEnergy(unsigned char const* data, SampleFmt fmt, unsigned channel, unsigned samples)
+{
+    double* s = shelfState[channel];
+    double* h = highPassState[channel];
+    double sum = 0;
+    double x;
+    double y;
+
+    for (unsigned j = 0; j < samples; j++) {
+        switch (fmt) {
+            case FLTP:
+                x = ((const float*) data)[j];
+                break;
+            case S16P:
+                x = ((const int16_t*) data)[j]*S16_TO_FLOAT;
+                break;
+            default:
+                x = ((int) data[j] - 128)*U8_TO_FLOAT;
+                break;
+        }
+
+        //NOTE: both stages as transposed direct form II biquads
+        y = shelf.b0*x + s[0];
+        s[0] = shelf.b1*x - shelf.a1*y + s[1];
+        s[1] = shelf.b2*x - shelf.a2*y;
+        x = y;
+
+        y = highPass.b0*x + h[0];
+        h[0] = highPass.b1*x - highPass.a1*y + h[1];
+        h[1] = highPass.b2*x - highPass.a2*y;
+
+        sum += y*y;
+    }
+
+    return sum;
+}
+
+void AudioLevelMeter::publish()
+{
+    unsigned nChannels = channels.load(std::memory_order_relaxed);
+    double total = 0;
+
+    for (unsigned i = 0; i < nChannels; i++) {
+        peaks[i].store(maxPeak[i] > 0 ? std::max(20*std::log10(maxPeak[i]), (float) METER_FLOOR) : METER_FLOOR,
+                       std::memory_order_relaxed);
+        rms[i].store(energy[i] > 0 ? std::max(10*std::log10(energy[i]/count), METER_FLOOR) : METER_FLOOR,
+                     std::memory_order_relaxed);
+        maxPeak[i] = 0;
+        energy[i] = 0;
+    }
+
+    if (loudnessActive) {
+        blockEnergy[blockIdx] = kEnergy/count;
+        blockIdx = (blockIdx + 1) % LOUDNESS_BLOCKS;
+        blocks = std::min(blocks + 1, (unsigned) LOUDNESS_BLOCKS);
+
+        for (unsigned j = 0; j < blocks; j++) {
+            total += blockEnergy[j];
+        }
+
+        total /= blocks;
+        loudness.store(total > 0 ? std::max(-0.691 + 10*std::log10(total), METER_FLOOR) : METER_FLOOR,
+                       std::memory_order_relaxed);
+    }
+
+    kEnergy = 0;
+    count = 0;
+}
+
+float AudioLevelMeter::getPeak(unsigned channel) const
+{
+    return channel < MAX_CHANNELS ? peaks[channel].load(std::memory_order_relaxed) : METER_FLOOR;
+}
+
+float AudioLevelMeter::getRms(unsigned channel) const
+{
+    return channel < MAX_CHANNELS ? rms[channel].load(std::memory_order_relaxed) : METER_FLOOR;
+}
+
+void AudioLevelMeter::getState(Jzon::Object &node) const
+{
+    Jzon::Array jsonPeaks;
+    Jzon::Array jsonRms;
+    unsigned nChannels = getChannels();
+
+    for (unsigned i = 0; i < nChannels; i++) {
+        jsonPeaks.Add(getPeak(i));
+        jsonRms.Add(getRms(i));
+    }
+
+    node.Add("peak", jsonPeaks);
+    node.Add("rms", jsonRms);
+    node.Add("loudness", getLoudness());
+}
@@ -0,0 +1,149 @@
+/*
+ *  AudioLevelMeter.hh - Per-channel audio level meter
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _AUDIO_LEVEL_METER_HH
+#define _AUDIO_LEVEL_METER_HH
+
+#include <atomic>
+
+#include "AudioFrame.hh"
+#include "Jzon.h"
+
+#define METER_WINDOW 100            //ms
+#define LOUDNESS_WINDOW 3000        //ms, short-term loudness
+#define METER_FLOOR -100.0          //dBFS
+#define LOUDNESS_BLOCKS (LOUDNESS_WINDOW/METER_WINDOW)
+
+/*! Block based peak and RMS meter of planar audio. Samples are measured where they are
+    already being copied or mixed, with one fused pass per channel span, and values are
+    published every METER_WINDOW milliseconds. Optionally, short-term loudness (ITU-R
+    BS.1770 K-weighting over the last LOUDNESS_WINDOW milliseconds, without channel
+    weighting nor gating) is computed as well, which filters every sample and so it
+    is disabled by default.
+
+    process is only called from one thread (the one producing the measured audio),
+    configure and the getters can be called from any thread, as the published values
+    are atomic. Metering is disabled until configure enables it.
+*/
+
+class AudioLevelMeter {
+
+public:
+    /**
+    * Class constructor
+    * @param channels Number of channels
+    * @param sampleRate Sample rate of the measured audio
+    */
+    AudioLevelMeter(unsigned channels, unsigned sampleRate);
+
+    /**
+    * Changes the measured layout and resets the meter. It must be called from the
+    * thread calling process
+    * @param channels Number of channels
+    * @param sampleRate Sample rate of the measured audio
+    */
+    void setup(unsigned channels, unsigned sampleRate);
+
+    /**
+    * Enables or disables metering. It can be called from any thread, it is applied
+    * with the next processed block
+    * @param enable True to measure peak and RMS levels
+    * @param loudness True to measure short-term loudness as well
+    */
+    void configure(bool enable, bool loudness = false);
+
+    /**
+    * Measures a span of samples
+    * @param data Planes of the measured audio, one per channel
+    * @param fmt Sample format (U8P, S16P and FLTP are supported)
+    * @param offset Position of the first sample to measure in each plane
+    * @param samples Number of samples to measure
+    */
+    void process(unsigned char const* const* data, SampleFmt fmt, unsigned offset, unsigned samples);
+
+    bool isEnabled() const {return enabled;};
+    bool isLoudnessEnabled() const {return loudnessEnabled;};
+    unsigned getChannels() const {return channels.load(std::memory_order_relaxed);};
+
+    /**
+    * @param channel Channel index
+    * @return peak level of the last window in dBFS
+    */
+    float getPeak(unsigned channel) const;
+
+    /**
+    * @param channel Channel index
+    * @return RMS level of the last window in dBFS
+    */
+    float getRms(unsigned channel) const;
+
+    /**
+    * @return short-term loudness in LUFS, METER_FLOOR if not measured
+    */
+    float getLoudness() const {return loudness;};
+
+    /**
+    * Adds the published values to a state node
+    * @param node Node where "peak" and "rms" arrays (one value per channel) and
+    * "loudness" are added
+    */
+    void getState(Jzon::Object &node) const;
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+
+    void reset();
+    void setFilters();
+    double kWeightedEnergy(unsigned char const* data, SampleFmt fmt, unsigned channel, unsigned samples);
+    void publish();
+
+    std::atomic<unsigned> channels;                 //read by the getters, set by the thread calling process
+    unsigned sampleRate;
+    unsigned windowSamples;
+
+    std::atomic<bool> enabled;
+    std::atomic<bool> loudnessEnabled;
+    std::atomic<float> peaks[MAX_CHANNELS];         //dBFS
+    std::atomic<float> rms[MAX_CHANNELS];           //dBFS
+    std::atomic<float> loudness;                    //LUFS
+
+    //NOTE: measuring state is only used by the thread calling process
+    bool active;
+    bool loudnessActive;
+    unsigned count;
+    float maxPeak[MAX_CHANNELS];
+    double energy[MAX_CHANNELS];
+    double kEnergy;
+
+    Biquad shelf;
+    Biquad highPass;
+    double shelfState[MAX_CHANNELS][2];
+    double highPassState[MAX_CHANNELS][2];
+
+    double blockEnergy[LOUDNESS_BLOCKS];
+    unsigned blockIdx;
+    unsigned blocks;
+};
+
+#endif
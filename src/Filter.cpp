@@ -516,7 +516,7 @@ std::vector<int> BaseFilter::regularProcessFrame(int& ret)
     runDoProcessFrame(oFrames, dFrames, newFrames, ret);
     
     //TODO: manage ret value
-    enabledJobs = addFrames(dFrames);
+    enabledJobs = mergeFlushedJobs(addFrames(dFrames));
     
     removeFrames(newFrames);
 
@@ -537,7 +537,7 @@ std::vector<int> BaseFilter::serverProcessFrame(int& ret)
 
     runDoProcessFrame(oFrames, dFrames, newFrames, ret);
 
-    enabledJobs = addFrames(dFrames);
+    enabledJobs = mergeFlushedJobs(addFrames(dFrames));
     removeFrames(newFrames);
     
     //ret = 0;
@@ -545,6 +545,18 @@ std::vector<int> BaseFilter::serverProcessFrame(int& ret)
     return enabledJobs;
 }
 
+std::vector<int> BaseFilter::mergeFlushedJobs(std::vector<int> enabledJobs)
+{
+    for (auto id : flushedJobs) {
+        if (std::find(enabledJobs.begin(), enabledJobs.end(), id) == enabledJobs.end()) {
+            enabledJobs.push_back(id);
+        }
+    }
+
+    flushedJobs.clear();
+    return enabledJobs;
+}
+
 bool BaseFilter::demandOriginFrames(std::map<int, Frame*> &oFrames, std::vector<int> &newFrames)
 {
     std::lock_guard<std::mutex> guard(mtx);
@@ -759,6 +771,21 @@ bool OneToOneFilter::runDoProcessFrame(std::map<int, Frame*> &oFrames,
     if (!doProcessFrame(oFrames.begin()->second, dFrames.begin()->second)) {
         return false;
     }
+
+    //NOTE: the last flushed frame is added by the caller, as the processed one would be
+    while (dFrames.begin()->second->getConsumed() && hasPendingFrames()) {
+        std::vector<int> jobs = addFrames(dFrames);
+        flushedJobs.insert(flushedJobs.end(), jobs.begin(), jobs.end());
+        dFrames.clear();
+
+        if (!demandDestinationFrames(dFrames) || dFrames.empty()) {
+            break;
+        }
+
+        if (!flushFrame(dFrames.begin()->second)) {
+            break;
+        }
+    }
     
     return true;
 }
@@ -878,3 +905,25 @@ bool ManyToOneFilter::runDoProcessFrame(std::map<int, Frame*> &oFrames,
     return true;
 }
 
+ManyToManyFilter::ManyToManyFilter(unsigned readersNum, unsigned writersNum, FilterRole fRole_, bool periodic) :
+    BaseFilter(readersNum, writersNum, fRole_, periodic)
+{
+}
+
+bool ManyToManyFilter::runDoProcessFrame(std::map<int, Frame*> &oFrames, 
+                                         std::map<int, Frame*> &dFrames, 
+                                         std::vector<int> newFrames, int& /*ret*/)
+{
+    if (!doProcessFrame(oFrames, dFrames, newFrames)) {
+        return false;
+    }
+
+    for (auto it : dFrames) {
+        if (it.second->getConsumed()) {
+            it.second->setOriginTime(std::chrono::high_resolution_clock::now());
+            it.second->setSequenceNumber(seqNums[it.first]++);
+        }
+    }
+
+    return true;
+}
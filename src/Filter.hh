@@ -246,9 +246,12 @@ protected:
     const unsigned maxWriters;
     std::chrono::microseconds frameTime;
     const std::chrono::microseconds syncMargin;
+    //NOTE: readers enabled by frames added inside runDoProcessFrame, returned with the processed frame ones
+    std::vector<int> flushedJobs;
 
 private:
     bool connect(BaseFilter *R, int writerID, int readerID);
+    std::vector<int> mergeFlushedJobs(std::vector<int> enabledJobs);
     std::vector<int> regularProcessFrame(int& ret);
     std::vector<int> serverProcessFrame(int& ret);
 
@@ -276,6 +279,15 @@ class OneToOneFilter : public BaseFilter {
 protected:
     OneToOneFilter(FilterRole fRole_= REGULAR, bool periodic = false);
     virtual bool doProcessFrame(Frame *org, Frame *dst) = 0;
+
+    /**
+    * Filters producing more than one output frame from one input frame override these two methods.
+    * While hasPendingFrames returns true after processing a frame, flushFrame is called with a new
+    * destination frame each time, so all the frames are delivered in the same processing cycle
+    */
+    virtual bool hasPendingFrames() {return false;};
+    virtual bool flushFrame(Frame* /*dst*/) {return false;};
+
     using BaseFilter::setFrameTime;
     using BaseFilter::getFrameTime;
 
@@ -423,4 +435,31 @@ private:
     using BaseFilter::mtx;
 };
 
+class ManyToManyFilter : public BaseFilter {
+
+protected:
+    ManyToManyFilter(unsigned readersNum = MAX_READERS, unsigned writersNum = MAX_WRITERS, FilterRole fRole_ = REGULAR, bool periodic = false);
+    virtual bool doProcessFrame(std::map<int, Frame *> &orgFrames, std::map<int, Frame *> &dstFrames, std::vector<int> newFrames) = 0;
+    using BaseFilter::setFrameTime;
+    using BaseFilter::getFrameTime;
+
+private:   
+    bool runDoProcessFrame(std::map<int, Frame*> &oFrames, 
+                           std::map<int, Frame*> &dFrames, 
+                           std::vector<int> newFrames, int& /*ret*/);
+
+    using BaseFilter::demandOriginFrames;
+    using BaseFilter::demandDestinationFrames;
+    using BaseFilter::addFrames;
+    using BaseFilter::removeFrames;
+    using BaseFilter::writers;
+    using BaseFilter::readers;
+    using BaseFilter::seqNums;
+    using BaseFilter::processEvent;
+    using BaseFilter::frameTime;
+    using BaseFilter::maxReaders;
+    using BaseFilter::maxWriters;
+    using BaseFilter::mtx;
+};
+
 #endif
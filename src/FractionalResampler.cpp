@@ -0,0 +1,142 @@
+/*
+ *  FractionalResampler.cpp - Polyphase resampler for small sample rate corrections
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "FractionalResampler.hh"
+
+#include <cmath>
+#include <cstring>
+
+#define HALF_TAPS (RESAMPLER_TAPS/2)
+
+FractionalResampler::FractionalResampler(unsigned channels) : channels(channels), step(1)
+{
+    double t;
+    double sinc;
+    double window;
+    double sum;
+
+    //NOTE: tap k of phase p weights the input sample at distance p/PHASES + HALF_TAPS - 1 - k
+    for (unsigned p = 0; p <= RESAMPLER_PHASES; p++) {
+        sum = 0;
+
+        for (unsigned k = 0; k < RESAMPLER_TAPS; k++) {
+            t = (double) p/RESAMPLER_PHASES + HALF_TAPS - 1 - k;
+            //NOTE: exact zeros at integer distances, so a ratio of 1 is a plain copy
+            if (t == 0) {
+                sinc = 1;
+            } else if (t == floor(t)) {
+                sinc = 0;
+            } else {
+                sinc = sin(M_PI*t)/(M_PI*t);
+            }
+
+            window = 0.42 + 0.5*cos(M_PI*t/HALF_TAPS) + 0.08*cos(2*M_PI*t/HALF_TAPS);
+            coefficients[p][k] = sinc*window;
+            sum += coefficients[p][k];
+        }
+
+        //NOTE: unity gain at DC for every phase
+        for (unsigned k = 0; k < RESAMPLER_TAPS; k++) {
+            coefficients[p][k] /= sum;
+        }
+    }
+
+    reset();
+}
+
+void FractionalResampler::reset()
+{
+    //NOTE: the filter needs HALF_TAPS - 1 past samples, silence is assumed at the beginning
+    for (unsigned c = 0; c < channels; c++) {
+        history[c].assign(HALF_TAPS - 1, 0);
+    }
+
+    buffered = HALF_TAPS - 1;
+    position = HALF_TAPS - 1;
+}
+
+unsigned FractionalResampler::process(const float* const* in, unsigned inSamples, float* const* out, unsigned maxOutSamples)
+{
+    float taps[RESAMPLER_TAPS];
+    unsigned produced = 0;
+    unsigned idx;
+    unsigned phase;
+    unsigned discarded;
+    double phasePos;
+    float alpha;
+    float value;
+    const float* x;
+
+    for (unsigned c = 0; c < channels; c++) {
+        if (history[c].size() < buffered + inSamples) {
+            history[c].resize(buffered + inSamples);
+        }
+
+        memcpy(history[c].data() + buffered, in[c], inSamples*sizeof(float));
+    }
+
+    buffered += inSamples;
+
+    while (produced < maxOutSamples) {
+        idx = (unsigned) position;
+
+        if (idx + HALF_TAPS >= buffered) {
+            break;
+        }
+
+        phasePos = (position - idx)*RESAMPLER_PHASES;
+        phase = (unsigned) phasePos;
+        alpha = phasePos - phase;
+
+        for (unsigned k = 0; k < RESAMPLER_TAPS; k++) {
+            taps[k] = coefficients[phase][k] + alpha*(coefficients[phase + 1][k] - coefficients[phase][k]);
+        }
+
+        for (unsigned c = 0; c < channels; c++) {
+            x = history[c].data() + idx + 1 - HALF_TAPS;
+            value = 0;
+
+            for (unsigned k = 0; k < RESAMPLER_TAPS; k++) {
+                value += x[k]*taps[k];
+            }
+
+            out[c][produced] = value;
+        }
+
+        produced++;
+        position += step;
+    }
+
+    //NOTE: samples no longer needed by the next output are dropped
+    idx = (unsigned) position;
+    discarded = idx + 1 > HALF_TAPS ? idx + 1 - HALF_TAPS : 0;
+    discarded = discarded > buffered ? buffered : discarded;
+
+    for (unsigned c = 0; c < channels; c++) {
+        memmove(history[c].data(), history[c].data() + discarded, (buffered - discarded)*sizeof(float));
+    }
+
+    buffered -= discarded;
+    position -= discarded;
+
+    return produced;
+}
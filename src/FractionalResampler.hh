@@ -0,0 +1,88 @@
+/*
+ *  FractionalResampler.hh - Polyphase resampler for small sample rate corrections
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _FRACTIONAL_RESAMPLER_HH
+#define _FRACTIONAL_RESAMPLER_HH
+
+#include <vector>
+
+#include "AudioFrame.hh"
+
+#define RESAMPLER_TAPS 16
+#define RESAMPLER_PHASES 64
+
+/*! Streaming resampler for planar float audio with a ratio close to 1, used to compensate
+    clock drift between a producer and a consumer. Output samples are interpolated with a
+    Blackman windowed sinc filter, whose coefficients are precomputed for RESAMPLER_PHASES
+    fractional positions and linearly interpolated between them. Since the ratio is close
+    to 1 there is no need of anti-aliasing, so the filter cutoff is the Nyquist frequency and
+    a ratio of exactly 1 copies the input. The history starts with RESAMPLER_TAPS/2 - 1 samples
+    of silence, which are not output, and the last RESAMPLER_TAPS/2 input samples are held until
+    the next call. The ratio can be changed between calls without discontinuities.
+*/
+
+class FractionalResampler {
+
+public:
+    /**
+    * Class constructor
+    * @param channels Number of channels
+    */
+    FractionalResampler(unsigned channels);
+
+    /**
+    * Sets the resampling ratio
+    * @param ratio Output samples per input sample
+    */
+    void setRatio(double ratio) {step = 1/ratio;};
+
+    /**
+    * @return output samples per input sample
+    */
+    double getRatio() {return 1/step;};
+
+    /**
+    * Resamples a block of samples. Input samples that cannot be used yet are kept for the next call
+    * @param in Input buffers, one per channel
+    * @param inSamples Number of input samples
+    * @param out Output buffers, one per channel
+    * @param maxOutSamples Size of the output buffers in samples
+    * @return number of output samples
+    */
+    unsigned process(const float* const* in, unsigned inSamples, float* const* out, unsigned maxOutSamples);
+
+    /**
+    * Discards the buffered input samples
+    */
+    void reset();
+
+private:
+    unsigned channels;
+    double step;
+    double position;
+    unsigned buffered;
+
+    std::vector<float> history[MAX_CHANNELS];
+    float coefficients[RESAMPLER_PHASES + 1][RESAMPLER_TAPS];
+};
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ *  JobsPool.cpp - Persistent threads running short parallel jobs
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "JobsPool.hh"
+
+#include <algorithm>
+
+JobsPool* JobsPool::getInstance()
+{
+    //NOTE: the calling thread is one of the workers
+    static JobsPool instance(std::max(std::thread::hardware_concurrency(), 2U) - 1);
+    return &instance;
+}
+
+JobsPool::JobsPool(size_t threadsNum) : stop(false)
+{
+    for (size_t i = 0; i < threadsNum; i++) {
+        threads.push_back(std::thread(&JobsPool::work, this));
+    }
+}
+
+JobsPool::~JobsPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        stop = true;
+    }
+
+    jobsCv.notify_all();
+
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+void JobsPool::run(std::vector<std::function<void()>>& jobs)
+{
+    Batch batch = {&jobs, 0, 0};
+    std::unique_lock<std::mutex> lock(mtx);
+
+    if (jobs.empty()) {
+        return;
+    }
+
+    if (jobs.size() > 1) {
+        batches.push_back(&batch);
+        jobsCv.notify_all();
+    }
+
+    while (runNext(&batch, lock)) {}
+
+    doneCv.wait(lock, [&]{return batch.done == jobs.size();});
+}
+
+void JobsPool::work()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+
+    while (true) {
+        jobsCv.wait(lock, [&]{return stop || !batches.empty();});
+
+        if (batches.empty()) {
+            break;
+        }
+
+        runNext(batches.front(), lock);
+    }
+}
+
+bool JobsPool::runNext(Batch* batch, std::unique_lock<std::mutex>& lock)
+{
+    size_t job;
+
+    if (batch->next >= batch->jobs->size()) {
+        return false;
+    }
+
+    job = batch->next++;
+
+    //NOTE: once every job is taken the batch only waits for the running ones
+    if (batch->next == batch->jobs->size()) {
+        batches.erase(std::remove(batches.begin(), batches.end(), batch), batches.end());
+    }
+
+    lock.unlock();
+    (*batch->jobs)[job]();
+    lock.lock();
+
+    if (++batch->done == batch->jobs->size()) {
+        doneCv.notify_all();
+    }
+
+    return true;
+}
@@ -0,0 +1,81 @@
+/*
+ *  JobsPool.hh - Persistent threads running short parallel jobs
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _JOBS_POOL_HH
+#define _JOBS_POOL_HH
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+/*! Process wide set of threads shared by the filters that split the processing of a frame in
+    independent jobs (e.g. Dasher segmenters or VideoEncoderX264Ladder renditions). Threads are
+    started once, so a processing round only costs a notification instead of a thread creation per
+    job. The calling thread runs jobs of its own batch too, so batches always progress even when
+    every worker is busy with jobs of other filters. */
+
+class JobsPool {
+
+public:
+    /**
+    * Gets the workers instance, threads are started the first time
+    * @return pointer to the workers
+    */
+    static JobsPool* getInstance();
+
+    /**
+    * Class destructor, it waits for the running jobs and stops the threads
+    */
+    ~JobsPool();
+
+    /**
+    * Runs the jobs and returns when all of them are done
+    * @param jobs Jobs to run, they must not depend on each other
+    */
+    void run(std::vector<std::function<void()>>& jobs);
+
+    size_t getThreads() {return threads.size();};
+
+private:
+    struct Batch {
+        std::vector<std::function<void()>>* jobs;
+        size_t next;
+        size_t done;
+    };
+
+    JobsPool(size_t threadsNum);
+
+    void work();
+    bool runNext(Batch* batch, std::unique_lock<std::mutex>& lock);
+
+    std::vector<std::thread> threads;
+    std::mutex mtx;
+    std::condition_variable jobsCv;
+    std::condition_variable doneCv;
+    std::deque<Batch*> batches;
+    bool stop;
+};
+
+#endif
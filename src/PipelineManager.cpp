@@ -26,11 +26,14 @@
 #include "modules/audioEncoder/AudioEncoderLibav.hh"
 #include "modules/audioDecoder/AudioDecoderLibav.hh"
 #include "modules/audioMixer/AudioMixer.hh"
+#include "modules/audioMixer/AudioMixMinus.hh"
 #include "modules/videoEncoder/VideoEncoderX264.hh"
+#include "modules/videoEncoder/VideoEncoderX264Ladder.hh"
 #include "modules/videoDecoder/VideoDecoderLibav.hh"
 #include "modules/videoMixer/VideoMixer.hh"
 #include "modules/videoSplitter/VideoSplitter.hh"
 #include "modules/videoResampler/VideoResampler.hh"
+#include "modules/videoThumbnailer/VideoThumbnailer.hh"
 #include "modules/receiver/SourceManager.hh"
 #include "modules/transmitter/SinkManager.hh"
 #include "modules/headDemuxer/HeadDemuxerLibav.hh"
@@ -167,6 +170,15 @@ bool PipelineManager::createFilter(int id, FilterType type)
         case SHARED_MEMORY:
             filter = SharedMemory::createNew();
             break;
+        case VIDEO_THUMBNAILER:
+            filter = new VideoThumbnailer();
+            break;
+        case VIDEO_ENCODER_LADDER:
+            filter = VideoEncoderX264Ladder::createNew();
+            break;
+        case AUDIO_MIX_MINUS:
+            filter = new AudioMixMinus();
+            break;
         default:
             utils::errorMsg("Unknown filter type");
             break;
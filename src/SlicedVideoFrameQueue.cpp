@@ -127,25 +127,36 @@ bool SlicedVideoFrameQueue::setup(unsigned maxSliceSize)
 }
 
 void SlicedVideoFrameQueue::pushBackSliceGroup(Slice* slices, int sliceNum) 
+{
+    for (int i=0; i<sliceNum; i++) {
+        pushBackSlice(slices[i].getData(), slices[i].getDataSize());
+    }
+}
+
+bool SlicedVideoFrameQueue::pushBackSlice(unsigned char *data, unsigned size)
 {
     Frame* frame;
     VideoFrame* vFrame;
 
-    for (int i=0; i<sliceNum; i++) {
+    if ((frame = innerGetRear()) == NULL){
+        frame = innerForceGetRear();
+    }
 
-        if ((frame = innerGetRear()) == NULL){
-            frame = innerForceGetRear();
-        }
+    if (size > frame->getMaxLength()) {
+        utils::warningMsg("Slice discarded, it does not fit in SlicedVideoFrameQueue frames");
+        return false;
+    }
 
-        vFrame = dynamic_cast<VideoFrame*>(frame);
-        vFrame->setSequenceNumber(inputFrame->getSequenceNumber());
+    vFrame = dynamic_cast<VideoFrame*>(frame);
+    vFrame->setSequenceNumber(inputFrame->getSequenceNumber());
 
-        memcpy(vFrame->getDataBuf(), slices[i].getData(), slices[i].getDataSize());
-        vFrame->setLength(slices[i].getDataSize());
-        vFrame->setPresentationTime(inputFrame->getPresentationTime());
-        vFrame->setDecodeTime(inputFrame->getDecodeTime());
-        vFrame->setOriginTime(inputFrame->getOriginTime());
-        vFrame->setSize(inputFrame->getWidth(), inputFrame->getHeight());
-        innerAddFrame();
-    }
-}      
+    memcpy(vFrame->getDataBuf(), data, size);
+    vFrame->setLength(size);
+    vFrame->setPresentationTime(inputFrame->getPresentationTime());
+    vFrame->setDecodeTime(inputFrame->getDecodeTime());
+    vFrame->setOriginTime(inputFrame->getOriginTime());
+    vFrame->setSize(inputFrame->getWidth(), inputFrame->getHeight());
+    innerAddFrame();
+
+    return true;
+}
@@ -64,6 +64,16 @@ public:
     */
     Frame *forceGetRear();
 
+    /**
+    * It copies a single NAL unit into the internal VideoFrameQueue as soon as it is available, using the
+    * input frame timing information. Used by low latency encoders that output slices while the frame is
+    * still being encoded. Readers are notified once the input frame is added.
+    * @param data NAL unit data
+    * @param size NAL unit size in bytes
+    * @return true if success, false if the NAL does not fit in a queue frame
+    */
+    bool pushBackSlice(unsigned char *data, unsigned size);
+
 private:
     SlicedVideoFrameQueue(struct ConnectionData cData, const StreamInfo *si, unsigned maxFrames);
 
@@ -79,7 +79,7 @@ enum SampleFmt {S_NONE = -1, U8, S16, FLT, U8P, S16P, FLTP};
 /**
 * Filter types
 */
-enum FilterType {FT_NONE = -1, RECEIVER, TRANSMITTER, VIDEO_DECODER, VIDEO_ENCODER, VIDEO_RESAMPLER, VIDEO_MIXER, AUDIO_DECODER, AUDIO_ENCODER, AUDIO_MIXER, SHARED_MEMORY, DASHER, DEMUXER, VIDEO_SPLITTER, V4L_CAPTURE};
+enum FilterType {FT_NONE = -1, RECEIVER, TRANSMITTER, VIDEO_DECODER, VIDEO_ENCODER, VIDEO_RESAMPLER, VIDEO_MIXER, AUDIO_DECODER, AUDIO_ENCODER, AUDIO_MIXER, SHARED_MEMORY, DASHER, DEMUXER, VIDEO_SPLITTER, V4L_CAPTURE, VIDEO_THUMBNAILER, VIDEO_ENCODER_LADDER, AUDIO_MIX_MINUS};
 
 enum FilterRole {FR_NONE = -1, REGULAR, SERVER};
 
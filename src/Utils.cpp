@@ -308,6 +308,15 @@ namespace utils
             case V4L_CAPTURE:
                 stringType = "v4lcapture";
                 break;
+            case VIDEO_THUMBNAILER:
+                stringType = "videoThumbnailer";
+                break;
+            case VIDEO_ENCODER_LADDER:
+                stringType = "videoEncoderLadder";
+                break;
+            case AUDIO_MIX_MINUS:
+                stringType = "audioMixMinus";
+                break;
             default:
                 stringType = "";
                 break;
@@ -348,6 +357,12 @@ namespace utils
            fType = VIDEO_SPLITTER;
         }  else if (stringFilterType.compare("v4lcapture") == 0) {
            fType = V4L_CAPTURE;
+        }  else if (stringFilterType.compare("videoThumbnailer") == 0) {
+           fType = VIDEO_THUMBNAILER;
+        }  else if (stringFilterType.compare("videoEncoderLadder") == 0) {
+           fType = VIDEO_ENCODER_LADDER;
+        }  else if (stringFilterType.compare("audioMixMinus") == 0) {
+           fType = AUDIO_MIX_MINUS;
         }  else {
            fType = FT_NONE;
         }
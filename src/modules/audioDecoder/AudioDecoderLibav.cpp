@@ -23,8 +23,10 @@
 #include "AudioDecoderLibav.hh"
 #include "../../AudioCircularBuffer.hh"
 #include "../../Utils.hh"
+#include "../../AudioKernels.hh"
 #include <functional>
 #include <fstream>
+#include <cstring>
 
 AVSampleFormat getAVSampleFormatFromtIntCode(int id)
 {
@@ -62,9 +64,14 @@ AudioDecoderLibav::AudioDecoderLibav()
     fType = AUDIO_DECODER;
 
     inChannels = 0;
+    inChannelLayout = 0;
     inSampleRate = 0;
     inFrame = av_frame_alloc();
     inLibavSampleFmt = AV_SAMPLE_FMT_NONE;
+    resampling = false;
+
+    outputStreamInfo = new StreamInfo(AUDIO);
+    outputStreamInfo->audio.codec = PCM;
 
     initializeEventMap();
 
@@ -83,7 +90,7 @@ AudioDecoderLibav::~AudioDecoderLibav()
 FrameQueue* AudioDecoderLibav::allocQueue(ConnectionData cData)
 {
     return AudioCircularBuffer::createNew(cData, outChannels, outSampleRate, DEFAULT_BUFFER_SIZE, 
-                                            outSampleFmt);
+                                            outSampleFmt, outputStreamInfo);
 }
 
 bool AudioDecoderLibav::doProcessFrame(Frame *org, Frame *dst)
@@ -125,6 +132,7 @@ bool AudioDecoderLibav::doProcessFrame(Frame *org, Frame *dst)
         }
 
         checkSampleFormat(inFrame->format);
+        checkChannelLayout(inFrame);
 
         if (!resample(inFrame, aDecodedFrame)) {
             utils::errorMsg("Error resampling audio frame");
@@ -145,10 +153,19 @@ bool AudioDecoderLibav::doProcessFrame(Frame *org, Frame *dst)
 
 bool AudioDecoderLibav::configure0(SampleFmt sampleFormat, int channels, int sampleRate)
 {
+    if (channels <= 0 || channels > MAX_CHANNELS) {
+        utils::errorMsg("[AudioDecoderLibav] Number of output channels not supported: " + std::to_string(channels));
+        return false;
+    }
+
     outSampleFmt = sampleFormat;
     outChannels = channels;
     outSampleRate = sampleRate;
 
+    outputStreamInfo->audio.channels = outChannels;
+    outputStreamInfo->audio.sampleRate = outSampleRate;
+    outputStreamInfo->audio.sampleFormat = outSampleFmt;
+
     switch(outSampleFmt){
         case U8:
             outLibavSampleFmt = AV_SAMPLE_FMT_U8;
@@ -192,7 +209,7 @@ bool AudioDecoderLibav::inputConfig()
                     av_get_default_channel_layout(outChannels),
                     outLibavSampleFmt,
                     outSampleRate,
-                    av_get_default_channel_layout(inChannels),
+                    inChannelLayout ? inChannelLayout : av_get_default_channel_layout(inChannels),
                     inLibavSampleFmt,
                     inSampleRate,
                     0,
@@ -204,11 +221,10 @@ bool AudioDecoderLibav::inputConfig()
         return false;
     }
 
-    if (swr_is_initialized(resampleCtx) == 0) {
-        if (swr_init(resampleCtx) < 0) {
-            utils::errorMsg("Init context failure!");
-            return false;
-        }
+    //NOTE: an already initialized context keeps its old options until it is initialized again
+    if (swr_init(resampleCtx) < 0) {
+        utils::errorMsg("Init context failure!");
+        return false;
     }
 
     return true;
@@ -226,7 +242,7 @@ bool AudioDecoderLibav::outputConfig()
                     av_get_default_channel_layout(outChannels),
                     outLibavSampleFmt,
                     outSampleRate,
-                    av_get_default_channel_layout(inChannels),
+                    inChannelLayout ? inChannelLayout : av_get_default_channel_layout(inChannels),
                     inLibavSampleFmt,
                     inSampleRate,
                     0,
@@ -238,11 +254,10 @@ bool AudioDecoderLibav::outputConfig()
         return false;
     }
 
-    if (swr_is_initialized(resampleCtx) == 0) {
-        if (swr_init(resampleCtx) < 0) {
-            utils::errorMsg("Init context failure!");
-            return false;
-        }
+    //NOTE: an already initialized context keeps its old options until it is initialized again
+    if (swr_init(resampleCtx) < 0) {
+        utils::errorMsg("Init context failure!");
+        return false;
     }
 
     return true;
@@ -252,6 +267,12 @@ bool AudioDecoderLibav::resample(AVFrame* src, AudioFrame* dst)
 {
     int samples;
 
+    resampling = !isDirectConversion(src, dst);
+
+    if (!resampling) {
+        return directConversion(src, dst);
+    }
+
     if (dst->isPlanar()) {
         samples = swr_convert(
                     resampleCtx,
@@ -291,6 +312,67 @@ bool AudioDecoderLibav::resample(AVFrame* src, AudioFrame* dst)
     return true;
 }
 
+bool AudioDecoderLibav::isDirectConversion(AVFrame* src, AudioFrame* dst)
+{
+    AVSampleFormat srcFmt = (AVSampleFormat) src->format;
+
+    if (src->sample_rate != (int) outSampleRate || av_frame_get_channels(src) != (int) outChannels) {
+        return false;
+    }
+
+    //NOTE: same channel count with another layout (e.g. side vs back surrounds) needs remixing
+    if (frameChannelLayout(src) != (uint64_t) av_get_default_channel_layout(outChannels)) {
+        return false;
+    }
+
+    if (av_get_packed_sample_fmt(srcFmt) != av_get_packed_sample_fmt(outLibavSampleFmt)) {
+        return false;
+    }
+
+    if (src->nb_samples > (int) dst->getMaxSamples()) {
+        return false;
+    }
+
+    //NOTE: same format is a plain copy, planarity changes have kernels for S16 and float samples
+    return srcFmt == outLibavSampleFmt || bytesPerSample == sizeof(int16_t) || bytesPerSample == sizeof(float);
+}
+
+bool AudioDecoderLibav::directConversion(AVFrame* src, AudioFrame* dst)
+{
+    unsigned samples = src->nb_samples;
+    bool srcPlanar = av_sample_fmt_is_planar((AVSampleFormat) src->format);
+
+    if (srcPlanar && dst->isPlanar()) {
+        for (unsigned c = 0; c < outChannels; c++) {
+            memcpy(dst->getPlanarDataBuf()[c], src->extended_data[c], samples*bytesPerSample);
+        }
+    } else if (!srcPlanar && !dst->isPlanar()) {
+        memcpy(dst->getDataBuf(), src->data[0], outChannels*samples*bytesPerSample);
+    } else if (srcPlanar && bytesPerSample == sizeof(int16_t)) {
+        audiokernels::interleaveS16((const int16_t* const*) src->extended_data,
+                                    (int16_t*) dst->getDataBuf(), outChannels, samples);
+    } else if (srcPlanar) {
+        audiokernels::interleaveFloat((const float* const*) src->extended_data,
+                                      (float*) dst->getDataBuf(), outChannels, samples);
+    } else if (bytesPerSample == sizeof(int16_t)) {
+        audiokernels::deinterleaveS16((const int16_t*) src->data[0],
+                                      (int16_t* const*) dst->getPlanarDataBuf(), outChannels, samples);
+    } else {
+        audiokernels::deinterleaveFloat((const float*) src->data[0],
+                                        (float* const*) dst->getPlanarDataBuf(), outChannels, samples);
+    }
+
+    if (dst->isPlanar()) {
+        dst->setLength(samples*bytesPerSample);
+    } else {
+        dst->setLength(outChannels*samples*bytesPerSample);
+    }
+
+    dst->setSamples(samples);
+
+    return true;
+}
+
 void AudioDecoderLibav::checkSampleFormat(int sampleFormatCode)
 {
     AVSampleFormat sampleFormat = getAVSampleFormatFromtIntCode(sampleFormatCode);
@@ -328,6 +410,30 @@ void AudioDecoderLibav::checkSampleFormat(int sampleFormatCode)
     inputConfig();
 }
 
+uint64_t AudioDecoderLibav::frameChannelLayout(AVFrame* frame)
+{
+    int channels = av_frame_get_channels(frame);
+
+    //NOTE: unset or inconsistent layouts are taken as the default one for the channel count
+    if (frame->channel_layout == 0 || av_get_channel_layout_nb_channels(frame->channel_layout) != channels) {
+        return av_get_default_channel_layout(channels);
+    }
+
+    return frame->channel_layout;
+}
+
+void AudioDecoderLibav::checkChannelLayout(AVFrame* frame)
+{
+    uint64_t layout = frameChannelLayout(frame);
+
+    if (inChannelLayout == layout) {
+        return;
+    }
+
+    inChannelLayout = layout;
+    inputConfig();
+}
+
 bool AudioDecoderLibav::configEvent(Jzon::Node* params)
 {
     SampleFmt newSampleFmt = outSampleFmt;
@@ -378,6 +484,7 @@ void AudioDecoderLibav::doGetState(Jzon::Object &filterNode)
     filterNode.Add("sampleRate", (int)outSampleRate);
     filterNode.Add("channels", (int)outChannels);
     filterNode.Add("sampleFormat", utils::getSampleFormatAsString(outSampleFmt));
+    filterNode.Add("resampling", resampling);
 }
 
 bool AudioDecoderLibav::reconfigureDecoder(AudioFrame* frame)
@@ -395,6 +502,7 @@ bool AudioDecoderLibav::reconfigureDecoder(AudioFrame* frame)
 
     fCodec = frame->getCodec();
     inChannels = frame->getChannels();
+    inChannelLayout = 0;
     inSampleRate = frame->getSampleRate();
 
     switch(fCodec) {
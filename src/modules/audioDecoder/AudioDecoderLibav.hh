@@ -48,7 +48,11 @@ protected:
 private:
     void initializeEventMap();
     bool resample(AVFrame* src, AudioFrame* dst);
+    bool isDirectConversion(AVFrame* src, AudioFrame* dst);
+    bool directConversion(AVFrame* src, AudioFrame* dst);
     void checkSampleFormat(int sampleFormat);
+    void checkChannelLayout(AVFrame* frame);
+    uint64_t frameChannelLayout(AVFrame* frame);
     bool inputConfig();
     bool outputConfig();
     bool reconfigureDecoder(AudioFrame* frame);
@@ -76,11 +80,15 @@ private:
     SampleFmt inSampleFmt;
     SampleFmt outSampleFmt;
     unsigned inChannels;
+    uint64_t inChannelLayout;
     unsigned outChannels;
     unsigned inSampleRate;
     unsigned outSampleRate;
     unsigned bytesPerSample;
     unsigned char *auxBuff[1];
+    bool resampling;
+
+    StreamInfo *outputStreamInfo;
 
 };
 
@@ -25,14 +25,18 @@
 #include "../../AudioCircularBuffer.hh"
 #include "../../Utils.hh"
 
+#include <cstdlib>
+
 bool checkSampleFormat(AVCodec *codec, enum AVSampleFormat sampleFmt);
 bool checkSampleRateSupport(AVCodec *codec, int sampleRate);
 bool checkChannelLayoutSupport(AVCodec *codec, uint64_t channelLayout);
 
 AudioEncoderLibav::AudioEncoderLibav() : OneToOneFilter(),
+        fifo(NULL), convBuffer(NULL), convBufferSamples(0),
         samplesPerFrame(0), internalLibavSampleFmt(AV_SAMPLE_FMT_NONE),
         outputBitrate(0), inputChannels(0), inputSampleRate(0), inputSampleFmt(S_NONE),
-        inputLibavSampleFmt(AV_SAMPLE_FMT_NONE)
+        inputLibavSampleFmt(AV_SAMPLE_FMT_NONE), lastSeqNum(0), inputSamples(0),
+        encodedSamples(0), syncPts(true)
 {
     avcodec_register_all();
 
@@ -54,6 +58,7 @@ AudioEncoderLibav::AudioEncoderLibav() : OneToOneFilter(),
     framerateMod = 1;
 
     currentTime = std::chrono::microseconds(0);
+    lastPts = std::chrono::microseconds(0);
 
     initializeEventMap();
 }
@@ -65,6 +70,15 @@ AudioEncoderLibav::~AudioEncoderLibav()
     swr_free(&resampleCtx);
     av_free(libavFrame);
     av_packet_unref(&pkt);
+
+    if (fifo) {
+        av_audio_fifo_free(fifo);
+    }
+
+    if (convBuffer) {
+        av_freep(&convBuffer[0]);
+        av_freep(&convBuffer);
+    }
 }
 
 FrameQueue* AudioEncoderLibav::allocQueue(ConnectionData cData)
@@ -74,7 +88,6 @@ FrameQueue* AudioEncoderLibav::allocQueue(ConnectionData cData)
 
 bool AudioEncoderLibav::doProcessFrame(Frame *org, Frame *dst)
 {     
-    int ret, gotFrame, samples;
     AudioFrame* rawFrame;
     AudioFrame* codedFrame;
 
@@ -86,43 +99,148 @@ bool AudioEncoderLibav::doProcessFrame(Frame *org, Frame *dst)
         return false;
     }
 
+    if (!fifo) {
+        utils::errorMsg("Error encoding audio frame: encoder is not configured");
+        return false;
+    }
+
     if(!reconfigure(rawFrame)) {
         utils::errorMsg("Error reconfiguring audio encoder");
         return false;
     }
 
-    //set up buffer and buffer length pointers
-    pkt.data = codedFrame->getDataBuf();
-    pkt.size = codedFrame->getMaxLength();
-
-    //resample in order to adapt to encoder constraints
-    samples = resample(rawFrame, libavFrame);
+    if (syncPts) {
+        av_audio_fifo_reset(fifo);
+        basePts.clear();
+        basePts[0] = org->getPresentationTime();
+        inputSamples = 0;
+        encodedSamples = 0;
+        syncPts = false;
+    } else {
+        resyncPts(org->getPresentationTime());
+    }
 
-    if (samples <= 0) {
+    //resample in order to adapt to encoder constraints, samples are queued until there are enough to fill a codec frame
+    if (resample(rawFrame) < 0) {
         utils::errorMsg("Error encoding audio frame: resampling error");
         return false;
     }
 
-    ret = avcodec_encode_audio2(codecCtx, &pkt, libavFrame, &gotFrame);
+    lastOriginTime = org->getOriginTime();
+    lastSeqNum = org->getSequenceNumber();
+
+    return encodeFrame(codedFrame);
+}
+
+void AudioEncoderLibav::resyncPts(std::chrono::microseconds inPts)
+{
+    int64_t samples = inputSamples + av_audio_fifo_size(fifo);
+    std::chrono::microseconds expectedPts = samplePts(samples);
+
+    if (std::abs((inPts - expectedPts).count()) <= PTS_RESYNC_THRESHOLD) {
+        return;
+    }
+
+    //NOTE: samples already queued or inside the codec keep their timeline, 
+    //      a new one starts with the first sample of this input frame
+    utils::debugMsg("Audio encoder timestamps resynchronized, deviation " +
+                    std::to_string((inPts - expectedPts).count()) + " us");
+    basePts[samples] = inPts;
+}
+
+std::chrono::microseconds AudioEncoderLibav::samplePts(int64_t sample)
+{
+    std::map<int64_t, std::chrono::microseconds>::iterator base = basePts.upper_bound(sample);
+
+    if (base == basePts.begin()) {
+        return std::chrono::microseconds(sample*std::micro::den/outputStreamInfo->audio.sampleRate);
+    }
+
+    base--;
+    return base->second + 
+        std::chrono::microseconds((sample - base->first)*std::micro::den/outputStreamInfo->audio.sampleRate);
+}
+
+bool AudioEncoderLibav::hasPendingFrames()
+{
+    return fifo && av_audio_fifo_size(fifo) >= (int) samplesPerFrame;
+}
+
+bool AudioEncoderLibav::flushFrame(Frame *dst)
+{
+    AudioFrame* codedFrame;
+
+    codedFrame = dynamic_cast<AudioFrame*>(dst);
 
-    if (ret < 0) {
-        utils::errorMsg("Error encoding audio frame");
+    if (!codedFrame) {
+        utils::errorMsg("Error encoding audio frame: dst frame is not valid");
         return false;
     }
 
+    return encodeFrame(codedFrame);
+}
+
+bool AudioEncoderLibav::encodeFrame(AudioFrame* codedFrame)
+{
+    std::chrono::microseconds pts;
+    std::chrono::microseconds duration;
+    int ret;
+    int gotFrame = 0;
+
+    //NOTE: codecs with delay may need more than one frame before returning the first packet
+    while (!gotFrame && av_audio_fifo_size(fifo) >= (int) samplesPerFrame) {
+        if (av_frame_make_writable(libavFrame) < 0) {
+            utils::errorMsg("Error encoding audio frame: codec frame is not writable");
+            return false;
+        }
+
+        if (av_audio_fifo_read(fifo, (void**) libavFrame->data, samplesPerFrame) < (int) samplesPerFrame) {
+            utils::errorMsg("Error encoding audio frame: could not read from samples FIFO");
+            return false;
+        }
+
+        libavFrame->pts = inputSamples;
+        inputSamples += samplesPerFrame;
+
+        //set up buffer and buffer length pointers
+        pkt.data = codedFrame->getDataBuf();
+        pkt.size = codedFrame->getMaxLength();
+
+        ret = avcodec_encode_audio2(codecCtx, &pkt, libavFrame, &gotFrame);
+
+        if (ret < 0) {
+            utils::errorMsg("Error encoding audio frame");
+            return false;
+        }
+    }
+
     if (!gotFrame) {
-        utils::warningMsg("Could not encode audio frame");
         return false;
     }
 
     codedFrame->setLength(pkt.size);
-    codedFrame->setSamples(samples);
+    codedFrame->setSamples(samplesPerFrame);
+
+    //NOTE: timelines older than the one of the current packet are not needed anymore
+    while (basePts.size() > 1 && std::next(basePts.begin())->first <= encodedSamples) {
+        basePts.erase(basePts.begin());
+    }
+
+    //NOTE: backward input jumps would overlap the packets already delivered
+    pts = samplePts(encodedSamples);
+    duration = std::chrono::microseconds(samplesPerFrame*std::micro::den/outputStreamInfo->audio.sampleRate);
+    if (encodedSamples > 0 && pts < lastPts + duration) {
+        pts = lastPts + duration;
+    }
+    lastPts = pts;
+
+    codedFrame->setConsumed(true);
+    codedFrame->setPresentationTime(pts);
+    codedFrame->setDecodeTime(NO_DTS);
+    codedFrame->setOriginTime(lastOriginTime);
+    codedFrame->setSequenceNumber(lastSeqNum);
 
-    dst->setConsumed(true);
-    dst->setPresentationTime(org->getPresentationTime());
-    dst->setDecodeTime(NO_DTS);
-    dst->setOriginTime(org->getOriginTime());
-    dst->setSequenceNumber(org->getSequenceNumber());
+    encodedSamples += samplesPerFrame;
     
     return true;
 }
@@ -158,6 +276,11 @@ bool AudioEncoderLibav::configure0(ACodecType codec, int codedAudioChannels, int
         return false;
     }
 
+    if (codedAudioChannels <= 0 || codedAudioChannels > MAX_CHANNELS) {
+        utils::errorMsg("Audio encoder number of channels not supported: " + std::to_string(codedAudioChannels));
+        return false;
+    }
+
     outputStreamInfo->audio.codec = codec;
     outputStreamInfo->setCodecDefaults();
     outputStreamInfo->audio.channels = codedAudioChannels;
@@ -234,6 +357,8 @@ bool AudioEncoderLibav::codingConfig(AVCodecID codecId)
     codecCtx->sample_rate = outputStreamInfo->audio.sampleRate;
     codecCtx->sample_fmt = internalLibavSampleFmt;
     codecCtx->bit_rate = outputBitrate;
+    codecCtx->time_base.num = 1;
+    codecCtx->time_base.den = outputStreamInfo->audio.sampleRate;
 
     if (avcodec_open2(codecCtx, codec, NULL) < 0) {
         utils::errorMsg("Could not open codec context");
@@ -243,7 +368,7 @@ bool AudioEncoderLibav::codingConfig(AVCodecID codecId)
     if (codecCtx->frame_size != 0) {
         libavFrame->nb_samples = codecCtx->frame_size;
     } else {
-        libavFrame->nb_samples = AudioFrame::getDefaultSamples(inputSampleRate);
+        libavFrame->nb_samples = AudioFrame::getDefaultSamples(outputStreamInfo->audio.sampleRate);
     }
 
     libavFrame->format = codecCtx->sample_fmt;
@@ -257,6 +382,13 @@ bool AudioEncoderLibav::codingConfig(AVCodecID codecId)
         return false;
     }
 
+    fifo = av_audio_fifo_alloc(internalLibavSampleFmt, outputStreamInfo->audio.channels, samplesPerFrame*2);
+
+    if (!fifo) {
+        utils::errorMsg("Could not allocate audio samples FIFO");
+        return false;
+    }
+
     return true;
 }
 
@@ -280,11 +412,10 @@ bool AudioEncoderLibav::resamplingConfig()
         return false;
     }
 
-    if (swr_is_initialized(resampleCtx) == 0) {
-        if (swr_init(resampleCtx) < 0) {
-            utils::errorMsg("Error initializing encoder resample context");
-            return false;
-        }
+    //NOTE: the context is reused, so it has to be initialized again after changing its options
+    if (swr_init(resampleCtx) < 0) {
+        utils::errorMsg("Error initializing encoder resample context");
+        return false;
     }
 
     return true;
@@ -330,36 +461,62 @@ bool AudioEncoderLibav::reconfigure(AudioFrame* frame)
     return true;
 }
 
-int AudioEncoderLibav::resample(AudioFrame* src, AVFrame* dst)
+int AudioEncoderLibav::resample(AudioFrame* src)
 {
     int samples;
+    int maxSamples;
     unsigned char *auxBuff;
+    const uint8_t **srcData;
 
     if (src->isPlanar()) {
-        samples = swr_convert(
-                    resampleCtx,
-                    dst->data,
-                    dst->nb_samples,
-                    (const uint8_t**)src->getPlanarDataBuf(),
-                    src->getSamples()
-                  );
-
+        srcData = (const uint8_t**)src->getPlanarDataBuf();
     } else {
         auxBuff = src->getDataBuf();
+        srcData = (const uint8_t**)&auxBuff;
+    }
 
-        samples = swr_convert(
-                    resampleCtx,
-                    dst->data,
-                    dst->nb_samples,
-                    (const uint8_t**)auxBuff,
-                    src->getSamples()
-                  );
+    maxSamples = swr_get_out_samples(resampleCtx, src->getSamples());
+
+    if (maxSamples > convBufferSamples && !allocConversionBuffer(maxSamples)) {
+        return -1;
+    }
+
+    samples = swr_convert(resampleCtx, convBuffer, convBufferSamples, srcData, src->getSamples());
+
+    if (samples <= 0) {
+        return samples;
+    }
 
+    if (av_audio_fifo_write(fifo, (void**) convBuffer, samples) < samples) {
+        utils::errorMsg("Error writing to audio samples FIFO");
+        return -1;
     }
 
     return samples;
 }
 
+bool AudioEncoderLibav::allocConversionBuffer(int samples)
+{
+    if (convBuffer) {
+        av_freep(&convBuffer[0]);
+        av_freep(&convBuffer);
+    }
+
+    //NOTE: one extra codec frame is reserved, so small input size variations do not cause reallocations
+    samples += samplesPerFrame;
+
+    if (av_samples_alloc_array_and_samples(&convBuffer, NULL, outputStreamInfo->audio.channels,
+                                           samples, internalLibavSampleFmt, 0) < 0) {
+        utils::errorMsg("Error allocating audio conversion buffer");
+        convBuffer = NULL;
+        convBufferSamples = 0;
+        return false;
+    }
+
+    convBufferSamples = samples;
+    return true;
+}
+
 void AudioEncoderLibav::doGetState(Jzon::Object &filterNode)
 {
     filterNode.Add("codec", utils::getAudioCodecAsString(getCodec()));
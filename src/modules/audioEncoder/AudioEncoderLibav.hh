@@ -24,10 +24,12 @@
 #define _AUDIO_ENCODER_LIBAV_HH
 
 #include <chrono>
+#include <map>
 
 extern "C" {
     #include <libavcodec/avcodec.h>
     #include <libswresample/swresample.h>
+    #include <libavutil/audio_fifo.h>
 }
 
 #include "../../AudioFrame.hh"
@@ -36,6 +38,16 @@ extern "C" {
 #include "../../Utils.hh"
 #include "../../StreamInfo.hh"
 
+#define PTS_RESYNC_THRESHOLD 40000 //us
+
+/*! Audio encoder based on libav. Input frames of any size are resampled to the codec format and
+    queued in a sample FIFO, which is consumed in codec frame size chunks. All the packets that
+    are ready after each input frame are delivered and their timestamps are derived from the
+    number of encoded samples. They are resynchronized when the input timestamps deviate more than
+    PTS_RESYNC_THRESHOLD from the sample count (upstream flushes, timestamp gaps). Samples already
+    queued or inside the codec keep the timeline they were queued with and output timestamps
+    never go backwards */
+
 class AudioEncoderLibav : public OneToOneFilter {
 
 public:
@@ -49,13 +61,19 @@ public:
 protected:
     FrameQueue* allocQueue(ConnectionData cData);
     bool doProcessFrame(Frame *org, Frame *dst);
+    bool hasPendingFrames();
+    bool flushFrame(Frame *dst);
     bool specificReaderConfig(int /*readerID*/, FrameQueue* queue);
     bool specificReaderDelete(int /*readerID*/) {return true;};
+    bool configure0(ACodecType codec, int codedAudioChannels, int codedAudioSampleRate, int bitrate);
 
 private:
-    bool configure0(ACodecType codec, int codedAudioChannels, int codedAudioSampleRate, int bitrate);
     void initializeEventMap();
-    int resample(AudioFrame* src, AVFrame* dst);
+    int resample(AudioFrame* src);
+    bool encodeFrame(AudioFrame* codedFrame);
+    void resyncPts(std::chrono::microseconds inPts);
+    std::chrono::microseconds samplePts(int64_t sample);
+    bool allocConversionBuffer(int samples);
     bool reconfigure(AudioFrame* frame);
     bool resamplingConfig();
     bool codingConfig(AVCodecID codecId); 
@@ -72,6 +90,9 @@ private:
     AVCodec             *codec;
     AVCodecContext      *codecCtx;
     AVFrame             *libavFrame;
+    AVAudioFifo         *fifo;
+    uint8_t             **convBuffer;
+    int                 convBufferSamples;
     AVPacket            pkt;
     SwrContext          *resampleCtx;
     int                 gotFrame;
@@ -86,6 +107,14 @@ private:
     SampleFmt           inputSampleFmt;
     AVSampleFormat      inputLibavSampleFmt;
 
+    std::map<int64_t, std::chrono::microseconds> basePts; //first sample of each timeline -> its pts
+    std::chrono::microseconds lastPts;
+    std::chrono::system_clock::time_point lastOriginTime;
+    size_t              lastSeqNum;
+    int64_t             inputSamples;
+    int64_t             encodedSamples;
+    bool                syncPts;
+
     std::chrono::microseconds currentTime;
     std::chrono::microseconds frameDuration;
     std::chrono::microseconds diffTime;
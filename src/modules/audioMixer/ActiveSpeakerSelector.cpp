@@ -0,0 +1,206 @@
+/*
+ *  ActiveSpeakerSelector - Voice activity based selection of mixing channels
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "ActiveSpeakerSelector.hh"
+#include "../../AudioKernels.hh"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+ActiveSpeakerSelector::ActiveSpeakerSelector() : enabled(false), speakers(DEFAULT_ACTIVE_SPEAKERS),
+    hangover(std::chrono::milliseconds(DEFAULT_SPEAKER_HANGOVER)), threshold(DEFAULT_VAD_THRESHOLD)
+{
+
+}
+
+bool ActiveSpeakerSelector::configure(bool enable, unsigned speakers_, unsigned hangover_, float threshold_)
+{
+    if (speakers_ == 0 || threshold_ > 0 || threshold_ < SILENCE_LEVEL) {
+        return false;
+    }
+
+    enabled = enable;
+    speakers = speakers_;
+    hangover = std::chrono::milliseconds(hangover_);
+    threshold = threshold_;
+
+    return true;
+}
+
+void ActiveSpeakerSelector::addChannel(int id)
+{
+    SpeakerActivity activity;
+
+    activity.level = SILENCE_LEVEL;
+    activity.voice = false;
+    activity.mixed = !enabled;
+    activity.hold = std::chrono::microseconds(0);
+
+    channels[id] = activity;
+}
+
+void ActiveSpeakerSelector::removeChannel(int id)
+{
+    channels.erase(id);
+}
+
+float ActiveSpeakerSelector::frameLevel(AudioFrame* frame)
+{
+    float sum = 0;
+    unsigned samples = frame->getSamples();
+
+    if (samples == 0 || frame->getChannels() == 0) {
+        return SILENCE_LEVEL;
+    }
+
+    for (unsigned i = 0; i < frame->getChannels(); i++) {
+        switch (frame->getSampleFmt()) {
+            case S16P:
+                sum += audiokernels::sumSquaresS16((const int16_t*) frame->getPlanarDataBuf()[i], samples);
+                break;
+            case FLTP:
+                sum += audiokernels::sumSquares((const float*) frame->getPlanarDataBuf()[i], samples);
+                break;
+            default:
+                return SILENCE_LEVEL;
+        }
+    }
+
+    sum /= samples*frame->getChannels();
+
+    if (sum <= 0) {
+        return SILENCE_LEVEL;
+    }
+
+    return std::max(10*std::log10(sum), (float) SILENCE_LEVEL);
+}
+
+bool ActiveSpeakerSelector::update(int id, AudioFrame* frame)
+{
+    float level;
+    std::chrono::microseconds duration;
+
+    if (channels.count(id) == 0 || frame->getSampleRate() == 0) {
+        return false;
+    }
+
+    if (frame->getSampleFmt() != S16P && frame->getSampleFmt() != FLTP) {
+        return false;
+    }
+
+    SpeakerActivity &activity = channels[id];
+
+    level = frameLevel(frame);
+    duration = std::chrono::microseconds(frame->getSamples()*std::micro::den/frame->getSampleRate());
+
+    //NOTE: instant attack and smoothed release, so short gaps do not drop the level
+    if (level > activity.level) {
+        activity.level = level;
+    } else {
+        activity.level += SPEAKER_LEVEL_RELEASE*(level - activity.level);
+    }
+
+    activity.voice = level > threshold;
+
+    if (activity.voice) {
+        activity.hold = hangover;
+    } else if (activity.hold > duration) {
+        activity.hold -= duration;
+    } else {
+        activity.hold = std::chrono::microseconds(0);
+    }
+
+    return true;
+}
+
+void ActiveSpeakerSelector::select()
+{
+    std::vector<std::pair<int, SpeakerActivity*>> candidates;
+    unsigned selected = 0;
+
+    if (!enabled) {
+        for (auto& it : channels) {
+            it.second.mixed = true;
+        }
+        return;
+    }
+
+    for (auto& it : channels) {
+        SpeakerActivity* a = &it.second;
+
+        if (a->voice || (a->mixed && a->hold.count() > 0)) {
+            candidates.push_back(std::make_pair(it.first, a));
+        }
+    }
+
+    //NOTE: speakers already mixed and still talking go first, then new speakers, and then
+    //      mixed speakers in their hangover. Louder speakers go first within each group
+    auto tier = [](SpeakerActivity* a) {
+        if (a->voice) {
+            return a->mixed ? 0 : 1;
+        }
+        return 2;
+    };
+
+    std::stable_sort(candidates.begin(), candidates.end(),
+        [&tier](const std::pair<int, SpeakerActivity*>& a, const std::pair<int, SpeakerActivity*>& b) {
+            if (tier(a.second) != tier(b.second)) {
+                return tier(a.second) < tier(b.second);
+            }
+            return a.second->level > b.second->level;
+        });
+
+    for (auto& it : channels) {
+        it.second.mixed = false;
+    }
+
+    for (auto& c : candidates) {
+        if (selected >= speakers) {
+            break;
+        }
+
+        c.second->mixed = true;
+        selected++;
+    }
+}
+
+bool ActiveSpeakerSelector::isSelected(int id)
+{
+    if (channels.count(id) == 0) {
+        return false;
+    }
+
+    return channels[id].mixed;
+}
+
+void ActiveSpeakerSelector::getState(Jzon::Array &activity)
+{
+    for (auto it : channels) {
+        Jzon::Object channel;
+        channel.Add("id", it.first);
+        channel.Add("level", it.second.level);
+        channel.Add("voice", it.second.voice);
+        channel.Add("mixed", it.second.mixed);
+        activity.Add(channel);
+    }
+}
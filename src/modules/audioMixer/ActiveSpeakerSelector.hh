@@ -0,0 +1,129 @@
+/*
+ *  ActiveSpeakerSelector - Voice activity based selection of mixing channels
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _ACTIVE_SPEAKER_SELECTOR_HH
+#define _ACTIVE_SPEAKER_SELECTOR_HH
+
+#include <map>
+#include <chrono>
+
+#include "../../AudioFrame.hh"
+#include "../../Jzon.h"
+
+#define DEFAULT_ACTIVE_SPEAKERS 4
+#define DEFAULT_SPEAKER_HANGOVER 500 //ms
+#define DEFAULT_VAD_THRESHOLD -50.0 //dBFS
+#define SILENCE_LEVEL -100.0 //dBFS
+#define SPEAKER_LEVEL_RELEASE 0.2
+
+/*! Per channel activity tracked by the ActiveSpeakerSelector */
+
+struct SpeakerActivity {
+    float level;                        //!< Smoothed RMS level in dBFS
+    bool voice;                         //!< Last frame level exceeded the VAD threshold
+    bool mixed;                         //!< Channel is currently selected for mixing
+    std::chrono::microseconds hold;     //!< Remaining hangover time
+};
+
+/*! It measures the energy of each mixing channel frame and selects the N loudest active
+*   speakers. A selected speaker keeps its slot while it talks and during the hangover time
+*   after it stops, unless a new active speaker needs the slot. When disabled every
+*   channel is selected.
+*/
+
+class ActiveSpeakerSelector {
+
+public:
+    /**
+    * Class constructor
+    */
+    ActiveSpeakerSelector();
+
+    /**
+    * Configures the selector
+    * @param enable If false, all channels are selected
+    * @param speakers Maximum number of channels selected at the same time
+    * @param hangover Time in milliseconds a speaker keeps its slot after it stops talking
+    * @param threshold Voice activity detection threshold in dBFS
+    * @return true if the values are valid
+    */
+    bool configure(bool enable, unsigned speakers, unsigned hangover, float threshold);
+
+    /**
+    * Adds a channel to be tracked
+    * @param id channel id
+    */
+    void addChannel(int id);
+
+    /**
+    * Stops tracking a channel
+    * @param id channel id
+    */
+    void removeChannel(int id);
+
+    /**
+    * Updates a channel activity with a new frame
+    * @param id channel id
+    * @param frame audio frame (only S16P and FLTP are supported)
+    * @return false if the channel is not tracked or the frame format is not supported
+    */
+    bool update(int id, AudioFrame* frame);
+
+    /**
+    * Updates the set of selected channels using the current activity
+    */
+    void select();
+
+    /**
+    * @param id channel id
+    * @return true if the channel is selected for mixing
+    */
+    bool isSelected(int id);
+
+    /**
+    * Adds channels activity to a Jzon array
+    * @param activity array to fill
+    */
+    void getState(Jzon::Array &activity);
+
+    /**
+    * Computes the RMS level of a frame, all its channels together
+    * @param frame audio frame (only S16P and FLTP are supported)
+    * @return level in dBFS, SILENCE_LEVEL if the frame is empty or not supported
+    */
+    static float frameLevel(AudioFrame* frame);
+
+    bool isEnabled() {return enabled;};
+    unsigned getSpeakers() {return speakers;};
+    unsigned getHangover() {return hangover.count()/1000;};
+    float getThreshold() {return threshold;};
+
+private:
+    std::map<int, SpeakerActivity> channels;
+
+    bool enabled;
+    unsigned speakers;
+    std::chrono::microseconds hangover;
+    float threshold;
+};
+
+#endif
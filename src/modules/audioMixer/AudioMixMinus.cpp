@@ -0,0 +1,403 @@
+/*
+ *  AudioMixMinus - Many to many audio mixer with mix-minus outputs
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "AudioMixMinus.hh"
+#include "../../AudioCircularBuffer.hh"
+#include "../../AudioKernels.hh"
+#include "../../Utils.hh"
+#include <algorithm>
+#include <string.h>
+
+AudioMixMinus::AudioMixMinus(int participants_) : 
+ManyToManyFilter(participants_, participants_ + 1), channels(DEFAULT_CHANNELS),
+sampleRate(DEFAULT_SAMPLE_RATE), sampleFormat(FLTP), maxParticipants(participants_),
+front(0), rear(0), masterGain(DEFAULT_MASTER_GAIN), th(COMPRESSION_THRESHOLD),
+syncTs(std::chrono::microseconds(-1))
+{
+    fType = AUDIO_MIX_MINUS;
+    inputFrameSamples = AudioFrame::getDefaultSamples(sampleRate);
+    outputSamples = inputFrameSamples;
+    mixBufferMaxSamples = inputFrameSamples*5;
+    mixingThreshold = inputFrameSamples*3;
+
+    for (int i = 0; i < channels; i++) {
+        mixBuffers[i] = new float[mixBufferMaxSamples]();
+    }
+
+    scratch = new float[mixBufferMaxSamples]();
+
+    initializeEventMap();
+}
+
+AudioMixMinus::~AudioMixMinus() 
+{
+    for (int i = 0; i < channels; i++) {
+        delete[] mixBuffers[i];
+    }
+
+    for (auto it : participants) {
+        for (int i = 0; i < channels; i++) {
+            delete[] it.second.contribution[i];
+        }
+    }
+
+    delete[] scratch;
+}
+
+FrameQueue *AudioMixMinus::allocQueue(ConnectionData cData) 
+{
+    return AudioCircularBuffer::createNew(cData, channels, sampleRate, DEFAULT_BUFFER_SIZE, 
+                                            sampleFormat);
+}
+
+bool AudioMixMinus::doProcessFrame(std::map<int, Frame*> &orgFrames, std::map<int, Frame*> &dstFrames, std::vector<int> newFrames) 
+{
+    AudioFrame* aFrame;
+
+    for (auto id : newFrames) {
+        aFrame = dynamic_cast<AudioFrame*>(orgFrames[id]);
+
+        if (!aFrame) {
+            utils::errorMsg("[AudioMixMinus] Input frames must be AudioFrames");
+            continue;
+        }
+
+        if (!pushToBuffer(id, aFrame)) {
+            utils::errorMsg("[AudioMixMinus] Error pushing samples to the internal buffer");
+            continue;
+        }
+    }
+
+    return extractMixedFrames(dstFrames);
+}
+
+bool AudioMixMinus::pushToBuffer(int id, AudioFrame* frame) 
+{
+    unsigned char* b;
+    SampleFmt fmt;
+    unsigned nOfSamples;
+    unsigned absolutePosition;
+    unsigned bufferIdx;
+    unsigned firstSpan;
+    unsigned inChannels;
+    float gain;
+
+    if (participants.count(id) == 0) {
+        return false;
+    }
+
+    Participant &p = participants[id];
+
+    fmt = frame->getSampleFmt();
+    nOfSamples = frame->getSamples();
+
+    if (fmt != S16P && fmt != FLTP) {
+        utils::errorMsg("[AudioMixMinus] Only S16P and FLTP sample formats are supported");
+        return false;
+    }
+
+    if (mixBufferMaxSamples - (rear - front) < nOfSamples) {
+        utils::errorMsg("[AudioMixMinus] No free space in mixing buffer, discarding frame from participant " + std::to_string(id));
+        return false;
+    }
+
+    if (syncTs.count() < 0) {
+        syncTs = frame->getPresentationTime();
+    }
+
+    absolutePosition = (frame->getPresentationTime() - syncTs).count()*sampleRate/std::micro::den;
+
+    if (absolutePosition < front) {
+        utils::errorMsg("[AudioMixMinus] Samples from the past ignored");
+        return false;
+    }
+
+    if (absolutePosition > front + mixBufferMaxSamples - nOfSamples) {
+        utils::errorMsg("[AudioMixMinus] Received frame exceeds buffer scope. Resyncing!");
+        front = 0;
+        rear = 0;
+        syncTs = frame->getPresentationTime();
+        absolutePosition = front;
+    }
+
+    gain = p.gain*masterGain;
+    bufferIdx = absolutePosition % mixBufferMaxSamples;
+    firstSpan = std::min(nOfSamples, mixBufferMaxSamples - bufferIdx);
+
+    //NOTE: the gained input is accumulated both in the full mix and in the participant
+    //      own buffer, which is what is subtracted from its output
+    inChannels = frame->getChannels();
+
+    //NOTE: mono inputs are mixed into all the output channels, as in the AudioMixer
+    for (int i = 0; i < channels; i++) {
+        if (inChannels != 1 && (unsigned) i >= inChannels) {
+            break;
+        }
+
+        b = frame->getPlanarDataBuf()[inChannels == 1 ? 0 : i];
+
+        for (float* dst : {mixBuffers[i], p.contribution[i]}) {
+            if (fmt == S16P) {
+                audiokernels::mulAddS16((const int16_t*) b, dst + bufferIdx, gain, firstSpan);
+                audiokernels::mulAddS16((const int16_t*) b + firstSpan, dst, gain, nOfSamples - firstSpan);
+            } else {
+                audiokernels::mulAdd((const float*) b, dst + bufferIdx, gain, firstSpan);
+                audiokernels::mulAdd((const float*) b + firstSpan, dst, gain, nOfSamples - firstSpan);
+            }
+        }
+    }
+
+    if (absolutePosition + nOfSamples > rear) {
+        rear = absolutePosition + nOfSamples;
+    }
+
+    return true;
+}
+
+void AudioMixMinus::extractSpan(float* mixBuff, float* ownBuff, unsigned char* data, unsigned samples)
+{
+    if (ownBuff) {
+        audiokernels::subtract(mixBuff, ownBuff, scratch, samples);
+    } else {
+        memcpy(scratch, mixBuff, samples*sizeof(float));
+    }
+
+    audiokernels::compress(scratch, th, samples);
+
+    if (sampleFormat == S16P) {
+        audiokernels::floatToS16(scratch, (int16_t*) data, samples);
+    } else {
+        memcpy(data, scratch, samples*sizeof(float));
+    }
+}
+
+bool AudioMixMinus::extractMixedFrames(std::map<int, Frame*> &dstFrames)
+{
+    unsigned pos;
+    unsigned firstSpan;
+    unsigned bytesPerSample;
+    unsigned char* b;
+    float* own;
+    AudioFrame* frame;
+    std::chrono::microseconds ts;
+
+    if (rear - front < mixingThreshold) {
+        return false;
+    }
+
+    bytesPerSample = utils::getBytesPerSampleFromFormat(sampleFormat);
+    pos = front % mixBufferMaxSamples;
+    firstSpan = std::min(outputSamples, mixBufferMaxSamples - pos);
+    ts = std::chrono::microseconds(front * std::micro::den/sampleRate) + syncTs;
+
+    for (auto it : dstFrames) {
+        frame = dynamic_cast<AudioFrame*>(it.second);
+
+        if (!frame) {
+            utils::errorMsg("[AudioMixMinus] Output frames must be AudioFrames");
+            continue;
+        }
+
+        for (int i = 0; i < channels; i++) {
+            b = frame->getPlanarDataBuf()[i];
+            own = participants.count(it.first) > 0 ? participants[it.first].contribution[i] : NULL;
+
+            extractSpan(mixBuffers[i] + pos, own ? own + pos : NULL, b, firstSpan);
+            extractSpan(mixBuffers[i], own, b + firstSpan*bytesPerSample, outputSamples - firstSpan);
+        }
+
+        frame->setPresentationTime(ts);
+        frame->setDecodeTime(NO_DTS);
+        frame->setLength(outputSamples*bytesPerSample);
+        frame->setSamples(outputSamples);
+        frame->setChannels(channels);
+        frame->setSampleRate(sampleRate);
+        frame->setConsumed(true);
+    }
+
+    for (int i = 0; i < channels; i++) {
+        memset(mixBuffers[i] + pos, 0, firstSpan*sizeof(float));
+        memset(mixBuffers[i], 0, (outputSamples - firstSpan)*sizeof(float));
+
+        for (auto& it : participants) {
+            memset(it.second.contribution[i] + pos, 0, firstSpan*sizeof(float));
+            memset(it.second.contribution[i], 0, (outputSamples - firstSpan)*sizeof(float));
+        }
+    }
+
+    front += outputSamples;
+    return true;
+}
+
+bool AudioMixMinus::specificReaderConfig(int readerID, FrameQueue* queue)
+{
+    AudioCircularBuffer* inBuffer;
+    Participant p;
+
+    inBuffer = dynamic_cast<AudioCircularBuffer*>(queue);
+
+    if (!inBuffer) {
+        utils::errorMsg("[AudioMixMinus] Error setting reader: queue must be an AudioCircularBuffer");
+        return false;
+    }
+
+    if (participants.count(readerID) > 0) {
+        return false;
+    }
+
+    inBuffer->setOutputFrameSamples(inputFrameSamples);
+
+    p.gain = DEFAULT_CHANNEL_GAIN;
+
+    for (int i = 0; i < channels; i++) {
+        p.contribution[i] = new float[mixBufferMaxSamples]();
+    }
+
+    participants[readerID] = p;
+
+    return true;
+}
+
+bool AudioMixMinus::specificReaderDelete(int readerID)
+{
+    if (participants.count(readerID) == 0) {
+        return false;
+    }
+
+    for (int i = 0; i < channels; i++) {
+        //NOTE: whatever the participant has already mixed stays in the full mix
+        //      until it is extracted, so it is removed from it too
+        audiokernels::subtract(mixBuffers[i], participants[readerID].contribution[i],
+                               mixBuffers[i], mixBufferMaxSamples);
+        delete[] participants[readerID].contribution[i];
+    }
+
+    participants.erase(readerID);
+    return true;
+}
+
+bool AudioMixMinus::setChannelGain(int id, float value)
+{
+    if (participants.count(id) == 0) {
+        return false;
+    }
+
+    participants[id].gain = std::max(0.0f, std::min(1.0f, value));
+    return true;
+}
+
+bool AudioMixMinus::changeChannelVolumeEvent(Jzon::Node* params)
+{
+    if (!params || !params->Has("id") || !params->Has("gain")) {
+        return false;
+    }
+
+    return setChannelGain(params->Get("id").ToInt(), params->Get("gain").ToFloat());
+}
+
+bool AudioMixMinus::muteChannelEvent(Jzon::Node* params)
+{
+    if (!params || !params->Has("id")) {
+        return false;
+    }
+
+    return setChannelGain(params->Get("id").ToInt(), 0);
+}
+
+bool AudioMixMinus::changeMasterVolumeEvent(Jzon::Node* params)
+{
+    if (!params || !params->Has("gain")) {
+        return false;
+    }
+
+    masterGain = params->Get("gain").ToFloat();
+    return true;
+}
+
+bool AudioMixMinus::changeChannelGain(int id, float value)
+{
+    Jzon::Object root, params;
+    root.Add("action", "changeChannelGain");
+    params.Add("id", id);
+    params.Add("gain", value);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
+bool AudioMixMinus::muteChannel(int id)
+{
+    Jzon::Object root, params;
+    root.Add("action", "muteChannel");
+    params.Add("id", id);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
+bool AudioMixMinus::changeMasterGain(float value)
+{
+    Jzon::Object root, params;
+    root.Add("action", "changeMasterGain");
+    params.Add("gain", value);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
+void AudioMixMinus::initializeEventMap()
+{
+    eventMap["changeChannelGain"] = std::bind(&AudioMixMinus::changeChannelVolumeEvent,
+                                                 this, std::placeholders::_1);
+
+    eventMap["muteChannel"] = std::bind(&AudioMixMinus::muteChannelEvent, this,
+                                         std::placeholders::_1);
+
+    eventMap["changeMasterGain"] = std::bind(&AudioMixMinus::changeMasterVolumeEvent, this,
+                                                std::placeholders::_1);
+}
+
+void AudioMixMinus::doGetState(Jzon::Object &filterNode)
+{
+    Jzon::Array jsonGains;
+
+    filterNode.Add("channels", channels);
+    filterNode.Add("sampleRate", sampleRate);
+    filterNode.Add("sampleFormat", utils::getSampleFormatAsString(sampleFormat));
+    filterNode.Add("maxParticipants", maxParticipants);
+    filterNode.Add("masterGain", masterGain);
+
+    for (auto it : participants) {
+        Jzon::Object gain;
+        gain.Add("id", it.first);
+        gain.Add("gain", it.second.gain);
+        jsonGains.Add(gain);
+    }
+
+    filterNode.Add("gains", jsonGains);
+}
@@ -0,0 +1,132 @@
+/*
+ *  AudioMixMinus - Many to many audio mixer with mix-minus outputs
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _AUDIO_MIX_MINUS_HH
+#define _AUDIO_MIX_MINUS_HH
+
+#include "../../Frame.hh"
+#include "../../Filter.hh"
+#include "../../AudioFrame.hh"
+#include "AudioMixer.hh"
+
+/*! Conferencing mixer. Each participant is a reader and gets back, through the writer with
+*   the same id, the mix of all the other participants. The full mix is computed once and
+*   each output is obtained subtracting the participant own gained contribution before
+*   compression, so the cost grows linearly with the number of participants. Writers with
+*   an id that does not match any reader get the full mix.
+*/
+
+class AudioMixMinus : public ManyToManyFilter {
+
+public:
+    /**
+    * Class constructor
+    * @param participants Max mixing participants
+    */
+    AudioMixMinus(int participants = AMIXER_MAX_CHANNELS);
+
+    /**
+    * Class destructor
+    */
+    ~AudioMixMinus();
+
+    /**
+    * @return mixing buffering in samples
+    */ 
+    unsigned getMixingThreshold() {return mixingThreshold;};
+
+    /**
+    * @return samples requested to each participant
+    */ 
+    unsigned getInputFrameSamples() {return inputFrameSamples;};
+
+    /**
+    * Sets participant gain
+    * @param id participant id
+    * @param value participant gain [0.0, 1.0]
+    * @return always true
+    */ 
+    bool changeChannelGain(int id, float value);
+
+    /**
+    * Mutes a participant, the rest of them will not hear it
+    * @param id participant id
+    * @return always true
+    */ 
+    bool muteChannel(int id);
+
+    /**
+    * Sets master gain
+    * @param value master gain [0.0, 1.0]
+    * @return always true
+    */ 
+    bool changeMasterGain(float value);
+
+protected:
+    void doGetState(Jzon::Object &filterNode);
+    FrameQueue *allocQueue(ConnectionData cData);
+    bool doProcessFrame(std::map<int, Frame*> &orgFrames, std::map<int, Frame*> &dstFrames, std::vector<int> newFrames);
+    bool specificReaderConfig(int readerID, FrameQueue* queue);
+    bool specificReaderDelete(int readerID);
+
+private:
+    struct Participant {
+        float gain;
+        float* contribution[MAX_CHANNELS];
+    };
+
+    void initializeEventMap();
+    bool pushToBuffer(int id, AudioFrame* frame);
+    bool extractMixedFrames(std::map<int, Frame*> &dstFrames);
+    void extractSpan(float* mixBuff, float* ownBuff, unsigned char* data, unsigned samples);
+    bool setChannelGain(int id, float value);
+
+    bool changeChannelVolumeEvent(Jzon::Node* params);
+    bool muteChannelEvent(Jzon::Node* params);
+    bool changeMasterVolumeEvent(Jzon::Node* params);
+
+    //NOTE: There is no need of specific writer configuration
+    bool specificWriterConfig(int /*writerID*/) {return true;};
+    bool specificWriterDelete(int /*writerID*/) {return true;};
+
+    int channels;
+    int sampleRate;
+    int inputFrameSamples;
+    SampleFmt sampleFormat;
+    int maxParticipants;
+    unsigned front;
+    unsigned rear;
+
+    float masterGain;
+    float th;
+
+    std::map<int, Participant> participants;
+    std::chrono::microseconds syncTs;
+    float* mixBuffers[MAX_CHANNELS];
+    float* scratch;
+
+    unsigned mixBufferMaxSamples;
+    unsigned outputSamples;
+    unsigned mixingThreshold;
+};
+
+#endif
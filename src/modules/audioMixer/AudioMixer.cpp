@@ -25,41 +25,174 @@
 #include "AudioMixer.hh"
 #include "../../AudioCircularBuffer.hh"
 #include "../../Utils.hh"
+#include "../../AudioKernels.hh"
 #include <iostream>
+#include <algorithm>
 #include <utility>
 #include <cmath>
 #include <string.h>
 
+enum Speaker {SPEAKER_FL, SPEAKER_FR, SPEAKER_FC, SPEAKER_LFE, SPEAKER_BL, SPEAKER_BR, 
+              SPEAKER_BC, SPEAKER_SL, SPEAKER_SR};
+
+//NOTE: streams only signal their number of channels, so the default libav layout
+//      (av_get_default_channel_layout) of each channel count is assumed
+static bool defaultLayout(unsigned channels, std::vector<Speaker>& layout)
+{
+    switch (channels) {
+        case 1:
+            layout = {SPEAKER_FC};
+            break;
+        case 2:
+            layout = {SPEAKER_FL, SPEAKER_FR};
+            break;
+        case 3:
+            layout = {SPEAKER_FL, SPEAKER_FR, SPEAKER_FC};
+            break;
+        case 4:
+            layout = {SPEAKER_FL, SPEAKER_FR, SPEAKER_FC, SPEAKER_BC};
+            break;
+        case 5:
+            layout = {SPEAKER_FL, SPEAKER_FR, SPEAKER_FC, SPEAKER_BL, SPEAKER_BR};
+            break;
+        case 6:
+            layout = {SPEAKER_FL, SPEAKER_FR, SPEAKER_FC, SPEAKER_LFE, SPEAKER_BL, SPEAKER_BR};
+            break;
+        case 7:
+            layout = {SPEAKER_FL, SPEAKER_FR, SPEAKER_FC, SPEAKER_LFE, SPEAKER_BC, SPEAKER_SL, SPEAKER_SR};
+            break;
+        case 8:
+            layout = {SPEAKER_FL, SPEAKER_FR, SPEAKER_FC, SPEAKER_LFE, SPEAKER_BL, SPEAKER_BR, SPEAKER_SL, SPEAKER_SR};
+            break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+static bool hasSpeaker(const std::vector<Speaker>& layout, Speaker s)
+{
+    return std::find(layout.begin(), layout.end(), s) != layout.end();
+}
+
+//NOTE: adds the gains of speaker s into the output layout, folding it into the nearest
+//      available speakers when the layout lacks it. Every layout has FC or both FL and FR
+static void foldSpeaker(Speaker s, const std::vector<Speaker>& layout, float gain, std::vector<float>& row)
+{
+    std::vector<Speaker>::const_iterator it = std::find(layout.begin(), layout.end(), s);
+
+    if (it != layout.end()) {
+        row[it - layout.begin()] += gain;
+        return;
+    }
+
+    switch (s) {
+        case SPEAKER_FC:
+            foldSpeaker(SPEAKER_FL, layout, gain*M_SQRT1_2, row);
+            foldSpeaker(SPEAKER_FR, layout, gain*M_SQRT1_2, row);
+            break;
+        case SPEAKER_FL:
+        case SPEAKER_FR:
+            foldSpeaker(SPEAKER_FC, layout, gain*M_SQRT1_2, row);
+            break;
+        case SPEAKER_LFE:
+            break;
+        case SPEAKER_BL:
+        case SPEAKER_SL:
+            if (hasSpeaker(layout, s == SPEAKER_BL ? SPEAKER_SL : SPEAKER_BL)) {
+                foldSpeaker(s == SPEAKER_BL ? SPEAKER_SL : SPEAKER_BL, layout, gain, row);
+            } else if (hasSpeaker(layout, SPEAKER_BC)) {
+                foldSpeaker(SPEAKER_BC, layout, gain*M_SQRT1_2, row);
+            } else {
+                foldSpeaker(SPEAKER_FL, layout, gain*M_SQRT1_2, row);
+            }
+            break;
+        case SPEAKER_BR:
+        case SPEAKER_SR:
+            if (hasSpeaker(layout, s == SPEAKER_BR ? SPEAKER_SR : SPEAKER_BR)) {
+                foldSpeaker(s == SPEAKER_BR ? SPEAKER_SR : SPEAKER_BR, layout, gain, row);
+            } else if (hasSpeaker(layout, SPEAKER_BC)) {
+                foldSpeaker(SPEAKER_BC, layout, gain*M_SQRT1_2, row);
+            } else {
+                foldSpeaker(SPEAKER_FR, layout, gain*M_SQRT1_2, row);
+            }
+            break;
+        case SPEAKER_BC:
+            if (hasSpeaker(layout, SPEAKER_BL)) {
+                foldSpeaker(SPEAKER_BL, layout, gain*M_SQRT1_2, row);
+                foldSpeaker(SPEAKER_BR, layout, gain*M_SQRT1_2, row);
+            } else if (hasSpeaker(layout, SPEAKER_SL)) {
+                foldSpeaker(SPEAKER_SL, layout, gain*M_SQRT1_2, row);
+                foldSpeaker(SPEAKER_SR, layout, gain*M_SQRT1_2, row);
+            } else {
+                foldSpeaker(SPEAKER_FL, layout, gain*M_SQRT1_2, row);
+                foldSpeaker(SPEAKER_FR, layout, gain*M_SQRT1_2, row);
+            }
+            break;
+    }
+}
+
 AudioMixer::AudioMixer(int inputChannels) : 
 ManyToOneFilter(inputChannels), channels(DEFAULT_CHANNELS),
 sampleRate(DEFAULT_SAMPLE_RATE), sampleFormat(FLTP), maxMixingChannels(inputChannels),
-front(0), rear(0), masterGain(DEFAULT_MASTER_GAIN), th(COMPRESSION_THRESHOLD),
-syncTs(std::chrono::microseconds(-1))
+front(0), rear(0), masterGain(DEFAULT_MASTER_GAIN), outputs(0), limiter(DEFAULT_SAMPLE_RATE),
+driftCompensation(false), driftLatency(0), outputMeter(DEFAULT_CHANNELS, DEFAULT_SAMPLE_RATE),
+metering(false), loudnessMetering(false), syncTs(std::chrono::microseconds(-1))
 {
     fType = AUDIO_MIXER;
+    outputStreamInfo = new StreamInfo(AUDIO);
+    outputStreamInfo->audio.codec = PCM;
+    outputStreamInfo->audio.channels = channels;
+    outputStreamInfo->audio.sampleRate = sampleRate;
+    outputStreamInfo->audio.sampleFormat = sampleFormat;
     inputFrameSamples = AudioFrame::getDefaultSamples(sampleRate);
     outputSamples = inputFrameSamples;
     mixBufferMaxSamples = inputFrameSamples*5;
     mixingThreshold = inputFrameSamples*3;
 
-    for (int i = 0; i < MAX_CHANNELS; i++) {
-        mixBuffers[i] = new float[mixBufferMaxSamples]();
-    }
+    allocMixBuffers();
 
     initializeEventMap();
 }
 
 AudioMixer::~AudioMixer() 
+{
+    freeMixBuffers();
+}
+
+void AudioMixer::allocMixBuffers()
+{
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        mixBuffers[i] = i < channels ? new float[mixBufferMaxSamples]() : NULL;
+    }
+}
+
+void AudioMixer::freeMixBuffers()
 {
     for (int i = 0; i < MAX_CHANNELS; i++) {
-        delete mixBuffers[i];
+        delete[] mixBuffers[i];
+        mixBuffers[i] = NULL;
     }
 }
 
 FrameQueue *AudioMixer::allocQueue(ConnectionData cData) 
 {
     return AudioCircularBuffer::createNew(cData, channels, sampleRate, DEFAULT_BUFFER_SIZE, 
-                                            sampleFormat);
+                                            sampleFormat, outputStreamInfo);
+}
+
+bool AudioMixer::specificWriterConfig(int /*writerID*/)
+{
+    outputs++;
+    return true;
+}
+
+bool AudioMixer::specificWriterDelete(int /*writerID*/)
+{
+    outputs--;
+    updateChannels();
+    return true;
 }
 
 bool AudioMixer::doProcessFrame(std::map<int, Frame*> &orgFrames, Frame *dst, std::vector<int> newFrames) 
@@ -67,6 +200,16 @@ bool AudioMixer::doProcessFrame(std::map<int, Frame*> &orgFrames, Frame *dst, st
     AudioFrame* aFrame;
     AudioFrame* aDstFrame;
 
+    for (auto id : newFrames) {
+        aFrame = dynamic_cast<AudioFrame*>(orgFrames[id]);
+
+        if (aFrame) {
+            speakerSelector.update(id, aFrame);
+        }
+    }
+
+    speakerSelector.select();
+
     for (auto id : newFrames) {
         aFrame = dynamic_cast<AudioFrame*>(orgFrames[id]);
 
@@ -75,8 +218,9 @@ bool AudioMixer::doProcessFrame(std::map<int, Frame*> &orgFrames, Frame *dst, st
             continue;
         }
 
-
-        if (!pushToBuffer(id, aFrame)) {
+        //NOTE: frames from channels that are not selected only move the mixing buffer
+        //      rear, so the output keeps flowing when nobody is talking
+        if (!pushToBuffer(id, aFrame, speakerSelector.isSelected(id))) {
             utils::errorMsg("[AudioMixer] Error pushing samples to the internal buffer");
             continue;
         }
@@ -98,22 +242,28 @@ bool AudioMixer::doProcessFrame(std::map<int, Frame*> &orgFrames, Frame *dst, st
     return true;
 }
 
-bool AudioMixer::pushToBuffer(int mixChId, AudioFrame* frame) 
+bool AudioMixer::pushToBuffer(int mixChId, AudioFrame* frame, bool mix) 
 {
     unsigned char* b;
-    float* mixBuff;
-    float fSample;
     SampleFmt fmt;
     unsigned nOfSamples;
     int bytesPerSample;
     unsigned absolutePosition;
     unsigned bufferIdx;
+    unsigned firstSpan;
     unsigned freeSpaceInMixBuffer;
+    unsigned inChannels;
+    float gain;
 
-    bytesPerSample = utils::getBytesPerSampleFromFormat(sampleFormat);
     fmt = frame->getSampleFmt();
+    bytesPerSample = utils::getBytesPerSampleFromFormat(fmt);
     nOfSamples = frame->getSamples();
 
+    if (fmt != S16P && fmt != FLTP) {
+        utils::errorMsg("[AudioMixer] Only S16P and FLTP sample formats are supported");
+        return false;
+    }
+
     freeSpaceInMixBuffer = mixBufferMaxSamples - (rear - front);
 
     if (freeSpaceInMixBuffer < nOfSamples) {
@@ -136,25 +286,35 @@ bool AudioMixer::pushToBuffer(int mixChId, AudioFrame* frame)
         utils::errorMsg("[AudioMixer] Received frame exceeds buffer scope. Resyncing!");
         front = 0;
         rear = 0;
+        limiter.reset();
         syncTs = frame->getPresentationTime();
         absolutePosition = front;
     }
 
-    for (int i = 0; i < channels; i++) {
+    gain = gains[mixChId]*masterGain;
+    bufferIdx = absolutePosition % mixBufferMaxSamples;
+    //NOTE: samples are mixed in two contiguous spans, split at the ring wrap point
+    firstSpan = std::min(nOfSamples, mixBufferMaxSamples - bufferIdx);
 
-        b = frame->getPlanarDataBuf()[i];
-        bufferIdx = absolutePosition % mixBufferMaxSamples;
-        mixBuff = mixBuffers[i];
+    inChannels = frame->getChannels();
+
+    if (mixMatrices.count(inChannels) == 0) {
+        getMixMatrix(inChannels, channels, mixMatrices[inChannels]);
+    }
 
-        for (unsigned j = 0; j < nOfSamples; j++) {
+    std::vector<float>& matrix = mixMatrices[inChannels];
 
-            if (!bytesToFloat(b + j*bytesPerSample, fSample, fmt)) {
-                utils::errorMsg("[AudioMixer] Error converting samples from bytes to float");
-                return false;
+    for (int o = 0; o < channels && mix; o++) {
+        for (unsigned i = 0; i < inChannels; i++) {
+            if (matrix[o*inChannels + i] == 0) {
+                continue;
             }
 
-            mixSample(fSample, mixBuff, bufferIdx, gains[mixChId]);
-            bufferIdx = (bufferIdx + 1) % mixBufferMaxSamples;
+            b = frame->getPlanarDataBuf()[i];
+
+            mixSpan(b, fmt, mixBuffers[o] + bufferIdx, gain*matrix[o*inChannels + i], firstSpan);
+            mixSpan(b + firstSpan*bytesPerSample, fmt, mixBuffers[o], gain*matrix[o*inChannels + i], 
+                    nOfSamples - firstSpan);
         }
     }
 
@@ -165,25 +325,42 @@ bool AudioMixer::pushToBuffer(int mixChId, AudioFrame* frame)
     return true;
 }
 
-void AudioMixer::mixSample(float sample, float* mixBuff, int bufferIdx, float gain)
+bool AudioMixer::mixSpan(unsigned char const* data, SampleFmt fmt, float* mixBuff, float gain, unsigned samples)
+{
+    switch(fmt) {
+        case S16P:
+            audiokernels::mulAddS16((const int16_t*) data, mixBuff, gain, samples);
+            break;
+        case FLTP:
+            audiokernels::mulAdd((const float*) data, mixBuff, gain, samples);
+            break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+void AudioMixer::extractSpan(float* mixBuff, unsigned char* data, unsigned samples)
 {
-    mixBuff[bufferIdx] += sample*gain*masterGain;
+    if (sampleFormat == S16P) {
+        audiokernels::floatToS16(mixBuff, (int16_t*) data, samples);
+    } else {
+        memcpy(data, mixBuff, samples*sizeof(float));
+    }
 
-    if (mixBuff[bufferIdx] > th) {
-        mixBuff[bufferIdx] = ((1-th)/(2-th))*mixBuff[bufferIdx] + th/(2-th);
-    } else if (mixBuff[bufferIdx] < -th) {
-        mixBuff[bufferIdx] = ((1-th)/(2-th))*mixBuff[bufferIdx] - th/(2-th);
-    } 
+    memset(mixBuff, 0, samples*sizeof(float));
 }
 
 bool AudioMixer::extractMixedFrame(AudioFrame* frame)
 {
     unsigned mixedElements = rear - front;
     unsigned pos;
+    unsigned firstSpan;
     unsigned char* b;
-    float *mixB;
     std::chrono::microseconds ts;
     unsigned bytesPerSample;
+    int outChannels;
 
     if (mixedElements < mixingThreshold) {
         return false;
@@ -191,26 +368,32 @@ bool AudioMixer::extractMixedFrame(AudioFrame* frame)
 
     bytesPerSample = utils::getBytesPerSampleFromFormat(sampleFormat);
 
-    if (bytesPerSample <= 0) {
+    if (sampleFormat != S16P && sampleFormat != FLTP) {
         utils::errorMsg("[AudioMixer] Only S16P and FLTP sample formats are supported");
         return false;
     }
 
-    for (int i = 0; i < channels; i++) {
+    pos = front % mixBufferMaxSamples;
+    //NOTE: samples already mixed after the extracted ones are used as limiter lookahead
+    limiter.process(mixBuffers, channels, mixBufferMaxSamples, pos, outputSamples, mixedElements);
 
-        b = frame->getPlanarDataBuf()[i];
-        pos = front % mixBufferMaxSamples;
-        mixB = mixBuffers[i];
+    firstSpan = std::min(outputSamples, mixBufferMaxSamples - pos);
+    outputMeter.process((unsigned char const* const*) mixBuffers, FLTP, pos, firstSpan);
+    outputMeter.process((unsigned char const* const*) mixBuffers, FLTP, 0, outputSamples - firstSpan);
+    //NOTE: output queues connected before changing the channels keep their own layout
+    outChannels = std::min(channels, (int) frame->getChannels());
 
-        for (unsigned j = 0; j < outputSamples; j++) {
+    for (int i = 0; i < channels; i++) {
+        if (i >= outChannels) {
+            memset(mixBuffers[i] + pos, 0, firstSpan*sizeof(float));
+            memset(mixBuffers[i], 0, (outputSamples - firstSpan)*sizeof(float));
+            continue;
+        }
 
-            if (!floatToBytes(b + j*bytesPerSample, mixB[(pos+j)%mixBufferMaxSamples], sampleFormat)) {
-                utils::errorMsg("[AudioMixer] Error converting samples from bytes to float");
-                return false;
-            }
+        b = frame->getPlanarDataBuf()[i];
 
-            mixB[(pos+j)%mixBufferMaxSamples] = 0;
-        }
+        extractSpan(mixBuffers[i] + pos, b, firstSpan);
+        extractSpan(mixBuffers[i], b + firstSpan*bytesPerSample, outputSamples - firstSpan);
     }
 
     ts = std::chrono::microseconds(front * std::micro::den/sampleRate) + syncTs;
@@ -218,7 +401,7 @@ bool AudioMixer::extractMixedFrame(AudioFrame* frame)
     frame->setDecodeTime(NO_DTS);
     frame->setLength(outputSamples*bytesPerSample);
     frame->setSamples(outputSamples);
-    frame->setChannels(channels);
+    frame->setChannels(outChannels);
     frame->setSampleRate(sampleRate);
 
     front += outputSamples;
@@ -276,8 +459,17 @@ bool AudioMixer::specificReaderConfig(int readerID, FrameQueue* queue)
     }
 
     inBuffer->setOutputFrameSamples(inputFrameSamples);
+    inBuffer->setDriftCompensation(driftCompensation, driftLatency);
+    inBuffer->getLevelMeter().configure(metering, loudnessMetering);
 
     gains[readerID] = DEFAULT_CHANNEL_GAIN;
+    inputBuffers[readerID] = inBuffer;
+    speakerSelector.addChannel(readerID);
+
+    if (queue->getStreamInfo() && queue->getStreamInfo()->audio.channels > 0) {
+        inputChannels[readerID] = queue->getStreamInfo()->audio.channels;
+        updateChannels();
+    }
 
     return true;
 }
@@ -286,11 +478,67 @@ bool AudioMixer::specificReaderDelete(int readerID)
 {
     if (gains.count(readerID) > 0){
         gains.erase(readerID);
+        inputBuffers.erase(readerID);
+        inputChannels.erase(readerID);
+        speakerSelector.removeChannel(readerID);
+        updateChannels();
         return true;
     }
     return false;
 }
 
+//NOTE: once the output is connected its queue keeps the layout, new inputs are mixed into it
+void AudioMixer::updateChannels()
+{
+    unsigned widest = 0;
+
+    if (outputs > 0 || inputChannels.empty()) {
+        return;
+    }
+
+    for (auto it : inputChannels) {
+        widest = std::max(widest, it.second);
+    }
+
+    setChannels(std::min(widest, (unsigned) MAX_CHANNELS));
+}
+
+void AudioMixer::getMixMatrix(unsigned inChannels, unsigned outChannels, std::vector<float>& matrix)
+{
+    std::vector<Speaker> inLayout;
+    std::vector<Speaker> outLayout;
+    std::vector<float> row;
+
+    matrix.assign(inChannels*outChannels, 0);
+
+    if (!defaultLayout(inChannels, inLayout) || !defaultLayout(outChannels, outLayout)) {
+        for (unsigned o = 0; o < outChannels; o++) {
+            if (inChannels == 1) {
+                matrix[o] = 1;
+            } else if (o < inChannels) {
+                matrix[o*inChannels + o] = 1;
+            }
+        }
+        return;
+    }
+
+    for (unsigned i = 0; i < inChannels; i++) {
+        row.assign(outChannels, 0);
+
+        //NOTE: without a centre speaker mono inputs keep their level in both front speakers
+        if (inChannels == 1 && outLayout[0] == SPEAKER_FL && !hasSpeaker(outLayout, SPEAKER_FC)) {
+            row[0] = 1;
+            row[1] = 1;
+        } else {
+            foldSpeaker(inLayout[i], outLayout, 1, row);
+        }
+
+        for (unsigned o = 0; o < outChannels; o++) {
+            matrix[o*inChannels + i] = row[o];
+        }
+    }
+}
+
 bool AudioMixer::setChannelGain(int id, float value)
 {
     if (gains.count(id) <= 0) {
@@ -454,6 +702,224 @@ bool AudioMixer::muteMaster()
     return true;
 }
 
+bool AudioMixer::activeSpeakersEvent(Jzon::Node* params)
+{
+    bool enable;
+    int speakers;
+    int hangover;
+    float threshold;
+
+    if (!params) {
+        return false;
+    }
+
+    if (!params->Has("enable") || !params->Get("enable").IsBool()) {
+        return false;
+    }
+
+    enable = params->Get("enable").ToBool();
+    speakers = speakerSelector.getSpeakers();
+    hangover = speakerSelector.getHangover();
+    threshold = speakerSelector.getThreshold();
+
+    if (params->Has("speakers") && params->Get("speakers").IsNumber()) {
+        speakers = params->Get("speakers").ToInt();
+    }
+
+    if (params->Has("hangover") && params->Get("hangover").IsNumber()) {
+        hangover = params->Get("hangover").ToInt();
+    }
+
+    if (params->Has("threshold") && params->Get("threshold").IsNumber()) {
+        threshold = params->Get("threshold").ToFloat();
+    }
+
+    if (speakers <= 0 || hangover < 0) {
+        utils::errorMsg("[AudioMixer] Invalid active speakers configuration");
+        return false;
+    }
+
+    if (!speakerSelector.configure(enable, speakers, hangover, threshold)) {
+        utils::errorMsg("[AudioMixer] Invalid active speakers configuration");
+        return false;
+    }
+
+    return true;
+}
+
+bool AudioMixer::configureActiveSpeakers(bool enable, int speakers, int hangover, float threshold)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configureActiveSpeakers");
+    params.Add("enable", enable);
+    params.Add("speakers", speakers);
+    params.Add("hangover", hangover);
+    params.Add("threshold", threshold);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
+bool AudioMixer::limiterEvent(Jzon::Node* params)
+{
+    float threshold;
+    int attack;
+    int release;
+
+    if (!params) {
+        return false;
+    }
+
+    threshold = limiter.getThreshold();
+    attack = limiter.getAttack();
+    release = limiter.getRelease();
+
+    if (params->Has("threshold") && params->Get("threshold").IsNumber()) {
+        threshold = params->Get("threshold").ToFloat();
+    }
+
+    if (params->Has("attack") && params->Get("attack").IsNumber()) {
+        attack = params->Get("attack").ToInt();
+    }
+
+    if (params->Has("release") && params->Get("release").IsNumber()) {
+        release = params->Get("release").ToInt();
+    }
+
+    //NOTE: lookahead cannot go further than the samples buffered after each extracted frame
+    if (attack < 0 || release < 0 || 
+        (unsigned) attack*sampleRate/1000 > mixingThreshold - outputSamples) {
+        utils::errorMsg("[AudioMixer] Invalid limiter configuration");
+        return false;
+    }
+
+    if (!limiter.configure(threshold, attack, release)) {
+        utils::errorMsg("[AudioMixer] Invalid limiter configuration");
+        return false;
+    }
+
+    return true;
+}
+
+bool AudioMixer::configureLimiter(float threshold, int attack, int release)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configureLimiter");
+    params.Add("threshold", threshold);
+    params.Add("attack", attack);
+    params.Add("release", release);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
+bool AudioMixer::driftCompensationEvent(Jzon::Node* params)
+{
+    int latency = 0;
+
+    if (!params) {
+        return false;
+    }
+
+    if (!params->Has("enable") || !params->Get("enable").IsBool()) {
+        return false;
+    }
+
+    if (params->Has("latency") && params->Get("latency").IsNumber()) {
+        latency = params->Get("latency").ToInt();
+    }
+
+    if (latency < 0) {
+        utils::errorMsg("[AudioMixer] Invalid drift compensation latency");
+        return false;
+    }
+
+    driftCompensation = params->Get("enable").ToBool();
+    driftLatency = latency;
+
+    for (auto it : inputBuffers) {
+        it.second->setDriftCompensation(driftCompensation, driftLatency);
+    }
+
+    return true;
+}
+
+bool AudioMixer::configureDriftCompensation(bool enable, int latency)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configureDriftCompensation");
+    params.Add("enable", enable);
+    params.Add("latency", latency);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
+void AudioMixer::setChannels(int outputChannels)
+{
+    if (outputChannels == channels) {
+        return;
+    }
+
+    //NOTE: whatever is buffered is discarded and the mix is resynchronized
+    freeMixBuffers();
+    channels = outputChannels;
+    allocMixBuffers();
+    outputMeter.setup(channels, sampleRate);
+    outputStreamInfo->audio.channels = channels;
+    mixMatrices.clear();
+
+    front = 0;
+    rear = 0;
+    limiter.reset();
+    syncTs = std::chrono::microseconds(-1);
+}
+
+bool AudioMixer::meteringEvent(Jzon::Node* params)
+{
+    if (!params) {
+        return false;
+    }
+
+    if (!params->Has("enable") || !params->Get("enable").IsBool()) {
+        return false;
+    }
+
+    metering = params->Get("enable").ToBool();
+    loudnessMetering = false;
+
+    if (params->Has("loudness") && params->Get("loudness").IsBool()) {
+        loudnessMetering = params->Get("loudness").ToBool();
+    }
+
+    outputMeter.configure(metering, loudnessMetering);
+
+    for (auto it : inputBuffers) {
+        it.second->getLevelMeter().configure(metering, loudnessMetering);
+    }
+
+    return true;
+}
+
+bool AudioMixer::configureMetering(bool enable, bool loudness)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configureMetering");
+    params.Add("enable", enable);
+    params.Add("loudness", loudness);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
 void AudioMixer::initializeEventMap()
 {
     eventMap["changeChannelGain"] = std::bind(&AudioMixer::changeChannelVolumeEvent,
@@ -470,11 +936,24 @@ void AudioMixer::initializeEventMap()
 
     eventMap["muteMaster"] = std::bind(&AudioMixer::muteMasterEvent, this,
                                         std::placeholders::_1);
+
+    eventMap["configureActiveSpeakers"] = std::bind(&AudioMixer::activeSpeakersEvent, this,
+                                                     std::placeholders::_1);
+
+    eventMap["configureLimiter"] = std::bind(&AudioMixer::limiterEvent, this,
+                                              std::placeholders::_1);
+
+    eventMap["configureDriftCompensation"] = std::bind(&AudioMixer::driftCompensationEvent, this,
+                                                        std::placeholders::_1);
+
+    eventMap["configureMetering"] = std::bind(&AudioMixer::meteringEvent, this,
+                                               std::placeholders::_1);
 }
 
 void AudioMixer::doGetState(Jzon::Object &filterNode)
 {
     Jzon::Array jsonGains;
+    Jzon::Array jsonActivity;
 
     filterNode.Add("channels", channels);
     filterNode.Add("sampleRate", sampleRate);
@@ -484,10 +963,47 @@ void AudioMixer::doGetState(Jzon::Object &filterNode)
 
     for (auto it : gains) {
         Jzon::Object gain;
+        AudioCircularBuffer* inBuffer = NULL;
+
+        if (inputBuffers.count(it.first) > 0) {
+            inBuffer = inputBuffers[it.first];
+        }
+
         gain.Add("id", it.first);
         gain.Add("gain", it.second);
+        gain.Add("drift", inBuffer ? inBuffer->getDriftCorrection() : 0);
+
+        if (metering && inBuffer) {
+            Jzon::Object levels;
+            inBuffer->getLevelMeter().getState(levels);
+            gain.Add("levels", levels);
+        }
+
         jsonGains.Add(gain);
     }
 
     filterNode.Add("gains", jsonGains);
+
+    speakerSelector.getState(jsonActivity);
+    filterNode.Add("activeSpeakers", speakerSelector.isEnabled());
+    filterNode.Add("speakers", (int) speakerSelector.getSpeakers());
+    filterNode.Add("hangover", (int) speakerSelector.getHangover());
+    filterNode.Add("vadThreshold", speakerSelector.getThreshold());
+    filterNode.Add("activity", jsonActivity);
+
+    filterNode.Add("limiterThreshold", limiter.getThreshold());
+    filterNode.Add("limiterAttack", (int) limiter.getAttack());
+    filterNode.Add("limiterRelease", (int) limiter.getRelease());
+    filterNode.Add("gainReduction", limiter.getGainReduction());
+    filterNode.Add("maxGainReduction", limiter.getMaxGainReduction());
+    filterNode.Add("driftCompensation", driftCompensation);
+    filterNode.Add("driftLatency", (int) driftLatency);
+    filterNode.Add("metering", metering);
+    filterNode.Add("loudnessMetering", loudnessMetering);
+
+    if (metering) {
+        Jzon::Object levels;
+        outputMeter.getState(levels);
+        filterNode.Add("levels", levels);
+    }
 }
\ No newline at end of file
@@ -23,9 +23,15 @@
 #ifndef _AUDIO_MIXER_HH
 #define _AUDIO_MIXER_HH
 
+#include <vector>
+
 #include "../../Frame.hh"
 #include "../../Filter.hh"
 #include "../../AudioFrame.hh"
+#include "../../AudioCircularBuffer.hh"
+#include "../../AudioLevelMeter.hh"
+#include "ActiveSpeakerSelector.hh"
+#include "PeakLimiter.hh"
 
 #define COMPRESSION_THRESHOLD 0.6
 #define DEFAULT_MASTER_GAIN 0.6
@@ -34,6 +40,8 @@
 
 /*! Filter that mixes different audio frames in one frame. Each mixing channel is 
 *   identified by and Id which coincides with the reader associated to it. 
+*   The output layout follows the widest input connected before the output (taken from the
+*   StreamInfo of the input queues), other inputs are down or upmixed to it (see getMixMatrix).
 */
 
 class AudioMixer : public ManyToOneFilter {
@@ -68,6 +76,19 @@ public:
     */ 
     static bool floatToBytes(unsigned char* dst, float const origin, SampleFmt fmt);
 
+    /**
+    * Computes the gains used to mix an input layout into an output layout, assuming the
+    * default libav layout of each channel count (up to 7.1). Missing speakers are folded
+    * following ITU-R BS.775: centre and surrounds at -3 dB into the front or side speakers
+    * and LFE dropped. Mono inputs go to the centre or at full level to both front speakers.
+    * Channel counts without a default layout are mixed channel by channel
+    * @param inChannels Input channels
+    * @param outChannels Output channels
+    * @param matrix (out) Gain of each input channel into each output one, indexed by
+    * output*inChannels + input
+    */
+    static void getMixMatrix(unsigned inChannels, unsigned outChannels, std::vector<float>& matrix);
+
     /**
     * @return mixing buffering in samples
     */ 
@@ -113,32 +134,84 @@ public:
     */ 
     bool muteMaster();
 
+    /**
+    * Configures the active speaker mode. When enabled, only the frames of the N loudest
+    * channels with voice activity are mixed, so mixing cost does not grow with the number
+    * of channels
+    * @param enable True to mix only active speakers
+    * @param speakers Maximum number of mixed channels
+    * @param hangover Time in milliseconds a speaker keeps being mixed after it stops talking
+    * @param threshold Voice activity detection threshold in dBFS
+    * @return always true
+    */
+    bool configureActiveSpeakers(bool enable, int speakers = DEFAULT_ACTIVE_SPEAKERS,
+                                 int hangover = DEFAULT_SPEAKER_HANGOVER, float threshold = DEFAULT_VAD_THRESHOLD);
+
+    /**
+    * Configures the output peak limiter, applied once to each mixed frame
+    * @param threshold Maximum output absolute value (0.0, 1.0]
+    * @param attack Lookahead time in milliseconds
+    * @param release Gain recovery time in milliseconds
+    * @return always true
+    */
+    bool configureLimiter(float threshold, int attack = DEFAULT_LIMITER_ATTACK, int release = DEFAULT_LIMITER_RELEASE);
+
+    /**
+    * Configures clock drift compensation of the input channels. When enabled, inputs are
+    * slightly resampled to keep their buffering stable instead of padding or flushing
+    * @param enable True to compensate drift
+    * @param latency Target buffering in milliseconds, 0 to keep the initial one
+    * @return always true
+    */
+    bool configureDriftCompensation(bool enable, int latency = 0);
+
+    /**
+    * Configures level metering of the input channels (measured by their queues when
+    * samples are pushed) and of the mixed output (measured after the limiter). Levels
+    * are reported by getState and can be polled at any time
+    * @param enable True to measure peak and RMS levels
+    * @param loudness True to measure short-term loudness as well
+    * @return always true
+    */
+    bool configureMetering(bool enable, bool loudness = false);
+
+    /**
+    * @return meter of the mixed output, it can be polled from any thread
+    */
+    const AudioLevelMeter& getOutputMeter() const {return outputMeter;};
+
 protected:
     
     void doGetState(Jzon::Object &filterNode);
     FrameQueue *allocQueue(ConnectionData cData);
     bool doProcessFrame(std::map<int, Frame*> &orgFrames, Frame *dst, std::vector<int> newFrames);
+    bool specificReaderConfig(int readerID, FrameQueue* queue);
+    bool specificReaderDelete(int readerID);
+    bool specificWriterConfig(int /*writerID*/);
+    bool specificWriterDelete(int /*writerID*/);
 
 private:
     void initializeEventMap();
-    bool pushToBuffer(int mixChId, AudioFrame* frame);
+    bool pushToBuffer(int mixChId, AudioFrame* frame, bool mix = true);
     bool fillChannel(std::queue<float> &buffer, int nOfSamples, unsigned char* data, SampleFmt fmt); 
     bool extractMixedFrame(AudioFrame* frame);
-    void mixSample(float sample, float* mixBuff, int bufferIdx, float gain);
+    bool mixSpan(unsigned char const* data, SampleFmt fmt, float* mixBuff, float gain, unsigned samples);
+    void extractSpan(float* mixBuff, unsigned char* data, unsigned samples);
     bool setChannelGain(int id, float value);
-    
-    bool specificReaderConfig(int readerID, FrameQueue* queue);
-    bool specificReaderDelete(int readerID);
 
     bool changeChannelVolumeEvent(Jzon::Node* params);
     bool muteChannelEvent(Jzon::Node* params);
     bool soloChannelEvent(Jzon::Node* params);
     bool changeMasterVolumeEvent(Jzon::Node* params);
     bool muteMasterEvent(Jzon::Node* params);
-    
-    //NOTE: There is no need of specific writer configuration
-    bool specificWriterConfig(int /*writerID*/) {return true;};
-    bool specificWriterDelete(int /*writerID*/) {return true;};
+    bool activeSpeakersEvent(Jzon::Node* params);
+    bool limiterEvent(Jzon::Node* params);
+    bool driftCompensationEvent(Jzon::Node* params);
+    bool meteringEvent(Jzon::Node* params);
+    void allocMixBuffers();
+    void freeMixBuffers();
+    void setChannels(int outputChannels);
+    void updateChannels();
 
     int channels;
     int sampleRate;
@@ -149,9 +222,20 @@ private:
     unsigned rear;
 
     float masterGain;
-    float th;  //Dynamic Range Compression algorithm threshold
 
     std::map<int, float> gains;
+    std::map<int, AudioCircularBuffer*> inputBuffers;
+    std::map<int, unsigned> inputChannels;
+    std::map<unsigned, std::vector<float>> mixMatrices;    //input channels -> gains
+    unsigned outputs;
+    StreamInfo* outputStreamInfo;
+    ActiveSpeakerSelector speakerSelector;
+    PeakLimiter limiter;
+    bool driftCompensation;
+    unsigned driftLatency;
+    AudioLevelMeter outputMeter;
+    bool metering;
+    bool loudnessMetering;
     std::chrono::microseconds syncTs;
     float* mixBuffers[MAX_CHANNELS];
 
@@ -0,0 +1,165 @@
+/*
+ *  PeakLimiter.cpp - Block based lookahead peak limiter
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "PeakLimiter.hh"
+#include "../../AudioKernels.hh"
+
+#include <algorithm>
+#include <cmath>
+
+PeakLimiter::PeakLimiter(unsigned sampleRate) : sampleRate(sampleRate), gain(1), maxReduction(0)
+{
+    configure(DEFAULT_LIMITER_THRESHOLD, DEFAULT_LIMITER_ATTACK, DEFAULT_LIMITER_RELEASE);
+}
+
+bool PeakLimiter::configure(float threshold, unsigned attack, unsigned release)
+{
+    unsigned attackSamples;
+
+    if (threshold <= 0 || threshold > 1) {
+        return false;
+    }
+
+    this->threshold = threshold;
+    this->attack = attack;
+    this->release = release;
+
+    attackSamples = attack*sampleRate/1000;
+    lookaheadBlocks = (attackSamples + LIMITER_BLOCK - 1)/LIMITER_BLOCK;
+
+    if (release == 0) {
+        releaseCoeff = 0;
+    } else {
+        releaseCoeff = std::exp(-1.0*LIMITER_BLOCK*1000/(release*sampleRate));
+    }
+
+    return true;
+}
+
+void PeakLimiter::reset()
+{
+    gain = 1;
+    maxReduction = 0;
+}
+
+float PeakLimiter::getGainReduction()
+{
+    return -20*std::log10(gain);
+}
+
+void PeakLimiter::process(float* const* buffers, int channels, unsigned size, unsigned pos,
+                          unsigned samples, unsigned available)
+{
+    unsigned blocks = (samples + LIMITER_BLOCK - 1)/LIMITER_BLOCK;
+    unsigned totalBlocks = blocks + lookaheadBlocks;
+    unsigned offset;
+    unsigned len;
+    unsigned last;
+    float peak;
+    float raw;
+    float distance;
+    float minGain;
+
+    if (samples == 0) {
+        return;
+    }
+
+    available = std::max(available, samples);
+    targets.resize(totalBlocks);
+    gains.resize(blocks + 1);
+
+    //NOTE: processed blocks are aligned to pos, lookahead ones start after the processed span
+    for (unsigned j = 0; j < totalBlocks; j++) {
+        offset = j < blocks ? j*LIMITER_BLOCK : samples + (j - blocks)*LIMITER_BLOCK;
+        last = j < blocks ? samples : available;
+
+        if (offset >= last) {
+            targets[j] = 1;
+            continue;
+        }
+
+        len = std::min((unsigned) LIMITER_BLOCK, last - offset);
+        peak = blockPeak(buffers, channels, size, (pos + offset) % size, len);
+        targets[j] = peak > threshold ? threshold/peak : 1;
+    }
+
+    //NOTE: gain at the start of block k is the minimum of the targets of the blocks k-1 to
+    //      k+lookahead, each one relaxed linearly with its distance to k. Both block edges
+    //      are then under the block target and so is the interpolated gain inside it
+    for (unsigned k = 0; k <= blocks; k++) {
+        raw = 1;
+
+        for (unsigned j = (k > 0 ? k - 1 : 0); j <= k + lookaheadBlocks && j < totalBlocks; j++) {
+            distance = j > k ? (float) (j - k)/(lookaheadBlocks + 1) : 0;
+            raw = std::min(raw, targets[j] + (1 - targets[j])*distance);
+        }
+
+        if (k == 0 || raw < gain) {
+            gain = std::min(gain, raw);
+        } else {
+            gain = raw - (raw - gain)*releaseCoeff;
+        }
+
+        gains[k] = gain;
+    }
+
+    minGain = 1;
+
+    for (unsigned k = 0; k < blocks; k++) {
+        offset = k*LIMITER_BLOCK;
+        len = std::min((unsigned) LIMITER_BLOCK, samples - offset);
+        minGain = std::min(minGain, std::min(gains[k], gains[k + 1]));
+
+        if (gains[k] == 1 && gains[k + 1] == 1) {
+            continue;
+        }
+
+        applyGain(buffers, channels, size, (pos + offset) % size, len, gains[k], gains[k + 1]);
+    }
+
+    maxReduction = -20*std::log10(minGain);
+}
+
+float PeakLimiter::blockPeak(float* const* buffers, int channels, unsigned size, unsigned pos, unsigned samples)
+{
+    unsigned firstSpan = std::min(samples, size - pos);
+    float peak = 0;
+
+    for (int i = 0; i < channels; i++) {
+        peak = std::max(peak, audiokernels::peak(buffers[i] + pos, firstSpan));
+        peak = std::max(peak, audiokernels::peak(buffers[i], samples - firstSpan));
+    }
+
+    return peak;
+}
+
+void PeakLimiter::applyGain(float* const* buffers, int channels, unsigned size, unsigned pos,
+                            unsigned samples, float start, float end)
+{
+    unsigned firstSpan = std::min(samples, size - pos);
+    float step = (end - start)/samples;
+
+    for (int i = 0; i < channels; i++) {
+        audiokernels::gainRamp(buffers[i] + pos, start, step, firstSpan);
+        audiokernels::gainRamp(buffers[i], start + step*firstSpan, step, samples - firstSpan);
+    }
+}
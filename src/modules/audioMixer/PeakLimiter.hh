@@ -0,0 +1,109 @@
+/*
+ *  PeakLimiter.hh - Block based lookahead peak limiter
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _PEAK_LIMITER_HH
+#define _PEAK_LIMITER_HH
+
+#include <vector>
+
+#define DEFAULT_LIMITER_THRESHOLD 0.98
+#define DEFAULT_LIMITER_ATTACK 5 //ms
+#define DEFAULT_LIMITER_RELEASE 50 //ms
+#define LIMITER_BLOCK 32 //samples
+
+/*! Lookahead peak limiter working on the mixer circular buffers. Gain is computed once per
+*   block of LIMITER_BLOCK samples from the peak of all channels (so the stereo image is
+*   kept) and interpolated linearly inside each block. The lookahead is taken from the
+*   samples already mixed after the extracted ones, so no delay is added: gain starts going
+*   down attack milliseconds before a peak and recovers exponentially with the release time.
+*   The output never exceeds the threshold and it is left untouched when no limiting is needed.
+*/
+
+class PeakLimiter {
+
+public:
+    /**
+    * Class constructor
+    * @param sampleRate Sample rate of the processed audio
+    */
+    PeakLimiter(unsigned sampleRate);
+
+    /**
+    * Configures the limiter
+    * @param threshold Maximum output absolute value (0.0, 1.0]
+    * @param attack Lookahead time in milliseconds
+    * @param release Time in milliseconds to recover 63% of the gain reduction
+    * @return true if the values are valid
+    */
+    bool configure(float threshold, unsigned attack, unsigned release);
+
+    /**
+    * Limits in place a span of samples of a set of circular buffers
+    * @param buffers Circular buffers, one per channel
+    * @param channels Number of channels
+    * @param size Size of the circular buffers in samples
+    * @param pos Position of the first sample to process
+    * @param samples Number of samples to process
+    * @param available Valid samples from pos, including the ones after the processed span
+    */
+    void process(float* const* buffers, int channels, unsigned size, unsigned pos,
+                 unsigned samples, unsigned available);
+
+    /**
+    * Resets the gain, used when the processed stream is resynchronized
+    */
+    void reset();
+
+    float getThreshold() {return threshold;};
+    unsigned getAttack() {return attack;};
+    unsigned getRelease() {return release;};
+
+    /**
+    * @return current gain reduction in dB (0 if not limiting)
+    */
+    float getGainReduction();
+
+    /**
+    * @return maximum gain reduction in dB applied to the last processed span
+    */
+    float getMaxGainReduction() {return maxReduction;};
+
+private:
+    float blockPeak(float* const* buffers, int channels, unsigned size, unsigned pos, unsigned samples);
+    void applyGain(float* const* buffers, int channels, unsigned size, unsigned pos,
+                   unsigned samples, float start, float end);
+
+    unsigned sampleRate;
+    float threshold;
+    unsigned attack;
+    unsigned release;
+    unsigned lookaheadBlocks;
+    float releaseCoeff;
+
+    float gain;
+    float maxReduction;
+
+    std::vector<float> targets;
+    std::vector<float> gains;
+};
+
+#endif
@@ -65,6 +65,7 @@ bool DashAudioSegmenter::setup(unsigned int channels, unsigned int sampleRate, u
 
     if (!dashContext) {
         i2error = generate_context(&dashContext, AUDIO_TYPE);
+        reserveSegmentData();
     }
 
     if (i2error != I2OK || !dashContext) {
@@ -98,7 +99,7 @@ bool DashAudioSegmenter::generateInitSegment(DashSegment* segment)
     data = reinterpret_cast<unsigned char*> (&extradata[0]);
     dataLength = extradata.size();
 
-    if (!data) {
+    if (!data || !segment->reserve(dataLength + INIT_SEGMENT_OVERHEAD)) {
         return false;
     }
 
@@ -0,0 +1,246 @@
+/*
+ *  DashFileWriter.cpp - Asynchronous writer of DASH files
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "DashFileWriter.hh"
+#include "../../Utils.hh"
+
+#include <cstdio>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+DashFileWriter::DashFileWriter(size_t maxBytes) :
+maxBytes(maxBytes), pendingBytes(0), busy(false), stop(false), writes(0), writtenBytes(0),
+removes(0), errors(0), stalls(0), latencySum(0), maxLatency(0)
+{
+    thread = std::thread(&DashFileWriter::run, this);
+}
+
+DashFileWriter::~DashFileWriter()
+{
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        stop = true;
+    }
+
+    taskCv.notify_all();
+    thread.join();
+}
+
+void DashFileWriter::write(std::string path, const unsigned char* data, size_t length)
+{
+    Task task;
+
+    task.path = path;
+    task.data = std::make_shared<const std::vector<unsigned char>>(data, data + length);
+    task.append = false;
+    queue(task, length);
+}
+
+void DashFileWriter::append(std::string path, const unsigned char* data, size_t length)
+{
+    Task task;
+
+    task.path = path;
+    task.data = std::make_shared<const std::vector<unsigned char>>(data, data + length);
+    task.append = true;
+    queue(task, length);
+}
+
+void DashFileWriter::queue(Task& task, size_t length)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+
+    //NOTE: a file bigger than the limit is accepted when the queue is empty
+    if (pendingBytes > 0 && pendingBytes + length > maxBytes) {
+        stalls++;
+        utils::warningMsg("[DashFileWriter] Writing queue full, waiting for the disk");
+        doneCv.wait(lock, [&]{return pendingBytes == 0 || pendingBytes + length <= maxBytes;});
+    }
+
+    task.queued = std::chrono::steady_clock::now();
+    pendingBytes += length;
+    tasks.push_back(task);
+    lock.unlock();
+
+    taskCv.notify_one();
+}
+
+void DashFileWriter::remove(std::string path)
+{
+    Task task;
+
+    task.path = path;
+    task.append = false;
+    task.queued = std::chrono::steady_clock::now();
+
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        tasks.push_back(task);
+    }
+
+    taskCv.notify_one();
+}
+
+void DashFileWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    doneCv.wait(lock, [&]{return tasks.empty() && !busy;});
+}
+
+size_t DashFileWriter::getPendingBytes()
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    return pendingBytes;
+}
+
+float DashFileWriter::getAvgLatency()
+{
+    uint64_t w = writes;
+
+    return w == 0 ? 0 : latencySum/(w*1000.0);
+}
+
+void DashFileWriter::run()
+{
+    std::vector<std::string> unlinks;
+    std::unique_lock<std::mutex> lock(mtx);
+    Task task;
+    size_t length;
+
+    while (true) {
+        taskCv.wait(lock, [&]{return stop || !tasks.empty();});
+
+        if (tasks.empty()) {
+            break;
+        }
+
+        task = tasks.front();
+        tasks.pop_front();
+        busy = true;
+        lock.unlock();
+
+        length = task.data ? task.data->size() : 0;
+
+        //NOTE: a pending removal of the same path must not delete the new file
+        if (task.data && std::find(unlinks.begin(), unlinks.end(), task.path) != unlinks.end()) {
+            removeFiles(unlinks);
+        }
+
+        if (task.data) {
+            writeFile(task);
+        } else {
+            unlinks.push_back(task.path);
+        }
+
+        task.data.reset();
+
+        lock.lock();
+        pendingBytes -= length;
+
+        if (tasks.empty() || unlinks.size() >= WRITER_UNLINK_BATCH) {
+            lock.unlock();
+            removeFiles(unlinks);
+            lock.lock();
+        }
+
+        busy = false;
+        doneCv.notify_all();
+    }
+}
+
+bool DashFileWriter::writeFile(Task& task)
+{
+    std::string openPath = task.append ? task.path : task.path + WRITER_TMP_EXT;
+    const unsigned char* data = task.data->data();
+    size_t length = task.data->size();
+    size_t written = 0;
+    ssize_t ret;
+    uint64_t latency;
+    uint64_t max;
+    int fd;
+
+    if (task.append) {
+        fd = open(openPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    } else {
+        fd = open(openPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+
+    if (fd < 0) {
+        errors++;
+        utils::errorMsg("[DashFileWriter] Error opening " + openPath);
+        return false;
+    }
+
+    while (written < length) {
+        ret = ::write(fd, data + written, length - written);
+
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (ret <= 0) {
+            break;
+        }
+
+        written += ret;
+    }
+
+    if (close(fd) != 0 || written < length || (!task.append && rename(openPath.c_str(), task.path.c_str()) != 0)) {
+        errors++;
+
+        if (!task.append) {
+            unlink(openPath.c_str());
+        }
+
+        utils::errorMsg("[DashFileWriter] Error writing " + task.path);
+        return false;
+    }
+
+    latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - task.queued).count();
+    latencySum += latency;
+    max = maxLatency;
+
+    if (latency > max) {
+        maxLatency = latency;
+    }
+
+    writes++;
+    writtenBytes += length;
+    return true;
+}
+
+void DashFileWriter::removeFiles(std::vector<std::string>& paths)
+{
+    for (auto path : paths) {
+        if (unlink(path.c_str()) != 0) {
+            errors++;
+            utils::warningMsg("[DashFileWriter] Error cleaning dash segment: " + path);
+            continue;
+        }
+
+        removes++;
+    }
+
+    paths.clear();
+}
@@ -0,0 +1,140 @@
+/*
+ *  DashFileWriter.hh - Asynchronous writer of DASH files
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _DASH_FILE_WRITER_HH
+#define _DASH_FILE_WRITER_HH
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+#include "DashSegmentStore.hh"
+
+#define DEFAULT_WRITER_MAX_BYTES 64*1024*1024  //bytes pending to be written
+#define WRITER_UNLINK_BATCH 32                 //files
+#define WRITER_TMP_EXT ".tmp"
+
+/*! Writes and removes the DASH files in its own thread, so a slow disk does not stall the
+    Dasher processing thread. Files are written to a temporary name and renamed, so readers
+    never see partial segments or MPDs. Tasks are executed in the order they are queued,
+    except removals, which are batched and done when the queue gets empty (or every
+    WRITER_UNLINK_BATCH files, or before writing a path waiting to be removed). The queue is bounded by the bytes pending to be written:
+    when it is full, write blocks until there is room, and the stall is counted. Chunked
+    segments are the exception to the renaming: their chunks are appended in place, so
+    they can be read while they grow. */
+
+class DashFileWriter {
+
+public:
+    /**
+    * Class constructor, it starts the writing thread
+    * @param maxBytes Maximum bytes queued before write blocks
+    */
+    DashFileWriter(size_t maxBytes = DEFAULT_WRITER_MAX_BYTES);
+
+    /**
+    * Class destructor, it writes all the queued files before returning
+    */
+    ~DashFileWriter();
+
+    /**
+    * Queues a file to be written, its content is copied
+    * @param path File path
+    * @param data File content
+    * @param length File length in bytes
+    */
+    void write(std::string path, const unsigned char* data, size_t length);
+
+    /**
+    * Queues data to be appended to a file, its content is copied
+    * @param path File path, it is created if it does not exist
+    * @param data Appended content
+    * @param length Appended length in bytes
+    */
+    void append(std::string path, const unsigned char* data, size_t length);
+
+    /**
+    * Queues a file to be removed
+    * @param path File path
+    */
+    void remove(std::string path);
+
+    /**
+    * Waits until all the queued tasks are done
+    */
+    void flush();
+
+    size_t getPendingBytes();
+    uint64_t getWrites() {return writes;};
+    uint64_t getWrittenBytes() {return writtenBytes;};
+    uint64_t getRemoves() {return removes;};
+    uint64_t getErrors() {return errors;};
+    uint64_t getStalls() {return stalls;};
+
+    /**
+    * @return average time from queuing to renaming of the written files in milliseconds
+    */
+    float getAvgLatency();
+
+    /**
+    * @return maximum time from queuing to renaming of the written files in milliseconds
+    */
+    float getMaxLatency() {return maxLatency/1000.0;};
+
+private:
+    struct Task {
+        std::string path;
+        StoredData data;
+        bool append;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    void run();
+    void queue(Task& task, size_t length);
+    bool writeFile(Task& task);
+    void removeFiles(std::vector<std::string>& paths);
+
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable taskCv;
+    std::condition_variable doneCv;
+    std::deque<Task> tasks;
+    size_t maxBytes;
+    size_t pendingBytes;
+    bool busy;
+    bool stop;
+
+    std::atomic<uint64_t> writes;
+    std::atomic<uint64_t> writtenBytes;
+    std::atomic<uint64_t> removes;
+    std::atomic<uint64_t> errors;
+    std::atomic<uint64_t> stalls;
+    std::atomic<uint64_t> latencySum;        //us
+    std::atomic<uint64_t> maxLatency;        //us
+};
+
+#endif
@@ -0,0 +1,758 @@
+/*
+ *  DashHttpServer.cpp - Embedded HTTP origin for DASH files
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "DashHttpServer.hh"
+#include "../../Utils.hh"
+
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+
+DashHttpServer::DashHttpServer(DashSegmentStore* store, unsigned timeout) :
+store(store), running(false), listenFd(-1), epollFd(-1), wakeFd(-1), port(0),
+idleTimeout(std::max(timeout, 1u)), connectionsNum(0), requests(0), sentBytes(0)
+{
+}
+
+DashHttpServer::~DashHttpServer()
+{
+    stop();
+}
+
+bool DashHttpServer::start(unsigned listenPort)
+{
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    struct epoll_event ev;
+    int yes = 1;
+
+    if (running) {
+        stop();
+    }
+
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (listenFd < 0) {
+        utils::errorMsg("[DashHttpServer] Error opening socket");
+        return false;
+    }
+
+    if (setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int)) == -1) {
+        utils::errorMsg("[DashHttpServer] Error setting socket options");
+        stop();
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(listenPort);
+
+    if (bind(listenFd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        listen(listenFd, HTTP_LISTEN_BACKLOG) < 0) {
+        utils::errorMsg("[DashHttpServer] Error binding port " + std::to_string(listenPort));
+        stop();
+        return false;
+    }
+
+    getsockname(listenFd, (struct sockaddr *) &addr, &addrLen);
+    port = ntohs(addr.sin_port);
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (epollFd < 0 || wakeFd < 0) {
+        utils::errorMsg("[DashHttpServer] Error creating event descriptors");
+        stop();
+        return false;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+    running = true;
+    thread = std::thread(&DashHttpServer::serve, this);
+    store->setListener(std::bind(&DashHttpServer::wake, this));
+
+    utils::infoMsg("[DashHttpServer] Serving DASH files at port " + std::to_string(port));
+    return true;
+}
+
+void DashHttpServer::stop()
+{
+    uint64_t one = 1;
+
+    //NOTE: it waits for a running notification, so wakeFd is not written once closed
+    store->setListener(nullptr);
+
+    if (thread.joinable()) {
+        running = false;
+
+        if (write(wakeFd, &one, sizeof(one)) < 0) {
+            utils::warningMsg("[DashHttpServer] Error waking up the server thread");
+        }
+
+        thread.join();
+    }
+
+    running = false;
+
+    for (auto it : connections) {
+        close(it.first);
+        delete it.second;
+    }
+
+    connections.clear();
+    connectionsNum = 0;
+
+    if (listenFd >= 0) {
+        close(listenFd);
+    }
+
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+
+    if (wakeFd >= 0) {
+        close(wakeFd);
+    }
+
+    listenFd = -1;
+    epollFd = -1;
+    wakeFd = -1;
+    port = 0;
+}
+
+void DashHttpServer::serve()
+{
+    struct epoll_event events[HTTP_MAX_EVENTS];
+    std::chrono::milliseconds checkPeriod = idleTimeout/HTTP_IDLE_CHECKS + std::chrono::milliseconds(1);
+    std::chrono::steady_clock::time_point lastCheck = std::chrono::steady_clock::now();
+    Connection* c;
+    int n;
+
+    while (running) {
+        n = epoll_wait(epollFd, events, HTTP_MAX_EVENTS, checkPeriod.count());
+
+        if (n < 0 && errno != EINTR) {
+            utils::errorMsg("[DashHttpServer] Error waiting for events");
+            break;
+        }
+
+        for (int i = 0; i < n && running; i++) {
+            if (events[i].data.fd == wakeFd) {
+                resumeConnections();
+                continue;
+            }
+
+            if (events[i].data.fd == listenFd) {
+                acceptConnections();
+                continue;
+            }
+
+            if (connections.count(events[i].data.fd) == 0) {
+                continue;
+            }
+
+            c = connections[events[i].data.fd];
+
+            if (events[i].events & EPOLLERR) {
+                closeConnection(c);
+                continue;
+            }
+
+            //NOTE: only the peer closing is watched while waiting for the file to grow
+            if (c->parked) {
+                if (events[i].events & (EPOLLRDHUP | EPOLLHUP)) {
+                    closeConnection(c);
+                }
+
+                continue;
+            }
+
+            //NOTE: a pending response is completed before reading more requests, pipelined
+            //      ones wait in the socket buffer meanwhile
+            if ((events[i].events & EPOLLOUT) && c->responding && !continueResponse(c)) {
+                closeConnection(c);
+                continue;
+            }
+
+            if ((events[i].events & (EPOLLIN | EPOLLHUP)) && !c->responding && !readRequests(c)) {
+                closeConnection(c);
+            }
+        }
+
+        //NOTE: a busy server returns from epoll_wait before the timeout, so the period is checked apart
+        if (std::chrono::steady_clock::now() - lastCheck >= checkPeriod) {
+            closeIdleConnections();
+            lastCheck = std::chrono::steady_clock::now();
+        }
+    }
+}
+
+void DashHttpServer::wake()
+{
+    uint64_t one = 1;
+
+    if (write(wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        utils::warningMsg("[DashHttpServer] Error waking up the server thread");
+    }
+}
+
+void DashHttpServer::acceptConnections()
+{
+    struct epoll_event ev;
+    Connection* c;
+    int fd;
+    int yes = 1;
+
+    while ((fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(int));
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
+        }
+
+        c = new Connection();
+        c->fd = fd;
+        c->events = EPOLLIN;
+        c->sent = 0;
+        c->nextPart = 0;
+        c->responding = false;
+        c->streaming = false;
+        c->chunked = false;
+        c->parked = false;
+        c->keepAlive = true;
+        c->lastActivity = std::chrono::steady_clock::now();
+        connections[fd] = c;
+        connectionsNum = connections.size();
+    }
+}
+
+void DashHttpServer::resumeConnections()
+{
+    std::vector<Connection*> parked;
+    uint64_t value;
+
+    if (read(wakeFd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        utils::warningMsg("[DashHttpServer] Error reading wake up events");
+    }
+
+    for (auto it : connections) {
+        if (it.second->parked) {
+            parked.push_back(it.second);
+        }
+    }
+
+    for (auto c : parked) {
+        c->parked = false;
+
+        if (!continueResponse(c)) {
+            closeConnection(c);
+        }
+    }
+}
+
+void DashHttpServer::closeConnection(Connection* c)
+{
+    //NOTE: counted before closing, so that peers never see the end of the stream first
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, c->fd, NULL);
+    connections.erase(c->fd);
+    connectionsNum = connections.size();
+    close(c->fd);
+    delete c;
+}
+
+void DashHttpServer::closeIdleConnections()
+{
+    std::vector<Connection*> idle;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    for (auto it : connections) {
+        if (now - it.second->lastActivity >= idleTimeout) {
+            idle.push_back(it.second);
+        }
+    }
+
+    for (auto c : idle) {
+        closeConnection(c);
+    }
+}
+
+bool DashHttpServer::setInterest(Connection* c, uint32_t events)
+{
+    struct epoll_event ev;
+
+    if (c->events == events) {
+        return true;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = c->fd;
+    c->events = events;
+
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, c->fd, &ev) == 0;
+}
+
+bool DashHttpServer::readRequests(Connection* c)
+{
+    char buffer[HTTP_READ_CHUNK];
+    ssize_t len;
+
+    while ((len = read(c->fd, buffer, HTTP_READ_CHUNK)) > 0) {
+        c->input.append(buffer, len);
+        c->lastActivity = std::chrono::steady_clock::now();
+
+        if (c->input.size() >= HTTP_MAX_REQUEST) {
+            break;
+        }
+    }
+
+    if (len == 0 || (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        return false;
+    }
+
+    return processRequests(c);
+}
+
+bool DashHttpServer::processRequests(Connection* c)
+{
+    size_t end;
+
+    while (!c->responding && (end = c->input.find("\r\n\r\n")) != std::string::npos) {
+        if (!parseRequest(c, c->input.substr(0, end))) {
+            c->keepAlive = false;
+        }
+
+        c->input.erase(0, end + 4);
+        requests++;
+
+        if (!sendResponse(c)) {
+            return false;
+        }
+
+        if (c->responding) {
+            return setInterest(c, c->parked ? EPOLLRDHUP : EPOLLOUT);
+        }
+
+        if (!c->keepAlive) {
+            return false;
+        }
+    }
+
+    //NOTE: oversized requests are not answered, the connection is just closed
+    return c->input.size() < HTTP_MAX_REQUEST;
+}
+
+bool DashHttpServer::parseRequest(Connection* c, std::string request)
+{
+    std::string line;
+    std::string method;
+    std::string target;
+    std::string version;
+    std::string field;
+    std::string range;
+    size_t lineEnd;
+    size_t pos;
+    StoredFileRef file;
+
+    lineEnd = request.find("\r\n");
+    line = request.substr(0, lineEnd);
+
+    pos = line.find(' ');
+    method = line.substr(0, pos);
+    line = pos == std::string::npos ? "" : line.substr(pos + 1);
+    pos = line.find(' ');
+    target = line.substr(0, pos);
+    version = pos == std::string::npos ? "" : line.substr(pos + 1);
+
+    c->keepAlive = version == "HTTP/1.1";
+
+    if (version != "HTTP/1.1" && version != "HTTP/1.0") {
+        setResponse(c, "400 Bad Request", StoredFileRef(), "", false, false);
+        return false;
+    }
+
+    while (lineEnd != std::string::npos) {
+        pos = lineEnd + 2;
+        lineEnd = request.find("\r\n", pos);
+        field = request.substr(pos, lineEnd == std::string::npos ? std::string::npos : lineEnd - pos);
+        std::transform(field.begin(), field.end(), field.begin(), ::tolower);
+
+        if (field.compare(0, 6, "range:") == 0) {
+            range = field.substr(6);
+            range.erase(std::remove(range.begin(), range.end(), ' '), range.end());
+            continue;
+        }
+
+        if (field.compare(0, 11, "connection:") != 0) {
+            continue;
+        }
+
+        if (field.find("close") != std::string::npos) {
+            c->keepAlive = false;
+        } else if (field.find("keep-alive") != std::string::npos) {
+            c->keepAlive = true;
+        }
+    }
+
+    if (method != "GET" && method != "HEAD") {
+        setResponse(c, "405 Method Not Allowed", StoredFileRef(), "", false, false);
+        return false;
+    }
+
+    target = target.substr(0, target.find('?'));
+    file = store->open(target);
+
+    if (!file) {
+        setResponse(c, "404 Not Found", StoredFileRef(), "", false, false);
+        return true;
+    }
+
+    //NOTE: malformed ranges are ignored and the whole file is sent
+    if (!range.empty() && setRangeResponse(c, file, getContentType(target), range, method == "GET")) {
+        return true;
+    }
+
+    setResponse(c, "200 OK", file, getContentType(target), method == "GET", version == "HTTP/1.1");
+    return true;
+}
+
+bool DashHttpServer::parseRange(std::string range, size_t length, size_t& first, size_t& last)
+{
+    size_t dash = range.find('-');
+    std::string firstPos;
+    std::string lastPos;
+    size_t suffix;
+
+    //NOTE: only single ranges are supported, multiple ones are ignored as malformed
+    if (range.compare(0, 6, "bytes=") != 0 || dash == std::string::npos || range.find(',') != std::string::npos) {
+        return false;
+    }
+
+    firstPos = range.substr(6, dash - 6);
+    lastPos = range.substr(dash + 1);
+
+    if ((firstPos.empty() && lastPos.empty()) || 
+        firstPos.find_first_not_of("0123456789") != std::string::npos ||
+        lastPos.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+
+    //NOTE: suffix ranges request the last bytes, the whole file if it is shorter
+    if (firstPos.empty()) {
+        suffix = std::min((size_t) strtoull(lastPos.c_str(), NULL, 10), length);
+        first = suffix > 0 ? length - suffix : length;
+        last = length - 1;
+        return true;
+    }
+
+    first = strtoull(firstPos.c_str(), NULL, 10);
+    last = lastPos.empty() ? length - 1 : strtoull(lastPos.c_str(), NULL, 10);
+
+    if (!lastPos.empty() && last < first) {
+        return false;
+    }
+
+    //NOTE: the last byte is limited to the file length, open ranges end there
+    last = std::min(last, length - 1);
+    return true;
+}
+
+bool DashHttpServer::setRangeResponse(Connection* c, StoredFileRef file, std::string type, std::string range, bool sendBody)
+{
+    bool complete = true;
+    size_t length = store->getLength(file, complete);
+    size_t first = 0;
+    size_t last = 0;
+    StoredData data;
+
+    if (!parseRange(range, length, first, last)) {
+        return false;
+    }
+
+    if (first < length && first <= last) {
+        data = store->readRange(file, first, last - first + 1);
+    }
+
+    c->header = data ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 416 Range Not Satisfiable\r\n";
+    c->header += "Server: liveMediaStreamer\r\n";
+
+    //NOTE: the length of a growing file is not known yet
+    if (data) {
+        c->header += "Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + 
+                     (complete ? std::to_string(length) : "*") + "\r\n";
+        c->header += "Content-Length: " + std::to_string(data->size()) + "\r\n";
+        c->header += "Content-Type: " + type + "\r\n";
+    } else {
+        c->header += "Content-Range: bytes */" + std::to_string(length) + "\r\n";
+        c->header += "Content-Length: 0\r\n";
+    }
+
+    c->header += "Access-Control-Allow-Origin: *\r\n";
+    c->header += c->keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+
+    c->body = sendBody ? data : StoredData();
+    c->trailer.clear();
+    c->sent = 0;
+    c->file.reset();
+    c->nextPart = 0;
+    c->responding = true;
+    c->streaming = false;
+    c->chunked = false;
+    c->parked = false;
+    return true;
+}
+
+void DashHttpServer::setResponse(Connection* c, std::string status, StoredFileRef file, std::string type, bool sendBody, bool chunked)
+{
+    StoredData part;
+    bool complete = true;
+    size_t length = file ? store->getLength(file, complete) : 0;
+
+    c->header = "HTTP/1.1 " + status + "\r\n";
+    c->header += "Server: liveMediaStreamer\r\n";
+
+    //NOTE: the length of a growing file is not known, HTTP/1.0 clients get it until the connection is closed
+    if (complete) {
+        c->header += "Content-Length: " + std::to_string(length) + "\r\n";
+    } else if (chunked) {
+        c->header += "Transfer-Encoding: chunked\r\n";
+    } else {
+        c->keepAlive = false;
+    }
+
+    if (!type.empty()) {
+        c->header += "Content-Type: " + type + "\r\n";
+    }
+
+    //NOTE: the MPD changes with every segment, segments never change once published
+    if (type == "application/dash+xml") {
+        c->header += "Cache-Control: no-cache\r\n";
+    }
+
+    if (file) {
+        c->header += "Accept-Ranges: bytes\r\n";
+    }
+
+    c->header += "Access-Control-Allow-Origin: *\r\n";
+    c->header += c->keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+
+    c->body.reset();
+    c->trailer.clear();
+    c->sent = 0;
+    c->file = sendBody ? file : StoredFileRef();
+    c->nextPart = 0;
+    c->responding = true;
+    c->streaming = sendBody && file;
+    c->chunked = !complete && chunked;
+    c->parked = false;
+
+    //NOTE: the first part is sent together with the header
+    if (c->streaming && store->readPart(file, 0, part, complete)) {
+        setPart(c, part);
+    }
+}
+
+bool DashHttpServer::continueResponse(Connection* c)
+{
+    if (!sendResponse(c)) {
+        return false;
+    }
+
+    if (c->responding) {
+        return setInterest(c, c->parked ? EPOLLRDHUP : EPOLLOUT);
+    }
+
+    if (!c->keepAlive) {
+        return false;
+    }
+
+    return setInterest(c, EPOLLIN) && processRequests(c);
+}
+
+bool DashHttpServer::sendResponse(Connection* c)
+{
+    struct iovec iov[3];
+    struct msghdr msg;
+    size_t bodyLength;
+    size_t total;
+    size_t pos;
+    ssize_t len;
+    int iovs;
+
+    while (c->responding) {
+        bodyLength = c->body ? c->body->size() : 0;
+        total = c->header.size() + bodyLength + c->trailer.size();
+
+        if (c->sent >= total) {
+            if (!queuePart(c)) {
+                return true;
+            }
+
+            continue;
+        }
+
+        iovs = 0;
+        pos = c->sent;
+
+        if (pos < c->header.size()) {
+            iov[iovs].iov_base = (void*) (c->header.data() + pos);
+            iov[iovs].iov_len = c->header.size() - pos;
+            iovs++;
+            pos = 0;
+        } else {
+            pos -= c->header.size();
+        }
+
+        if (pos < bodyLength) {
+            iov[iovs].iov_base = (void*) (c->body->data() + pos);
+            iov[iovs].iov_len = bodyLength - pos;
+            iovs++;
+            pos = 0;
+        } else {
+            pos -= bodyLength;
+        }
+
+        if (pos < c->trailer.size()) {
+            iov[iovs].iov_base = (void*) (c->trailer.data() + pos);
+            iov[iovs].iov_len = c->trailer.size() - pos;
+            iovs++;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovs;
+
+        len = sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+
+        if (len < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        c->sent += len;
+        c->lastActivity = std::chrono::steady_clock::now();
+        sentBytes += len;
+    }
+
+    return true;
+}
+
+bool DashHttpServer::queuePart(Connection* c)
+{
+    StoredData part;
+    bool complete;
+
+    c->header.clear();
+    c->body.reset();
+    c->trailer.clear();
+    c->sent = 0;
+
+    if (c->streaming && store->readPart(c->file, c->nextPart, part, complete)) {
+        setPart(c, part);
+        return true;
+    }
+
+    if (c->streaming && !complete) {
+        c->parked = true;
+        return false;
+    }
+
+    //NOTE: the last chunk is queued once the file is complete, then the response is done
+    if (c->streaming && c->chunked) {
+        c->streaming = false;
+        c->trailer = "0\r\n\r\n";
+        return true;
+    }
+
+    c->streaming = false;
+    c->responding = false;
+    c->file.reset();
+    return false;
+}
+
+void DashHttpServer::setPart(Connection* c, StoredData part)
+{
+    char sizeLine[32];
+
+    c->nextPart++;
+    c->body = part;
+
+    if (c->chunked) {
+        snprintf(sizeLine, sizeof(sizeLine), "%zx\r\n", part->size());
+        c->header += sizeLine;
+        c->trailer = "\r\n";
+    }
+}
+
+std::string DashHttpServer::getContentType(std::string path)
+{
+    std::string ext = path.substr(std::min(path.rfind('.'), path.size()));
+
+    if (ext == ".mpd") {
+        return "application/dash+xml";
+    }
+
+    if (ext == ".m4v" || ext == ".mp4") {
+        return "video/mp4";
+    }
+
+    if (ext == ".m4a") {
+        return "audio/mp4";
+    }
+
+    if (ext == ".m3u8") {
+        return "application/vnd.apple.mpegurl";
+    }
+
+    return "application/octet-stream";
+}
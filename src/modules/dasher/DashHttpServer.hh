@@ -0,0 +1,146 @@
+/*
+ *  DashHttpServer.hh - Embedded HTTP origin for DASH files
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _DASH_HTTP_SERVER_HH
+#define _DASH_HTTP_SERVER_HH
+
+#include <map>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "DashSegmentStore.hh"
+
+#define HTTP_MAX_EVENTS 64
+#define HTTP_MAX_REQUEST 8192       //bytes of request line and headers
+#define HTTP_READ_CHUNK 4096        //bytes
+#define HTTP_LISTEN_BACKLOG 128
+#define HTTP_IDLE_TIMEOUT 30000     //ms without reading nor sending before closing a connection
+#define HTTP_IDLE_CHECKS 4          //idle checks per timeout period
+
+/*! Event driven HTTP/1.1 server of the files of a DashSegmentStore. One thread serves
+    all the connections with non-blocking sockets and epoll. GET and HEAD requests are
+    supported, with persistent connections and pipelining. Responses are sent without
+    copying the files: the header and the shared file content are written together
+    with scatter-gather I/O, and the content is kept alive until it is completely sent
+    even if the Dasher removes it from the store meanwhile. Files still being generated
+    (chunked segments in low latency mode) are sent while they grow, using the chunked
+    transfer coding: the connection waits for the next chunk without polling, the store
+    wakes the server thread up after every append. Connections without any progress
+    during the idle timeout (idle keep-alive clients, stalled readers or streams of files
+    that stopped growing) are closed. Single byte ranges, suffix ones
+    included, are supported, so the ring files of the byte-range mode can be requested
+    segment by segment. */
+
+class DashHttpServer {
+
+public:
+    /**
+    * Class constructor
+    * @param store Served files, it must outlive the server
+    * @param idleTimeout Milliseconds without reading nor sending before closing a connection
+    */
+    DashHttpServer(DashSegmentStore* store, unsigned idleTimeout = HTTP_IDLE_TIMEOUT);
+
+    /**
+    * Class destructor, it stops the server
+    */
+    ~DashHttpServer();
+
+    /**
+    * Starts listening and serving in a new thread
+    * @param port TCP port, 0 to use any free one (see getPort)
+    * @return true if succeeded and false if not
+    */
+    bool start(unsigned port);
+
+    /**
+    * Stops the server and closes all the connections
+    */
+    void stop();
+
+    bool isRunning() {return running;};
+
+    /**
+    * @return listening port, 0 if not running
+    */
+    unsigned getPort() {return port;};
+
+    unsigned getConnections() {return connectionsNum;};
+    uint64_t getRequests() {return requests;};
+    uint64_t getSentBytes() {return sentBytes;};
+
+private:
+    struct Connection {
+        int fd;
+        uint32_t events;
+        std::string input;
+        std::string header;     //response header or chunk size line pending to be sent
+        StoredData body;        //file part pending to be sent
+        std::string trailer;    //chunk end pending to be sent
+        size_t sent;
+        StoredFileRef file;
+        size_t nextPart;
+        bool responding;
+        bool streaming;         //file parts pending to be queued
+        bool chunked;
+        bool parked;            //waiting for the file to grow
+        bool keepAlive;
+        std::chrono::steady_clock::time_point lastActivity;
+    };
+
+    void serve();
+    void wake();
+    void acceptConnections();
+    void resumeConnections();
+    void closeConnection(Connection* c);
+    void closeIdleConnections();
+    bool readRequests(Connection* c);
+    bool processRequests(Connection* c);
+    bool parseRequest(Connection* c, std::string request);
+    void setResponse(Connection* c, std::string status, StoredFileRef file, std::string type, bool sendBody, bool chunked);
+    bool setRangeResponse(Connection* c, StoredFileRef file, std::string type, std::string range, bool sendBody);
+    bool continueResponse(Connection* c);
+    bool sendResponse(Connection* c);
+    bool queuePart(Connection* c);
+    void setPart(Connection* c, StoredData part);
+    bool setInterest(Connection* c, uint32_t events);
+    static bool parseRange(std::string range, size_t length, size_t& first, size_t& last);
+    static std::string getContentType(std::string path);
+
+    DashSegmentStore* store;
+    std::thread thread;
+    std::atomic<bool> running;
+    int listenFd;
+    int epollFd;
+    int wakeFd;
+    unsigned port;
+    std::chrono::milliseconds idleTimeout;
+
+    std::map<int, Connection*> connections;
+    std::atomic<unsigned> connectionsNum;
+    std::atomic<uint64_t> requests;
+    std::atomic<uint64_t> sentBytes;
+};
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ *  DashSegmentStore.cpp - In-memory store of DASH files
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "DashSegmentStore.hh"
+
+#include <algorithm>
+
+DashSegmentStore::DashSegmentStore() : bytes(0)
+{
+}
+
+void DashSegmentStore::put(std::string path, const unsigned char* data, size_t length)
+{
+    //NOTE: content is copied out of the lock, requests are not blocked by the copy
+    StoredFileRef file = std::make_shared<StoredFile>();
+    bool replaced = false;
+
+    file->parts.push_back(std::make_shared<const std::vector<unsigned char>>(data, data + length));
+    file->length = length;
+    file->complete = true;
+
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = files.find(path);
+
+        if (it != files.end()) {
+            bytes -= it->second->length;
+            replaced = !it->second->complete;
+            it->second->complete = true;
+        }
+
+        files[path] = file;
+        bytes += length;
+    }
+
+    //NOTE: readers of a replaced incomplete file end it with the data they have
+    if (replaced) {
+        notify();
+    }
+}
+
+void DashSegmentStore::append(std::string path, const unsigned char* data, size_t length, bool complete)
+{
+    StoredData content;
+    StoredFileRef file;
+
+    if (length > 0) {
+        content = std::make_shared<const std::vector<unsigned char>>(data, data + length);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = files.find(path);
+
+        if (it == files.end() || it->second->complete) {
+            if (it != files.end()) {
+                bytes -= it->second->length;
+            }
+
+            file = std::make_shared<StoredFile>();
+            file->length = 0;
+            file->complete = false;
+            files[path] = file;
+        } else {
+            file = it->second;
+        }
+
+        if (content) {
+            file->parts.push_back(content);
+            file->length += length;
+            bytes += length;
+        }
+
+        file->complete = complete;
+    }
+
+    notify();
+}
+
+bool DashSegmentStore::remove(std::string path)
+{
+    bool incomplete;
+
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = files.find(path);
+
+        if (it == files.end()) {
+            return false;
+        }
+
+        bytes -= it->second->length;
+        incomplete = !it->second->complete;
+        it->second->complete = true;
+        files.erase(it);
+    }
+
+    if (incomplete) {
+        notify();
+    }
+
+    return true;
+}
+
+StoredData DashSegmentStore::get(std::string path)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    std::shared_ptr<std::vector<unsigned char>> merged;
+    auto it = files.find(path);
+
+    if (it == files.end() || !it->second->complete) {
+        return StoredData();
+    }
+
+    if (it->second->parts.size() == 1) {
+        return it->second->parts.front();
+    }
+
+    //NOTE: parts are not replaced by the merged copy, files can be being read part by part
+    merged = std::make_shared<std::vector<unsigned char>>();
+    merged->reserve(it->second->length);
+
+    for (auto part : it->second->parts) {
+        merged->insert(merged->end(), part->begin(), part->end());
+    }
+
+    return merged;
+}
+
+StoredFileRef DashSegmentStore::open(std::string path)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    auto it = files.find(path);
+
+    if (it == files.end()) {
+        return StoredFileRef();
+    }
+
+    return it->second;
+}
+
+bool DashSegmentStore::readPart(StoredFileRef file, size_t index, StoredData& part, bool& complete)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+
+    complete = file->complete;
+
+    if (index >= file->parts.size()) {
+        return false;
+    }
+
+    part = file->parts[index];
+    return true;
+}
+
+size_t DashSegmentStore::getLength(StoredFileRef file, bool& complete)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+
+    complete = file->complete;
+    return file->length;
+}
+
+StoredData DashSegmentStore::readRange(StoredFileRef file, size_t offset, size_t length)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    std::shared_ptr<std::vector<unsigned char>> range;
+    size_t partStart = 0;
+    size_t first;
+    size_t last;
+
+    if (length == 0 || offset + length > file->length) {
+        return StoredData();
+    }
+
+    range = std::make_shared<std::vector<unsigned char>>();
+    range->reserve(length);
+
+    for (auto part : file->parts) {
+        first = std::max(offset, partStart);
+        last = std::min(offset + length, partStart + part->size());
+
+        if (first < last) {
+            range->insert(range->end(), part->begin() + (first - partStart), part->begin() + (last - partStart));
+        }
+
+        partStart += part->size();
+    }
+
+    return range;
+}
+
+void DashSegmentStore::setListener(std::function<void()> l)
+{
+    std::lock_guard<std::mutex> guard(listenerMtx);
+    listener = l;
+}
+
+void DashSegmentStore::notify()
+{
+    //NOTE: setListener waits for a running notification, so the listener can be destroyed after removing it
+    std::lock_guard<std::mutex> guard(listenerMtx);
+
+    if (listener) {
+        listener();
+    }
+}
+
+size_t DashSegmentStore::getFiles()
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    return files.size();
+}
+
+size_t DashSegmentStore::getBytes()
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    return bytes;
+}
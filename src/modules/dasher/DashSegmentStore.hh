@@ -0,0 +1,154 @@
+/*
+ *  DashSegmentStore.hh - In-memory store of DASH files
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _DASH_SEGMENT_STORE_HH
+#define _DASH_SEGMENT_STORE_HH
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+/*! Immutable content of a stored file. It is shared between the store and the requests
+    being served, so a file removed from the store stays alive until it is sent */
+
+typedef std::shared_ptr<const std::vector<unsigned char>> StoredData;
+
+/*! Stored file, made of the parts appended to it. Files written at once have a single part,
+    chunked segments get a part per chunk until they are complete. Parts are only accessed
+    through the store methods, which synchronize them with the appends */
+
+struct StoredFile {
+    std::vector<StoredData> parts;
+    size_t length;
+    bool complete;
+};
+
+typedef std::shared_ptr<StoredFile> StoredFileRef;
+
+/*! In-memory replacement of the DASH folder, used when the Dasher works as origin server.
+    Segments, init segments and the MPD are stored by path (e.g. "/test_0_init.m4v"). The
+    Dasher adds and removes files following the MPD time-shift window, exactly as it does
+    with the files on disk, so memory is bounded by maxSeg segments per representation.
+    In low latency mode segments are appended chunk by chunk while they are generated and
+    readers are notified of every append, so they can send each chunk as soon as it exists.
+    All methods can be called from any thread. */
+
+class DashSegmentStore {
+
+public:
+    /**
+    * Class constructor
+    */
+    DashSegmentStore();
+
+    /**
+    * Adds or replaces a file, its content is copied
+    * @param path File path, starting with '/'
+    * @param data File content
+    * @param length File length in bytes
+    */
+    void put(std::string path, const unsigned char* data, size_t length);
+
+    /**
+    * Appends data to a file, creating it if it does not exist, its content is copied
+    * @param path File path, starting with '/'
+    * @param data Appended content, it can be empty
+    * @param length Appended length in bytes
+    * @param complete true if it is the last append of the file
+    */
+    void append(std::string path, const unsigned char* data, size_t length, bool complete);
+
+    /**
+    * Removes a file, an incomplete file is completed with the data it has
+    * @param path File path
+    * @return true if the file existed
+    */
+    bool remove(std::string path);
+
+    /**
+    * @param path File path
+    * @return shared file content, empty if it does not exist or it is not complete
+    */
+    StoredData get(std::string path);
+
+    /**
+    * @param path File path
+    * @return file, which can be read with readPart even if it is removed, empty if it does not exist
+    */
+    StoredFileRef open(std::string path);
+
+    /**
+    * @param file File returned by open
+    * @param index Part index
+    * @param part Part content, if it exists
+    * @param complete Set to true if the file is complete
+    * @return true if the part exists, false if it does not exist yet or the file is complete
+    */
+    bool readPart(StoredFileRef file, size_t index, StoredData& part, bool& complete);
+
+    /**
+    * @param file File returned by open
+    * @param complete Set to true if the file is complete
+    * @return file length in bytes at this moment
+    */
+    size_t getLength(StoredFileRef file, bool& complete);
+
+    /**
+    * Copies a byte range of a file, which can be incomplete
+    * @param file File returned by open
+    * @param offset First byte of the range
+    * @param length Range length in bytes
+    * @return range content, empty if the file does not have it yet
+    */
+    StoredData readRange(StoredFileRef file, size_t offset, size_t length);
+
+    /**
+    * Sets the function called after every append to an incomplete file
+    * @param listener Function, empty to remove it
+    */
+    void setListener(std::function<void()> listener);
+
+    /**
+    * @return number of stored files
+    */
+    size_t getFiles();
+
+    /**
+    * @return total size of the stored files in bytes
+    */
+    size_t getBytes();
+
+private:
+    void notify();
+
+    std::mutex mtx;
+    std::map<std::string, StoredFileRef> files;
+    size_t bytes;
+
+    std::mutex listenerMtx;
+    std::function<void()> listener;
+};
+
+#endif
@@ -27,7 +27,7 @@
 
 DashVideoSegmenter::DashVideoSegmenter(std::chrono::seconds segDur, std::string video_format_, std::chrono::microseconds offset) : 
 DashSegmenter(segDur, DASH_VIDEO_TIME_BASE, offset), 
-currentIntra(false), previousIntra(false), video_format(video_format_)
+currentIntra(false), previousIntra(false), video_format(video_format_), pendingFrameLength(0)
 {
 
 }
@@ -48,6 +48,12 @@ Frame* DashVideoSegmenter::manageFrame(Frame* frame)
         utils::errorMsg("Error managing frame: it MUST be a video frame");
         return NULL;
     }
+
+    //NOTE: the data of a frame which has not been appended to the segment would be taken by the next one
+    if (pendingFrameLength > 0) {
+        discard_pending_video_sample(pendingFrameLength, &dashContext);
+        pendingFrameLength = 0;
+    }
     
     vFrame = parseNal(nal);
 
@@ -59,21 +65,32 @@ Frame* DashVideoSegmenter::manageFrame(Frame* frame)
 
     if(!setup(vFrame->getWidth(), vFrame->getHeight())) {
         utils::errorMsg("Error during Dash Video Segmenter setup");
+        discard_pending_video_sample(vFrame->getLength(), &dashContext);
         return NULL;
     }
 
+    pendingFrameLength = vFrame->getLength();
     return vFrame;
 }
 
-bool DashVideoSegmenter::setup(unsigned int width, unsigned int height)
+bool DashVideoSegmenter::setupContext()
 {
-    uint8_t i2error = I2OK;
-
     if (!dashContext) {
-        i2error = generateContext();
+        if (generateContext() != I2OK) {
+            return false;
+        }
+
+        reserveSegmentData();
     }
 
-    if (i2error != I2OK || !dashContext) {
+    return dashContext != NULL;
+}
+
+bool DashVideoSegmenter::setup(unsigned int width, unsigned int height)
+{
+    uint8_t i2error = I2OK;
+
+    if (!setupContext()) {
         return false;
     }
 
@@ -100,7 +117,7 @@ bool DashVideoSegmenter::generateInitSegment(DashSegment* segment)
     data = reinterpret_cast<unsigned char*> (&extradata[0]);
     dataLength = extradata.size();
 
-    if (!data) {
+    if (!data || !segment->reserve(dataLength + INIT_SEGMENT_OVERHEAD)) {
         return false;
     }
 
@@ -133,7 +150,7 @@ bool DashVideoSegmenter::appendFrameToDashSegment(Frame* frame)
     
     VideoFrame* vFrame = dynamic_cast<VideoFrame*> (frame);
 
-    if (!vFrame || !vFrame->getDataBuf() || vFrame->getLength() <= 0 || !dashContext) {
+    if (!vFrame || vFrame->getLength() <= 0 || vFrame->getLength() != pendingFrameLength || !dashContext) {
         utils::errorMsg("Error appeding frame to segment: frame not valid");
         return false;
     }
@@ -141,9 +158,11 @@ bool DashVideoSegmenter::appendFrameToDashSegment(Frame* frame)
     timeBasePts = microsToTimeBase(vFrame->getPresentationTime());
     timeBaseDts = microsToTimeBase(vFrame->getDecodeTime());
 
+    //NOTE: frame data is already assembled in the context, only the sample is added
     //TODO: test it with bFrames
-    addSampleReturn = add_video_sample(vFrame->getDataBuf(), vFrame->getLength(), timeBasePts, 
-                                        timeBaseDts, sequenceNumber, isPreviousFrameIntra(), &dashContext);
+    addSampleReturn = add_pending_video_sample(vFrame->getLength(), timeBasePts, 
+                                                timeBaseDts, sequenceNumber, isPreviousFrameIntra(), &dashContext);
+    pendingFrameLength = 0;
 
     if (addSampleReturn != I2OK) {
         utils::errorMsg("Error adding video sample. Code error: " + std::to_string(addSampleReturn));
@@ -156,20 +175,21 @@ bool DashVideoSegmenter::appendFrameToDashSegment(Frame* frame)
 bool DashVideoSegmenter::appendNalToFrame(VideoFrame* frame, unsigned char* nalData, unsigned nalDataLength, 
                                            unsigned nalWidth, unsigned nalHeight, std::chrono::microseconds ts, std::chrono::microseconds dts)
 {
-    if (frame->getLength() + nalDataLength + AVCC_HEADER_BYTES_MINUS_ONE + 1 > frame->getMaxLength()) {
-        utils::errorMsg("[DashVideoSegmenter::appendNalToFrame] Nal exceeds frame max length");
+    uint32_t i2error;
+
+    if (!setupContext()) {
+        utils::errorMsg("[DashVideoSegmenter::appendNalToFrame] Error generating context");
         return false;
     }
 
-    frame->getDataBuf()[frame->getLength()] = (nalDataLength >> 24) & 0xFF;
-    frame->getDataBuf()[frame->getLength()+1] = (nalDataLength >> 16) & 0xFF;
-    frame->getDataBuf()[frame->getLength()+2] = (nalDataLength >> 8) & 0xFF;
-    frame->getDataBuf()[frame->getLength()+3] = nalDataLength & 0xFF;
-    frame->setLength(frame->getLength() + 4);
+    i2error = append_video_nal(nalData, nalDataLength, &dashContext);
 
-    memcpy(frame->getDataBuf() + frame->getLength(), nalData, nalDataLength);
-    frame->setLength(frame->getLength() + nalDataLength);
-    
+    if (i2error != I2OK) {
+        utils::errorMsg("[DashVideoSegmenter::appendNalToFrame] Error appending NAL. Code error: " + std::to_string(i2error));
+        return false;
+    }
+
+    frame->setLength(frame->getLength() + AVCC_NAL_LENGTH_SIZE + nalDataLength);
     frame->setSize(nalWidth, nalHeight);
     frame->setPresentationTime(ts);
     frame->setDecodeTime(dts);
@@ -34,7 +34,8 @@
 
 /*! Virtual class responsible for managing DASH video segments creation. It receives H264or5 NALs, joining them into complete frames
     and using these frames to create the segments. It also manages Init Segment creation, constructing MP4 metadata from
-    SPS and PPS (and VPS) NALUs*/
+    SPS and PPS (and VPS) NALUs. NALs are converted to AVCC right into the segment data of the context, so the frames
+    returned by manageFrame only describe them and must be appended before managing the next NAL*/
 
 class DashVideoSegmenter : public DashSegmenter {
 
@@ -43,8 +44,7 @@ public:
     * It manages an input NAL, doing different actions depending on its type. See children classes headers to check which 
     * types of NALUs are checked.
     * @param frame Pointer the source NAL, which must be contained in a VideoFrame structure
-    * @param newFrame Passed as reference, it indicates if there is a complete frame in the internal frame buffer
-    * @return false if error and true if the NAL has been managed correctly
+    * @return the complete frame, whose data is pending in the segmenter context, or NULL if there is not any
     */
     Frame* manageFrame(Frame* frame);
 
@@ -103,6 +103,7 @@ protected:
                            unsigned nalWidth, unsigned nalHeight, std::chrono::microseconds ts,
                            std::chrono::microseconds dts);
     int detectStartCode(unsigned char const* ptr);
+    bool setupContext();
     bool setup(unsigned int width, unsigned int height);
     unsigned customGenerateSegment(unsigned char *segBuffer, std::chrono::microseconds nextFrameTs, 
                                     uint64_t &segTimestamp, uint32_t &segDuration, bool force);
@@ -112,6 +113,9 @@ protected:
     bool currentIntra;
     bool previousIntra;
     const std::string video_format;
+
+private:
+    unsigned int pendingFrameLength;
 };
 
 #endif
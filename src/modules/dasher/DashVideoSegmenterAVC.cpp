@@ -27,8 +27,9 @@
 DashVideoSegmenterAVC::DashVideoSegmenterAVC(std::chrono::seconds segDur, std::chrono::microseconds offset) : 
 DashVideoSegmenter(segDur, VIDEO_CODEC_AVC, offset)
 {
-    vFrame = InterleavedVideoFrame::createNew(H264, LENGTH_H264_FRAME);
-    tmpFrame = InterleavedVideoFrame::createNew(H264, LENGTH_H264_FRAME);
+    //NOTE: frames only keep the properties and length of the NALs, which are assembled in the context
+    vFrame = InterleavedVideoFrame::createNew(H264, 0);
+    tmpFrame = InterleavedVideoFrame::createNew(H264, 0);
 }
 
 DashVideoSegmenterAVC::~DashVideoSegmenterAVC()
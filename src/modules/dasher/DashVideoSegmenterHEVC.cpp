@@ -27,8 +27,9 @@
 DashVideoSegmenterHEVC::DashVideoSegmenterHEVC(std::chrono::seconds segDur, std::chrono::microseconds offset) : 
 DashVideoSegmenter(segDur, VIDEO_CODEC_HEVC, offset)
 {
-    vFrame = InterleavedVideoFrame::createNew(H265, LENGTH_H264_FRAME);
-    tmpFrame = InterleavedVideoFrame::createNew(H265, LENGTH_H264_FRAME);
+    //NOTE: frames only keep the properties and length of the NALs, which are assembled in the context
+    vFrame = InterleavedVideoFrame::createNew(H265, 0);
+    tmpFrame = InterleavedVideoFrame::createNew(H265, 0);
 
 }
 
@@ -27,18 +27,26 @@
 #include "DashVideoSegmenterAVC.hh"
 #include "DashVideoSegmenterHEVC.hh"
 #include "DashAudioSegmenter.hh"
+#include "DashHttpServer.hh"
+#include "DashFileWriter.hh"
+#include "HlsManager.hh"
+#include "../../JobsPool.hh"
 
 #include <map>
 #include <string>
 #include <chrono>
 #include <fstream>
+#include <algorithm>
+#include <functional>
+#include <string.h>
 #include <unistd.h>
 #include <math.h>
 
 Dasher::Dasher(unsigned readersNum) :
-TailFilter(readersNum), mpdMngr(NULL), hasVideo(false), videoStarted(false), timestampOffset(std::chrono::microseconds(0))
+TailFilter(readersNum), mpdMngr(NULL), hlsMngr(NULL), store(NULL), httpServer(NULL), writer(NULL), chunkFrames(0), byteRange(false), parallel(true), writtenSegments(0), hasVideo(false), videoStarted(false), timestampOffset(std::chrono::microseconds(0))
 {
     fType = DASHER;
+    writer = new DashFileWriter();
     initializeEventMap();
 }
 
@@ -48,16 +56,22 @@ Dasher::~Dasher()
         delete seg.second;
     }
     delete mpdMngr;
+    delete hlsMngr;
+    delete writer;
+    delete httpServer;
+    delete store;
 }
 
-bool Dasher::configure(std::string dashFolder, std::string baseName_, unsigned int segDurInSec, unsigned int maxSeg, unsigned int minBuffTime)
+bool Dasher::configure(std::string dashFolder, std::string baseName_, unsigned int segDurInSec, unsigned int maxSeg, 
+                       unsigned int minBuffTime, unsigned int httpPort, unsigned int chunkFrames_, bool hls, bool byteRange_)
 {
-    if (access(dashFolder.c_str(), W_OK) != 0) {
+    //NOTE: in origin mode nothing is written to the folder
+    if (httpPort == 0 && access(dashFolder.c_str(), W_OK) != 0) {
         utils::errorMsg("Error configuring Dasher: provided folder is not writable");
         return false;
     }
 
-    if (dashFolder.back() != '/') {
+    if (!dashFolder.empty() && dashFolder.back() != '/') {
         dashFolder.append("/");
     }
 
@@ -66,11 +80,61 @@ bool Dasher::configure(std::string dashFolder, std::string baseName_, unsigned i
         return false;
     }
 
+    //NOTE: chunks and HLS playlists reference whole segment files
+    if (byteRange_ && (chunkFrames_ > 0 || hls)) {
+        utils::errorMsg("Error configuring Dasher: byte-range mode is not compatible with chunked segments nor HLS");
+        return false;
+    }
+
+    if (httpPort > 0 && (!httpServer || httpServer->getPort() != httpPort)) {
+        if (!store) {
+            store = new DashSegmentStore();
+        }
+
+        if (!httpServer) {
+            httpServer = new DashHttpServer(store);
+        }
+
+        if (!httpServer->start(httpPort)) {
+            utils::errorMsg("Error configuring Dasher: HTTP server cannot be started");
+            delete httpServer;
+            httpServer = NULL;
+            delete store;
+            store = NULL;
+            return false;
+        }
+    }
+
+    if (httpPort == 0 && httpServer) {
+        delete httpServer;
+        httpServer = NULL;
+        delete store;
+        store = NULL;
+    }
+
     basePath = dashFolder;
     baseName = baseName_;
     mpdPath = basePath + baseName + ".mpd";
-    vSegTempl = baseName + "_$RepresentationID$_$Time$.m4v";
-    aSegTempl = baseName + "_$RepresentationID$_$Time$.m4a";
+    writtenMpd.clear();
+
+    if (byteRange != byteRange_) {
+        for (auto seg : segmenters) {
+            removeRingFiles(seg.first);
+        }
+
+        ringFiles.clear();
+
+        if (mpdMngr) {
+            mpdMngr->flushAdaptationSetTimestamps(V_ADAPT_SET_ID);
+            mpdMngr->flushAdaptationSetTimestamps(A_ADAPT_SET_ID);
+        }
+    }
+
+    byteRange = byteRange_;
+
+    //NOTE: without segment template the MPD lists the byte ranges of each representation
+    vSegTempl = byteRange ? "" : baseName + "_$RepresentationID$_$Time$.m4v";
+    aSegTempl = byteRange ? "" : baseName + "_$RepresentationID$_$Time$.m4a";
     vInitSegTempl = baseName + "_$RepresentationID$_init.m4v";
     aInitSegTempl = baseName + "_$RepresentationID$_init.m4a";
 
@@ -80,6 +144,31 @@ bool Dasher::configure(std::string dashFolder, std::string baseName_, unsigned i
     
     mpdMngr->configure(minBuffTime, maxSeg, segDurInSec);
     segDur = std::chrono::seconds(segDurInSec);
+    chunkFrames = chunkFrames_;
+
+    for (auto seg : segmenters) {
+        seg.second->setChunkFrames(chunkFrames);
+    }
+
+    if (hls && !hlsMngr) {
+        hlsMngr = new HlsManager();
+
+        for (auto seg : segmenters) {
+            updateRepresentation(seg.first, seg.second);
+        }
+    }
+
+    if (!hls && hlsMngr) {
+        delete hlsMngr;
+        hlsMngr = NULL;
+    }
+
+    //NOTE: chunked segments enter the MPD (and leave the window) before being complete, so HLS lists one less
+    if (hlsMngr) {
+        hlsMngr->configure(baseName, mpdMngr->getMaxSeg() - (chunkFrames > 0 ? 1 : 0), segDurInSec);
+    }
+
+    writtenPlaylists.clear();
 
     return true;
 }
@@ -87,7 +176,9 @@ bool Dasher::configure(std::string dashFolder, std::string baseName_, unsigned i
 bool Dasher::doProcessFrame(std::map<int, Frame*> &orgFrames, std::vector<int> newFrames, int& ret)
 {
     DashSegmenter* segmenter;
-    Frame* frame;
+    SegmenterOutput output;
+    std::map<int, SegmenterOutput> outputs;
+    std::vector<std::function<void()>> jobs;
 
     if (!mpdMngr) {
         utils::errorMsg("Dasher MUST be configured in order to process frames");
@@ -108,24 +199,36 @@ bool Dasher::doProcessFrame(std::map<int, Frame*> &orgFrames, std::vector<int> n
             }
         }
 
-        frame = segmenter->manageFrame(orgFrames[id]);
+        //NOTE: each job only touches its own segmenter and segments, files and manifests are updated after the join
+        Frame* frame = orgFrames[id];
+        SegmenterOutput* out = &outputs[id];
+        jobs.push_back([this, id, frame, segmenter, out]{*out = processFrame(id, frame, segmenter);});
+    }
 
-        if (!frame) {
-            continue;
+    //NOTE: a single job is run in this thread, there is nothing to run concurrently
+    if (parallel && jobs.size() > 1) {
+        JobsPool::getInstance()->run(jobs);
+    } else {
+        for (auto& job : jobs) {
+            job();
         }
+    }
 
-        if (!generateInitSegment(id, segmenter)) {
-            utils::errorMsg("[Dasher::doProcessFrame] Error generating init segment");
-            continue;
+    for (auto& out : outputs) {
+        output = out.second;
+        segmenter = getSegmenter(out.first);
+
+        if (output.initSegment && !writeInitSegment(out.first)) {
+            utils::errorMsg("[Dasher::doProcessFrame] Error writing init segment");
         }
 
-        if (generateSegment(id, frame, segmenter)) {
+        if (output.segment) {
+            updateRepresentation(out.first, segmenter);
             utils::debugMsg("[Dasher::doProcessFrame] New segment generated");
         }
 
-        if (!appendFrameToSegment(id, frame, segmenter)) {
-            utils::errorMsg("[Dasher::doProcessFrame] Error appnding frame to segment");
-            continue;
+        if (output.chunk && publishChunk(out.first, segmenter)) {
+            utils::debugMsg("[Dasher::doProcessFrame] New chunk published");
         }
     }
 
@@ -142,104 +245,122 @@ bool Dasher::doProcessFrame(std::map<int, Frame*> &orgFrames, std::vector<int> n
     return true;
 }
 
-bool Dasher::appendFrameToSegment(unsigned int id, Frame* frame, DashSegmenter* segmenter)
+Dasher::SegmenterOutput Dasher::processFrame(unsigned int id, Frame* org, DashSegmenter* segmenter)
 {
-    DashVideoSegmenter* vSeg;
-    DashAudioSegmenter* aSeg;
+    SegmenterOutput output = {false, false, false};
+    Frame* frame;
 
-    if ((vSeg = dynamic_cast<DashVideoSegmenter*>(segmenter)) != NULL) {
+    frame = segmenter->manageFrame(org);
 
-        if (!vSeg->appendFrameToDashSegment(frame)) {
-            utils::errorMsg("Error appending video frame to segment");
-            return false;
-        }
+    if (!frame) {
+        return output;
+    }
 
-    }   
+    output.initSegment = segmenter->generateInitSegment(initSegments.at(id));
+    output.segment = generateSegment(id, frame, segmenter);
 
-    if ((aSeg = dynamic_cast<DashAudioSegmenter*>(segmenter)) != NULL) {
-
-        if (!aSeg->appendFrameToDashSegment(frame)) {
-            utils::errorMsg("Error appending audio frame to segment");
-            return false;
-        }
+    if (!segmenter->appendFrameToDashSegment(frame)) {
+        utils::errorMsg("[Dasher::processFrame] Error appending frame to segment");
+        return output;
     }
 
-    if (!vSeg && !aSeg) {
+    output.chunk = generateChunk(id, segmenter);
+    return output;
+}
+
+bool Dasher::writeInitSegment(unsigned int id)
+{
+    std::string ext = vSegments.count(id) > 0 ? V_EXT : A_EXT;
+
+    if (!writeFile(initSegments[id], getInitSegmentName("", baseName, id, ext))) {
+        utils::errorMsg("Error writing DASH segment to disk: invalid path");
         return false;
     }
 
     return true;
 }
 
-bool Dasher::generateInitSegment(unsigned int id, DashSegmenter* segmenter)
+bool Dasher::generateSegment(unsigned int id, Frame* frame, DashSegmenter* segmenter)
 {
-    DashVideoSegmenter* vSeg;
-    DashAudioSegmenter* aSeg;
+    if (vSegments.count(id) > 0) {
+        return segmenter->generateSegment(vSegments.at(id), frame);
+    }
 
-    if ((vSeg = dynamic_cast<DashVideoSegmenter*>(segmenter)) != NULL) {
+    //NOTE: with video, audio segments are forced when the video ones are complete
+    if (!hasVideo && aSegments.count(id) > 0) {
+        return segmenter->generateSegment(aSegments.at(id), frame);
+    }
 
-        if (!vSeg->generateInitSegment(initSegments[id])) {
-            return true;
-        }
+    return false;
+}
 
-        if(!initSegments[id]->writeToDisk(getInitSegmentName(basePath, baseName, id, V_EXT))) {
-            utils::errorMsg("Error writing DASH segment to disk: invalid path");
-            return false;
-        }
+bool Dasher::generateChunk(unsigned int id, DashSegmenter* segmenter)
+{
+    if (vSegments.count(id) > 0) {
+        return segmenter->generateChunk(vSegments.at(id));
     }
 
-    if ((aSeg = dynamic_cast<DashAudioSegmenter*>(segmenter)) != NULL) {
+    if (aSegments.count(id) > 0) {
+        return segmenter->generateChunk(aSegments.at(id));
+    }
 
-        if (!aSeg->generateInitSegment(initSegments[id])) {
-            return true;
-        }
+    return false;
+}
 
-        if(!initSegments[id]->writeToDisk(getInitSegmentName(basePath, baseName, id, A_EXT))) {
-            utils::errorMsg("Error writing DASH segment to disk: invalid path");
-            return false;
-        }
-    }
+bool Dasher::publishChunk(unsigned int id, DashSegmenter* segmenter)
+{
+    updateRepresentation(id, segmenter);
 
-    if (!vSeg && !aSeg) {
-        return false;
+    if (vSegments.count(id) > 0) {
+        return publishChunks(vSegments, V_ADAPT_SET_ID, V_EXT);
     }
 
-    return true;
+    return publishChunks(aSegments, A_ADAPT_SET_ID, A_EXT);
 }
 
-bool Dasher::generateSegment(unsigned int id, Frame* frame, DashSegmenter* segmenter)
+void Dasher::updateRepresentation(unsigned int id, DashSegmenter* segmenter)
 {
     DashVideoSegmenter* vSeg;
     DashAudioSegmenter* aSeg;
+    std::string adSetId;
+    unsigned int chunkDuration = 0;
 
     if ((vSeg = dynamic_cast<DashVideoSegmenter*>(segmenter)) != NULL) {
-
-        if (!vSeg->generateSegment(vSegments[id], frame)) {
-            return false;
-        }
-
-        mpdMngr->updateVideoAdaptationSet(V_ADAPT_SET_ID, segmenters[id]->getTimeBase(), vSegTempl, vInitSegTempl);
+        mpdMngr->updateVideoAdaptationSet(V_ADAPT_SET_ID, segmenter->getTimeBase(), vSegTempl, vInitSegTempl);
         mpdMngr->updateVideoRepresentation(V_ADAPT_SET_ID, std::to_string(id), vSeg->getVideoFormat(), vSeg->getWidth(),
                                             vSeg->getHeight(), vSeg->getBitrate(), vSeg->getFramerate());
+        adSetId = V_ADAPT_SET_ID;
 
-    }
-
-    if (!hasVideo && (aSeg = dynamic_cast<DashAudioSegmenter*>(segmenter)) != NULL) {
-        
-        if (!aSeg->generateSegment(aSegments[id], frame)) {
-            return false;
+        if (hlsMngr) {
+            hlsMngr->updateGroup(V_ADAPT_SET_ID, true, segmenter->getTimeBase(), vSegTempl, vInitSegTempl);
+            hlsMngr->updateRepresentation(V_ADAPT_SET_ID, std::to_string(id), vSeg->getVideoFormat(), vSeg->getWidth(),
+                                            vSeg->getHeight(), vSeg->getBitrate());
         }
+    }
 
-        mpdMngr->updateAudioAdaptationSet(A_ADAPT_SET_ID, segmenters[id]->getTimeBase(), aSegTempl, aInitSegTempl);
+    if ((aSeg = dynamic_cast<DashAudioSegmenter*>(segmenter)) != NULL) {
+        mpdMngr->updateAudioAdaptationSet(A_ADAPT_SET_ID, segmenter->getTimeBase(), aSegTempl, aInitSegTempl);
         mpdMngr->updateAudioRepresentation(A_ADAPT_SET_ID, std::to_string(id), AUDIO_CODEC, 
                                             aSeg->getSampleRate(), aSeg->getBitrate(), aSeg->getChannels());
+        adSetId = A_ADAPT_SET_ID;
+
+        if (hlsMngr) {
+            hlsMngr->updateGroup(A_ADAPT_SET_ID, false, segmenter->getTimeBase(), aSegTempl, aInitSegTempl);
+            hlsMngr->updateRepresentation(A_ADAPT_SET_ID, std::to_string(id), AUDIO_CODEC, 0, 0, aSeg->getBitrate());
+        }
     }
 
-    if (!vSeg && !aSeg) {
-        return false;
+    if (chunkFrames > 0) {
+        chunkDuration = segmenter->getChunkDuration();
     }
 
-    return true;
+    //NOTE: chunked segments can be requested once their first chunk is published
+    if (chunkDuration > 0 && chunkDuration < segmenter->getSegDurInTimeBaseUnits()) {
+        mpdMngr->setAdaptationSetAvailabilityTimeOffset(adSetId, 
+            (double) (segmenter->getSegDurInTimeBaseUnits() - chunkDuration)/segmenter->getTimeBase());
+    } else if (chunkFrames == 0) {
+        mpdMngr->setAdaptationSetAvailabilityTimeOffset(adSetId, 0);
+    }
 }
 
 bool Dasher::writeVideoSegments()
@@ -279,14 +400,19 @@ bool Dasher::writeVideoSegments()
         sendSetReferenceEvent(lastTs + std::chrono::microseconds(segDur).count());
     }
     
-    if (!writeSegmentsToDisk(vSegments, ts, V_EXT)) {
+    if (!writeSegmentsToDisk(vSegments, ts, V_ADAPT_SET_ID, V_EXT)) {
         utils::errorMsg("Error writing DASH video segment to disk");
         return false;
     }
 
     rmTimestamp = mpdMngr->updateAdaptationSetTimestamp(V_ADAPT_SET_ID, ts, dur);
 
-    mpdMngr->writeToDisk(mpdPath.c_str());
+    if (hlsMngr) {
+        hlsMngr->updateGroupTimestamp(V_ADAPT_SET_ID, ts, dur);
+    }
+
+    writeMpd();
+    writePlaylists();
 
     if (rmTimestamp > 0 && !cleanSegments(vSegments, rmTimestamp, V_EXT)) {
         utils::warningMsg("Error cleaning dash video segments");
@@ -332,14 +458,19 @@ bool Dasher::writeAudioSegments()
         }
     }
 
-    if (!writeSegmentsToDisk(aSegments, ts, A_EXT)) {
+    if (!writeSegmentsToDisk(aSegments, ts, A_ADAPT_SET_ID, A_EXT)) {
         utils::errorMsg("Error writing DASH video segment to disk");
         return false;
     }
 
     rmTimestamp = mpdMngr->updateAdaptationSetTimestamp(A_ADAPT_SET_ID, ts, dur);
 
-    mpdMngr->writeToDisk(mpdPath.c_str());
+    if (hlsMngr) {
+        hlsMngr->updateGroupTimestamp(A_ADAPT_SET_ID, ts, dur);
+    }
+
+    writeMpd();
+    writePlaylists();
 
     if (rmTimestamp > 0 && !cleanSegments(aSegments, rmTimestamp, A_EXT)) {
         utils::warningMsg("Error cleaning dash video segments");
@@ -371,39 +502,245 @@ bool Dasher::forceAudioSegmentsGeneration()
             return false;
         }
 
-        mpdMngr->updateAudioAdaptationSet(A_ADAPT_SET_ID, segmenters[seg.first]->getTimeBase(), aSegTempl, aInitSegTempl);
-        mpdMngr->updateAudioRepresentation(A_ADAPT_SET_ID, std::to_string(seg.first), AUDIO_CODEC, 
-                                            aSeg->getSampleRate(), aSeg->getBitrate(), aSeg->getChannels());
+        updateRepresentation(seg.first, segmenter);
     }
 
     return true;
 }
 
-bool Dasher::writeSegmentsToDisk(std::map<int,DashSegment*> segments, uint64_t timestamp, std::string segExt)
+bool Dasher::writeSegmentsToDisk(std::map<int,DashSegment*> segments, uint64_t timestamp, std::string adSetId, std::string segExt)
 {
     for (auto seg : segments) {
 
-        if(!seg.second->writeToDisk(getSegmentName(basePath, baseName, seg.first, timestamp, segExt))) {
+        if (byteRange && !appendToRingFile(seg.first, seg.second, adSetId, segExt)) {
+            utils::errorMsg("Error appending DASH segment to its ring file");
+            return false;
+        }
+
+        if(!byteRange && !writeFile(seg.second, getSegmentName("", baseName, seg.first, timestamp, segExt))) {
             utils::errorMsg("Error writing DASH segment to disk: invalid path");
             return false;
         }
 
         seg.second->clear();
         seg.second->incrSeqNumber();
+        writtenSegments++;
+    }
+
+    return true;
+}
+
+bool Dasher::appendToRingFile(int id, DashSegment* segment, std::string adSetId, std::string segExt)
+{
+    RingFile& ring = ringFiles[id];
+    std::string name;
+    size_t indexOffset;
+    size_t indexLength;
+
+    if (!segment->getIndexRange(indexOffset, indexLength)) {
+        utils::errorMsg("Error appending DASH segment: it has no segment index");
+        return false;
+    }
+
+    //NOTE: a file is overwritten once the segments of the next ones fill the MPD window
+    if (ring.segments >= mpdMngr->getMaxSeg()) {
+        ring.index = (ring.index + 1) % BYTE_RANGE_RING_FILES;
+        ring.segments = 0;
+        ring.length = 0;
+    }
+
+    ring.files = std::max(ring.files, ring.index + 1);
+    name = getRingFileName("", baseName, id, ring.index, segExt);
+
+    if (store && ring.length == 0) {
+        store->remove("/" + name);
+    }
+
+    if (store) {
+        store->append("/" + name, segment->getDataBuffer(), segment->getDataLength(), false);
+    } else if (ring.length == 0) {
+        writer->write(basePath + name, segment->getDataBuffer(), segment->getDataLength());
+    } else {
+        writer->append(basePath + name, segment->getDataBuffer(), segment->getDataLength());
+    }
+
+    mpdMngr->updateRepresentationSegment(adSetId, std::to_string(id), ByteRangeSegment{segment->getTimestamp(), 
+        segment->getDuration(), name, ring.length, segment->getDataLength(), ring.length + indexOffset, indexLength});
+
+    ring.length += segment->getDataLength();
+    ring.segments++;
+    return true;
+}
+
+void Dasher::removeRingFiles(int id)
+{
+    std::string ext = vSegments.count(id) > 0 ? V_EXT : A_EXT;
+
+    if (ringFiles.count(id) <= 0) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < ringFiles[id].files; i++) {
+        removeFile(getRingFileName("", baseName, id, i, ext));
+    }
+}
+
+bool Dasher::writeFile(DashSegment* segment, std::string name)
+{
+    //NOTE: chunked segments are completed with the data not published yet
+    if (segment->isChunked()) {
+        return publishFile(segment, name, true);
+    }
+
+    if (store) {
+        store->put("/" + name, segment->getDataBuffer(), segment->getDataLength());
+        return true;
+    }
+
+    writer->write(basePath + name, segment->getDataBuffer(), segment->getDataLength());
+    return true;
+}
+
+bool Dasher::publishFile(DashSegment* segment, std::string name, bool complete)
+{
+    unsigned int published = segment->getPublishedLength();
+    unsigned int length = segment->getDataLength() - published;
+    const unsigned char* data = segment->getDataBuffer() + published;
+
+    if (store) {
+        store->append("/" + name, data, length, complete);
+    } else if (published == 0) {
+        writer->write(basePath + name, data, length);
+    } else if (length > 0) {
+        writer->append(basePath + name, data, length);
+    }
+
+    segment->setPublishedLength(segment->getDataLength());
+    return true;
+}
+
+bool Dasher::publishChunks(std::map<int,DashSegment*> segments, std::string adSetId, std::string segExt)
+{
+    DashSegment* first = segments.begin()->second;
+    DashSegmenter* segmenter = getSegmenter(segments.begin()->first);
+    uint64_t rmTimestamp = 0;
+    bool announce = false;
+    bool success = true;
+    uint64_t ts;
+
+    //NOTE: segments are named after the first representation, nothing is published before its first chunk
+    if (!segmenter || first->getDataLength() == 0) {
+        return false;
+    }
+
+    ts = first->getTimestamp();
+
+    if (!first->isChunked()) {
+        announce = true;
+
+        for (auto seg : segments) {
+            seg.second->setChunked(true);
+
+            if (store) {
+                store->append("/" + getSegmentName("", baseName, seg.first, ts, segExt), NULL, 0, false);
+            }
+        }
+
+        //NOTE: the segment is announced with its nominal duration, updated once it is complete
+        rmTimestamp = mpdMngr->updateAdaptationSetTimestamp(adSetId, ts, segmenter->getSegDurInTimeBaseUnits());
+    }
+
+    for (auto seg : segments) {
+        if (seg.second->getDataLength() > seg.second->getPublishedLength() && 
+            !publishFile(seg.second, getSegmentName("", baseName, seg.first, ts, segExt), false)) {
+            success = false;
+        }
+    }
+
+    if (!announce) {
+        return success;
+    }
+
+    writeMpd();
+
+    if (rmTimestamp > 0 && !cleanSegments(segments, rmTimestamp, segExt)) {
+        utils::warningMsg("Error cleaning dash segments");
+    }
+
+    return success;
+}
+
+bool Dasher::removeFile(std::string name)
+{
+    if (store) {
+        return store->remove("/" + name);
     }
 
+    //NOTE: removal errors are reported by the writer
+    writer->remove(basePath + name);
     return true;
 }
 
+void Dasher::writeMpd()
+{
+    std::string mpd = mpdMngr->toString();
+
+    if (mpd == writtenMpd) {
+        return;
+    }
+
+    writtenMpd = mpd;
+    writeManifest(baseName + ".mpd", mpd);
+}
+
+void Dasher::writePlaylists()
+{
+    if (!hlsMngr) {
+        return;
+    }
+
+    writePlaylist(hlsMngr->getMasterPlaylistName(), hlsMngr->getMasterPlaylist());
+
+    for (auto id : hlsMngr->getRepresentations()) {
+        writePlaylist(hlsMngr->getMediaPlaylistName(id), hlsMngr->getMediaPlaylist(id));
+    }
+}
+
+void Dasher::writePlaylist(std::string name, const std::string& playlist)
+{
+    if (writtenPlaylists.count(name) > 0 && writtenPlaylists[name] == playlist) {
+        return;
+    }
+
+    writtenPlaylists[name] = playlist;
+    writeManifest(name, playlist);
+}
+
+void Dasher::writeManifest(std::string name, const std::string& content)
+{
+    if (store) {
+        store->put("/" + name, (const unsigned char*) content.data(), content.size());
+        return;
+    }
+
+    //NOTE: queued after the segments it references, so they are already on disk when it is renamed
+    writer->write(basePath + name, (const unsigned char*) content.data(), content.size());
+}
+
 bool Dasher::cleanSegments(std::map<int,DashSegment*> segments, uint64_t timestamp, std::string segExt)
 {
     bool success = true;
     std::string segmentName;
 
+    //NOTE: ring files are overwritten, not removed
+    if (byteRange) {
+        return true;
+    }
+
     for (auto seg : segments) {
-        segmentName = getSegmentName(basePath, baseName, seg.first, timestamp, segExt);
+        segmentName = getSegmentName("", baseName, seg.first, timestamp, segExt);
 
-        if (std::remove(segmentName.c_str()) != 0) {
+        if (!removeFile(segmentName)) {
             success &= false;
             utils::warningMsg("Error cleaning dash segment: " + segmentName);
         }
@@ -425,8 +762,36 @@ void Dasher::doGetState(Jzon::Object &filterNode)
 
     filterNode.Add("folder", basePath);
     filterNode.Add("baseName", baseName);
-    filterNode.Add("mpdURI", mpdPath);
+    filterNode.Add("mpdURI", store ? "/" + baseName + ".mpd" : mpdPath);
     filterNode.Add("segDurInSec", (int) segDur.count());
+    filterNode.Add("httpPort", httpServer ? (int) httpServer->getPort() : 0);
+    filterNode.Add("chunkFrames", (int) chunkFrames);
+    filterNode.Add("hls", hlsMngr != NULL);
+    filterNode.Add("byteRange", byteRange);
+
+    if (hlsMngr) {
+        filterNode.Add("hlsURI", store ? "/" + hlsMngr->getMasterPlaylistName() : basePath + hlsMngr->getMasterPlaylistName());
+    }
+
+    if (httpServer) {
+        filterNode.Add("storedFiles", (int) store->getFiles());
+        filterNode.Add("storedBytes", std::to_string(store->getBytes()));
+        filterNode.Add("httpConnections", (int) httpServer->getConnections());
+        filterNode.Add("httpRequests", std::to_string(httpServer->getRequests()));
+        filterNode.Add("httpSentBytes", std::to_string(httpServer->getSentBytes()));
+    }
+
+    filterNode.Add("ioPendingBytes", std::to_string(writer->getPendingBytes()));
+    filterNode.Add("ioWrites", std::to_string(writer->getWrites()));
+    filterNode.Add("ioWrittenBytes", std::to_string(writer->getWrittenBytes()));
+    filterNode.Add("ioRemoves", std::to_string(writer->getRemoves()));
+    filterNode.Add("ioErrors", std::to_string(writer->getErrors()));
+    filterNode.Add("ioStalls", std::to_string(writer->getStalls()));
+    filterNode.Add("ioAvgLatencyMs", writer->getAvgLatency());
+    filterNode.Add("ioMaxLatencyMs", writer->getMaxLatency());
+    filterNode.Add("segmenterMemory", std::to_string(getSegmenterMemory()));
+    filterNode.Add("writtenSegments", std::to_string(writtenSegments));
+
     if (mpdMngr){
         filterNode.Add("maxSegments", (int) mpdMngr->getMaxSeg());
         filterNode.Add("minBufferTime", (int) mpdMngr->getMinBuffTime());
@@ -439,6 +804,29 @@ void Dasher::doGetState(Jzon::Object &filterNode)
     filterNode.Add("readers", readersList);
 }
 
+size_t Dasher::getSegmenterMemory()
+{
+    size_t bytes = 0;
+
+    for (auto seg : segmenters) {
+        bytes += seg.second->getContextMemory();
+    }
+
+    for (auto seg : vSegments) {
+        bytes += seg.second->getCapacity();
+    }
+
+    for (auto seg : aSegments) {
+        bytes += seg.second->getCapacity();
+    }
+
+    for (auto seg : initSegments) {
+        bytes += seg.second->getCapacity();
+    }
+
+    return bytes;
+}
+
 bool Dasher::configureEvent(Jzon::Node* params)
 {
     std::string dashFolder = basePath;
@@ -446,6 +834,10 @@ bool Dasher::configureEvent(Jzon::Node* params)
     unsigned int segDurInSec = segDur.count();
     unsigned int maxSeg = 0;
     unsigned int minBuffTime = 0;
+    unsigned int httpPort = httpServer ? httpServer->getPort() : 0;
+    unsigned int chunkFr = chunkFrames;
+    bool hls = hlsMngr != NULL;
+    bool byteRng = byteRange;
 
     if (!params) {
         return false;
@@ -475,7 +867,23 @@ bool Dasher::configureEvent(Jzon::Node* params)
         minBuffTime = mpdMngr->getMinBuffTime();
     }
 
-    return configure(dashFolder, bName, segDurInSec, maxSeg, minBuffTime);
+    if (params->Has("httpPort") && params->Get("httpPort").IsNumber()) {
+        httpPort = params->Get("httpPort").ToInt();
+    }
+
+    if (params->Has("chunkFrames") && params->Get("chunkFrames").IsNumber()) {
+        chunkFr = params->Get("chunkFrames").ToInt();
+    }
+
+    if (params->Has("hls") && params->Get("hls").IsBool()) {
+        hls = params->Get("hls").ToBool();
+    }
+
+    if (params->Has("byteRange") && params->Get("byteRange").IsBool()) {
+        byteRng = params->Get("byteRange").ToBool();
+    }
+
+    return configure(dashFolder, bName, segDurInSec, maxSeg, minBuffTime, httpPort, chunkFr, hls, byteRng);
 }
 
 bool Dasher::setBitrateEvent(Jzon::Node* params)
@@ -530,6 +938,7 @@ bool Dasher::specificReaderConfig(int readerId, FrameQueue* queue)
         vSegments[readerId] = new DashSegment();
         initSegments[readerId] = new DashSegment();
         hasVideo = true;
+        segmenters[readerId]->setChunkFrames(chunkFrames);
     }
 
     if ((aQueue = dynamic_cast<AudioFrameQueue*>(queue)) != NULL) {
@@ -542,6 +951,7 @@ bool Dasher::specificReaderConfig(int readerId, FrameQueue* queue)
         segmenters[readerId] = new DashAudioSegmenter(segDur, timestampOffset);
         aSegments[readerId] = new DashSegment();
         initSegments[readerId] = new DashSegment();
+        segmenters[readerId]->setChunkFrames(chunkFrames);
     }
 
     return true;
@@ -554,6 +964,9 @@ bool Dasher::specificReaderDelete(int readerId)
         return false;
     }
 
+    removeRingFiles(readerId);
+    ringFiles.erase(readerId);
+
     if (vSegments.count(readerId) > 0) {
         delete vSegments[readerId];
         vSegments.erase(readerId);
@@ -566,6 +979,12 @@ bool Dasher::specificReaderDelete(int readerId)
         mpdMngr->removeRepresentation(A_ADAPT_SET_ID, std::to_string(readerId));
     }
 
+    if (hlsMngr && (hlsMngr->removeRepresentation(V_ADAPT_SET_ID, std::to_string(readerId)) ||
+                    hlsMngr->removeRepresentation(A_ADAPT_SET_ID, std::to_string(readerId)))) {
+        writtenPlaylists.erase(hlsMngr->getMediaPlaylistName(std::to_string(readerId)));
+        removeFile(hlsMngr->getMediaPlaylistName(std::to_string(readerId)));
+    }
+
     if (initSegments.count(readerId) > 0) {
         delete initSegments[readerId];
         initSegments.erase(readerId);
@@ -579,7 +998,8 @@ bool Dasher::specificReaderDelete(int readerId)
         videoStarted = false;
     }
 
-    mpdMngr->writeToDisk(mpdPath.c_str());
+    writeMpd();
+    writePlaylists();
     return true;
 }
 
@@ -599,6 +1019,14 @@ std::string Dasher::getInitSegmentName(std::string basePath, std::string baseNam
     return fullName;
 }
 
+std::string Dasher::getRingFileName(std::string basePath, std::string baseName, unsigned int reprId, unsigned int index, std::string ext)
+{
+    std::string fullName;
+    fullName = basePath + baseName + "_" + std::to_string(reprId) + "_r" + std::to_string(index) + ext;
+
+    return fullName;
+}
+
 DashSegmenter* Dasher::getSegmenter(unsigned int id)
 {
     if (segmenters.count(id) <= 0) {
@@ -629,21 +1057,44 @@ bool Dasher::setDashSegmenterBitrate(int id, unsigned int bps)
 
 DashSegmenter::DashSegmenter(std::chrono::seconds segmentDuration, unsigned int tBase, std::chrono::microseconds offset) :
 segDur(segmentDuration), dashContext(NULL), timeBase(tBase), frameDuration(0), currentTimestamp(0),
-sequenceNumber(0), bitrateInBitsPerSec(0), tsOffset(offset)
+sequenceNumber(0), bitrateInBitsPerSec(0), chunkFrames(0), chunkDuration(0), tsOffset(offset)
 {
     segDurInTimeBaseUnits = segDur.count()*timeBase;
 }
 
 DashSegmenter::~DashSegmenter()
 {
-    if(dashContext){
-        free(dashContext);
+    free_context(&dashContext);
+}
+
+void DashSegmenter::setBitrate(size_t bps)
+{
+    bitrateInBitsPerSec = bps;
+    reserveSegmentData();
+}
+
+unsigned int DashSegmenter::getContextMemory()
+{
+    return get_context_memory(dashContext);
+}
+
+void DashSegmenter::reserveSegmentData()
+{
+    uint64_t expected;
+
+    if (!dashContext || bitrateInBitsPerSec == 0) {
+        return;
     }
+
+    //NOTE: 25% over the nominal size, bigger segments grow the buffer anyway
+    expected = (uint64_t) bitrateInBitsPerSec/BYTE_TO_BIT*segDur.count()*5/4;
+    reserve_segment_data(&dashContext, std::min(expected, (uint64_t) MAX_DAT));
 }
 
 bool DashSegmenter::generateSegment(DashSegment* segment, Frame* frame, bool force)
 {
     unsigned int segmentSize = 0;
+    unsigned int offset = 0;
     uint64_t segTimestamp;
     uint32_t segDuration;
     std::chrono::microseconds frameTs = std::chrono::microseconds(0);
@@ -656,7 +1107,17 @@ bool DashSegmenter::generateSegment(DashSegment* segment, Frame* frame, bool for
         frameTs = frame->getPresentationTime();
     }
 
-    segmentSize = customGenerateSegment(segment->getDataBuffer(), frameTs, segTimestamp, segDuration, force);
+    //NOTE: the last chunk is appended to the ones already generated
+    if (!segment->isComplete()) {
+        offset = segment->getDataLength();
+    }
+
+    if (!segment->reserve(offset + get_segment_max_size(dashContext))) {
+        utils::errorMsg("Error generating segment: it exceeds the maximum segment size");
+        return false;
+    }
+
+    segmentSize = customGenerateSegment(segment->getDataBuffer() + offset, frameTs, segTimestamp, segDuration, force);
 
     if (segmentSize <= I2ERROR_MAX) {
         segment->setLastFrameTimestamp(frameTs.count());
@@ -665,7 +1126,7 @@ bool DashSegmenter::generateSegment(DashSegment* segment, Frame* frame, bool for
     
     segment->setTimestamp(segTimestamp);
     segment->setDuration(segDuration);
-    segment->setDataLength(segmentSize);
+    segment->setDataLength(offset + segmentSize);
     segment->setComplete(true);
     segment->setSeqNumber(++sequenceNumber);
     
@@ -677,6 +1138,58 @@ bool DashSegmenter::generateSegment(DashSegment* segment, Frame* frame, bool for
     return true;
 }
 
+bool DashSegmenter::generateChunk(DashSegment* segment)
+{
+    i2ctx_sample* ctxSample;
+    unsigned int chunkSize;
+    unsigned int offset;
+    uint32_t mediaType;
+    uint64_t segTimestamp;
+    uint64_t chunkStart;
+
+    if (chunkFrames == 0 || !dashContext || segment->isComplete()) {
+        return false;
+    }
+
+    if (dashContext->ctxvideo) {
+        ctxSample = dashContext->ctxvideo->ctxsample;
+        mediaType = dashContext->ctxvideo->video_type;
+    } else if (dashContext->ctxaudio) {
+        ctxSample = dashContext->ctxaudio->ctxsample;
+        mediaType = AUDIO_TYPE;
+    } else {
+        return false;
+    }
+
+    if (ctxSample->mdat_sample_length <= chunkFrames) {
+        return false;
+    }
+
+    offset = segment->getDataLength();
+    chunkStart = ctxSample->mdat[0].presentation_timestamp;
+
+    if (!segment->reserve(offset + get_segment_max_size(dashContext))) {
+        utils::errorMsg("Error generating chunk: it exceeds the maximum segment size");
+        return false;
+    }
+
+    chunkSize = generate_chunk(chunkFrames, mediaType, segment->getDataBuffer() + offset, &dashContext, &segTimestamp);
+
+    if (chunkSize <= I2ERROR_MAX) {
+        return false;
+    }
+
+    //NOTE: the kept sample is the first one of the next chunk
+    chunkDuration = ctxSample->mdat[0].presentation_timestamp - chunkStart;
+
+    if (offset == 0) {
+        segment->setTimestamp(segTimestamp);
+    }
+
+    segment->setDataLength(offset + chunkSize);
+    return true;
+}
+
 uint64_t DashSegmenter::microsToTimeBase(std::chrono::microseconds microValue)
 {
     return (microValue-tsOffset).count()*timeBase/std::micro::den;
@@ -687,11 +1200,11 @@ uint64_t DashSegmenter::microsToTimeBase(std::chrono::microseconds microValue)
 // DashSegment //
 /////////////////
 
-DashSegment::DashSegment(unsigned int maxSize) : 
-dataLength(0), seqNumber(0), timestamp(0), duration(0), 
-complete(false), lastFrameTimestamp(0)
+DashSegment::DashSegment(unsigned int size) : 
+dataLength(0), capacity(size), seqNumber(0), timestamp(0), duration(0), 
+complete(false), chunked(false), publishedLength(0), lastFrameTimestamp(0)
 {
-    data = new unsigned char[maxSize];
+    data = new unsigned char[capacity];
 }
 
 DashSegment::~DashSegment()
@@ -704,6 +1217,29 @@ void DashSegment::setSeqNumber(unsigned int seqNum)
     seqNumber = seqNum;
 }
 
+bool DashSegment::reserve(unsigned int size)
+{
+    unsigned char* newData;
+    unsigned int newCapacity;
+
+    if (size <= capacity) {
+        return true;
+    }
+
+    if (size > MAX_DAT) {
+        return false;
+    }
+
+    newCapacity = std::min(std::max(capacity*2, size), (unsigned int) MAX_DAT);
+    newData = new unsigned char[newCapacity];
+    memcpy(newData, data, dataLength);
+
+    delete[] data;
+    data = newData;
+    capacity = newCapacity;
+    return true;
+}
+
 void DashSegment::setDataLength(unsigned int length)
 {
     dataLength = length;
@@ -723,6 +1259,31 @@ bool DashSegment::writeToDisk(std::string path)
     return true;
 }
 
+bool DashSegment::getIndexRange(size_t& offset, size_t& length)
+{
+    size_t pos = 0;
+    size_t boxSize;
+
+    //NOTE: segments are a sequence of top level boxes (styp, sidx, moof, mdat) with 32 bit sizes
+    while (pos + 8 <= dataLength) {
+        boxSize = ((size_t) data[pos] << 24) | (data[pos + 1] << 16) | (data[pos + 2] << 8) | data[pos + 3];
+
+        if (boxSize < 8 || pos + boxSize > dataLength) {
+            return false;
+        }
+
+        if (memcmp(data + pos + 4, "sidx", 4) == 0) {
+            offset = pos;
+            length = boxSize;
+            return true;
+        }
+
+        pos += boxSize;
+    }
+
+    return false;
+}
+
 void DashSegment::setTimestamp(uint64_t ts)
 {
     timestamp = ts;
@@ -744,4 +1305,6 @@ void DashSegment::clear()
     duration = 0;
     dataLength = 0;
     complete = false;
+    chunked = false;
+    publishedLength = 0;
 }
@@ -29,6 +29,7 @@
 #include "../../VideoFrame.hh"
 #include "../../AudioFrame.hh"
 #include "MpdManager.hh"
+#include "DashSegmentStore.hh"
 
 extern "C" {
     #include "i2libdash.h"
@@ -45,9 +46,13 @@ extern "C" {
 #define AUDIO_CODEC             "mp4a.40.2"
 #define V_EXT                   ".m4v"
 #define A_EXT                   ".m4a"
+#define BYTE_RANGE_RING_FILES   3
 
 class DashSegmenter;
 class DashSegment;
+class DashHttpServer;
+class DashFileWriter;
+class HlsManager;
 
 /*! Class responsible for managing DASH segmenters. */
 
@@ -68,8 +73,37 @@ public:
     */
     ~Dasher();
 
-    //TODO: add documentation
-    bool configure(std::string dashFolder, std::string baseName_, unsigned int segDurInSeconds, unsigned int maxSeg, unsigned int minBuffTime);
+    /**
+    * Configures the dasher
+    * @param dashFolder is the system folder where the segmenter is going to work with
+    * @param baseName_ is the file base name for all generated and required files
+    * @param segDurInSeconds is the segment duration in seconds
+    * @param maxSeg is the number of segments kept in the MPD time-shift window
+    * @param minBuffTime is the MPD minimum buffer time in seconds
+    * @param httpPort if not 0, files are kept in memory instead of written to dashFolder and
+    * served by an embedded HTTP server listening at this port
+    * @param chunkFrames if not 0, segments are generated in CMAF chunks of this number of frames,
+    * which are published as soon as they are generated (low latency mode)
+    * @param hls if true, HLS playlists referencing the same segments are written next to the MPD
+    * @param byteRange if true, segments are appended to a few ring files per representation and listed
+    * in the MPD by byte range instead of written to a file each. Not compatible with chunkFrames nor hls
+    * @return true if succeeded and false if not
+    */
+    bool configure(std::string dashFolder, std::string baseName_, unsigned int segDurInSeconds, unsigned int maxSeg, 
+                   unsigned int minBuffTime, unsigned int httpPort = 0, unsigned int chunkFrames = 0, bool hls = false,
+                   bool byteRange = false);
+
+    /**
+    * @return in-memory store of the generated files, NULL if they are written to disk
+    */
+    DashSegmentStore* getSegmentStore() {return store;};
+
+    /**
+    * Enables or disables running the segmenters of a processing round in the JobsPool threads.
+    * When disabled, the frames of every representation are segmented in the filter thread
+    * @param enable True to run them in parallel, which is the default
+    */
+    void setParallel(bool enable) {parallel = enable;};
 
     /**
     * Creates a segment name as a function of the input and required params
@@ -92,21 +126,63 @@ public:
     */
     static std::string getInitSegmentName(std::string basePath, std::string baseName, unsigned int reprId, std::string ext);
 
+    /**
+    * Creates the name of a ring file, which contains consecutive segments in byte-range mode
+    * @param basePath is the folder path where the ring files are written
+    * @param baseName is the base name for that ring file specified as a convention
+    * @param reprId is the specific ID of that segmenter with an associated reader
+    * @param index is the ring file index, from 0 to BYTE_RANGE_RING_FILES - 1
+    * @param ext is the file extension that indicates its file format
+    * @return string of the ring file name
+    */
+    static std::string getRingFileName(std::string basePath, std::string baseName, unsigned int reprId, unsigned int index, std::string ext);
+
     bool setDashSegmenterBitrate(int id, unsigned int kbps);
 
+    /**
+    * @return Bytes allocated by the segmenters contexts and the segment buffers
+    */
+    size_t getSegmenterMemory();
+
 private:
+    struct SegmenterOutput {
+        bool initSegment;
+        bool segment;
+        bool chunk;
+    };
+
+    struct RingFile {
+        unsigned int index;     //file being appended
+        unsigned int files;     //files created so far
+        unsigned int segments;  //segments in the current file
+        size_t length;          //bytes in the current file
+    };
+
     bool doProcessFrame(std::map<int, Frame*> &orgFrames, std::vector<int> newFrames, int& ret);
     void doGetState(Jzon::Object &filterNode);
     void initializeEventMap();
-    bool generateInitSegment(unsigned int id, DashSegmenter* segmenter);
+    SegmenterOutput processFrame(unsigned int id, Frame* org, DashSegmenter* segmenter);
+    bool writeInitSegment(unsigned int id);
     bool generateSegment(unsigned int id, Frame* frame, DashSegmenter* segmenter);
-    bool appendFrameToSegment(unsigned int id, Frame* frame, DashSegmenter* segmenter);
+    bool generateChunk(unsigned int id, DashSegmenter* segmenter);
+    bool publishChunk(unsigned int id, DashSegmenter* segmenter);
+    void updateRepresentation(unsigned int id, DashSegmenter* segmenter);
     DashSegmenter* getSegmenter(unsigned int id);
     bool forceAudioSegmentsGeneration();
     bool writeVideoSegments();
     bool writeAudioSegments();
 
-    bool writeSegmentsToDisk(std::map<int,DashSegment*> segments, uint64_t timestamp, std::string segExt);
+    bool writeFile(DashSegment* segment, std::string name);
+    bool publishFile(DashSegment* segment, std::string name, bool complete);
+    bool publishChunks(std::map<int,DashSegment*> segments, std::string adSetId, std::string segExt);
+    bool removeFile(std::string name);
+    void writeMpd();
+    void writePlaylists();
+    void writePlaylist(std::string name, const std::string& playlist);
+    void writeManifest(std::string name, const std::string& content);
+    bool writeSegmentsToDisk(std::map<int,DashSegment*> segments, uint64_t timestamp, std::string adSetId, std::string segExt);
+    bool appendToRingFile(int id, DashSegment* segment, std::string adSetId, std::string segExt);
+    void removeRingFiles(int id);
     bool cleanSegments(std::map<int,DashSegment*> segments, uint64_t timestamp, std::string segExt);
     bool configureEvent(Jzon::Node* params);
 
@@ -120,13 +196,24 @@ private:
     std::map<int, DashSegment*> vSegments;
     std::map<int, DashSegment*> aSegments;
     std::map<int, DashSegment*> initSegments;
+    std::map<int, RingFile> ringFiles;
 
     MpdManager* mpdMngr;
+    HlsManager* hlsMngr;
+    DashSegmentStore* store;
+    DashHttpServer* httpServer;
+    DashFileWriter* writer;
     std::chrono::seconds segDur;
+    unsigned int chunkFrames;
+    bool byteRange;
+    bool parallel;
+    uint64_t writtenSegments;
 
     std::string basePath;
     std::string baseName;
     std::string mpdPath;
+    std::string writtenMpd;
+    std::map<std::string, std::string> writtenPlaylists;
     std::string vSegTempl;
     std::string aSegTempl;
     std::string vInitSegTempl;
@@ -169,6 +256,27 @@ public:
 
     virtual bool appendFrameToDashSegment(Frame* frame) = 0;
     bool generateSegment(DashSegment* segment, Frame* frame, bool force = false);
+
+    /**
+    * Generates a chunk of the current segment if there are enough frames, it is appended
+    * to the segment data, which is completed later by generateSegment
+    * @param segment Segment being generated
+    * @return true if a chunk has been generated and false if not
+    */
+    bool generateChunk(DashSegment* segment);
+
+    /**
+    * Sets the number of frames of each chunk
+    * @param frames Frames per chunk, 0 disables the chunked generation
+    */
+    void setChunkFrames(unsigned int frames) {chunkFrames = frames;};
+    unsigned int getChunkFrames() {return chunkFrames;};
+
+    /**
+    * Returns the duration of the last generated chunk
+    * @return duration in time base
+    */
+    unsigned int getChunkDuration() {return chunkDuration;};
     /**
     * Returns average frame duration
     * @return duration in time base
@@ -201,9 +309,18 @@ public:
     
     virtual bool flushDashContext() = 0;
 
-    void setBitrate(size_t bps) {bitrateInBitsPerSec = bps;};
+    /**
+    * Sets the representation bitrate, also used to size the segment buffers in advance
+    * @param bps Bitrate in bits per second
+    */
+    void setBitrate(size_t bps);
     unsigned int getBitrate() {return bitrateInBitsPerSec;};
 
+    /**
+    * @return Bytes allocated by the i2libdash context
+    */
+    unsigned int getContextMemory();
+
 protected:
     virtual unsigned customGenerateSegment(unsigned char *segBuffer, std::chrono::microseconds nextFrameTs, 
                                             uint64_t &segTimestamp, uint32_t &segDuration, bool force) = 0;
@@ -212,6 +329,7 @@ protected:
     std::string getSegmentName();
     uint64_t customTimestamp(std::chrono::system_clock::time_point timestamp);
     uint64_t microsToTimeBase(std::chrono::microseconds microValue);
+    void reserveSegmentData();
 
     std::chrono::seconds segDur;
 
@@ -223,6 +341,8 @@ protected:
     unsigned int sequenceNumber;
     std::vector<unsigned char> extradata;
     unsigned int bitrateInBitsPerSec;
+    unsigned int chunkFrames;
+    unsigned int chunkDuration;
     
     std::chrono::microseconds tsOffset;
 };
@@ -235,9 +355,9 @@ class DashSegment {
 public:
     /**
     * Class constructor
-    * @param maxSize Segment data max length
+    * @param size Segment data initial capacity, it grows on demand (see reserve)
     */
-    DashSegment(unsigned int maxSize = MAX_DAT);
+    DashSegment(unsigned int size = INIT_DAT);
 
     /**
     * Class destructor
@@ -249,11 +369,31 @@ public:
     */
     unsigned char* getDataBuffer() {return data;};
 
+    /**
+    * Grows the segment data buffer keeping its content, the buffer pointer may change
+    * @param size Required capacity in bytes
+    * @return true if succeeded and false if not
+    */
+    bool reserve(unsigned int size);
+
+    /**
+    * @return Segment data capacity in bytes
+    */
+    unsigned int getCapacity() {return capacity;};
+
     /**
     * @return Segment data length in bytes
     */
     unsigned int getDataLength() {return dataLength;};
 
+    /**
+    * Finds the segment index (sidx box) in the segment data
+    * @param offset Set to the sidx offset in bytes
+    * @param length Set to the sidx length in bytes
+    * @return true if found and false if not
+    */
+    bool getIndexRange(size_t& offset, size_t& length);
+
     /**
     * @params Segment data length in bytes
     */
@@ -328,13 +468,28 @@ public:
     bool isComplete() {return complete;};
     void setComplete(bool c) {complete = c;};
 
+    /**
+    * @return true if the segment is published chunk by chunk
+    */
+    bool isChunked() {return chunked;};
+    void setChunked(bool c) {chunked = c;};
+
+    /**
+    * @return Segment data bytes already published
+    */
+    unsigned int getPublishedLength() {return publishedLength;};
+    void setPublishedLength(unsigned int length) {publishedLength = length;};
+
 private:
     unsigned char* data;
     unsigned int dataLength;
+    unsigned int capacity;
     unsigned int seqNumber;
     uint64_t timestamp;
     unsigned int duration;
     bool complete;
+    bool chunked;
+    unsigned int publishedLength;
     uint64_t lastFrameTimestamp;
 };
 
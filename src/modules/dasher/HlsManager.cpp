@@ -0,0 +1,244 @@
+/*
+ *  HlsManager - HLS playlists manager class
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <cstdio>
+#include <algorithm>
+
+#include "HlsManager.hh"
+
+HlsManager::HlsManager() : maxSeg(0), targetDuration(1)
+{
+}
+
+HlsManager::~HlsManager()
+{
+}
+
+void HlsManager::configure(std::string baseName_, unsigned int maxSegment, unsigned int segDurInSec)
+{
+    baseName = baseName_;
+    maxSeg = std::max(maxSegment, 1U);
+    targetDuration = std::max(segDurInSec, 1U);
+}
+
+void HlsManager::updateGroup(std::string id, bool video, unsigned int timescale, std::string segmentTempl, std::string initTempl)
+{
+    Group* group = getGroup(id);
+
+    if (!group) {
+        group = &groups[id];
+        group->mediaSequence = 0;
+        group->maxDuration = 0;
+    }
+
+    group->video = video;
+    group->timescale = timescale;
+    group->segTemplate = segmentTempl;
+    group->initTemplate = initTempl;
+}
+
+bool HlsManager::updateGroupTimestamp(std::string id, uint64_t ts, unsigned int duration)
+{
+    Group* group = getGroup(id);
+
+    if (!group) {
+        return false;
+    }
+
+    //NOTE: EXTINF rounded to the nearest integer must not exceed the target duration, which
+    //      cannot decrease in a live playlist (RFC 8216), so the longest segment is kept
+    if (group->timescale > 0) {
+        group->maxDuration = std::max(group->maxDuration, (duration + group->timescale/2)/group->timescale);
+    }
+
+    if (!group->segments.empty() && group->segments.back().first == ts) {
+        group->segments.back().second = duration;
+        return true;
+    }
+
+    while (group->segments.size() >= maxSeg) {
+        group->segments.pop_front();
+        group->mediaSequence++;
+    }
+
+    group->segments.push_back(std::pair<uint64_t,unsigned int>(ts, duration));
+    return true;
+}
+
+bool HlsManager::updateRepresentation(std::string groupId, std::string reprId, std::string codec, int width, int height, int bandwidth)
+{
+    Group* group = getGroup(groupId);
+    Representation* repr;
+
+    if (!group) {
+        return false;
+    }
+
+    repr = &group->representations[reprId];
+    repr->codec = codec;
+    repr->width = width;
+    repr->height = height;
+    repr->bandwidth = bandwidth;
+    return true;
+}
+
+bool HlsManager::removeRepresentation(std::string groupId, std::string reprId)
+{
+    Group* group = getGroup(groupId);
+
+    if (!group) {
+        return false;
+    }
+
+    return group->representations.erase(reprId) > 0;
+}
+
+std::vector<std::string> HlsManager::getRepresentations()
+{
+    std::vector<std::string> ids;
+
+    for (auto group : groups) {
+        for (auto repr : group.second.representations) {
+            ids.push_back(repr.first);
+        }
+    }
+
+    return ids;
+}
+
+std::string HlsManager::getMasterPlaylist()
+{
+    std::string playlist;
+    std::string audioCodec;
+    int audioBandwidth = 0;
+    bool hasVideo = false;
+    bool defaultAudio = true;
+
+    playlist = "#EXTM3U\n#EXT-X-VERSION:" + std::to_string(HLS_VERSION) + "\n#EXT-X-INDEPENDENT-SEGMENTS\n";
+
+    for (auto group : groups) {
+        hasVideo |= group.second.video && !group.second.representations.empty();
+    }
+
+    //NOTE: with video, the audio renditions are an alternative group referenced from every variant stream
+    for (auto group : groups) {
+        if (group.second.video || !hasVideo) {
+            continue;
+        }
+
+        for (auto repr : group.second.representations) {
+            playlist += "#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID=\"" HLS_AUDIO_GROUP_ID "\",NAME=\"" + repr.first +
+                        "\",LANGUAGE=\"" HLS_AUDIO_LANG "\",AUTOSELECT=YES,DEFAULT=" + (defaultAudio ? "YES" : "NO") +
+                        ",URI=\"" + getMediaPlaylistName(repr.first) + "\"\n";
+            defaultAudio = false;
+
+            if (audioCodec.empty()) {
+                audioCodec = repr.second.codec;
+            }
+
+            audioBandwidth = std::max(audioBandwidth, repr.second.bandwidth);
+        }
+    }
+
+    for (auto group : groups) {
+        if (group.second.video != hasVideo) {
+            continue;
+        }
+
+        for (auto repr : group.second.representations) {
+            playlist += "#EXT-X-STREAM-INF:BANDWIDTH=" + std::to_string(repr.second.bandwidth + audioBandwidth);
+            playlist += ",CODECS=\"" + repr.second.codec + (audioCodec.empty() ? "" : "," + audioCodec) + "\"";
+
+            if (hasVideo) {
+                playlist += ",RESOLUTION=" + std::to_string(repr.second.width) + "x" + std::to_string(repr.second.height);
+            }
+
+            if (!audioCodec.empty()) {
+                playlist += ",AUDIO=\"" HLS_AUDIO_GROUP_ID "\"";
+            }
+
+            playlist += "\n" + getMediaPlaylistName(repr.first) + "\n";
+        }
+    }
+
+    return playlist;
+}
+
+std::string HlsManager::getMediaPlaylist(std::string reprId)
+{
+    Group* group = getRepresentationGroup(reprId);
+    std::string playlist;
+    std::string segments;
+    unsigned int target;
+    char extinf[64];
+
+    if (!group || group->timescale == 0) {
+        return "";
+    }
+
+    target = std::max(targetDuration, group->maxDuration);
+
+    for (auto seg : group->segments) {
+        snprintf(extinf, sizeof(extinf), "#EXTINF:%.3f,\n", (double) seg.second/group->timescale);
+        segments += extinf + fillTemplate(group->segTemplate, reprId, seg.first) + "\n";
+    }
+
+    playlist = "#EXTM3U\n#EXT-X-VERSION:" + std::to_string(HLS_VERSION) + "\n";
+    playlist += "#EXT-X-TARGETDURATION:" + std::to_string(target) + "\n";
+    playlist += "#EXT-X-MEDIA-SEQUENCE:" + std::to_string(group->mediaSequence) + "\n";
+    playlist += "#EXT-X-INDEPENDENT-SEGMENTS\n";
+    playlist += "#EXT-X-MAP:URI=\"" + fillTemplate(group->initTemplate, reprId, 0) + "\"\n";
+    playlist += segments;
+
+    return playlist;
+}
+
+HlsManager::Group* HlsManager::getGroup(std::string id)
+{
+    return groups.count(id) <= 0 ? NULL : &groups[id];
+}
+
+HlsManager::Group* HlsManager::getRepresentationGroup(std::string reprId)
+{
+    for (auto& group : groups) {
+        if (group.second.representations.count(reprId) > 0) {
+            return &group.second;
+        }
+    }
+
+    return NULL;
+}
+
+std::string HlsManager::fillTemplate(std::string templ, std::string reprId, uint64_t ts)
+{
+    size_t pos;
+
+    if ((pos = templ.find(REPRESENTATION_ID_TEMPL)) != std::string::npos) {
+        templ.replace(pos, std::string(REPRESENTATION_ID_TEMPL).size(), reprId);
+    }
+
+    if ((pos = templ.find(TIME_TEMPL)) != std::string::npos) {
+        templ.replace(pos, std::string(TIME_TEMPL).size(), std::to_string(ts));
+    }
+
+    return templ;
+}
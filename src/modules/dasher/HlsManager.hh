@@ -0,0 +1,159 @@
+/*
+ *  HlsManager - HLS playlists manager class
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _HLS_MANAGER_HH_
+#define _HLS_MANAGER_HH_
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#define HLS_VERSION 7
+#define HLS_EXT ".m3u8"
+#define HLS_AUDIO_GROUP_ID "audio"
+#define HLS_AUDIO_LANG "eng"
+#define REPRESENTATION_ID_TEMPL "$RepresentationID$"
+#define TIME_TEMPL "$Time$"
+
+/*! It is used to manage the HLS playlists of the DASH segments. Segments and init segments are shared with
+    the MPD: each DASH adaptation set is a group of HLS renditions, whose fMP4 segments are referenced from the
+    media playlists with the same templates used in the MPD. The master playlist lists the video renditions as
+    variant streams, with the audio renditions as an alternative audio group (or as variant streams when there
+    is no video). */
+
+class HlsManager
+{
+public:
+    /**
+    * Class constructor
+    */
+    HlsManager();
+
+    /**
+    * Class destructor
+    */
+    virtual ~HlsManager();
+
+    /**
+    * Configures the playlists
+    * @param baseName_ Base name of the playlists
+    * @param maxSegment Number of segments listed in each media playlist
+    * @param segDurInSec Nominal segment duration in seconds, the minimum target duration
+    */
+    void configure(std::string baseName_, unsigned int maxSegment, unsigned int segDurInSec);
+
+    /**
+    * Updates an existing group of renditions. If it does not exist, it creates a new one.
+    * @param id Group Id, the DASH adaptation set Id
+    * @param video true if it is a group of video renditions and false if it is audio
+    * @param timescale Timescale of the segment timestamps and durations (in ticks per second)
+    * @param segmentTempl Template of the segment names, as in the MPD <SegmentTemplate> "media" attribute
+    * @param initTempl Template of the init segment names, as in the MPD <SegmentTemplate> "initialization" attribute
+    */
+    void updateGroup(std::string id, bool video, unsigned int timescale, std::string segmentTempl, std::string initTempl);
+
+    /**
+    * Adds a segment to the media playlists of a group. If the number of segments exceeds maxSeg the oldest one
+    * is removed. If the last one has the same timestamp only its duration is updated.
+    * @param id Group Id. Must exist.
+    * @param ts Timestamp of the segment in timescale base
+    * @param duration Duration of the segment in timescale base
+    * @return true if succeeded and false if not
+    */
+    bool updateGroupTimestamp(std::string id, uint64_t ts, unsigned int duration);
+
+    /**
+    * Updates an existing rendition. If it does not exist, it creates a new one.
+    * @param groupId Group Id. Must exist.
+    * @param reprId Rendition Id, the DASH representation Id
+    * @param codec RFC 6381 codec string
+    * @param width Video width in pixels, 0 for audio
+    * @param height Video height in pixels, 0 for audio
+    * @param bandwidth Bandwidth in bits per second
+    * @return true if succeeded and false if not
+    */
+    bool updateRepresentation(std::string groupId, std::string reprId, std::string codec, int width, int height, int bandwidth);
+
+    /**
+    * Removes an existing rendition
+    * @param groupId Group Id
+    * @param reprId Rendition Id
+    * @return true on success and false on fail
+    */
+    bool removeRepresentation(std::string groupId, std::string reprId);
+
+    /**
+    * @return Ids of all the renditions, which have a media playlist each
+    */
+    std::vector<std::string> getRepresentations();
+
+    /**
+    * Renders the master playlist
+    * @return playlist content
+    */
+    std::string getMasterPlaylist();
+
+    /**
+    * Renders the media playlist of a rendition
+    * @param reprId Rendition Id
+    * @return playlist content, empty if the rendition does not exist
+    */
+    std::string getMediaPlaylist(std::string reprId);
+
+    std::string getMasterPlaylistName() {return baseName + HLS_EXT;};
+    std::string getMediaPlaylistName(std::string reprId) {return baseName + "_" + reprId + HLS_EXT;};
+
+    unsigned int getMaxSeg() {return maxSeg;};
+
+private:
+    struct Representation {
+        std::string codec;
+        int width;
+        int height;
+        int bandwidth;
+    };
+
+    struct Group {
+        bool video;
+        unsigned int timescale;
+        std::string segTemplate;
+        std::string initTemplate;
+        std::deque<std::pair<uint64_t,unsigned int>> segments;
+        uint64_t mediaSequence;
+        unsigned int maxDuration;   //seconds, longest segment ever listed
+        std::map<std::string, Representation> representations;
+    };
+
+    Group* getGroup(std::string id);
+    Group* getRepresentationGroup(std::string reprId);
+    std::string fillTemplate(std::string templ, std::string reprId, uint64_t ts);
+
+    std::string baseName;
+    unsigned int maxSeg;
+    unsigned int targetDuration;
+
+    std::map<std::string, Group> groups;
+};
+
+#endif /* _HLS_MANAGER_HH_ */
@@ -23,13 +23,17 @@
 #include <iostream>
 #include <ctime>
 #include <chrono> 
+#include <cstdio>
+#include <cstring>
 
 #include "MpdManager.hh"
 
 MpdManager::MpdManager()
 {
     started = false;
+    changed = true;
     maxSeg = MIN_SEGMENT;
+    publishTime[0] = '\0';
     
     //NOTE: Assuming MIN_SEGMENT and the minimum segment duration 1 second
     minBufferTime = MIN_SEGMENT; 
@@ -60,16 +64,119 @@ void MpdManager::configure(unsigned int minBuffTime, unsigned int maxSegment, un
     
     timeShiftBufferDepth = "PT" + std::to_string(maxSeg*segDurInSec) + ".0S";
     minimumUpdatePeriod = "PT" + std::to_string(segDurInSec) + ".0S";
+    changed = true;
 }
 
-void MpdManager::writeToDisk(const char* fileName)
+bool MpdManager::writeToDisk(const char* fileName)
+{
+    std::string mpd = toString();
+    std::string tmpName = std::string(fileName) + ".tmp";
+    std::ofstream file;
+
+    if (writtenFile == fileName && written == mpd) {
+        return true;
+    }
+
+    file.open(tmpName.c_str(), std::ofstream::binary | std::ofstream::trunc);
+    file.write(mpd.data(), mpd.size());
+    file.close();
+
+    if (!file || std::rename(tmpName.c_str(), fileName) != 0) {
+        std::remove(tmpName.c_str());
+        std::cerr << "Error writing MPD file " << fileName << std::endl;
+        return false;
+    }
+
+    writtenFile = fileName;
+    written.swap(mpd);
+    return true;
+}
+
+std::string MpdManager::toString()
+{
+    std::string mpd;
+    std::string newTimelines;
+    std::vector<size_t> ends;
+    size_t start = 0;
+    size_t i = 2;
+
+    for (auto ad : adaptationSets) {
+        changed |= ad.second->isChanged();
+    }
+
+    if (changed) {
+        renderTemplate();
+    }
+
+    for (auto ad : adaptationSets) {
+        ad.second->timelineToString(newTimelines, ends, markIndents);
+    }
+
+    //NOTE: the publishTime is kept while the content does not change, so identical MPDs can be skipped
+    if (changed || publishTime[0] == '\0' || newTimelines != timelines) {
+        std::time_t tt = std::chrono::system_clock::to_time_t (std::chrono::system_clock::now());
+        struct std::tm *ptm = std::gmtime(&tt);
+        std::strftime(publishTime, AVAILABILITY_START_TIME, "%FT%T", ptm);
+        timelines.swap(newTimelines);
+    }
+
+    changed = false;
+
+    mpd.reserve(mpdTemplate[0].size() + mpdTemplate[1].size() + timelines.size() + mpdTemplate.size()*128);
+    mpd.append(mpdTemplate[0]).append(publishTime).append(mpdTemplate[1]);
+
+    for (auto end : ends) {
+        mpd.append(timelines, start, end - start).append(mpdTemplate[i++]);
+        start = end;
+    }
+
+    return mpd;
+}
+
+void MpdManager::renderTemplate()
 {
     tinyxml2::XMLDocument doc;
+    tinyxml2::XMLPrinter printer;
+    std::string mpd;
+    size_t pos;
+    size_t mark;
+    size_t lineStart;
+    std::string timelineMark = std::string("<!--") + TIMELINE_MARK + "-->";
+
+    toMpd(doc, false);
+    doc.Print(&printer);
+    mpd = std::string(printer.CStr(), printer.CStrSize() - 1);
+
+    mpdTemplate.clear();
+    markIndents.clear();
+
+    mark = mpd.find(PUBLISH_TIME_MARK);
+    mpdTemplate.push_back(mpd.substr(0, mark));
+    pos = mark + strlen(PUBLISH_TIME_MARK);
+
+    //NOTE: tinyxml2 prints the line break before each node, the <S> tags replace the whole marker line
+    while ((mark = mpd.find(timelineMark, pos)) != std::string::npos) {
+        lineStart = mpd.rfind('\n', mark);
+        mpdTemplate.push_back(mpd.substr(pos, lineStart - pos));
+        markIndents.push_back(mpd.substr(lineStart + 1, mark - lineStart - 1));
+        pos = mark + timelineMark.size();
+    }
+
+    mpdTemplate.push_back(mpd.substr(pos));
+
+    for (auto ad : adaptationSets) {
+        ad.second->setChanged(false);
+    }
+}
+
+void MpdManager::toMpd(tinyxml2::XMLDocument& doc, bool timeline)
+{
     tinyxml2::XMLElement* root;
     tinyxml2::XMLElement* period;
     tinyxml2::XMLElement* el;
     tinyxml2::XMLElement* title;
     tinyxml2::XMLText* text;
+    bool byteRange = false;
     
     if (!started){
         std::time_t tt = std::chrono::system_clock::to_time_t (std::chrono::system_clock::now());
@@ -78,17 +185,23 @@ void MpdManager::writeToDisk(const char* fileName)
         started = true;
     }
 
+    //NOTE: the live profile requires segment templates
+    for (auto ad : adaptationSets) {
+        byteRange |= ad.second->isByteRange();
+    }
+
     root = doc.NewElement("MPD");
     root->SetAttribute("xmlns:xsi", XMLNS_XSI);
     root->SetAttribute("xmlns", XMLNS);
     root->SetAttribute("xmlns:xlink", XMLNS_XLINK);
     root->SetAttribute("xsi:schemaLocation", XSI_SCHEMA_LOCATION);
-    root->SetAttribute("profiles", PROFILES);
+    root->SetAttribute("profiles", byteRange ? BYTE_RANGE_PROFILES : PROFILES);
     root->SetAttribute("type", TYPE_DYNAMIC);
     root->SetAttribute("minimumUpdatePeriod", minimumUpdatePeriod.c_str());
     root->SetAttribute("timeShiftBufferDepth", timeShiftBufferDepth.c_str());
     root->SetAttribute("minBufferTime", ("PT" + std::to_string(minBufferTime) + ".0S").c_str());
     root->SetAttribute("availabilityStartTime", availabilityStartTime);
+    root->SetAttribute("publishTime", timeline ? publishTime : PUBLISH_TIME_MARK);
     doc.InsertFirstChild(root);
 
     el = doc.NewElement("ProgramInformation");
@@ -105,12 +218,11 @@ void MpdManager::writeToDisk(const char* fileName)
     for (auto ad : adaptationSets) {
         el = doc.NewElement("AdaptationSet");
         el->SetAttribute("id", ad.first.c_str());
-        ad.second->toMpd(doc, el);
+        ad.second->toMpd(doc, el, timeline);
         period->InsertEndChild(el);
     }
 
     root->InsertEndChild(period);
-    doc.SaveFile(fileName);
 }
 
 uint64_t MpdManager::updateAdaptationSetTimestamp(std::string id, uint64_t ts, unsigned int duration)
@@ -128,6 +240,34 @@ uint64_t MpdManager::updateAdaptationSetTimestamp(std::string id, uint64_t ts, u
     return removedTimestamp;
 }
 
+bool MpdManager::setAdaptationSetAvailabilityTimeOffset(std::string id, double offset)
+{
+    AdaptationSet* adSet;
+
+    adSet = getAdaptationSet(id);
+
+    if (!adSet) {
+        return false;
+    }
+
+    adSet->setAvailabilityTimeOffset(offset);
+    return true;
+}
+
+bool MpdManager::updateRepresentationSegment(std::string adSetId, std::string reprId, ByteRangeSegment segment)
+{
+    AdaptationSet* adSet;
+
+    adSet = getAdaptationSet(adSetId);
+
+    if (!adSet) {
+        return false;
+    }
+
+    adSet->updateSegment(reprId, segment, maxSeg);
+    return true;
+}
+
 bool MpdManager::flushAdaptationSetTimestamps(std::string id)
 {
     AdaptationSet* adSet;
@@ -215,6 +355,7 @@ bool MpdManager::addAdaptationSet(std::string id, AdaptationSet* adaptationSet)
     }
 
     adaptationSets[id] = adaptationSet;
+    changed = true;
     return true;
 }
 
@@ -232,6 +373,8 @@ AdaptationSet::AdaptationSet(int segTimescale, std::string segTempl, std::string
     startWithSAP = START_WITH_SAP;
     subsegmentAlignment = SUBSEGMENT_ALIGNMENT;
     subsegmentStartsWithSAP = SUBSEGMENT_STARTS_WITH_SAP;
+    availabilityTimeOffset = 0;
+    changed = true;
 }
 
 AdaptationSet::~AdaptationSet()
@@ -242,6 +385,11 @@ uint64_t AdaptationSet::updateTimestamp(uint64_t ts, unsigned int duration, unsi
 {
     uint64_t removedTimestamp= 0;
 
+    if (!timestamps.empty() && timestamps.back().first == ts) {
+        timestamps.back().second = duration;
+        return removedTimestamp;
+    }
+
     while (timestamps.size() >= maxSeg) {
         removedTimestamp = timestamps.front().first;
         timestamps.pop_front();
@@ -251,13 +399,181 @@ uint64_t AdaptationSet::updateTimestamp(uint64_t ts, unsigned int duration, unsi
     return removedTimestamp;
 }
 
+void AdaptationSet::updateSegment(std::string reprId, ByteRangeSegment segment, unsigned int maxSeg)
+{
+    std::deque<ByteRangeSegment>& reprSegments = segments[reprId];
+
+    if (!reprSegments.empty() && reprSegments.back().timestamp == segment.timestamp) {
+        reprSegments.back() = segment;
+        return;
+    }
+
+    while (reprSegments.size() >= maxSeg) {
+        reprSegments.pop_front();
+    }
+
+    reprSegments.push_back(segment);
+}
+
 void AdaptationSet::flushTimestamps()
 {
     timestamps.clear();
+    segments.clear();
+}
+
+void AdaptationSet::timelineToString(std::string& timeline, std::vector<size_t>& ends, const std::vector<std::string>& indents)
+{
+    std::string indent;
+
+    if (!isByteRange()) {
+        indent = ends.size() < indents.size() ? indents[ends.size()] : "";
+
+        for (auto ts : timestamps) {
+            timeline.append("\n").append(indent).append("<S t=\"").append(std::to_string(ts.first));
+            timeline.append("\" d=\"").append(std::to_string(ts.second)).append("\"/>");
+        }
+
+        ends.push_back(timeline.size());
+        return;
+    }
+
+    //NOTE: each representation has its own timeline, segments of representations added later are not listed
+    for (auto id : getRepresentationIds()) {
+        indent = ends.size() < indents.size() ? indents[ends.size()] : "";
+
+        for (auto seg : segments[id]) {
+            timeline.append("\n").append(indent).append("<S t=\"").append(std::to_string(seg.timestamp));
+            timeline.append("\" d=\"").append(std::to_string(seg.duration)).append("\"/>");
+        }
+
+        ends.push_back(timeline.size());
+        indent = ends.size() < indents.size() ? indents[ends.size()] : "";
+        segmentURLsToString(timeline, id, indent);
+        ends.push_back(timeline.size());
+    }
+}
+
+void AdaptationSet::segmentURLsToString(std::string& urls, std::string reprId, const std::string& indent)
+{
+    for (auto seg : segments[reprId]) {
+        urls.append("\n").append(indent).append("<SegmentURL media=\"").append(seg.media);
+        urls.append("\" mediaRange=\"").append(std::to_string(seg.offset)).append("-");
+        urls.append(std::to_string(seg.offset + seg.length - 1));
+        urls.append("\" indexRange=\"").append(std::to_string(seg.indexOffset)).append("-");
+        urls.append(std::to_string(seg.indexOffset + seg.indexLength - 1)).append("\"/>");
+    }
+}
+
+void AdaptationSet::timelineToMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement* segmentTimeline, bool timeline)
+{
+    tinyxml2::XMLElement* s;
+
+    if (!timeline) {
+        segmentTimeline->InsertEndChild(doc.NewComment(TIMELINE_MARK));
+        return;
+    }
+
+    for (auto ts : timestamps) {
+        s = doc.NewElement("S");
+        s->SetAttribute("t", std::to_string(ts.first).c_str());
+        s->SetAttribute("d", std::to_string(ts.second).c_str());
+        segmentTimeline->InsertEndChild(s);
+    }
+}
+
+void AdaptationSet::segmentTemplateToMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement* adaptSet, bool timeline)
+{
+    tinyxml2::XMLElement* segmentTemplate;
+    tinyxml2::XMLElement* segmentTimeline;
+
+    if (isByteRange()) {
+        return;
+    }
+
+    segmentTemplate = doc.NewElement("SegmentTemplate");
+    segmentTemplate->SetAttribute("timescale", timescale);
+    segmentTemplate->SetAttribute("media", segTemplate.c_str());
+    segmentTemplate->SetAttribute("initialization", initTemplate.c_str());
+
+    if (availabilityTimeOffset > 0) {
+        segmentTemplate->SetAttribute("availabilityTimeOffset", availabilityTimeOffset);
+        segmentTemplate->SetAttribute("availabilityTimeComplete", false);
+    }
+
+    segmentTimeline = doc.NewElement("SegmentTimeline");
+    timelineToMpd(doc, segmentTimeline, timeline);
+
+    segmentTemplate->InsertEndChild(segmentTimeline);
+    adaptSet->InsertEndChild(segmentTemplate);
+}
+
+void AdaptationSet::segmentListToMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement* repr, std::string reprId, bool timeline)
+{
+    tinyxml2::XMLElement* segmentList;
+    tinyxml2::XMLElement* initialization;
+    tinyxml2::XMLElement* segmentTimeline;
+    tinyxml2::XMLElement* el;
+    std::string init = initTemplate;
+    size_t pos;
+
+    if (!isByteRange()) {
+        return;
+    }
+
+    if ((pos = init.find("$RepresentationID$")) != std::string::npos) {
+        init.replace(pos, std::string("$RepresentationID$").size(), reprId);
+    }
+
+    segmentList = doc.NewElement("SegmentList");
+    segmentList->SetAttribute("timescale", timescale);
+
+    initialization = doc.NewElement("Initialization");
+    initialization->SetAttribute("sourceURL", init.c_str());
+    segmentList->InsertEndChild(initialization);
+
+    segmentTimeline = doc.NewElement("SegmentTimeline");
+    segmentList->InsertEndChild(segmentTimeline);
+
+    if (!timeline) {
+        segmentTimeline->InsertEndChild(doc.NewComment(TIMELINE_MARK));
+        segmentList->InsertEndChild(doc.NewComment(TIMELINE_MARK));
+        repr->InsertEndChild(segmentList);
+        return;
+    }
+
+    for (auto seg : segments[reprId]) {
+        el = doc.NewElement("S");
+        el->SetAttribute("t", std::to_string(seg.timestamp).c_str());
+        el->SetAttribute("d", std::to_string(seg.duration).c_str());
+        segmentTimeline->InsertEndChild(el);
+    }
+
+    for (auto seg : segments[reprId]) {
+        el = doc.NewElement("SegmentURL");
+        el->SetAttribute("media", seg.media.c_str());
+        el->SetAttribute("mediaRange", (std::to_string(seg.offset) + "-" + std::to_string(seg.offset + seg.length - 1)).c_str());
+        el->SetAttribute("indexRange", (std::to_string(seg.indexOffset) + "-" + 
+                                        std::to_string(seg.indexOffset + seg.indexLength - 1)).c_str());
+        segmentList->InsertEndChild(el);
+    }
+
+    repr->InsertEndChild(segmentList);
+}
+
+void AdaptationSet::setAvailabilityTimeOffset(double offset)
+{
+    if (availabilityTimeOffset != offset) {
+        availabilityTimeOffset = offset;
+        changed = true;
+    }
 }
 
 void AdaptationSet::update(int segTimescale, std::string segTempl, std::string initTempl)
 {
+    if (timescale != segTimescale || segTemplate != segTempl || initTemplate != initTempl) {
+        changed = true;
+    }
+
     timescale = segTimescale;
     segTemplate = segTempl;
     initTemplate = initTempl;
@@ -287,6 +603,8 @@ bool VideoAdaptationSet::removeRepresentation(std::string id)
 
     delete representations[id];
     representations.erase(id);
+    segments.erase(id);
+    changed = true;
     return true;
 }
 
@@ -305,19 +623,25 @@ void VideoAdaptationSet::updateVideoRepresentation(std::string id, std::string c
     if (!vRepr) {
         vRepr = new VideoRepresentation(codec, width, height, bandwidth);
         addRepresentation(id, vRepr);
-    } else {
-        vRepr->update(codec, width, height, bandwidth);
+        changed = true;
+    } else if (vRepr->update(codec, width, height, bandwidth)) {
+        changed = true;
     }
 
     if (maxWidth < width) {
         maxWidth = width;
+        changed = true;
     }
 
     if (maxHeight < height) {
         maxHeight = height;
+        changed = true;
     }
 
-    frameRate = fps;
+    if (frameRate != fps) {
+        frameRate = fps;
+        changed = true;
+    }
 }
 
 bool VideoAdaptationSet::addRepresentation(std::string id, VideoRepresentation* repr)
@@ -330,11 +654,8 @@ bool VideoAdaptationSet::addRepresentation(std::string id, VideoRepresentation*
     return true;
 }
 
-void VideoAdaptationSet::toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*& adaptSet)
+void VideoAdaptationSet::toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*& adaptSet, bool timeline)
 {
-    tinyxml2::XMLElement* segmentTemplate;
-    tinyxml2::XMLElement* segmentTimeline;
-    tinyxml2::XMLElement* s;
     tinyxml2::XMLElement* repr;
 
     adaptSet->SetAttribute("mimeType", mimeType.c_str());
@@ -346,22 +667,7 @@ void VideoAdaptationSet::toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*
     adaptSet->SetAttribute("subsegmentAlignment", subsegmentAlignment);
     adaptSet->SetAttribute("subsegmentStartsWithSAP", subsegmentStartsWithSAP);
 
-    segmentTemplate = doc.NewElement("SegmentTemplate");
-    segmentTemplate->SetAttribute("timescale", timescale);
-    segmentTemplate->SetAttribute("media", segTemplate.c_str());
-    segmentTemplate->SetAttribute("initialization", initTemplate.c_str());
-
-    segmentTimeline = doc.NewElement("SegmentTimeline");
-
-    for (auto ts : timestamps) {
-        s = doc.NewElement("S");
-        s->SetAttribute("t", std::to_string(ts.first).c_str());
-        s->SetAttribute("d", std::to_string(ts.second).c_str());
-        segmentTimeline->InsertEndChild(s);
-    }
-
-    segmentTemplate->InsertEndChild(segmentTimeline);
-    adaptSet->InsertEndChild(segmentTemplate);
+    segmentTemplateToMpd(doc, adaptSet, timeline);
 
     for (auto r : representations) {
         repr = doc.NewElement("Representation");
@@ -371,10 +677,22 @@ void VideoAdaptationSet::toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*
         repr->SetAttribute("height", r.second->getHeight());
         repr->SetAttribute("sar", r.second->getSAR().c_str());
         repr->SetAttribute("bandwidth", r.second->getBandwidth());
+        segmentListToMpd(doc, repr, r.first, timeline);
         adaptSet->InsertEndChild(repr);
     }
 }
 
+std::vector<std::string> VideoAdaptationSet::getRepresentationIds()
+{
+    std::vector<std::string> ids;
+
+    for (auto r : representations) {
+        ids.push_back(r.first);
+    }
+
+    return ids;
+}
+
 AudioAdaptationSet::AudioAdaptationSet(int segTimescale, std::string segTempl, std::string initTempl)
 : AdaptationSet(segTimescale, segTempl, initTempl)
 {
@@ -399,6 +717,8 @@ bool AudioAdaptationSet::removeRepresentation(std::string id)
 
     delete representations[id];
     representations.erase(id);
+    segments.erase(id);
+    changed = true;
     return true;
 }
 
@@ -416,10 +736,13 @@ void AudioAdaptationSet::updateAudioRepresentation(std::string id, std::string c
     if (!repr) {
         repr = new AudioRepresentation(codec, sampleRate, bandwidth, channels);
         addRepresentation(id, repr);
+        changed = true;
         return;
     }
 
-    repr->update(codec, sampleRate, bandwidth, channels);
+    if (repr->update(codec, sampleRate, bandwidth, channels)) {
+        changed = true;
+    }
 }
 
 bool AudioAdaptationSet::addRepresentation(std::string id, AudioRepresentation* repr)
@@ -432,13 +755,10 @@ bool AudioAdaptationSet::addRepresentation(std::string id, AudioRepresentation*
     return true;
 }
 
-void AudioAdaptationSet::toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*& adaptSet)
+void AudioAdaptationSet::toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*& adaptSet, bool timeline)
 {
-    tinyxml2::XMLElement* segmentTemplate;
-    tinyxml2::XMLElement* segmentTimeline;
     tinyxml2::XMLElement* role;
     tinyxml2::XMLElement* audioChannelConfiguration;
-    tinyxml2::XMLElement* s;
     tinyxml2::XMLElement* repr;
 
     adaptSet->SetAttribute("mimeType", mimeType.c_str());
@@ -453,22 +773,7 @@ void AudioAdaptationSet::toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*
     role->SetAttribute("value", roleValue.c_str());
     adaptSet->InsertEndChild(role);
 
-    segmentTemplate = doc.NewElement("SegmentTemplate");
-    segmentTemplate->SetAttribute("timescale", timescale);
-    segmentTemplate->SetAttribute("media", segTemplate.c_str());
-    segmentTemplate->SetAttribute("initialization", initTemplate.c_str());
-
-    segmentTimeline = doc.NewElement("SegmentTimeline");
-
-    for (auto ts : timestamps) {
-        s = doc.NewElement("S");
-        s->SetAttribute("t", std::to_string(ts.first).c_str());
-        s->SetAttribute("d", std::to_string(ts.second).c_str());
-        segmentTimeline->InsertEndChild(s);
-    }
-
-    segmentTemplate->InsertEndChild(segmentTimeline);
-    adaptSet->InsertEndChild(segmentTemplate);
+    segmentTemplateToMpd(doc, adaptSet, timeline);
 
     for (auto r : representations) {
         repr = doc.NewElement("Representation");
@@ -482,10 +787,22 @@ void AudioAdaptationSet::toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*
         audioChannelConfiguration->SetAttribute("value", r.second->getAudioChannelConfigValue());
         repr->InsertEndChild(audioChannelConfiguration);
 
+        segmentListToMpd(doc, repr, r.first, timeline);
         adaptSet->InsertEndChild(repr);
     }
 }
 
+std::vector<std::string> AudioAdaptationSet::getRepresentationIds()
+{
+    std::vector<std::string> ids;
+
+    for (auto r : representations) {
+        ids.push_back(r.first);
+    }
+
+    return ids;
+}
+
 VideoRepresentation::VideoRepresentation(std::string vCodec, int vWidth, int vHeight, int vBandwidth)
 {
     codec = vCodec;
@@ -499,12 +816,17 @@ VideoRepresentation::~VideoRepresentation()
 {
 }
 
-void VideoRepresentation::update(std::string vCodec, int vWidth, int vHeight, int vBandwidth)
+bool VideoRepresentation::update(std::string vCodec, int vWidth, int vHeight, int vBandwidth)
 {
+    if (codec == vCodec && width == vWidth && height == vHeight && bandwidth == vBandwidth) {
+        return false;
+    }
+
     codec = vCodec;
     width = vWidth;
     height = vHeight;
     bandwidth = vBandwidth;
+    return true;
 }
 
 AudioRepresentation::AudioRepresentation(std::string aCodec, int aSampleRate, int aBandwidth, int channels)
@@ -520,11 +842,16 @@ AudioRepresentation::~AudioRepresentation()
 {
 }
 
-void AudioRepresentation::update(std::string aCodec, int aSampleRate, int aBandwidth, int channels)
+bool AudioRepresentation::update(std::string aCodec, int aSampleRate, int aBandwidth, int channels)
 {
+    if (codec == aCodec && sampleRate == aSampleRate && bandwidth == aBandwidth && audioChannelConfigValue == channels) {
+        return false;
+    }
+
     codec = aCodec;
     sampleRate = aSampleRate;
     bandwidth = aBandwidth;
     audioChannelConfigValue = channels;
+    return true;
 }
 
@@ -24,6 +24,9 @@
 
 #include <map>
 #include <deque>
+#include <vector>
+#include <string>
+#include <cstdint>
 #include <tinyxml2.h>
 
 #define MIN_SEGMENT 2
@@ -32,6 +35,7 @@
 #define XMLNS_XLINK "http://www.w3.org/1999/xlink"
 #define XSI_SCHEMA_LOCATION "urn:mpeg:DASH:schema:MPD:2011 http://standards.iso.org/ittf/PubliclyAvailableStandards/MPEG-DASH_schema_files/DASH-MPD.xsd"
 #define PROFILES "urn:mpeg:dash:profile:isoff-live:2011"
+#define BYTE_RANGE_PROFILES "urn:mpeg:dash:profile:isoff-main:2011"
 #define AVAILABILITY_START_TIME 64
 #define TYPE_DYNAMIC "dynamic"
 #define PERIOD_ID 0
@@ -47,6 +51,21 @@
 #define AUDIO_ROLE_VALUE "main"
 #define SAR "1:1"
 #define AUDIO_CHANNEL_CONFIG_SCHEME_ID_URI "urn:mpeg:dash:23003:3:audio_channel_configuration:2011"
+#define PUBLISH_TIME_MARK "$PublishTime$"
+#define TIMELINE_MARK "$SegmentTimeline$"
+
+/*! Location of a segment inside a file, used when segments are addressed by byte range. Offsets and lengths are
+    in bytes, the index is the segment sidx box. */
+
+struct ByteRangeSegment {
+    uint64_t timestamp;
+    uint64_t duration;
+    std::string media;
+    size_t offset;
+    size_t length;
+    size_t indexOffset;
+    size_t indexLength;
+};
 
 class AdaptationSet;
 class VideoAdaptationSet;
@@ -55,7 +74,9 @@ class VideoRepresentation;
 class AudioRepresentation;
 
 /*! It is used to manage the MPD File. Use the different setters to fill values and write the file 
-    to disk in .mpd format using writeToDisk method */ 
+    to disk in .mpd format using writeToDisk method. The MPD is rendered from a template, which is only
+    rebuilt with tinyxml2 when its static content changes: the segment timelines and the publishTime
+    are patched into it at every render. */ 
 
 class MpdManager
 {
@@ -71,10 +92,20 @@ public:
     virtual ~MpdManager();
 
     /**
-    * Write to disk the .mpd file with the current data stored in the class. If the .mpd file already exists, it is overwritted
+    * Write to disk the .mpd file with the current data stored in the class. If the .mpd file already exists, it is
+    * replaced atomically (written to a temporary file and renamed). Nothing is written if the content has not changed
+    * since the last call with the same file name.
     * @param fileName File name (can be an absolute or relative path)
+    * @return true if succeeded and false if not
+    */
+    bool writeToDisk(const char* fileName);
+
+    /**
+    * Renders the .mpd file with the current data stored in the class. The publishTime is only updated when the
+    * content changes, so consecutive renders of the same data are identical.
+    * @return MPD document
     */
-    void writeToDisk(const char* fileName);
+    std::string toString();
     
     //TODO: add documentation
     unsigned int getMaxSeg() {return maxSeg;};
@@ -88,7 +119,8 @@ public:
     * represented in the MPD file by the <AdaptationSet> tag. 
     * @param id Adaptation set Id. Must be unique for each one. <AdaptationSet> tag "id" attribute
     * @param timescale Timescale of the media represented by this adaptation set (in ticks per second). <SegmentTemplate> tag "timescale" attribute
-    * @param segmentTempl Template for the DASH segments. <SegmentTemplate> tag "media" attribute 
+    * @param segmentTempl Template for the DASH segments. <SegmentTemplate> tag "media" attribute. If it is empty, segments
+    * are addressed by byte range in a <SegmentList> of each representation (see updateRepresentationSegment)
     * @param initTempl Template for the DASH init segments. <SegmentTemplate> tag "initialization" attribute
     */
     void updateVideoAdaptationSet(std::string id, int timescale, std::string segmentTempl, std::string initTempl);
@@ -101,7 +133,8 @@ public:
     /**
     * Updates an adaptation set timestamp, represented in the MPD file with the tag <S>, child of <SegmentTimeline>. If the
     * number of Timestamps exceeds maxSeg attribute it replaces the oldest one by the current. If the limit has still not
-    * been reached, it adds the current one to the list.
+    * been reached, it adds the current one to the list. If the last one has the same timestamp (a segment announced before
+    * being complete) only its duration is updated.
     * @param id Adaptation set Id. Must exist.
     * @param ts Timestamp of the current segment in timescale base.
     * @param duration Duration of the current segment in timescale base.
@@ -109,6 +142,27 @@ public:
     */
     uint64_t updateAdaptationSetTimestamp(std::string id, uint64_t ts, unsigned int duration);
 
+    /**
+    * Sets the availability time offset of the segments of an adaptation set, used in low latency mode, where
+    * segments are announced when their first chunk is available. <SegmentTemplate> tag "availabilityTimeOffset"
+    * attribute, together with "availabilityTimeComplete" set to false.
+    * @param id Adaptation set Id. Must exist.
+    * @param offset Offset in seconds, 0 to disable it
+    * @return true if succeeded and false if not
+    */
+    bool setAdaptationSetAvailabilityTimeOffset(std::string id, double offset);
+
+    /**
+    * Adds a segment to the <SegmentList> of a representation, where it is represented by its <S> tag and its
+    * <SegmentURL> tag with "mediaRange" and "indexRange" attributes. Only rendered if the adaptation set has no
+    * segment template. It keeps up to maxSeg segments, as updateAdaptationSetTimestamp does.
+    * @param adSetId Adaptation set Id. Must exist.
+    * @param reprId Representation Id
+    * @param segment Timestamp and duration in timescale base, file name and byte ranges of the segment
+    * @return true if succeeded and false if not
+    */
+    bool updateRepresentationSegment(std::string adSetId, std::string reprId, ByteRangeSegment segment);
+
     /**
     * Updates an existing video representation. If it does not exists, it creates a new one. Each representation is
     * represented in the MPD file by the <Representation> tag, child of <AdaptationSet>. 
@@ -151,6 +205,8 @@ public:
 
 
 private:
+    void toMpd(tinyxml2::XMLDocument& doc, bool timeline);
+    void renderTemplate();
     bool addAdaptationSet(std::string id, AdaptationSet* adaptationSet);
     AdaptationSet* getAdaptationSet(std::string id);
 
@@ -161,7 +217,15 @@ private:
     unsigned int maxSeg;
     unsigned int minBufferTime;
     char availabilityStartTime[AVAILABILITY_START_TIME];
+    char publishTime[AVAILABILITY_START_TIME];
     bool started;
+    bool changed;
+
+    std::vector<std::string> mpdTemplate;
+    std::vector<std::string> markIndents;
+    std::string timelines;
+    std::string writtenFile;
+    std::string written;
     
     std::map<std::string, AdaptationSet*> adaptationSets;
 };
@@ -189,8 +253,18 @@ public:
     * It is a pure virtual method implemented by Video and Audio adaptation sets.
     * @param doc tinyxml2::XMLDocument which represents the whole MPD file
     * @param adaptSet tinyxml2:XMLElement which represents the <AdaptationSet> node.
+    * @param timeline if false, the <SegmentTimeline> node only contains a TIMELINE_MARK comment
+    */
+    virtual void toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*& adaptSet, bool timeline = true) = 0;
+
+    /**
+    * Appends the tags replacing each TIMELINE_MARK of the adaptation set (the <S> tags of the segment timeline and, in
+    * byte range mode, the <SegmentURL> tags of each representation), as they are printed by tinyxml2
+    * @param timeline String where the tags are appended
+    * @param ends End position in timeline of the tags of each mark, one is added for each mark of the adaptation set
+    * @param indents Indentation of the tags of all the marks in the MPD, the ones of this adaptation set start at ends.size()
     */
-    virtual void toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*& adaptSet) = 0;
+    void timelineToString(std::string& timeline, std::vector<size_t>& ends, const std::vector<std::string>& indents);
 
     /**
     * @see MpdManager::updateVideoRepresentation 
@@ -215,6 +289,24 @@ public:
     */
     uint64_t updateTimestamp(uint64_t ts, unsigned int duration, unsigned int maxSeg);
 
+    void setAvailabilityTimeOffset(double offset);
+
+    /**
+    * @see MpdManager::updateRepresentationSegment
+    */
+    void updateSegment(std::string reprId, ByteRangeSegment segment, unsigned int maxSeg);
+
+    /**
+    * @return true if segments are addressed by byte range, when there is no segment template
+    */
+    bool isByteRange() {return segTemplate.empty();};
+
+    /**
+    * @return true if the data rendered in the MPD template has changed since the last setChanged(false)
+    */
+    bool isChanged() {return changed;};
+    void setChanged(bool c) {changed = c;};
+
     /**
     * Sets timescale, segment template and init template values
     * @see MpdManager::removeRepresentation 
@@ -224,6 +316,11 @@ public:
     void flushTimestamps();
     
 protected:
+    virtual std::vector<std::string> getRepresentationIds() = 0;
+    void timelineToMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement* segmentTimeline, bool timeline);
+    void segmentTemplateToMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement* adaptSet, bool timeline);
+    void segmentListToMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement* repr, std::string reprId, bool timeline);
+    void segmentURLsToString(std::string& urls, std::string reprId, const std::string& indent);
 
     bool segmentAlignment;
     int startWithSAP;
@@ -234,6 +331,9 @@ protected:
     std::string segTemplate;
     std::string initTemplate;
     std::deque<std::pair<uint64_t,uint64_t>> timestamps;
+    std::map<std::string, std::deque<ByteRangeSegment>> segments;
+    double availabilityTimeOffset;
+    bool changed;
 };
 
 /*! It is used to encapsulate all the data of a video AdaptationSet. It adds specific video data to the common data
@@ -256,7 +356,7 @@ public:
     /**
     * @see AdaptationSet::toMpd
     */
-    void toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*& adaptSet);
+    void toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*& adaptSet, bool timeline = true);
 
     /**
     * @see AdaptationSet::updateVideoRepresentation
@@ -267,6 +367,7 @@ private:
     VideoRepresentation* getRepresentation(std::string id);
     bool addRepresentation(std::string id, VideoRepresentation* repr);
     bool removeRepresentation(std::string id);
+    std::vector<std::string> getRepresentationIds();
 
     std::map<std::string, VideoRepresentation*> representations;
     int maxWidth;
@@ -294,7 +395,7 @@ public:
     /**
     * @see AdaptationSet::toMpd
     */
-    void toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*& adaptSet);
+    void toMpd(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement*& adaptSet, bool timeline = true);
 
     /**
     * @see AdaptationSet::updateAudioRepresentation
@@ -305,6 +406,7 @@ private:
     AudioRepresentation* getRepresentation(std::string id);
     bool addRepresentation(std::string id, AudioRepresentation* repr);
     bool removeRepresentation(std::string id);
+    std::vector<std::string> getRepresentationIds();
 
     std::map<std::string, AudioRepresentation*> representations;
     std::string lang;
@@ -331,8 +433,9 @@ public:
     /**
     * Sets codec, width, height and bandwidth
     * @see MpdManager::updateVideoRepresentation 
+    * @return true if any value has changed
     */
-    void update(std::string vCodec, int vWidth, int vHeight, int vBandwidth);
+    bool update(std::string vCodec, int vWidth, int vHeight, int vBandwidth);
 
     /**
     * Get codec as a string
@@ -387,8 +490,9 @@ public:
     /**
     * Sets codec, sample rate, bandwdith and channels
     * @see MpdManager::updateAudioRepresentation 
+    * @return true if any value has changed
     */
-    void update(std::string aCodec, int aSampleRate, int aBandwidth, int channels);
+    bool update(std::string aCodec, int aSampleRate, int aBandwidth, int channels);
 
     std::string getCodec() {return codec;};
     int getSampleRate() {return sampleRate;};
@@ -30,10 +30,17 @@ typedef unsigned char byte;
 #define VIDEO_TYPE_AVC 1            //AVC1_VIDEO_TYPE  &   HEV1_VIDEO_TYPE
 #define VIDEO_TYPE_HEVC 2            //AVC1_VIDEO_TYPE  &   HEV1_VIDEO_TYPE
 #define AUDIO_TYPE 3
-#define MAX_MDAT_SAMPLE 65536   //H265 -> 119296
-#define MAX_DAT 10*1024*1024 
+#define MAX_MDAT_SAMPLE 65536   //H265 -> 119296, sample table upper bound
+#define MAX_DAT 10*1024*1024    //segment data upper bound
+#define INIT_MDAT_SAMPLE 64     //initial sample table entries, it grows on demand
+#define INIT_DAT 64*1024        //initial segment data bytes, it grows on demand
+#define SEGMENT_OVERHEAD 1024   //styp, sidx, moof and mdat bytes besides the sample entries
+#define SAMPLE_OVERHEAD 16      //trun entry bytes per sample
+#define INIT_SEGMENT_OVERHEAD 4096  //ftyp and moov bytes besides the codec configuration
+#define AVCC_NAL_LENGTH_SIZE 4  //NAL length prefix bytes of the AVCC samples
 //TODO: error negative values
 #define I2ERROR_MAX 10
+#define I2ERROR_ALLOC 10
 #define I2ERROR_SPS_PPS 9
 #define I2ERROR_IS_INTRA 8
 #define I2ERROR_DURATION_ZERO 7
@@ -61,19 +68,23 @@ typedef struct {
 
 typedef struct {
     uint32_t        box_flags;
-    mdat_sample     mdat[MAX_MDAT_SAMPLE];
+    mdat_sample     *mdat;
     uint32_t        mdat_sample_length;
+    uint32_t        mdat_sample_capacity;
     uint32_t        mdat_total_size;
     uint32_t        moof_pos;
     uint32_t        trun_pos;
+    uint32_t        chunk_count;//fragments of the current segment already generated
 } i2ctx_sample;
 
 //CONTEXT
 typedef struct {
     byte            *pps_sps_data;
     uint32_t        pps_sps_data_length;
-    byte            segment_data[MAX_DAT];
+    byte            *segment_data;
     uint32_t        segment_data_size;
+    uint32_t        segment_data_capacity;
+    uint32_t        pending_data_size;
     uint32_t        time_base;
     uint32_t        sample_duration;
     uint16_t        width;
@@ -89,8 +100,9 @@ typedef struct {
 typedef struct {
     byte            *aac_data;
     uint32_t        aac_data_length;
-    byte            segment_data[MAX_DAT];
+    byte            *segment_data;
     uint32_t        segment_data_size;
+    uint32_t        segment_data_capacity;
     uint32_t        time_base;
     uint32_t        sample_duration;
     uint16_t        channels;
@@ -33,8 +33,17 @@ void video_context_initializer(i2ctx **context, uint32_t media_type);
 
 void video_sample_context_initializer(i2ctx_video **ctxVideo);
 
+uint8_t reserve_data(byte **data, uint32_t *capacity, uint32_t size);
+
+uint8_t reserve_samples(i2ctx_sample *ctxSample, uint32_t samples);
+
 uint8_t is_key_frame(byte *input_data, uint32_t size_input);
 
+uint32_t close_segment(byte *source_data, uint32_t size_source_data, byte *output_data, uint32_t media_type, i2ctx **context);
+
+void add_video_sample_metadata(uint32_t sample_length, uint64_t pts, uint64_t dts, 
+                               uint32_t seqNumber, uint8_t is_intra, i2ctx **context);
+
 void set_segment_duration(uint32_t segment_duration, i2ctx **context)
 {
     (*context)->duration = segment_duration;
@@ -48,8 +57,11 @@ void audio_context_initializer(i2ctx **context) {
     (*context)->ctxaudio = (i2ctx_audio *) malloc(sizeof(i2ctx_audio));
     i2ctx_audio *ctxAudio = (*context)->ctxaudio;
 
+    ctxAudio->aac_data = NULL;
     ctxAudio->aac_data_length = 0;
+    ctxAudio->segment_data = (byte *) malloc(INIT_DAT);
     ctxAudio->segment_data_size = 0;
+    ctxAudio->segment_data_capacity = INIT_DAT;
     ctxAudio->channels = 0;
     ctxAudio->sample_rate = 0;
     ctxAudio->sample_size = 0;
@@ -66,20 +78,29 @@ void audio_sample_context_initializer(i2ctx_audio **ctxAudio) {
     i2ctx_sample *ctxASample = (*ctxAudio)->ctxsample;
 
     ctxASample->box_flags = 769;
+    ctxASample->mdat = (mdat_sample *) malloc(INIT_MDAT_SAMPLE*sizeof(mdat_sample));
     ctxASample->mdat_sample_length = 0;
+    ctxASample->mdat_sample_capacity = INIT_MDAT_SAMPLE;
     ctxASample->mdat_total_size = 0;
     ctxASample->moof_pos = 0;
     ctxASample->trun_pos = 0;
+    ctxASample->chunk_count = 0;
 }
 
 void video_context_initializer(i2ctx **context, uint32_t media_type) {
     (*context)->ctxvideo = (i2ctx_video *) malloc(sizeof(i2ctx_video));
     i2ctx_video *ctxVideo = (*context)->ctxvideo;
 
+    ctxVideo->pps_sps_data = NULL;
     ctxVideo->pps_sps_data_length = 0;
+    ctxVideo->segment_data = (byte *) malloc(INIT_DAT);
     ctxVideo->segment_data_size = 0;
+    ctxVideo->segment_data_capacity = INIT_DAT;
+    ctxVideo->pending_data_size = 0;
     ctxVideo->width = 0;
     ctxVideo->height = 0;
+    ctxVideo->frame_rate = 0;
+    ctxVideo->sample_duration = 0;
     ctxVideo->time_base = 0;
     ctxVideo->earliest_presentation_time = 0;
     ctxVideo->sequence_number = 0;
@@ -94,11 +115,15 @@ void context_refresh(i2ctx **context, uint32_t media_type) {
         (*context)->ctxvideo->earliest_presentation_time = 0;
         (*context)->ctxvideo->sequence_number = 0;
         (*context)->ctxvideo->current_video_duration = 0;
+        // The pending NALs belong to the next segment
+        memmove((*context)->ctxvideo->segment_data, (*context)->ctxvideo->segment_data + (*context)->ctxvideo->segment_data_size,
+                (*context)->ctxvideo->pending_data_size);
         (*context)->ctxvideo->segment_data_size = 0;
         (*context)->ctxvideo->ctxsample->mdat_sample_length = 0;
         (*context)->ctxvideo->ctxsample->mdat_total_size = 0;
         (*context)->ctxvideo->ctxsample->moof_pos = 0;
         (*context)->ctxvideo->ctxsample->trun_pos = 0;
+        (*context)->ctxvideo->ctxsample->chunk_count = 0;
     }
     if (media_type == AUDIO_TYPE) {
         (*context)->ctxaudio->earliest_presentation_time = 0;
@@ -109,6 +134,7 @@ void context_refresh(i2ctx **context, uint32_t media_type) {
         (*context)->ctxaudio->ctxsample->mdat_total_size = 0;
         (*context)->ctxaudio->ctxsample->moof_pos = 0;
         (*context)->ctxaudio->ctxsample->trun_pos = 0;
+        (*context)->ctxaudio->ctxsample->chunk_count = 0;
     }
 }
 
@@ -117,10 +143,151 @@ void video_sample_context_initializer(i2ctx_video **ctxVideo) {
     i2ctx_sample *ctxVSample = (*ctxVideo)->ctxsample;
 
     ctxVSample->box_flags = 3841;
+    ctxVSample->mdat = (mdat_sample *) malloc(INIT_MDAT_SAMPLE*sizeof(mdat_sample));
     ctxVSample->mdat_sample_length = 0;
+    ctxVSample->mdat_sample_capacity = INIT_MDAT_SAMPLE;
     ctxVSample->mdat_total_size = 0;
     ctxVSample->moof_pos = 0;
     ctxVSample->trun_pos = 0;
+    ctxVSample->chunk_count = 0;
+}
+
+uint8_t reserve_data(byte **data, uint32_t *capacity, uint32_t size) {
+    uint32_t new_capacity;
+    byte *new_data;
+
+    if (size <= *capacity) {
+        return I2OK;
+    }
+
+    if (size > MAX_DAT) {
+        return I2ERROR_ALLOC;
+    }
+
+    // Grow geometrically so a segment costs few reallocations, the capacity is kept for the next ones
+    new_capacity = (*capacity) * 2 > size ? (*capacity) * 2 : size;
+    new_capacity = new_capacity > MAX_DAT ? MAX_DAT : new_capacity;
+    new_data = (byte *) realloc(*data, new_capacity);
+
+    if (new_data == NULL) {
+        return I2ERROR_ALLOC;
+    }
+
+    *data = new_data;
+    *capacity = new_capacity;
+    return I2OK;
+}
+
+uint8_t reserve_samples(i2ctx_sample *ctxSample, uint32_t samples) {
+    uint32_t new_capacity;
+    mdat_sample *new_mdat;
+
+    if (samples <= ctxSample->mdat_sample_capacity) {
+        return I2OK;
+    }
+
+    if (samples > MAX_MDAT_SAMPLE) {
+        return I2ERROR_ALLOC;
+    }
+
+    new_capacity = ctxSample->mdat_sample_capacity * 2 > samples ? ctxSample->mdat_sample_capacity * 2 : samples;
+    new_capacity = new_capacity > MAX_MDAT_SAMPLE ? MAX_MDAT_SAMPLE : new_capacity;
+    new_mdat = (mdat_sample *) realloc(ctxSample->mdat, new_capacity * sizeof(mdat_sample));
+
+    if (new_mdat == NULL) {
+        return I2ERROR_ALLOC;
+    }
+
+    ctxSample->mdat = new_mdat;
+    ctxSample->mdat_sample_capacity = new_capacity;
+    return I2OK;
+}
+
+uint8_t reserve_segment_data(i2ctx **context, uint32_t size)
+{
+    if ((*context) == NULL) {
+        return I2ERROR_CONTEXT_NULL;
+    }
+
+    if ((*context)->ctxvideo != NULL) {
+        return reserve_data(&(*context)->ctxvideo->segment_data, &(*context)->ctxvideo->segment_data_capacity, size);
+    }
+
+    if ((*context)->ctxaudio != NULL) {
+        return reserve_data(&(*context)->ctxaudio->segment_data, &(*context)->ctxaudio->segment_data_capacity, size);
+    }
+
+    return I2ERROR_CONTEXT_NULL;
+}
+
+uint32_t get_segment_max_size(i2ctx *context)
+{
+    if (context == NULL) {
+        return 0;
+    }
+
+    if (context->ctxvideo != NULL) {
+        return context->ctxvideo->segment_data_size + SEGMENT_OVERHEAD +
+               context->ctxvideo->ctxsample->mdat_sample_length * SAMPLE_OVERHEAD;
+    }
+
+    if (context->ctxaudio != NULL) {
+        return context->ctxaudio->segment_data_size + SEGMENT_OVERHEAD +
+               context->ctxaudio->ctxsample->mdat_sample_length * SAMPLE_OVERHEAD;
+    }
+
+    return 0;
+}
+
+uint32_t get_context_memory(i2ctx *context)
+{
+    uint32_t size;
+
+    if (context == NULL) {
+        return 0;
+    }
+
+    size = sizeof(i2ctx);
+
+    if (context->ctxvideo != NULL) {
+        size += sizeof(i2ctx_video) + sizeof(i2ctx_sample) + context->ctxvideo->pps_sps_data_length;
+        size += context->ctxvideo->segment_data_capacity;
+        size += context->ctxvideo->ctxsample->mdat_sample_capacity * sizeof(mdat_sample);
+    }
+
+    if (context->ctxaudio != NULL) {
+        size += sizeof(i2ctx_audio) + sizeof(i2ctx_sample) + context->ctxaudio->aac_data_length;
+        size += context->ctxaudio->segment_data_capacity;
+        size += context->ctxaudio->ctxsample->mdat_sample_capacity * sizeof(mdat_sample);
+    }
+
+    return size;
+}
+
+void free_context(i2ctx **context)
+{
+    if ((*context) == NULL) {
+        return;
+    }
+
+    if ((*context)->ctxvideo != NULL) {
+        free((*context)->ctxvideo->ctxsample->mdat);
+        free((*context)->ctxvideo->ctxsample);
+        free((*context)->ctxvideo->segment_data);
+        free((*context)->ctxvideo->pps_sps_data);
+        free((*context)->ctxvideo);
+    }
+
+    if ((*context)->ctxaudio != NULL) {
+        free((*context)->ctxaudio->ctxsample->mdat);
+        free((*context)->ctxaudio->ctxsample);
+        free((*context)->ctxaudio->segment_data);
+        free((*context)->ctxaudio->aac_data);
+        free((*context)->ctxaudio);
+    }
+
+    free(*context);
+    (*context) = NULL;
 }
 
 uint8_t generate_context(i2ctx **context, uint32_t media_type) 
@@ -132,6 +299,9 @@ uint8_t generate_context(i2ctx **context, uint32_t media_type)
 
     *context = (i2ctx *) malloc(sizeof(i2ctx));
     (*context)->reference_size = 0;
+    (*context)->duration = 0;
+    (*context)->threshold = 0;
+    (*context)->audio_segment_flag = 0;
 
     if ((media_type == VIDEO_TYPE_AVC) || (media_type == VIDEO_TYPE_HEVC)) {
         video_context_initializer(context, media_type);
@@ -333,9 +503,9 @@ uint32_t generate_video_segment(uint8_t nextFrameIsIntra, uint32_t nextFramePts,
         (*context)->ctxvideo->ctxsample->mdat[sampleIdx].duration = lastSampleDuration;
         (*context)->ctxvideo->current_video_duration += lastSampleDuration;
 
-        segDataLength = segmentGenerator((*context)->ctxvideo->segment_data, 
-                                         (*context)->ctxvideo->segment_data_size, output_data, 
-                                         (*context)->ctxvideo->video_type, context);
+        segDataLength = close_segment((*context)->ctxvideo->segment_data, 
+                                      (*context)->ctxvideo->segment_data_size, output_data, 
+                                      (*context)->ctxvideo->video_type, context);
 
         if (segDataLength <= I2ERROR_MAX) {
             return segDataLength;
@@ -365,7 +535,7 @@ uint32_t generate_audio_segment(byte *output_data, i2ctx **context, uint64_t* se
 
     if ((*context)->duration <= (*context)->ctxaudio->current_audio_duration) { 
 
-        segDataLength = segmentGenerator((*context)->ctxaudio->segment_data, (*context)->ctxaudio->segment_data_size, output_data, AUDIO_TYPE, context);
+        segDataLength = close_segment((*context)->ctxaudio->segment_data, (*context)->ctxaudio->segment_data_size, output_data, AUDIO_TYPE, context);
 
         if (segDataLength <= I2ERROR_MAX) {
             return segDataLength;
@@ -393,7 +563,7 @@ uint32_t force_generate_audio_segment(byte *output_data, i2ctx **context, uint64
         return I2ERROR_DESTINATION_NULL;
     }
 
-    segDataLength = segmentGenerator((*context)->ctxaudio->segment_data, (*context)->ctxaudio->segment_data_size, output_data, AUDIO_TYPE, context);
+    segDataLength = close_segment((*context)->ctxaudio->segment_data, (*context)->ctxaudio->segment_data_size, output_data, AUDIO_TYPE, context);
 
     if (segDataLength <= I2ERROR_MAX) {
         return segDataLength;
@@ -406,12 +576,96 @@ uint32_t force_generate_audio_segment(byte *output_data, i2ctx **context, uint64
     return segDataLength;
 }
 
+uint32_t close_segment(byte *source_data, uint32_t size_source_data, byte *output_data, uint32_t media_type, i2ctx **context)
+{
+    i2ctx_sample *ctxSample;
+
+    if (media_type == AUDIO_TYPE) {
+        ctxSample = (*context)->ctxaudio->ctxsample;
+    } else {
+        ctxSample = (*context)->ctxvideo->ctxsample;
+    }
+
+    // A chunked segment is closed with the fragment of its last samples
+    if (ctxSample->chunk_count > 0) {
+        return chunkGenerator(source_data, size_source_data, output_data, media_type, FALSE, context);
+    }
+
+    return segmentGenerator(source_data, size_source_data, output_data, media_type, context);
+}
+
+uint32_t generate_chunk(uint32_t chunk_samples, uint32_t media_type, byte *output_data, i2ctx **context, uint64_t* segmentTimestamp)
+{
+    i2ctx_sample *ctxSample;
+    byte *segment_data;
+    uint32_t *segment_data_size;
+    uint32_t *sequence_number;
+    uint32_t pending_data_size;
+    uint32_t samples, pending_samples, chunk_data_size, chunk_length, i;
+
+    if ((*context) == NULL) {
+        return I2ERROR_CONTEXT_NULL;
+    }
+
+    if (output_data == NULL) {
+        return I2ERROR_DESTINATION_NULL;
+    }
+
+    if ((media_type == VIDEO_TYPE_AVC) || (media_type == VIDEO_TYPE_HEVC)) {
+        ctxSample = (*context)->ctxvideo->ctxsample;
+        segment_data = (*context)->ctxvideo->segment_data;
+        segment_data_size = &(*context)->ctxvideo->segment_data_size;
+        sequence_number = &(*context)->ctxvideo->sequence_number;
+        pending_data_size = (*context)->ctxvideo->pending_data_size;
+        *segmentTimestamp = (*context)->ctxvideo->earliest_presentation_time;
+    } else if (media_type == AUDIO_TYPE) {
+        ctxSample = (*context)->ctxaudio->ctxsample;
+        segment_data = (*context)->ctxaudio->segment_data;
+        segment_data_size = &(*context)->ctxaudio->segment_data_size;
+        sequence_number = &(*context)->ctxaudio->sequence_number;
+        pending_data_size = 0;
+        *segmentTimestamp = (*context)->ctxaudio->earliest_presentation_time;
+    } else {
+        return I2ERROR_MEDIA_TYPE;
+    }
+
+    // The last sample is kept, so the segment is always closed with a fragment (and the video sample duration is not known yet)
+    if (ctxSample->mdat_sample_length <= chunk_samples || chunk_samples < 1) {
+        return 0;
+    }
+
+    samples = ctxSample->mdat_sample_length - 1;
+    pending_samples = ctxSample->mdat_sample_length;
+    chunk_data_size = 0;
+
+    for (i = 0; i < samples; i++) {
+        chunk_data_size += ctxSample->mdat[i].size;
+    }
+
+    ctxSample->mdat_sample_length = samples;
+    chunk_length = chunkGenerator(segment_data, chunk_data_size, output_data, media_type, ctxSample->chunk_count == 0, context);
+    ctxSample->mdat_sample_length = pending_samples;
+
+    if (chunk_length <= I2ERROR_MAX) {
+        return chunk_length;
+    }
+
+    // Only the kept sample (and the pending NALs) remains in the context
+    memmove(segment_data, segment_data + chunk_data_size, *segment_data_size - chunk_data_size + pending_data_size);
+    *segment_data_size -= chunk_data_size;
+    memmove(ctxSample->mdat, ctxSample->mdat + samples, (pending_samples - samples) * sizeof(mdat_sample));
+    ctxSample->mdat_sample_length = pending_samples - samples;
+    ctxSample->moof_pos = 0;
+    ctxSample->trun_pos = 0;
+    ctxSample->chunk_count++;
+    (*sequence_number)++;
+
+    return chunk_length;
+}
+
 uint32_t add_video_sample(byte *input_data, uint32_t input_data_length, uint64_t pts, 
                            uint64_t dts, uint32_t seqNumber, uint8_t is_intra, i2ctx **context)
 {
-    uint32_t samp_len;
-    uint32_t sample_duration;
-
     if ((*context) == NULL) {
         return I2ERROR_CONTEXT_NULL;
     }
@@ -435,13 +689,117 @@ uint32_t add_video_sample(byte *input_data, uint32_t input_data_length, uint64_t
         return I2ERROR_IS_INTRA;
     }
 
+    if (reserve_data(&(*context)->ctxvideo->segment_data, &(*context)->ctxvideo->segment_data_capacity,
+                     (*context)->ctxvideo->segment_data_size + input_data_length) != I2OK ||
+        reserve_samples(ctxSample, ctxSample->mdat_sample_length + 1) != I2OK) {
+        return I2ERROR_ALLOC;
+    }
+
     // Add segment data
     memcpy((*context)->ctxvideo->segment_data + (*context)->ctxvideo->segment_data_size, input_data, input_data_length);
     (*context)->ctxvideo->segment_data_size += input_data_length;
 
-    // Add metadata
+    add_video_sample_metadata(input_data_length, pts, dts, seqNumber, is_intra, context);
+
+    return I2OK;
+}
+
+uint32_t append_video_nal(byte *nal_data, uint32_t nal_data_length, i2ctx **context)
+{
+    i2ctx_video *ctxVideo;
+    byte *dst;
+
+    if ((*context) == NULL || (*context)->ctxvideo == NULL) {
+        return I2ERROR_CONTEXT_NULL;
+    }
+
+    if (nal_data == NULL) {
+        return I2ERROR_SOURCE_NULL;
+    }
+
+    if (nal_data_length < 1) {
+        return I2ERROR_SIZE_ZERO;
+    }
+
+    ctxVideo = (*context)->ctxvideo;
+
+    if (reserve_data(&ctxVideo->segment_data, &ctxVideo->segment_data_capacity, ctxVideo->segment_data_size +
+                     ctxVideo->pending_data_size + AVCC_NAL_LENGTH_SIZE + nal_data_length) != I2OK) {
+        return I2ERROR_ALLOC;
+    }
+
+    // The Annex-B NAL is copied once, behind its AVCC length prefix, right where the mdat is assembled
+    dst = ctxVideo->segment_data + ctxVideo->segment_data_size + ctxVideo->pending_data_size;
+    dst[0] = (nal_data_length >> 24) & 0xFF;
+    dst[1] = (nal_data_length >> 16) & 0xFF;
+    dst[2] = (nal_data_length >> 8) & 0xFF;
+    dst[3] = nal_data_length & 0xFF;
+    memcpy(dst + AVCC_NAL_LENGTH_SIZE, nal_data, nal_data_length);
+    ctxVideo->pending_data_size += AVCC_NAL_LENGTH_SIZE + nal_data_length;
+
+    return I2OK;
+}
+
+uint32_t add_pending_video_sample(uint32_t sample_length, uint64_t pts, uint64_t dts, 
+                                   uint32_t seqNumber, uint8_t is_intra, i2ctx **context)
+{
+    i2ctx_sample *ctxSample;
+
+    if ((*context) == NULL || (*context)->ctxvideo == NULL) {
+        return I2ERROR_CONTEXT_NULL;
+    }
+
+    if (sample_length < 1 || sample_length > (*context)->ctxvideo->pending_data_size) {
+        return I2ERROR_SIZE_ZERO;
+    }
+
+    ctxSample = (*context)->ctxvideo->ctxsample;
+
+    if (((is_intra != TRUE) && (is_intra != FALSE)) || (ctxSample->mdat_sample_length == 0 && is_intra != TRUE)) {
+        discard_pending_video_sample(sample_length, context);
+        return I2ERROR_IS_INTRA;
+    }
+
+    if (reserve_samples(ctxSample, ctxSample->mdat_sample_length + 1) != I2OK) {
+        discard_pending_video_sample(sample_length, context);
+        return I2ERROR_ALLOC;
+    }
+
+    // The sample data is already in place, it only moves from the pending to the segment data
+    (*context)->ctxvideo->segment_data_size += sample_length;
+    (*context)->ctxvideo->pending_data_size -= sample_length;
+
+    add_video_sample_metadata(sample_length, pts, dts, seqNumber, is_intra, context);
+
+    return I2OK;
+}
+
+void discard_pending_video_sample(uint32_t sample_length, i2ctx **context)
+{
+    i2ctx_video *ctxVideo;
+    byte *pending;
+
+    if ((*context) == NULL || (*context)->ctxvideo == NULL) {
+        return;
+    }
+
+    ctxVideo = (*context)->ctxvideo;
+    sample_length = sample_length > ctxVideo->pending_data_size ? ctxVideo->pending_data_size : sample_length;
+    pending = ctxVideo->segment_data + ctxVideo->segment_data_size;
+
+    memmove(pending, pending + sample_length, ctxVideo->pending_data_size - sample_length);
+    ctxVideo->pending_data_size -= sample_length;
+}
+
+void add_video_sample_metadata(uint32_t sample_length, uint64_t pts, uint64_t dts, 
+                               uint32_t seqNumber, uint8_t is_intra, i2ctx **context)
+{
+    uint32_t samp_len;
+    uint32_t sample_duration;
+    i2ctx_sample *ctxSample = (*context)->ctxvideo->ctxsample;
+
     samp_len = ctxSample->mdat_sample_length;
-    ctxSample->mdat[samp_len].size = input_data_length;
+    ctxSample->mdat[samp_len].size = sample_length;
     ctxSample->mdat[samp_len].presentation_timestamp = pts;
     ctxSample->mdat[samp_len].decode_timestamp = dts;
     ctxSample->mdat[samp_len].key = is_intra;
@@ -457,8 +815,6 @@ uint32_t add_video_sample(byte *input_data, uint32_t input_data_length, uint64_t
     }
 
     ctxSample->mdat_sample_length++;
-
-    return I2OK;
 }
 
 uint32_t add_audio_sample(byte *input_data, uint32_t input_data_length, uint32_t sample_duration, 
@@ -482,6 +838,12 @@ uint32_t add_audio_sample(byte *input_data, uint32_t input_data_length, uint32_t
     // Add sample or Init new segmentation
     i2ctx_sample *ctxSample = (*context)->ctxaudio->ctxsample;
     
+    if (reserve_data(&(*context)->ctxaudio->segment_data, &(*context)->ctxaudio->segment_data_capacity,
+                     (*context)->ctxaudio->segment_data_size + input_data_length) != I2OK ||
+        reserve_samples(ctxSample, ctxSample->mdat_sample_length + 1) != I2OK) {
+        return I2ERROR_ALLOC;
+    }
+
     // Add segment data
     memcpy((*context)->ctxaudio->segment_data + (*context)->ctxaudio->segment_data_size, input_data, input_data_length);
     (*context)->ctxaudio->segment_data_size += input_data_length;
@@ -522,13 +884,13 @@ uint32_t finish_segment(uint32_t media_type, byte *output_data, i2ctx **context)
     if ((media_type == VIDEO_TYPE_AVC) || (media_type == VIDEO_TYPE_HEVC)) {
         seg_gen = I2OK;
         
-        seg_gen = segmentGenerator((*context)->ctxvideo->segment_data, (*context)->ctxvideo->segment_data_size, output_data, media_type, context);
+        seg_gen = close_segment((*context)->ctxvideo->segment_data, (*context)->ctxvideo->segment_data_size, output_data, media_type, context);
         if ((seg_gen == I2OK) || (seg_gen > I2ERROR_MAX))
             context_refresh(context, media_type);
     } else if(media_type == AUDIO_TYPE) {
         seg_gen = I2OK;
         
-        seg_gen = segmentGenerator((*context)->ctxaudio->segment_data, (*context)->ctxaudio->segment_data_size, output_data, AUDIO_TYPE, context);
+        seg_gen = close_segment((*context)->ctxaudio->segment_data, (*context)->ctxaudio->segment_data_size, output_data, AUDIO_TYPE, context);
         if ((seg_gen == I2OK) || (seg_gen > I2ERROR_MAX))
             context_refresh(context, AUDIO_TYPE);
     }
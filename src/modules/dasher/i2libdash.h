@@ -66,14 +66,41 @@ uint32_t generate_audio_segment(byte *output_data, i2ctx **context, uint64_t* se
 
 uint32_t force_generate_audio_segment(byte *output_data, i2ctx **context, uint64_t* segmentTimestamp, uint32_t* segmentDuration);
 
+// Adds an AVCC sample, copying it after the segment data. It must not be mixed with pending NALs.
 uint32_t add_video_sample(byte *input_data, uint32_t input_data_length, uint64_t pts, 
                            uint64_t dts, uint32_t seqNumber, uint8_t is_intra, i2ctx **context);
 
+// Appends an Annex-B NAL (without start code) to the pending data, behind its AVCC length prefix. Pending data is kept
+// after the segment data, so samples are assembled in place and survive the segment generation.
+uint32_t append_video_nal(byte *nal_data, uint32_t nal_data_length, i2ctx **context);
+
+// Adds the first sample_length pending bytes to the segment as a sample. On error these bytes are discarded.
+uint32_t add_pending_video_sample(uint32_t sample_length, uint64_t pts, uint64_t dts, 
+                                   uint32_t seqNumber, uint8_t is_intra, i2ctx **context);
+
+// Discards the first sample_length pending bytes
+void discard_pending_video_sample(uint32_t sample_length, i2ctx **context);
+
 uint32_t add_audio_sample(byte *input_data, uint32_t input_data_length, uint32_t sample_duration, 
                           uint64_t pts, uint64_t dts, uint32_t seqNumber, i2ctx **context);
 
+// Generates a fragment (moof and mdat) of the current segment with all the samples but the last one, if there are more than
+// chunk_samples. The first one starts with the styp, the segment is closed by the segment generation functions as usual.
+uint32_t generate_chunk(uint32_t chunk_samples, uint32_t media_type, byte *output_data, i2ctx **context, uint64_t* segmentTimestamp);
+
 void context_refresh(i2ctx **context, uint32_t media_type);
 
+// Grows the segment data buffer to at least size bytes, so it is not reallocated while the segment is filled
+uint8_t reserve_segment_data(i2ctx **context, uint32_t size);
+
+// Upper bound of the output buffer size required to generate a segment with the current samples
+uint32_t get_segment_max_size(i2ctx *context);
+
+// Bytes allocated by the context
+uint32_t get_context_memory(i2ctx *context);
+
+void free_context(i2ctx **context);
+
 
 #endif
 
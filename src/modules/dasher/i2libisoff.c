@@ -151,6 +151,7 @@ uint32_t initVideoGenerator(byte *source_data, uint32_t size_source_data, byte *
         return I2ERROR_MEDIA_TYPE;
     }
     count = 0;
+    free((*context)->ctxvideo->pps_sps_data);
     (*context)->ctxvideo->pps_sps_data = (byte*) malloc (size_source_data);
     memcpy((*context)->ctxvideo->pps_sps_data, source_data, size_source_data);
     (*context)->ctxvideo->pps_sps_data_length = size_source_data;
@@ -187,6 +188,7 @@ uint32_t initAudioGenerator(byte *source_data, uint32_t size_source_data, byte *
     }
 
     count = 0;
+    free((*context)->ctxaudio->aac_data);
     (*context)->ctxaudio->aac_data = (byte*) malloc(size_source_data);
     memcpy((*context)->ctxaudio->aac_data, source_data, size_source_data);
     (*context)->ctxaudio->aac_data_length = size_source_data;
@@ -263,6 +265,61 @@ uint32_t segmentGenerator(byte *source_data, uint32_t size_source_data, byte *de
     return count;
 }
 
+uint32_t chunkGenerator(byte *source_data, uint32_t size_source_data, byte *destination_data, uint32_t media_type, uint8_t first_chunk, i2ctx **context) {
+    uint32_t count, size_styp, size_moof, size_mdat;
+    i2ctx_sample *ctxSample;
+
+    if ((*context) == NULL) {
+        return I2ERROR_CONTEXT_NULL;
+    }
+    if (destination_data == NULL) {
+        return I2ERROR_DESTINATION_NULL;
+    }
+    if (source_data == NULL) {
+        return I2ERROR_SOURCE_NULL;
+    }   
+    if (size_source_data < 1) {
+        return I2ERROR_SIZE_ZERO;
+    }
+
+    if ((media_type == VIDEO_TYPE_AVC) || (media_type == VIDEO_TYPE_HEVC)) {
+        ctxSample = (*context)->ctxvideo->ctxsample;
+    } else if (media_type == AUDIO_TYPE) {
+        ctxSample = (*context)->ctxaudio->ctxsample;
+    } else {
+        return I2ERROR_MEDIA_TYPE;
+    }
+
+    count = 0;
+
+    // Only the first fragment of the segment carries the styp, there is no sidx because the segment size is not known yet
+    if (first_chunk) {
+        size_styp = write_styp(destination_data + count, media_type, (*context));
+
+        if (size_styp < 8)
+            return I2ERROR_ISOFF;
+
+        count+= size_styp;
+    }
+
+    // Offsets are relative to this fragment, trun data offset is relative to its moof
+    ctxSample->moof_pos = count;
+    ctxSample->trun_pos = count;
+
+    size_moof = write_moof(destination_data + count, media_type, context);
+    if (size_moof < 8)
+        return I2ERROR_ISOFF;
+
+    count+= size_moof;
+    size_mdat = write_mdat(source_data, size_source_data, destination_data + count, media_type, (*context));
+
+    if (size_mdat < 8)
+        return I2ERROR_ISOFF;
+
+    count+= size_mdat;
+    return count;
+}
+
 uint32_t write_ftyp(byte *data, uint32_t media_type, i2ctx *context) {
     uint32_t count, size, hton_size, version, hton_version;
     
@@ -1857,11 +1914,12 @@ uint32_t write_tfdt(byte *data, uint32_t media_type, i2ctx *context) {
     i2ctx_audio *ctxAudio = context->ctxaudio;
     earliest_presentation_time = 0;
 
+    // First sample of the fragment, which is the segment earliest presentation time unless the segment is chunked
     if ((media_type == VIDEO_TYPE_AVC) || (media_type == VIDEO_TYPE_HEVC)) {
-        earliest_presentation_time = ctxVideo->earliest_presentation_time;
+        earliest_presentation_time = ctxVideo->ctxsample->mdat[0].presentation_timestamp;
     }
     else if (media_type == AUDIO_TYPE) {
-        earliest_presentation_time = ctxAudio->earliest_presentation_time;
+        earliest_presentation_time = ctxAudio->ctxsample->mdat[0].presentation_timestamp;
     }
 
     count = 0;
@@ -38,4 +38,7 @@ uint32_t initAudioGenerator(byte *source_data, uint32_t size_source_data, byte *
 
 uint32_t segmentGenerator(byte *source_data, uint32_t size_source_data, byte *destination_data, uint32_t media_type, i2ctx **context);
 
+// Writes a moof and mdat pair with the current samples, preceded by the styp if it is the first fragment of the segment
+uint32_t chunkGenerator(byte *source_data, uint32_t size_source_data, byte *destination_data, uint32_t media_type, uint8_t first_chunk, i2ctx **context);
+
 #endif
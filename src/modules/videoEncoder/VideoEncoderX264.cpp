@@ -27,12 +27,19 @@
 
 #define MAX_PLANES_PER_PICTURE 4
 
+#define H264_NAL_SLICE 1
+#define H264_NAL_SLICE_IDR 5
+
 VideoEncoderX264::VideoEncoderX264() :
-VideoEncoderX264or5(), encoder(NULL)
+VideoEncoderX264or5(), encoder(NULL), lowLatency(false), openedLowLatency(false),
+    outputQueue(NULL), nalBufferIdx(0), nextFirstMb(0), earlySlices(0), encWidth(0),
+    encHeight(0), pooledOpens(0), coldOpens(0), headerOpens(0)
 {
+    nalBuffers.resize(LOW_LATENCY_NAL_BUFFERS);
     outputStreamInfo->video.codec = H264;
     x264_picture_init(&picIn);
     x264_picture_init(&picOut);
+    initializeEventMap();
 }
 
 VideoEncoderX264::~VideoEncoderX264()
@@ -75,6 +82,15 @@ bool VideoEncoderX264::encodeFrame(VideoFrame* codedFrame)
     }
 
     picIn.i_pts = inPts;
+
+    if (openedLowLatency) {
+        std::lock_guard<std::mutex> guard(nalMtx);
+        nalBufferIdx = 0;
+        nextFirstMb = 0;
+        pendingSlices.clear();
+        picIn.opaque = this;
+    }
+
     success = x264_encoder_encode(encoder, &nals, &piNal, &picIn, &picOut);
 
     if (success < 0) {
@@ -91,6 +107,17 @@ bool VideoEncoderX264::encodeFrame(VideoFrame* codedFrame)
     outPts = picOut.i_pts;
     dts = picOut.i_dts;
 
+    if (openedLowLatency) {
+        //NOTE: NALs have already been pushed to the queue by naluProcess,
+        //      just make sure that no slice is left behind
+        std::lock_guard<std::mutex> guard(nalMtx);
+        for (auto it : pendingSlices) {
+            pushNal(&it.second);
+        }
+        pendingSlices.clear();
+        return true;
+    }
+
     for (int i = 0; i < piNal; i++) {
 
         if (!slicedFrame->setSlice(nals[i].p_payload, nals[i].i_payload)) {
@@ -107,30 +134,391 @@ bool VideoEncoderX264::encodeHeadersFrame()
     int encodeSize;
     int piNal;
     x264_nal_t* nals;
+    std::vector<unsigned char> headers;
+
+    if (!openedLowLatency) {
+        encodeSize = x264_encoder_headers(encoder, &nals, &piNal);
+
+        if (encodeSize < 0) {
+            utils::errorMsg("Could not encode headers");
+            return false;
+        }
+
+        outputStreamInfo->setExtraData(nals[0].p_payload, encodeSize);
+        return true;
+    }
+
+    //NOTE: nalu_process would be called without an input picture, so low latency headers come
+    //      from an equivalent encoder without the callback. They only depend on the settings that
+    //      need a new encoder, so they are obtained once per open key (or by prepare)
+    if (!X264EncoderPool::getInstance()->getHeaders(openedKey, headers)) {
+        if (!cacheHeaders(&xparams, openedKey) ||
+            !X264EncoderPool::getInstance()->getHeaders(openedKey, headers)) {
+            return false;
+        }
+    }
+
+    outputStreamInfo->setExtraData(headers.data(), headers.size());
+    return true;
+}
+
+bool VideoEncoderX264::cacheHeaders(x264_param_t* params, std::string key)
+{
+    int encodeSize;
+    int piNal;
+    x264_nal_t* nals;
+    x264_t* headersEncoder;
+    x264_param_t headersParams;
+
+    headersParams = *params;
+    headersParams.nalu_process = NULL;
+    headersEncoder = x264_encoder_open(&headersParams);
+
+    if (!headersEncoder) {
+        utils::errorMsg("Could not open x264 encoder to encode headers");
+        return false;
+    }
+
+    headerOpens++;
+    encodeSize = x264_encoder_headers(headersEncoder, &nals, &piNal);
 
-    encodeSize = x264_encoder_headers(encoder, &nals, &piNal);
+    if (encodeSize >= 0) {
+        X264EncoderPool::getInstance()->setHeaders(key, nals[0].p_payload, encodeSize);
+    }
+
+    x264_encoder_close(headersEncoder);
 
     if (encodeSize < 0) {
         utils::errorMsg("Could not encode headers");
         return false;
     }
-       
-    outputStreamInfo->setExtraData(nals[0].p_payload, encodeSize);
 
     return true;
 }
 
+void VideoEncoderX264::setSpeedParams(x264_param_t* params, int level)
+{
+    //NOTE: only analysis settings accepted by x264_encoder_reconfig are stepped,
+    //      from ultrafast-like (0) to medium-like (SPEED_LEVELS - 1) behaviour
+    static const int meMethod[SPEED_LEVELS] = {X264_ME_DIA, X264_ME_DIA, X264_ME_HEX, X264_ME_HEX, X264_ME_HEX, X264_ME_UMH};
+    static const int subme[SPEED_LEVELS] = {0, 1, 2, 4, 6, 7};
+    static const int trellis[SPEED_LEVELS] = {0, 0, 0, 0, 1, 1};
+    static const bool mixedRefs[SPEED_LEVELS] = {false, false, false, true, true, true};
+
+    params->analyse.i_me_method = meMethod[level];
+    params->analyse.i_subpel_refine = subme[level];
+    params->analyse.i_trellis = trellis[level];
+    params->analyse.b_mixed_references = mixedRefs[level];
+    params->analyse.inter = level == 0 ? 0 : 
+        X264_ANALYSE_I4x4 | X264_ANALYSE_I8x8 | X264_ANALYSE_PSUB16x16 | X264_ANALYSE_BSUB16x16;
+}
+
+bool VideoEncoderX264::applySpeedLevel(int level)
+{
+    if (!encoder || level < 0 || level >= SPEED_LEVELS) {
+        return false;
+    }
+
+    setSpeedParams(&xparams, level);
+
+    if (x264_encoder_reconfig(encoder, &xparams) < 0) {
+        utils::errorMsg("Could not apply x264 speed level " + std::to_string(level));
+        return false;
+    }
+
+    return true;
+}
+
+void VideoEncoderX264::naluProcess(x264_t *h, x264_nal_t *nal, void *opaque)
+{
+    VideoEncoderX264* enc = static_cast<VideoEncoderX264*>(opaque);
+
+    if (enc) {
+        enc->publishNal(h, nal);
+    }
+}
+
+void VideoEncoderX264::publishNal(x264_t *h, x264_nal_t *nal)
+{
+    std::vector<unsigned char>* buffer;
+
+    //NOTE: slice threads encode their NALs concurrently, each one in its own buffer. Buffers
+    //      are added when needed, a deque does not move the ones that are being written
+    {
+        std::lock_guard<std::mutex> guard(nalMtx);
+
+        if (nalBufferIdx >= nalBuffers.size()) {
+            nalBuffers.emplace_back();
+            utils::debugMsg("X264 Encoder: " + std::to_string(nalBuffers.size()) + " low latency NAL buffers");
+        }
+
+        buffer = &nalBuffers[nalBufferIdx++];
+    }
+
+    //NOTE: x264 requires at least this size for x264_nal_encode output
+    buffer->resize(nal->i_payload*3/2 + 5 + 64);
+    x264_nal_encode(h, buffer->data(), nal);
+
+    std::lock_guard<std::mutex> guard(nalMtx);
+
+    if (nal->i_type != H264_NAL_SLICE && nal->i_type != H264_NAL_SLICE_IDR) {
+        pushNal(nal);
+        return;
+    }
+
+    //NOTE: slice threads may finish out of order, slices are pushed by first macroblock
+    if (nal->i_first_mb != nextFirstMb) {
+        pendingSlices[nal->i_first_mb] = *nal;
+        return;
+    }
+
+    pushNal(nal);
+    earlySlices++;
+
+    while (!pendingSlices.empty() && pendingSlices.begin()->first == nextFirstMb) {
+        pushNal(&pendingSlices.begin()->second);
+        earlySlices++;
+        pendingSlices.erase(pendingSlices.begin());
+    }
+}
+
+void VideoEncoderX264::pushNal(x264_nal_t *nal)
+{
+    if (nal->i_type == H264_NAL_SLICE || nal->i_type == H264_NAL_SLICE_IDR) {
+        nextFirstMb = nal->i_last_mb + 1;
+    }
+
+    if (!outputQueue || !outputQueue->pushBackSlice(nal->p_payload, nal->i_payload)) {
+        utils::warningMsg("X264 Encoder: low latency NAL could not be pushed");
+    }
+}
+
 FrameQueue* VideoEncoderX264::allocQueue(ConnectionData cData)
 {
-    return SlicedVideoFrameQueue::createNew(cData, outputStreamInfo, DEFAULT_VIDEO_FRAMES, MAX_H264_OR_5_NAL_SIZE);
+    outputQueue = SlicedVideoFrameQueue::createNew(cData, outputStreamInfo, DEFAULT_VIDEO_FRAMES, MAX_H264_OR_5_NAL_SIZE);
+    return outputQueue;
+}
+
+bool VideoEncoderX264::specificWriterDelete(int /*writerID*/)
+{
+    outputQueue = NULL;
+    return true;
+}
+
+bool VideoEncoderX264::setLowLatency(bool enable)
+{
+    Jzon::Object root, params;
+    root.Add("action", "lowLatency");
+    params.Add("enable", enable);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
+
+bool VideoEncoderX264::lowLatencyEvent(Jzon::Node* params)
+{
+    if (!params || !params->Has("enable") || !params->Get("enable").IsBool()) {
+        return false;
+    }
+
+    lowLatency = params->Get("enable").ToBool();
+    needsConfig = true;
+    return true;
+}
+
+void VideoEncoderX264::initializeEventMap()
+{
+    eventMap["lowLatency"] = std::bind(&VideoEncoderX264::lowLatencyEvent, this, std::placeholders::_1);
+    eventMap["prepare"] = std::bind(&VideoEncoderX264::prepareEvent, this, std::placeholders::_1);
+}
+
+void VideoEncoderX264::doGetState(Jzon::Object &filterNode)
+{
+    VideoEncoderX264or5::doGetState(filterNode);
+    filterNode.Add("lowLatency", lowLatency);
+    filterNode.Add("earlySlices", (int) earlySlices);
+    filterNode.Add("pooledOpens", (int) pooledOpens);
+    filterNode.Add("coldOpens", (int) coldOpens);
+    filterNode.Add("headerOpens", (int) headerOpens);
+}
+
+bool VideoEncoderX264::prepare(int width, int height, PixType pixelFormat, int count)
+{
+    Jzon::Object root, params;
+    root.Add("action", "prepare");
+    params.Add("width", width);
+    params.Add("height", height);
+    params.Add("pixelFormat", (int) pixelFormat);
+    params.Add("count", count);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
+
+bool VideoEncoderX264::prepareEvent(Jzon::Node* params)
+{
+    PixType pixelFormat = YUV420P;
+    int count = 1;
+
+    if (!params || !params->Has("width") || !params->Has("height") ||
+        !params->Get("width").IsNumber() || !params->Get("height").IsNumber()) {
+        return false;
+    }
+
+    if (params->Has("pixelFormat") && params->Get("pixelFormat").IsNumber()) {
+        pixelFormat = (PixType) params->Get("pixelFormat").ToInt();
+    }
+
+    if (params->Has("count") && params->Get("count").IsNumber()) {
+        count = params->Get("count").ToInt();
+    }
+
+    if (count <= 0) {
+        return false;
+    }
+
+    return prepare0(params->Get("width").ToInt(), params->Get("height").ToInt(), pixelFormat, count);
+}
+
+bool VideoEncoderX264::prepare0(int width, int height, PixType pixelFormat, unsigned count)
+{
+    x264_param_t params;
+    int colorspace;
+    std::vector<unsigned char> headers;
+
+    colorspace = getColorspace(pixelFormat);
+
+    if (width <= 0 || height <= 0 || colorspace == X264_CSP_NONE) {
+        utils::errorMsg("[VideoEncoderX264] Invalid prepare parameters");
+        return false;
+    }
+
+    fillParams(&params, width, height, colorspace);
+
+    if (!X264EncoderPool::getInstance()->prewarm(poolKey(width, height, colorspace), &params, count)) {
+        utils::errorMsg("[VideoEncoderX264] Could not prepare x264 encoders");
+        return false;
+    }
+
+    if (lowLatency && !X264EncoderPool::getInstance()->getHeaders(openKey(width, height, colorspace), headers) &&
+        !cacheHeaders(&params, openKey(width, height, colorspace))) {
+        utils::errorMsg("[VideoEncoderX264] Could not prepare x264 low latency headers");
+        return false;
+    }
+
+    return true;
+}
+
+int VideoEncoderX264::getColorspace(PixType pixelFormat)
+{
+    switch (pixelFormat) {
+        case YUV420P:
+            return X264_CSP_I420;
+        case YUV422P:
+            return X264_CSP_I422;
+        case YUV444P:
+            return X264_CSP_I444;
+        default:
+            return X264_CSP_NONE;
+    }
+}
+
+std::string VideoEncoderX264::openKey(int width, int height, int colorspace)
+{
+    //NOTE: settings applied by fillParams that x264_encoder_reconfig ignores or cannot change
+    return preset + ":" + std::to_string(width) + "x" + std::to_string(height) +
+        ":" + std::to_string(colorspace) + ":" + std::to_string(fps) + ":" + std::to_string(gop) +
+        ":" + std::to_string(threads) + ":" + std::to_string(lookahead) +
+        ":" + std::to_string(bFrames) + ":" + std::to_string(outputStreamInfo->video.h264or5.annexb) +
+        ":" + std::to_string(lowLatency);
+}
+
+std::string VideoEncoderX264::poolKey(int width, int height, int colorspace)
+{
+    //NOTE: it must identify every setting applied by fillParams
+    return openKey(width, height, colorspace) + ":" + std::to_string(bitrate) +
+        ":" + std::to_string(speedControl ? speedLevel : -1);
+}
+
+void VideoEncoderX264::fillParams(x264_param_t* params, int width, int height, int colorspace)
+{
+    x264_param_default_preset(params, preset.c_str(), NULL);
+    x264_param_apply_profile(params, "high");
+
+    params->i_width = width;
+    params->i_height = height;
+    params->i_csp = colorspace;
+
+    x264_param_parse(params, "keyint", std::to_string(gop).c_str());
+    x264_param_parse(params, "fps", std::to_string(fps).c_str());
+    x264_param_parse(params, "threads", std::to_string(threads).c_str());
+    x264_param_parse(params, "aud", std::to_string(1).c_str());
+    x264_param_parse(params, "bitrate", std::to_string(bitrate).c_str());
+    if (bFrames < 0){
+        x264_param_parse(params, "bframes", std::to_string(bFrames).c_str());
+    }
+    x264_param_parse(params, "open-gop", std::to_string(0).c_str());
+    x264_param_parse(params, "repeat-headers", std::to_string(0).c_str());
+    x264_param_parse(params, "vbv-maxrate", std::to_string(bitrate*1.05).c_str());
+    x264_param_parse(params, "vbv-bufsize", std::to_string(bitrate*2).c_str());
+    x264_param_parse(params, "rc-lookahead", std::to_string(lookahead).c_str());
+
+    if (outputStreamInfo->video.h264or5.annexb) {
+        x264_param_parse(params, "repeat-headers", std::to_string(1).c_str());
+        x264_param_parse(params, "annexb", std::to_string(1).c_str());
+    }
+
+    if (lowLatency) {
+        //NOTE: frames must leave the encoder in the same call they enter, so no
+        //      lookahead, no B-frames and sliced threads instead of frame threads
+        x264_param_parse(params, "bframes", std::to_string(0).c_str());
+        x264_param_parse(params, "rc-lookahead", std::to_string(0).c_str());
+        x264_param_parse(params, "sync-lookahead", std::to_string(0).c_str());
+        x264_param_parse(params, "sliced-threads", std::to_string(1).c_str());
+        x264_param_parse(params, "slices", std::to_string(threads).c_str());
+        params->b_vfr_input = 0;
+        params->rc.b_mb_tree = 0;
+        //NOTE: the callback gets the encoder through the picture opaque,
+        //      so pooled encoders can be used by any instance
+        params->nalu_process = &VideoEncoderX264::naluProcess;
+    } else {
+        params->nalu_process = NULL;
+    }
+
+    if (speedControl) {
+        setSpeedParams(params, speedLevel);
+    }
+}
+
+bool VideoEncoderX264::openEncoder()
+{
+    encoder = X264EncoderPool::getInstance()->take(poolKey(xparams.i_width, xparams.i_height, xparams.i_csp));
+
+    if (encoder) {
+        pooledOpens++;
+        return true;
+    }
+
+    encoder = x264_encoder_open(&xparams);
+
+    if (encoder) {
+        coldOpens++;
+        return true;
+    }
+
+    return false;
 }
 
 bool VideoEncoderX264::reconfigure(VideoFrame* orgFrame, VideoFrame* dstFrame)
 {
     int colorspace;
 
-    if (!needsConfig && orgFrame->getWidth() == xparams.i_width &&
-        orgFrame->getHeight() == xparams.i_height && orgFrame->getPixelFormat() == inPixFmt) {
+    if (!needsConfig && encoder && orgFrame->getWidth() == encWidth &&
+        orgFrame->getHeight() == encHeight && orgFrame->getPixelFormat() == inPixFmt) {
         return true;
     }
 
@@ -138,63 +526,38 @@ bool VideoEncoderX264::reconfigure(VideoFrame* orgFrame, VideoFrame* dstFrame)
     switch (inPixFmt) {
         case YUV420P:
             libavInPixFmt = AV_PIX_FMT_YUV420P;
-            colorspace = X264_CSP_I420;
             break;
         case YUV422P:
             libavInPixFmt = AV_PIX_FMT_YUV422P;
-            colorspace = X264_CSP_I422;
             break;
         case YUV444P:
             libavInPixFmt = AV_PIX_FMT_YUV444P;
-            colorspace = X264_CSP_I444;
             break;
         default:
             utils::errorMsg("Uncompatibe input pixel format");
             libavInPixFmt = AV_PIX_FMT_NONE;
-            colorspace = X264_CSP_NONE;
             return false;
             break;
     }
 
+    colorspace = getColorspace(inPixFmt);
     picIn.img.i_csp = colorspace;
-    x264_param_default_preset(&xparams, preset.c_str(), NULL);
-    x264_param_apply_profile(&xparams, "high");
-
-    x264_param_parse(&xparams, "keyint", std::to_string(gop).c_str());
-    x264_param_parse(&xparams, "fps", std::to_string(fps).c_str());
-    x264_param_parse(&xparams, "threads", std::to_string(threads).c_str());
-    x264_param_parse(&xparams, "aud", std::to_string(1).c_str());
-    x264_param_parse(&xparams, "bitrate", std::to_string(bitrate).c_str());
-    if (bFrames < 0){
-        x264_param_parse(&xparams, "bframes", std::to_string(bFrames).c_str());
-    }
-    x264_param_parse(&xparams, "open-gop", std::to_string(0).c_str());
-    x264_param_parse(&xparams, "repeat-headers", std::to_string(0).c_str());
-    x264_param_parse(&xparams, "vbv-maxrate", std::to_string(bitrate*1.05).c_str());
-    x264_param_parse(&xparams, "vbv-bufsize", std::to_string(bitrate*2).c_str());
-    x264_param_parse(&xparams, "rc-lookahead", std::to_string(lookahead).c_str());
-
-    if (outputStreamInfo->video.h264or5.annexb) {
-        x264_param_parse(&xparams, "repeat-headers", std::to_string(1).c_str());
-        x264_param_parse(&xparams, "annexb", std::to_string(1).c_str());
-    }
-
-    if (orgFrame->getWidth() != xparams.i_width || orgFrame->getHeight() != xparams.i_height) {
-        xparams.i_width = orgFrame->getWidth();
-        xparams.i_height = orgFrame->getHeight();
+    fillParams(&xparams, orgFrame->getWidth(), orgFrame->getHeight(), colorspace);
 
-        if (encoder != NULL){
-            x264_encoder_close(encoder);
-            encoder = NULL;
-        }
+    //NOTE: only bitrate (rate control and VBV) and speed changes are applied through
+    //      x264_encoder_reconfig, any other change needs a new encoder
+    if (encoder != NULL && openKey(orgFrame->getWidth(), orgFrame->getHeight(), colorspace) != openedKey) {
+        x264_encoder_close(encoder);
+        encoder = NULL;
     }
 
     if (!encoder) {
-        encoder = x264_encoder_open(&xparams);
+        openEncoder();
     } else if (x264_encoder_reconfig(encoder, &xparams) < 0) {
         utils::errorMsg("Could not reconfigure x264 encoder, closing and opening again");
         x264_encoder_close(encoder);
-        encoder = x264_encoder_open(&xparams);
+        encoder = NULL;
+        openEncoder();
     }
 
     if (!encoder) {
@@ -202,6 +565,11 @@ bool VideoEncoderX264::reconfigure(VideoFrame* orgFrame, VideoFrame* dstFrame)
         return false;
     }
 
+    encWidth = orgFrame->getWidth();
+    encHeight = orgFrame->getHeight();
+    openedKey = openKey(encWidth, encHeight, colorspace);
+    openedLowLatency = lowLatency;
+
     needsConfig = false;
    
     return encodeHeadersFrame();
@@ -26,6 +26,7 @@
 #define _VIDEO_ENCODER_X264_HH
 
 #include "VideoEncoderX264or5.hh"
+#include "X264EncoderPool.hh"
 #include <stdint.h>
 #include "../../Utils.hh"
 #include "../../VideoFrame.hh"
@@ -37,25 +38,93 @@ extern "C" {
 #include <x264.h>
 }
 
+#include <map>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <string>
+
+#define LOW_LATENCY_NAL_BUFFERS 32 //initial ones, more are added if a frame has more NALs
+
+class SlicedVideoFrameQueue;
+
 class VideoEncoderX264 : public VideoEncoderX264or5 {
 
 public:
     VideoEncoderX264();
     ~VideoEncoderX264();
 
-private:
+    /**
+    * Enables or disables the low latency mode. When enabled, x264 uses sliced threads with no
+    * lookahead nor B-frames and each NAL unit is pushed to the output queue as soon as it is
+    * produced by its slice thread, instead of waiting for the whole picture to be encoded.
+    * @param enable True to enable low latency mode
+    * @return true if success
+    */
+    bool setLowLatency(bool enable);
+
+    /**
+    * Opens encoders for the given input format ahead of time, using the current configuration.
+    * They are kept in the X264EncoderPool and taken by the first reconfiguration that matches
+    * it, so channel start and resolution switches do not wait for x264_encoder_open.
+    * @param width Expected input width
+    * @param height Expected input height
+    * @param pixelFormat Expected input pixel format
+    * @param count Number of encoders to have ready for this configuration
+    * @return true if the event was pushed
+    */
+    bool prepare(int width, int height, PixType pixelFormat = YUV420P, int count = 1);
+
+protected:
+    bool prepare0(int width, int height, PixType pixelFormat, unsigned count);
     FrameQueue* allocQueue(ConnectionData cData);
+    bool lowLatencyEvent(Jzon::Node* params);
+    virtual void pushNal(x264_nal_t *nal);
+
+private:
     void initializeEventMap();
+    bool prepareEvent(Jzon::Node* params);
+    void doGetState(Jzon::Object &filterNode);
+    bool specificWriterDelete(int writerID);
+
+    static void naluProcess(x264_t *h, x264_nal_t *nal, void *opaque);
+    void publishNal(x264_t *h, x264_nal_t *nal);
 
     x264_picture_t picIn;
     x264_picture_t picOut;
     x264_param_t xparams;
     x264_t* encoder;
 
+    bool lowLatency;
+    bool openedLowLatency;
+    SlicedVideoFrameQueue* outputQueue;
+    std::mutex nalMtx;
+    unsigned nalBufferIdx;
+    std::deque<std::vector<unsigned char>> nalBuffers;
+    std::map<int, x264_nal_t> pendingSlices;
+    int nextFirstMb;
+    unsigned earlySlices;
+
+    int encWidth;
+    int encHeight;
+    std::string openedKey;
+    unsigned pooledOpens;
+    unsigned coldOpens;
+    unsigned headerOpens;
+
     bool fillPicturePlanes(unsigned char** data, int* linesize);
     bool encodeFrame(VideoFrame* codedFrame);
     bool reconfigure(VideoFrame *orgFrame, VideoFrame* dstFrame);
     bool encodeHeadersFrame();
+    bool cacheHeaders(x264_param_t* params, std::string key);
+    bool applySpeedLevel(int level);
+    bool hasSpeedControl() {return true;};
+    void setSpeedParams(x264_param_t* params, int level);
+    void fillParams(x264_param_t* params, int width, int height, int colorspace);
+    std::string openKey(int width, int height, int colorspace);
+    std::string poolKey(int width, int height, int colorspace);
+    bool openEncoder();
+    static int getColorspace(PixType pixelFormat);
 };
 
 #endif
@@ -0,0 +1,704 @@
+/*
+ *  VideoEncoderX264Ladder.cpp - Multi-rendition x264 video encoder
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <algorithm>
+#include <functional>
+#include <stdlib.h>
+
+#include "VideoEncoderX264Ladder.hh"
+#include "../../SlicedVideoFrameQueue.hh"
+#include "../../JobsPool.hh"
+
+#define MAX_PLANES_PER_PICTURE 4
+
+///////////////////////////////////////////////////
+//              LadderRendition Class            //
+///////////////////////////////////////////////////
+
+LadderRendition::LadderRendition() : width(0), height(0), bitrate(DEFAULT_BITRATE),
+    outWidth(0), outHeight(0), needsConfig(true), opens(0), encoder(NULL), nals(NULL), piNal(0),
+    encoded(false), outPts(0), dts(0), swsCtx(NULL), picFrame(NULL)
+{
+    x264_picture_init(&picIn);
+    x264_picture_init(&picOut);
+    scaledFrame = av_frame_alloc();
+
+    outputStreamInfo = new StreamInfo(VIDEO);
+    outputStreamInfo->video.codec = H264;
+    outputStreamInfo->video.h264or5.annexb = DEFAULT_ANNEXB;
+}
+
+LadderRendition::~LadderRendition()
+{
+    if (encoder) {
+        x264_encoder_close(encoder);
+    }
+
+    sws_freeContext(swsCtx);
+    av_frame_free(&scaledFrame);
+    delete outputStreamInfo;
+}
+
+void LadderRendition::config(int width, int height, unsigned bitrate)
+{
+    this->width = width;
+    this->height = height;
+    this->bitrate = bitrate;
+    needsConfig = true;
+}
+
+///////////////////////////////////////////////////
+//           VideoEncoderX264Ladder Class        //
+///////////////////////////////////////////////////
+
+VideoEncoderX264Ladder* VideoEncoderX264Ladder::createNew()
+{
+    return new VideoEncoderX264Ladder();
+}
+
+VideoEncoderX264Ladder::VideoEncoderX264Ladder() : OneToManyFilter(),
+    libavInPixFmt(AV_PIX_FMT_NONE), inPixFmt(P_NONE), colorspace(X264_CSP_NONE),
+    inWidth(0), inHeight(0), forceIntra(false), needsConfig(false), needsSort(false), inPts(0),
+    framesSinceIdr(0), idrFrames(0), sceneCuts(0)
+{
+    fType = VIDEO_ENCODER_LADDER;
+    inFrame = av_frame_alloc();
+    initializeEventMap();
+    configure0(VIDEO_DEFAULT_FRAMERATE, DEFAULT_GOP, DEFAULT_LOOKAHEAD, DEFAULT_B_FRAMES,
+               DEFAULT_THREADS, DEFAULT_ANNEXB, DEFAULT_PRESET);
+}
+
+VideoEncoderX264Ladder::~VideoEncoderX264Ladder()
+{
+    for (auto it : renditions) {
+        delete it.second;
+    }
+    renditions.clear();
+
+    av_frame_free(&inFrame);
+}
+
+FrameQueue* VideoEncoderX264Ladder::allocQueue(ConnectionData cData)
+{
+    if (renditions.count(cData.writerId) == 0) {
+        utils::errorMsg("[VideoEncoderX264Ladder] Unknown rendition " + std::to_string(cData.writerId));
+        return NULL;
+    }
+
+    return SlicedVideoFrameQueue::createNew(cData, renditions[cData.writerId]->getStreamInfo(),
+                                            DEFAULT_VIDEO_FRAMES, MAX_H264_OR_5_NAL_SIZE);
+}
+
+bool VideoEncoderX264Ladder::doProcessFrame(Frame *org, std::map<int, Frame *> &dstFrames)
+{
+    bool idr;
+    bool cut;
+    bool produced = false;
+    FrameTimeParams frameTP;
+    FrameTimeParams outTP;
+    std::vector<std::function<void()>> jobs;
+    AVFrame* src;
+    int64_t minDts;
+
+    VideoFrame* rawFrame = dynamic_cast<VideoFrame*>(org);
+
+    if (!rawFrame) {
+        utils::errorMsg("[VideoEncoderX264Ladder] Origin frame MUST be a VideoFrame");
+        return false;
+    }
+
+    if (renditions.empty() || !setInputFrame(rawFrame)) {
+        return false;
+    }
+
+    if (needsConfig || needsSort) {
+        sortRenditions(needsConfig);
+    }
+
+    //NOTE: renditions are sorted from bigger to smaller, each one is scaled from the previous one
+    //      unless it does not fit in it. Upscaled pictures are never used as a source
+    src = inFrame;
+    for (auto r : cascade) {
+        if (r->outWidth > src->width || r->outHeight > src->height) {
+            src = inFrame;
+        }
+
+        if (!reconfigureRendition(r) || !scaleRendition(r, src)) {
+            return false;
+        }
+
+        if (r->outWidth <= inWidth && r->outHeight <= inHeight) {
+            src = r->picFrame;
+        }
+    }
+
+    needsConfig = false;
+    needsSort = false;
+
+    //NOTE: GOP and scene cut decisions are taken here for the whole ladder, x264 is not allowed to place
+    //      IDRs by itself. The smallest picture is the cheapest one to analyse
+    cut = detectSceneCut(cascade.back()->picFrame);
+    idr = forceIntra || cut || idrFrames == 0 || framesSinceIdr >= gop;
+    forceIntra = false;
+    if (idr) {
+        idrFrames++;
+        sceneCuts += cut ? 1 : 0;
+        framesSinceIdr = 0;
+    }
+    framesSinceIdr++;
+
+    frameTP.pTime = org->getPresentationTime();
+    frameTP.oTime = org->getOriginTime();
+    frameTP.seqNum = org->getSequenceNumber();
+    qFTP[inPts] = frameTP;
+
+    for (auto r : cascade) {
+        jobs.push_back([this, r, idr]{encodeRendition(r, idr);});
+    }
+
+    JobsPool::getInstance()->run(jobs);
+
+    inPts++;
+    minDts = inPts;
+
+    for (auto it : renditions) {
+        LadderRendition* r = it.second;
+
+        if (!r->encoded) {
+            continue;
+        }
+
+        minDts = std::min(minDts, r->dts);
+
+        if (dstFrames.count(it.first) == 0) {
+            continue;
+        }
+
+        SlicedVideoFrame* slicedFrame = dynamic_cast<SlicedVideoFrame*>(dstFrames[it.first]);
+        if (!slicedFrame) {
+            continue;
+        }
+
+        for (int i = 0; i < r->piNal; i++) {
+            if (!slicedFrame->setSlice(r->nals[i].p_payload, r->nals[i].i_payload)) {
+                utils::errorMsg("[VideoEncoderX264Ladder] Too many NALs for one slicedFrame");
+                break;
+            }
+        }
+
+        outTP = qFTP.count(r->outPts) > 0 ? qFTP[r->outPts] : frameTP;
+        std::chrono::microseconds dTime = qFTP.count(r->dts) > 0 ? qFTP[r->dts].pTime : outTP.pTime;
+
+        slicedFrame->setSize(r->outWidth, r->outHeight);
+        slicedFrame->setPresentationTime(outTP.pTime);
+        slicedFrame->setDecodeTime(dTime);
+        slicedFrame->setOriginTime(outTP.oTime);
+        slicedFrame->setSequenceNumber(outTP.seqNum);
+        slicedFrame->setConsumed(true);
+        produced = true;
+    }
+
+    qFTP.erase(qFTP.begin(), qFTP.lower_bound(minDts));
+
+    return produced;
+}
+
+bool VideoEncoderX264Ladder::setInputFrame(VideoFrame* rawFrame)
+{
+    if (rawFrame->getPixelFormat() != inPixFmt) {
+        inPixFmt = rawFrame->getPixelFormat();
+        switch (inPixFmt) {
+            case YUV420P:
+                libavInPixFmt = AV_PIX_FMT_YUV420P;
+                colorspace = X264_CSP_I420;
+                break;
+            case YUV422P:
+                libavInPixFmt = AV_PIX_FMT_YUV422P;
+                colorspace = X264_CSP_I422;
+                break;
+            case YUV444P:
+                libavInPixFmt = AV_PIX_FMT_YUV444P;
+                colorspace = X264_CSP_I444;
+                break;
+            default:
+                utils::errorMsg("[VideoEncoderX264Ladder] Uncompatibe input pixel format");
+                libavInPixFmt = AV_PIX_FMT_NONE;
+                colorspace = X264_CSP_NONE;
+                return false;
+        }
+        needsConfig = true;
+    }
+
+    if (rawFrame->getWidth() != inWidth || rawFrame->getHeight() != inHeight) {
+        inWidth = rawFrame->getWidth();
+        inHeight = rawFrame->getHeight();
+        needsConfig = true;
+    }
+
+    if (av_image_fill_arrays(inFrame->data, inFrame->linesize, rawFrame->getDataBuf(),
+                             libavInPixFmt, inWidth, inHeight, 1) <= 0) {
+        utils::errorMsg("[VideoEncoderX264Ladder] Could not feed AVFrame");
+        return false;
+    }
+
+    inFrame->width = inWidth;
+    inFrame->height = inHeight;
+    inFrame->format = libavInPixFmt;
+
+    return true;
+}
+
+void VideoEncoderX264Ladder::sortRenditions(bool reconfigAll)
+{
+    int width;
+    int height;
+
+    cascade.clear();
+
+    //NOTE: only the renditions whose encoder settings changed are reopened, unless the change is
+    //      common to all of them (input format or ladder configuration)
+    for (auto it : renditions) {
+        LadderRendition* r = it.second;
+
+        width = r->width > 0 ? r->width : inWidth;
+        height = r->height > 0 ? r->height : ((width * inHeight / inWidth) & ~1);
+
+        if (reconfigAll || width != r->outWidth || height != r->outHeight) {
+            r->needsConfig = true;
+        }
+
+        r->outWidth = width;
+        r->outHeight = height;
+
+        cascade.push_back(r);
+    }
+
+    std::sort(cascade.begin(), cascade.end(), [](LadderRendition* a, LadderRendition* b) {
+        return a->outWidth * a->outHeight > b->outWidth * b->outHeight;
+    });
+}
+
+bool VideoEncoderX264Ladder::reconfigureRendition(LadderRendition* r)
+{
+    if (!r->needsConfig) {
+        return true;
+    }
+
+    x264_param_t* xparams = &r->xparams;
+
+    x264_param_default_preset(xparams, preset.c_str(), NULL);
+    x264_param_apply_profile(xparams, "high");
+
+    x264_param_parse(xparams, "fps", std::to_string(fps).c_str());
+    x264_param_parse(xparams, "threads", std::to_string(threads).c_str());
+    x264_param_parse(xparams, "aud", std::to_string(1).c_str());
+    x264_param_parse(xparams, "bitrate", std::to_string(r->bitrate).c_str());
+    if (bFrames >= 0){
+        x264_param_parse(xparams, "bframes", std::to_string(bFrames).c_str());
+    }
+    x264_param_parse(xparams, "open-gop", std::to_string(0).c_str());
+    x264_param_parse(xparams, "repeat-headers", std::to_string(0).c_str());
+    x264_param_parse(xparams, "vbv-maxrate", std::to_string(r->bitrate*1.05).c_str());
+    x264_param_parse(xparams, "vbv-bufsize", std::to_string(r->bitrate*2).c_str());
+    x264_param_parse(xparams, "rc-lookahead", std::to_string(lookahead).c_str());
+
+    //NOTE: IDRs are forced by the ladder, so scenecut and automatic keyframes are disabled
+    xparams->i_keyint_max = X264_KEYINT_MAX_INFINITE;
+    xparams->i_scenecut_threshold = 0;
+
+    if (annexB) {
+        x264_param_parse(xparams, "repeat-headers", std::to_string(1).c_str());
+        x264_param_parse(xparams, "annexb", std::to_string(1).c_str());
+    }
+
+    xparams->i_width = r->outWidth;
+    xparams->i_height = r->outHeight;
+    xparams->i_csp = colorspace;
+    r->picIn.img.i_csp = colorspace;
+    r->outputStreamInfo->video.h264or5.annexb = annexB;
+
+    if (r->encoder) {
+        x264_encoder_close(r->encoder);
+    }
+
+    r->encoder = x264_encoder_open(xparams);
+    if (!r->encoder) {
+        utils::errorMsg("[VideoEncoderX264Ladder] Could not open x264 encoder");
+        return false;
+    }
+    r->opens++;
+
+    int piNal;
+    x264_nal_t* nals;
+    int headersSize = x264_encoder_headers(r->encoder, &nals, &piNal);
+    if (headersSize < 0) {
+        utils::errorMsg("[VideoEncoderX264Ladder] Could not encode headers");
+        return false;
+    }
+    r->outputStreamInfo->setExtraData(nals[0].p_payload, headersSize);
+
+    //NOTE: input sized renditions always share the input picture or an equal one (see doProcessFrame)
+    av_frame_unref(r->scaledFrame);
+    if (r->outWidth != inWidth || r->outHeight != inHeight) {
+        r->scaledFrame->width = r->outWidth;
+        r->scaledFrame->height = r->outHeight;
+        r->scaledFrame->format = libavInPixFmt;
+        if (av_frame_get_buffer(r->scaledFrame, 32) < 0) {
+            utils::errorMsg("[VideoEncoderX264Ladder] Could not allocate scaled frame");
+            return false;
+        }
+    }
+
+    r->needsConfig = false;
+    return true;
+}
+
+bool VideoEncoderX264Ladder::scaleRendition(LadderRendition* r, AVFrame* src)
+{
+    if (r->outWidth == src->width && r->outHeight == src->height) {
+        //NOTE: same size than the previous step, pictures are shared without copying
+        r->picFrame = src;
+    } else if (!r->scaledFrame->data[0]) {
+        utils::errorMsg("[VideoEncoderX264Ladder] Scaled frame not allocated");
+        return false;
+    } else {
+        r->swsCtx = sws_getCachedContext(r->swsCtx, src->width, src->height, libavInPixFmt,
+                                         r->outWidth, r->outHeight, libavInPixFmt,
+                                         SWS_FAST_BILINEAR, NULL, NULL, NULL);
+        if (!r->swsCtx) {
+            utils::errorMsg("[VideoEncoderX264Ladder] Could not get the swscale context");
+            return false;
+        }
+
+        if (sws_scale(r->swsCtx, src->data, src->linesize, 0, src->height,
+                      r->scaledFrame->data, r->scaledFrame->linesize) <= 0) {
+            utils::errorMsg("[VideoEncoderX264Ladder] Could not scale input frame");
+            return false;
+        }
+
+        r->picFrame = r->scaledFrame;
+    }
+
+    for (int i = 0; i < MAX_PLANES_PER_PICTURE; i++) {
+        r->picIn.img.plane[i] = r->picFrame->data[i];
+        r->picIn.img.i_stride[i] = r->picFrame->linesize[i];
+    }
+
+    return true;
+}
+
+bool VideoEncoderX264Ladder::detectSceneCut(AVFrame* pic)
+{
+    int step;
+    int width;
+    int height;
+    size_t idx = 0;
+    uint64_t diff = 0;
+    bool sizeChanged;
+
+    if (sceneCut == 0) {
+        prevLuma.clear();
+        return false;
+    }
+
+    //NOTE: the luma plane is subsampled, so the analysis cost does not depend on the ladder sizes
+    step = std::max(1, (pic->width + SCENECUT_ANALYSIS_WIDTH - 1) / SCENECUT_ANALYSIS_WIDTH);
+    width = pic->width / step;
+    height = pic->height / step;
+
+    sizeChanged = prevLuma.size() != (size_t) (width * height);
+    if (sizeChanged) {
+        prevLuma.assign(width * height, 0);
+    }
+
+    for (int y = 0; y < height; y++) {
+        unsigned char* row = pic->data[0] + y * step * pic->linesize[0];
+        for (int x = 0; x < width; x++, idx++) {
+            diff += abs(row[x * step] - prevLuma[idx]);
+            prevLuma[idx] = row[x * step];
+        }
+    }
+
+    //NOTE: IDRs are not placed closer than gop/10 frames, as x264 default min-keyint
+    if (sizeChanged || prevLuma.empty() || framesSinceIdr < std::max(1U, gop / 10)) {
+        return false;
+    }
+
+    return diff / prevLuma.size() >= sceneCut;
+}
+
+bool VideoEncoderX264Ladder::encodeRendition(LadderRendition* r, bool idr)
+{
+    int size;
+
+    r->encoded = false;
+    r->picIn.i_type = idr ? X264_TYPE_IDR : X264_TYPE_AUTO;
+    r->picIn.i_pts = inPts;
+
+    size = x264_encoder_encode(r->encoder, &r->nals, &r->piNal, &r->picIn, &r->picOut);
+
+    if (size < 0) {
+        utils::errorMsg("[VideoEncoderX264Ladder] Could not encode video frame");
+        return false;
+    }
+
+    if (size == 0) {
+        return false;
+    }
+
+    r->outPts = r->picOut.i_pts;
+    r->dts = r->picOut.i_dts;
+    r->encoded = true;
+
+    return true;
+}
+
+bool VideoEncoderX264Ladder::configure0(unsigned fps_, unsigned gop_, unsigned lookahead_, int bFrames_,
+                                        unsigned threads_, bool annexB_, std::string preset_,
+                                        unsigned sceneCut_)
+{
+    if (gop_ <= 0 || threads_ <= 0 || preset_.empty()) {
+        utils::errorMsg("[VideoEncoderX264Ladder] Invalid configuration values");
+        return false;
+    }
+
+    gop = gop_;
+    lookahead = lookahead_;
+    bFrames = bFrames_;
+    threads = threads_;
+    annexB = annexB_;
+    preset = preset_;
+    sceneCut = sceneCut_;
+
+    if (fps_ <= 0) {
+        fps = VIDEO_DEFAULT_FRAMERATE;
+        setFrameTime(std::chrono::microseconds(0));
+    } else {
+        fps = fps_;
+        setFrameTime(std::chrono::microseconds(std::micro::den/fps));
+    }
+
+    needsConfig = true;
+    return true;
+}
+
+bool VideoEncoderX264Ladder::configRendition0(int id, int width, int height, int bitrate)
+{
+    if (renditions.count(id) == 0) {
+        utils::errorMsg("[VideoEncoderX264Ladder] Error configuring rendition. Incorrect Id " + std::to_string(id));
+        return false;
+    }
+
+    if (width < 0 || height < 0 || bitrate <= 0) {
+        utils::errorMsg("[VideoEncoderX264Ladder] Error configuring rendition. Incoherent values");
+        return false;
+    }
+
+    renditions[id]->config(width, height, bitrate);
+    needsSort = true;
+    return true;
+}
+
+bool VideoEncoderX264Ladder::specificWriterConfig(int writerID)
+{
+    if (renditions.count(writerID) > 0) {
+        utils::errorMsg("[VideoEncoderX264Ladder] Rendition already exists " + std::to_string(writerID));
+        return false;
+    }
+
+    renditions[writerID] = new LadderRendition();
+    needsSort = true;
+    return true;
+}
+
+bool VideoEncoderX264Ladder::specificWriterDelete(int writerID)
+{
+    if (renditions.count(writerID) == 0) {
+        utils::errorMsg("[VideoEncoderX264Ladder] Rendition does not exist " + std::to_string(writerID));
+        return false;
+    }
+
+    cascade.erase(std::remove(cascade.begin(), cascade.end(), renditions[writerID]), cascade.end());
+    delete renditions[writerID];
+    renditions.erase(writerID);
+    needsSort = true;
+    return true;
+}
+
+void VideoEncoderX264Ladder::initializeEventMap()
+{
+    eventMap["configure"] = std::bind(&VideoEncoderX264Ladder::configureEvent, this, std::placeholders::_1);
+    eventMap["configRendition"] = std::bind(&VideoEncoderX264Ladder::configRenditionEvent, this, std::placeholders::_1);
+    eventMap["forceIntra"] = std::bind(&VideoEncoderX264Ladder::forceIntraEvent, this, std::placeholders::_1);
+}
+
+bool VideoEncoderX264Ladder::configureEvent(Jzon::Node* params)
+{
+    unsigned tmpFps = fps;
+    unsigned tmpGop = gop;
+    unsigned tmpLookahead = lookahead;
+    int tmpBFrames = bFrames;
+    unsigned tmpThreads = threads;
+    bool tmpAnnexB = annexB;
+    std::string tmpPreset = preset;
+    int tmpSceneCut = sceneCut;
+
+    if (!params) {
+        return false;
+    }
+
+    if (params->Has("fps") && params->Get("fps").IsNumber()) {
+        tmpFps = params->Get("fps").ToInt();
+    }
+
+    if (params->Has("gop") && params->Get("gop").IsNumber()) {
+        tmpGop = params->Get("gop").ToInt();
+    }
+
+    if (params->Has("lookahead") && params->Get("lookahead").IsNumber()) {
+        tmpLookahead = params->Get("lookahead").ToInt();
+    }
+
+    if (params->Has("bframes") && params->Get("bframes").IsNumber()) {
+        tmpBFrames = params->Get("bframes").ToInt();
+    }
+
+    if (params->Has("threads") && params->Get("threads").IsNumber()) {
+        tmpThreads = params->Get("threads").ToInt();
+    }
+
+    if (params->Has("annexb") && params->Get("annexb").IsBool()) {
+        tmpAnnexB = params->Get("annexb").ToBool();
+    }
+
+    if (params->Has("preset")) {
+        tmpPreset = params->Get("preset").ToString();
+    }
+
+    if (params->Has("sceneCut") && params->Get("sceneCut").IsNumber()) {
+        tmpSceneCut = params->Get("sceneCut").ToInt();
+    }
+
+    if (tmpSceneCut < 0) {
+        utils::errorMsg("[VideoEncoderX264Ladder] Invalid scene cut threshold");
+        return false;
+    }
+
+    return configure0(tmpFps, tmpGop, tmpLookahead, tmpBFrames, tmpThreads, tmpAnnexB, tmpPreset, tmpSceneCut);
+}
+
+bool VideoEncoderX264Ladder::configRenditionEvent(Jzon::Node* params)
+{
+    if (!params) {
+        return false;
+    }
+
+    if (!params->Has("id") || !params->Get("id").IsNumber() ||
+        !params->Has("bitrate") || !params->Get("bitrate").IsNumber()) {
+        utils::errorMsg("[VideoEncoderX264Ladder] configRendition params node not complete");
+        return false;
+    }
+
+    int id = params->Get("id").ToInt();
+    int bitrate = params->Get("bitrate").ToInt();
+    int width = 0;
+    int height = 0;
+
+    if (params->Has("width") && params->Get("width").IsNumber()) {
+        width = params->Get("width").ToInt();
+    }
+
+    if (params->Has("height") && params->Get("height").IsNumber()) {
+        height = params->Get("height").ToInt();
+    }
+
+    return configRendition0(id, width, height, bitrate);
+}
+
+bool VideoEncoderX264Ladder::forceIntraEvent(Jzon::Node*)
+{
+    forceIntra = true;
+    return true;
+}
+
+void VideoEncoderX264Ladder::doGetState(Jzon::Object &filterNode)
+{
+    Jzon::Array jsonRenditions;
+
+    filterNode.Add("fps", (int) fps);
+    filterNode.Add("gop", (int) gop);
+    filterNode.Add("lookahead", (int) lookahead);
+    filterNode.Add("bframes", bFrames);
+    filterNode.Add("threads", (int) threads);
+    filterNode.Add("annexb", annexB);
+    filterNode.Add("preset", preset);
+    filterNode.Add("sceneCut", (int) sceneCut);
+    filterNode.Add("idrFrames", (int) idrFrames);
+    filterNode.Add("sceneCuts", (int) sceneCuts);
+
+    for (auto it : renditions) {
+        Jzon::Object rendition;
+        rendition.Add("id", it.first);
+        rendition.Add("width", it.second->getOutputWidth());
+        rendition.Add("height", it.second->getOutputHeight());
+        rendition.Add("bitrate", (int) it.second->getBitrate());
+        rendition.Add("opens", (int) it.second->getOpens());
+        jsonRenditions.Add(rendition);
+    }
+
+    filterNode.Add("renditions", jsonRenditions);
+}
+
+bool VideoEncoderX264Ladder::configure(int fps, int gop, int lookahead, int bFrames,
+                                       int threads, bool annexB, std::string preset, int sceneCut)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configure");
+    params.Add("fps", fps);
+    params.Add("gop", gop);
+    params.Add("lookahead", lookahead);
+    params.Add("bframes", bFrames);
+    params.Add("threads", threads);
+    params.Add("annexb", annexB);
+    params.Add("preset", preset);
+    params.Add("sceneCut", sceneCut);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
+
+bool VideoEncoderX264Ladder::configRendition(int id, int width, int height, int bitrate)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configRendition");
+    params.Add("id", id);
+    params.Add("width", width);
+    params.Add("height", height);
+    params.Add("bitrate", bitrate);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
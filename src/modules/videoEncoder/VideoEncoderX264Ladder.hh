@@ -0,0 +1,217 @@
+/*
+ *  VideoEncoderX264Ladder.hh - Multi-rendition x264 video encoder
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _VIDEO_ENCODER_X264_LADDER_HH
+#define _VIDEO_ENCODER_X264_LADDER_HH
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <string>
+
+#include "VideoEncoderX264or5.hh"
+#include "../../Utils.hh"
+#include "../../VideoFrame.hh"
+#include "../../Filter.hh"
+#include "../../FrameQueue.hh"
+#include "../../StreamInfo.hh"
+
+extern "C" {
+    #include <x264.h>
+    #include <libswscale/swscale.h>
+    #include <libavutil/imgutils.h>
+}
+
+#define DEFAULT_LADDER_SCENECUT 30      //mean absolute luma difference between consecutive frames
+#define SCENECUT_ANALYSIS_WIDTH 320     //max analysed luma samples per row
+
+/*! Configuration and encoding context of one of the ladder renditions (one per writer) */
+
+class LadderRendition {
+public:
+    /**
+    * Class constructor
+    */
+    LadderRendition();
+
+    /**
+    * Class destructor
+    */
+    ~LadderRendition();
+
+    /**
+    * It sets the rendition configuration. Changes are applied with the next frame
+    * @param width Output width, 0 to use the input one
+    * @param height Output height, 0 to keep the input aspect ratio
+    * @param bitrate Output bitrate in kbps
+    */
+    void config(int width, int height, unsigned bitrate);
+
+    int getWidth() {return width;};
+    int getHeight() {return height;};
+    unsigned getBitrate() {return bitrate;};
+    int getOutputWidth() {return outWidth;};
+    int getOutputHeight() {return outHeight;};
+    unsigned getOpens() {return opens;};
+    StreamInfo* getStreamInfo() {return outputStreamInfo;};
+
+private:
+    friend class VideoEncoderX264Ladder;
+
+    int width;
+    int height;
+    unsigned bitrate;
+    int outWidth;
+    int outHeight;
+    bool needsConfig;
+    unsigned opens;
+
+    x264_t* encoder;
+    x264_param_t xparams;
+    x264_picture_t picIn;
+    x264_picture_t picOut;
+    x264_nal_t* nals;
+    int piNal;
+    bool encoded;
+    int64_t outPts;
+    int64_t dts;
+
+    struct SwsContext* swsCtx;
+    AVFrame* scaledFrame;
+    AVFrame* picFrame;
+
+    StreamInfo* outputStreamInfo;
+};
+
+/*! One input, many outputs x264 encoder. Each writer is a rendition of the ladder. The input is
+    downscaled internally in cascade (each rendition is scaled from the previous bigger one, upscaled
+    renditions and the ones not fitting in the previous one are scaled from the input), all
+    renditions are encoded in parallel in the JobsPool threads and GOP decisions are taken once for the
+    whole ladder, so IDR frames are placed at the same positions in every rendition and outputs are
+    segment-aligned. Scene cut detection runs once per frame on the smallest rendition picture and
+    its decision is forced in all renditions, instead of running x264 scenecut in each encoder. */
+
+class VideoEncoderX264Ladder : public OneToManyFilter {
+
+public:
+    /**
+    * Creates a new ladder encoder
+    * @return pointer to the new object
+    */
+    static VideoEncoderX264Ladder* createNew();
+
+    /**
+    * Class destructor
+    */
+    ~VideoEncoderX264Ladder();
+
+    /**
+    * Common configuration for all the renditions
+    * @param fps Output frame rate
+    * @param gop GOP size in frames, shared by all renditions
+    * @param lookahead Rate control lookahead in frames
+    * @param bFrames B-frames number
+    * @param threads Threads of each rendition encoder
+    * @param annexB If true, output is in Annex B format
+    * @param preset x264 preset
+    * @param sceneCut Mean absolute luma difference (0-255) between consecutive frames above which an
+    * IDR is placed in all renditions, 0 to disable scene cut detection
+    * @return true if the event was pushed
+    */
+    bool configure(int fps, int gop, int lookahead, int bFrames, int threads, bool annexB, std::string preset,
+                   int sceneCut = DEFAULT_LADDER_SCENECUT);
+
+    /**
+    * Configures one of the renditions
+    * @param id Writer ID of the rendition
+    * @param width Output width, 0 to use the input one
+    * @param height Output height, 0 to keep the input aspect ratio
+    * @param bitrate Output bitrate in kbps
+    * @return true if the event was pushed
+    */
+    bool configRendition(int id, int width, int height, int bitrate);
+
+protected:
+    VideoEncoderX264Ladder();
+    bool configure0(unsigned fps_, unsigned gop_, unsigned lookahead_, int bFrames_,
+                    unsigned threads_, bool annexB_, std::string preset_,
+                    unsigned sceneCut_ = DEFAULT_LADDER_SCENECUT);
+    bool configRendition0(int id, int width, int height, int bitrate);
+    bool specificWriterConfig(int writerID);
+    bool specificWriterDelete(int writerID);
+    bool doProcessFrame(Frame *org, std::map<int, Frame *> &dstFrames);
+
+private:
+    FrameQueue* allocQueue(ConnectionData cData);
+    void initializeEventMap();
+    void doGetState(Jzon::Object &filterNode);
+    bool configureEvent(Jzon::Node* params);
+    bool configRenditionEvent(Jzon::Node* params);
+    bool forceIntraEvent(Jzon::Node* params);
+
+    bool setInputFrame(VideoFrame* rawFrame);
+    bool reconfigureRendition(LadderRendition* r);
+    bool scaleRendition(LadderRendition* r, AVFrame* src);
+    bool encodeRendition(LadderRendition* r, bool idr);
+    bool detectSceneCut(AVFrame* pic);
+    void sortRenditions(bool reconfigAll);
+
+    //There is no need of specific reader configuration
+    bool specificReaderConfig(int /*readerID*/, FrameQueue* /*queue*/)  {return true;};
+    bool specificReaderDelete(int /*readerID*/) {return true;};
+
+    struct FrameTimeParams {
+        std::chrono::microseconds pTime;
+        std::chrono::system_clock::time_point oTime;
+        size_t seqNum;
+    };
+
+    std::map<int, LadderRendition*> renditions;
+    std::vector<LadderRendition*> cascade;
+    std::map<int64_t, FrameTimeParams> qFTP;
+
+    AVFrame *inFrame;
+    AVPixelFormat libavInPixFmt;
+    PixType inPixFmt;
+    int colorspace;
+    int inWidth;
+    int inHeight;
+
+    unsigned fps;
+    unsigned gop;
+    unsigned lookahead;
+    int bFrames;
+    unsigned threads;
+    std::string preset;
+    bool annexB;
+    unsigned sceneCut;
+    bool forceIntra;
+    bool needsConfig;
+    bool needsSort;
+    int64_t inPts;
+    unsigned framesSinceIdr;
+    unsigned idrFrames;
+    unsigned sceneCuts;
+    std::vector<unsigned char> prevLuma;
+};
+
+#endif
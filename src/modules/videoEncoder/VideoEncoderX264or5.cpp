@@ -21,12 +21,15 @@
  *            David Cassany <david.cassany@i2cat.net>
  */
 
+#include <algorithm>
 #include "VideoEncoderX264or5.hh"
 
 VideoEncoderX264or5::VideoEncoderX264or5() :
 OneToOneFilter(), inPixFmt(P_NONE), forceIntra(false), fps(0), bitrate(0), gop(0), 
     gopTime(0), refTime(std::chrono::microseconds(0)), threads(0), bFrames(-1),
-    needsConfig(false), inPts(0), outPts(0), dts(0)
+    needsConfig(false), inPts(0), outPts(0), dts(0), speedControl(false), speedLevel(0),
+    maxSpeedLevel(SPEED_LEVELS - 1), encodeLoad(0), windowEncodeTime(0), windowFrames(0),
+    framesSinceSpeedChange(0), speedChanges(0)
 {
     fType = VIDEO_ENCODER;
     midFrame = av_frame_alloc();
@@ -91,12 +94,26 @@ bool VideoEncoderX264or5::doProcessFrame(Frame *org, Frame *dst)
     frameTP.seqNum = org->getSequenceNumber();
     qFTP[inPts] = frameTP;
     
-    if (!encodeFrame(codedFrame)) {
+    //NOTE: low latency encoders may output slices before encodeFrame returns,
+    //      so the coded frame carries the input frame timing while encoding
+    codedFrame->setSize(rawFrame->getWidth(), rawFrame->getHeight());
+    dst->setPresentationTime(frameTP.pTime);
+    dst->setDecodeTime(frameTP.pTime);
+    dst->setOriginTime(frameTP.oTime);
+    dst->setSequenceNumber(frameTP.seqNum);
+    
+    std::chrono::steady_clock::time_point encodeStart = std::chrono::steady_clock::now();
+    bool encoded = encodeFrame(codedFrame);
+
+    if (speedControl) {
+        updateSpeedControl(std::chrono::duration_cast<std::chrono::microseconds>
+                           (std::chrono::steady_clock::now() - encodeStart));
+    }
+
+    if (!encoded) {
         utils::warningMsg("Could not encode video frame");
         return false;
     }
-
-    codedFrame->setSize(rawFrame->getWidth(), rawFrame->getHeight());
     
     dst->setConsumed(true);
     dst->setPresentationTime(qFTP[outPts].pTime);
@@ -109,6 +126,72 @@ bool VideoEncoderX264or5::doProcessFrame(Frame *org, Frame *dst)
     return true;
 }
 
+void VideoEncoderX264or5::updateSpeedControl(std::chrono::microseconds encodeTime)
+{
+    std::chrono::microseconds budget = getFrameTime();
+    unsigned window = std::max((unsigned) SPEED_CONTROL_WINDOW, 2*threads);
+    int newLevel = speedLevel;
+
+    if (budget.count() <= 0) {
+        budget = std::chrono::microseconds(std::micro::den/fps);
+    }
+
+    //NOTE: with frame threads a single call either returns right away or blocks until a
+    //      thread is free, so load is only measured over a whole window of frames
+    windowEncodeTime += encodeTime;
+    framesSinceSpeedChange++;
+
+    if (++windowFrames < window) {
+        return;
+    }
+
+    encodeLoad = (double) windowEncodeTime.count() / (windowFrames * budget.count());
+    windowEncodeTime = std::chrono::microseconds(0);
+    windowFrames = 0;
+
+    //NOTE: hysteresis, a change is only considered after holding the current level for a while
+    //      and only if load is out of the [LOW, HIGH] band
+    if (framesSinceSpeedChange < SPEED_CONTROL_HOLD_FRAMES) {
+        return;
+    }
+
+    if (encodeLoad > SPEED_CONTROL_HIGH_LOAD && speedLevel > 0) {
+        newLevel = speedLevel - 1;
+    } else if (encodeLoad < SPEED_CONTROL_LOW_LOAD && speedLevel < maxSpeedLevel) {
+        newLevel = speedLevel + 1;
+    }
+
+    if (newLevel == speedLevel) {
+        return;
+    }
+
+    if (!applySpeedLevel(newLevel)) {
+        utils::warningMsg("Encoder speed level could not be changed, disabling speed control");
+        speedControl = false;
+        return;
+    }
+
+    utils::debugMsg("Encoder speed level changed from " + std::to_string(speedLevel) + 
+                    " to " + std::to_string(newLevel));
+    speedLevel = newLevel;
+    framesSinceSpeedChange = 0;
+    speedChanges++;
+}
+
+int VideoEncoderX264or5::presetSpeedLevel(std::string preset)
+{
+    static const char* presets[SPEED_LEVELS - 1] = {"ultrafast", "superfast", "veryfast", "faster", "fast"};
+
+    for (int level = 0; level < SPEED_LEVELS - 1; level++) {
+        if (preset == presets[level]) {
+            return level;
+        }
+    }
+
+    //NOTE: medium and slower presets
+    return SPEED_LEVELS - 1;
+}
+
 //TODO: this should be done without libav
 bool VideoEncoderX264or5::fill_x264or5_picture(VideoFrame* videoFrame)
 {
@@ -143,6 +226,10 @@ bool VideoEncoderX264or5::configure0(unsigned bitrate_, unsigned fps_, unsigned
     bFrames = bFrames_;
 
     outputStreamInfo->video.h264or5.annexb = annexB_;
+
+    if (preset != preset_) {
+        speedLevel = std::min(presetSpeedLevel(preset_), maxSpeedLevel);
+    }
     preset = preset_;
 
     if (fps_ <= 0) {
@@ -233,6 +320,41 @@ bool VideoEncoderX264or5::configEvent(Jzon::Node* params)
                       tmpThreads, tmpAnnexB, tmpPreset, tmpGopTime);
 }
 
+bool VideoEncoderX264or5::speedControlEvent(Jzon::Node* params)
+{
+    if (!params || !params->Has("enable") || !params->Get("enable").IsBool()) {
+        return false;
+    }
+
+    if (params->Get("enable").ToBool() && !hasSpeedControl()) {
+        utils::errorMsg("Error configuring speed control: not supported by this encoder");
+        return false;
+    }
+
+    if (params->Has("maxLevel") && params->Get("maxLevel").IsNumber()) {
+        int level = params->Get("maxLevel").ToInt();
+        if (level < 0 || level >= SPEED_LEVELS) {
+            utils::errorMsg("Error configuring speed control: invalid maximum level");
+            return false;
+        }
+        maxSpeedLevel = level;
+    }
+
+    if (params->Get("enable").ToBool() && !speedControl) {
+        speedLevel = presetSpeedLevel(preset);
+    }
+
+    speedControl = params->Get("enable").ToBool();
+    speedLevel = std::min(speedLevel, maxSpeedLevel);
+    framesSinceSpeedChange = 0;
+    windowEncodeTime = std::chrono::microseconds(0);
+    windowFrames = 0;
+    encodeLoad = 0;
+    needsConfig = true;
+
+    return true;
+}
+
 bool VideoEncoderX264or5::forceIntraEvent(Jzon::Node*)
 {
     forceIntra = true;
@@ -254,6 +376,7 @@ void VideoEncoderX264or5::initializeEventMap()
     eventMap["forceIntra"] = std::bind(&VideoEncoderX264or5::forceIntraEvent, this, std::placeholders::_1);
     eventMap["gopReferenceTime"] = std::bind(&VideoEncoderX264or5::setGopReferenceTimeEvent, this, std::placeholders::_1);
     eventMap["configure"] = std::bind(&VideoEncoderX264or5::configEvent, this, std::placeholders::_1);
+    eventMap["speedControl"] = std::bind(&VideoEncoderX264or5::speedControlEvent, this, std::placeholders::_1);
 }
 
 void VideoEncoderX264or5::doGetState(Jzon::Object &filterNode)
@@ -269,6 +392,11 @@ void VideoEncoderX264or5::doGetState(Jzon::Object &filterNode)
     filterNode.Add("annexb", outputStreamInfo->video.h264or5.annexb);
     filterNode.Add("bframes", (int) bFrames);
     filterNode.Add("preset", preset);
+    filterNode.Add("speedControl", speedControl);
+    filterNode.Add("speedLevel", speedLevel);
+    filterNode.Add("maxSpeedLevel", maxSpeedLevel);
+    filterNode.Add("encodeLoad", (int) (encodeLoad*100));
+    filterNode.Add("speedChanges", (int) speedChanges);
 }
 
 bool VideoEncoderX264or5::configure(int bitrate, int fps, int gop,
@@ -293,3 +421,15 @@ bool VideoEncoderX264or5::configure(int bitrate, int fps, int gop,
     return true;
 }
 
+bool VideoEncoderX264or5::configureSpeedControl(bool enable, int maxLevel)
+{
+    Jzon::Object root, params;
+    root.Add("action", "speedControl");
+    params.Add("enable", enable);
+    params.Add("maxLevel", maxLevel);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
@@ -48,6 +48,12 @@ extern "C" {
 #define DEFAULT_PRESET "ultrafast"
 #define MIN_GOP_TIME 1000000 //usec
 
+#define SPEED_LEVELS 6
+#define SPEED_CONTROL_HIGH_LOAD 0.9 //encoding time / frame time
+#define SPEED_CONTROL_LOW_LOAD 0.6
+#define SPEED_CONTROL_HOLD_FRAMES 50
+#define SPEED_CONTROL_WINDOW 25 //frames, at least twice the encoding threads are used
+
 /*! Base class for VideoEncoderX264 and VideoEncoderX265. It implements common methods, basically configure and doProcessFrame */
 
 class VideoEncoderX264or5 : public OneToOneFilter {
@@ -65,6 +71,17 @@ public:
 
     bool configure(int bitrate, int fps, int gop, int lookahead, int bFrames,
                    int threads, bool annexB, std::string preset, int gopTime = 0);
+
+    /**
+    * Enables or disables the CPU load driven speed control. When enabled, the time spent
+    * encoding a window of frames is compared with the time of those frames and the motion
+    * estimation and subpixel refinement settings are stepped up or down to keep encoding in
+    * real time. Speed control starts from the level closest to the configured preset.
+    * @param enable True to enable the speed control
+    * @param maxLevel Slowest (best quality) speed level allowed, from 0 to SPEED_LEVELS - 1
+    * @return true if the event was pushed
+    */
+    bool configureSpeedControl(bool enable, int maxLevel = SPEED_LEVELS - 1);
     
 protected:
     AVPixelFormat libavInPixFmt;
@@ -86,6 +103,15 @@ protected:
     int64_t outPts;
     int64_t dts;
 
+    bool speedControl;
+    int speedLevel;
+    int maxSpeedLevel;
+    double encodeLoad;
+    std::chrono::microseconds windowEncodeTime;
+    unsigned windowFrames;
+    unsigned framesSinceSpeedChange;
+    unsigned speedChanges;
+
     StreamInfo *outputStreamInfo;
     
     bool doProcessFrame(Frame *org, Frame *dst);
@@ -93,18 +119,27 @@ protected:
     virtual bool fillPicturePlanes(unsigned char** data, int* linesize) = 0;
     virtual bool encodeFrame(VideoFrame* codedFrame) = 0;
     virtual bool reconfigure(VideoFrame* orgFrame, VideoFrame* dstFrame) = 0;
+    /**
+    * Applies a speed level to the running encoder, 0 being the fastest one
+    * @return false if the encoder does not support changing its speed on the fly
+    */
+    virtual bool applySpeedLevel(int /*level*/) {return false;};
+    virtual bool hasSpeedControl() {return false;};
+    bool speedControlEvent(Jzon::Node* params);
+    void updateSpeedControl(std::chrono::microseconds encodeTime);
+    static int presetSpeedLevel(std::string preset);
     void setIntra(){forceIntra = true;};
     bool fill_x264or5_picture(VideoFrame* videoFrame);
 
     bool configure0(unsigned bitrate_, unsigned fps_, unsigned gop_, 
                     unsigned lookahead_, int bFrames_, unsigned threads_,
                     bool annexB_, std::string preset_, unsigned gopTime);
+    void doGetState(Jzon::Object &filterNode);
     
 private:
     bool setGopReferenceTimeEvent(Jzon::Node* params);
     bool forceIntraEvent(Jzon::Node* params);
     bool configEvent(Jzon::Node* params);
-    void doGetState(Jzon::Object &filterNode);
     
     //There is no need of specific reader configuration
     bool specificReaderConfig(int /*readerID*/, FrameQueue* /*queue*/)  {return true;};
@@ -0,0 +1,159 @@
+/*
+ *  X264EncoderPool.cpp - Pool of pre-opened x264 encoders
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "X264EncoderPool.hh"
+#include "../../Utils.hh"
+
+X264EncoderPool* X264EncoderPool::getInstance()
+{
+    static X264EncoderPool instance;
+    return &instance;
+}
+
+X264EncoderPool::~X264EncoderPool()
+{
+    clear();
+}
+
+bool X264EncoderPool::prewarm(std::string key, x264_param_t* params, unsigned count)
+{
+    x264_t* encoder;
+    bool ready;
+    std::unique_lock<std::mutex> lock(mtx);
+
+    if (!params || count > MAX_POOLED_ENCODERS) {
+        utils::errorMsg("[X264EncoderPool] Invalid prewarm request");
+        return false;
+    }
+
+    //NOTE: the size check and the reservation are done with the lock held, so concurrent
+    //      requests never open more than count encoders. Opening may take a while, it is
+    //      done without holding the lock so that take does not wait for it
+    while (encoders[key].size() < count) {
+        if (encoders[key].size() + opening[key] >= count) {
+            openedCv.wait(lock);
+            continue;
+        }
+
+        opening[key]++;
+
+        lock.unlock();
+        encoder = x264_encoder_open(params);
+        lock.lock();
+
+        opening[key]--;
+        openedCv.notify_all();
+
+        if (!encoder) {
+            utils::errorMsg("[X264EncoderPool] Could not open x264 encoder");
+            break;
+        }
+
+        encoders[key].push_back(encoder);
+    }
+
+    ready = encoders[key].size() >= count;
+
+    if (encoders[key].empty()) {
+        encoders.erase(key);
+    }
+
+    if (opening[key] == 0) {
+        opening.erase(key);
+    }
+
+    return ready;
+}
+
+x264_t* X264EncoderPool::take(std::string key)
+{
+    x264_t* encoder;
+    std::lock_guard<std::mutex> guard(mtx);
+
+    if (encoders.count(key) == 0 || encoders[key].empty()) {
+        return NULL;
+    }
+
+    encoder = encoders[key].front();
+    encoders[key].pop_front();
+
+    if (encoders[key].empty()) {
+        encoders.erase(key);
+    }
+
+    return encoder;
+}
+
+unsigned X264EncoderPool::available(std::string key)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+
+    if (encoders.count(key) == 0) {
+        return 0;
+    }
+
+    return encoders[key].size();
+}
+
+void X264EncoderPool::setHeaders(std::string key, unsigned char* data, unsigned size)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    headers[key].assign(data, data + size);
+}
+
+bool X264EncoderPool::getHeaders(std::string key, std::vector<unsigned char>& data)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+
+    if (headers.count(key) == 0) {
+        return false;
+    }
+
+    data = headers[key];
+    return true;
+}
+
+unsigned X264EncoderPool::size()
+{
+    unsigned total = 0;
+    std::lock_guard<std::mutex> guard(mtx);
+
+    for (auto it : encoders) {
+        total += it.second.size();
+    }
+
+    return total;
+}
+
+void X264EncoderPool::clear()
+{
+    std::lock_guard<std::mutex> guard(mtx);
+
+    for (auto it : encoders) {
+        for (auto encoder : it.second) {
+            x264_encoder_close(encoder);
+        }
+    }
+
+    encoders.clear();
+    headers.clear();
+}
@@ -0,0 +1,114 @@
+/*
+ *  X264EncoderPool.hh - Pool of pre-opened x264 encoders
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _X264_ENCODER_POOL_HH
+#define _X264_ENCODER_POOL_HH
+
+#include <stdint.h>
+#include <string>
+#include <map>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+extern "C" {
+#include <x264.h>
+}
+
+#define MAX_POOLED_ENCODERS 8 //per configuration
+
+/*! Process wide pool of x264 encoders opened ahead of time. Opening an encoder allocates
+    lookahead buffers and threads, which adds a noticeable delay to channel start and to
+    resolution switches. Encoders are indexed by a configuration key built by the user
+    and they are handed out only once, since an encoder that has already been used keeps
+    rate control state. */
+
+class X264EncoderPool {
+
+public:
+    /**
+    * Gets the pool instance
+    * @return pointer to the pool
+    */
+    static X264EncoderPool* getInstance();
+
+    /**
+    * Opens encoders with the given parameters and keeps them ready to be taken
+    * @param key Configuration key identifying the parameters
+    * @param params x264 parameters used to open the encoders
+    * @param count Number of encoders to have ready for this key
+    * @return true if the requested encoders are available
+    */
+    bool prewarm(std::string key, x264_param_t* params, unsigned count = 1);
+
+    /**
+    * Takes a pre-opened encoder for a configuration key
+    * @param key Configuration key
+    * @return an opened encoder that the caller owns, or NULL if none is ready
+    */
+    x264_t* take(std::string key);
+
+    /**
+    * @param key Configuration key
+    * @return number of encoders ready for the key
+    */
+    unsigned available(std::string key);
+
+    /**
+    * Keeps the stream headers (SPS, PPS and SEI) of a configuration, so that they are not
+    * obtained from a new encoder each time an equivalent one is opened or reconfigured
+    * @param key Configuration key, it must identify every setting that changes the headers
+    * @param data Headers in the encoder output format
+    * @param size Headers size in bytes
+    */
+    void setHeaders(std::string key, unsigned char* data, unsigned size);
+
+    /**
+    * @param key Configuration key
+    * @param data Filled with the headers of the configuration, if any
+    * @return true if there are headers for the key
+    */
+    bool getHeaders(std::string key, std::vector<unsigned char>& data);
+
+    /**
+    * @return total number of pooled encoders
+    */
+    unsigned size();
+
+    /**
+    * Closes all the pooled encoders and drops the cached headers
+    */
+    void clear();
+
+private:
+    X264EncoderPool() {};
+    ~X264EncoderPool();
+
+    std::mutex mtx;
+    std::map<std::string, std::deque<x264_t*>> encoders;
+    std::map<std::string, unsigned> opening;
+    std::condition_variable openedCv;
+    std::map<std::string, std::vector<unsigned char>> headers;
+};
+
+#endif
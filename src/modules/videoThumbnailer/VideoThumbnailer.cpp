@@ -0,0 +1,498 @@
+/*
+ *  VideoThumbnailer.cpp - A keyframe-only H264/H265 thumbnail extractor
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "VideoThumbnailer.hh"
+#include "../../AVFramedQueue.hh"
+#include "../../Utils.hh"
+
+#include <algorithm>
+
+#define H264_NALU_TYPE_MASK 0x1F
+#define H265_NALU_TYPE_MASK 0x7E
+
+#define H264_IDR 5
+#define H264_SPS 7
+#define H264_PPS 8
+
+#define H265_BLA_W_LP 16
+#define H265_CRA_NUT 21
+#define H265_VPS 32
+#define H265_SPS 33
+#define H265_PPS 34
+
+static unsigned char const startCode[4] = {0x00, 0x00, 0x00, 0x01};
+
+VideoThumbnailer::VideoThumbnailer() : OneToOneFilter(),
+    codec(NULL), codecCtx(NULL), swsCtx(NULL), fCodec(VC_NONE), collecting(false),
+    auPts(0), auSeqNum(0), interval(std::chrono::milliseconds(DEFAULT_THUMBNAIL_INTERVAL)),
+    lastThumbnailPts(0), firstThumbnail(true), outWidth(DEFAULT_THUMBNAIL_WIDTH),
+    outHeight(DEFAULT_THUMBNAIL_HEIGHT), lowres(0), skipLoopFilter(true),
+    needsConfig(false), thumbnails(0), discardedNals(0)
+{
+    avcodec_register_all();
+    fType = VIDEO_THUMBNAILER;
+
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+
+    frame = av_frame_alloc();
+    outFrame = av_frame_alloc();
+
+    outputStreamInfo = new StreamInfo(VIDEO);
+    outputStreamInfo->video.codec = RAW;
+    outputStreamInfo->video.pixelFormat = RGB24;
+
+    initializeEventMap();
+}
+
+VideoThumbnailer::~VideoThumbnailer()
+{
+    if (codecCtx) {
+        avcodec_close(codecCtx);
+        av_free(codecCtx);
+    }
+
+    av_frame_free(&frame);
+    av_frame_free(&outFrame);
+    sws_freeContext(swsCtx);
+
+    delete outputStreamInfo;
+}
+
+FrameQueue* VideoThumbnailer::allocQueue(ConnectionData cData)
+{
+    return VideoFrameQueue::createNew(cData, outputStreamInfo, THUMBNAIL_QUEUE_FRAMES);
+}
+
+bool VideoThumbnailer::isRandomAccessNal(VCodecType codec, unsigned char nalHeader)
+{
+    unsigned char type;
+
+    switch (codec) {
+        case H264:
+            type = nalHeader & H264_NALU_TYPE_MASK;
+            return type == H264_IDR;
+        case H265:
+            type = (nalHeader & H265_NALU_TYPE_MASK) >> 1;
+            return type >= H265_BLA_W_LP && type <= H265_CRA_NUT;
+        default:
+            return false;
+    }
+}
+
+bool VideoThumbnailer::isParameterSetNal(VCodecType codec, unsigned char nalHeader)
+{
+    unsigned char type;
+
+    switch (codec) {
+        case H264:
+            type = nalHeader & H264_NALU_TYPE_MASK;
+            return type == H264_SPS || type == H264_PPS;
+        case H265:
+            type = (nalHeader & H265_NALU_TYPE_MASK) >> 1;
+            return type >= H265_VPS && type <= H265_PPS;
+        default:
+            return false;
+    }
+}
+
+bool VideoThumbnailer::doProcessFrame(Frame *org, Frame *dst)
+{
+    bool produced = false;
+    VideoFrame* vFrame = dynamic_cast<VideoFrame*>(org);
+    VideoFrame* thumbnail = dynamic_cast<VideoFrame*>(dst);
+
+    if (!vFrame || !thumbnail) {
+        return false;
+    }
+
+    if (!reconfigure(vFrame->getCodec())) {
+        return false;
+    }
+
+    //NOTE: the access unit is complete once a NALU with a different timestamp arrives
+    if (collecting && org->getPresentationTime() != auPts) {
+        produced = decodeAccessUnit(thumbnail);
+        collecting = false;
+        accessUnit.clear();
+    }
+
+    parseNals(vFrame);
+
+    return produced;
+}
+
+void VideoThumbnailer::parseNals(VideoFrame *vFrame)
+{
+    unsigned char *data = vFrame->getDataBuf();
+    unsigned length = vFrame->getLength();
+    unsigned nalStart = 0;
+    bool found = false;
+    unsigned i = 0;
+
+    while (i + 3 <= length) {
+        if (data[i] == 0x00 && data[i + 1] == 0x00 && data[i + 2] == 0x01) {
+            if (found) {
+                unsigned nalEnd = i;
+                if (nalEnd > nalStart && data[nalEnd - 1] == 0x00) {
+                    nalEnd--;
+                }
+                manageNal(data + nalStart, nalEnd - nalStart, vFrame);
+            }
+            found = true;
+            i += 3;
+            nalStart = i;
+            continue;
+        }
+        i++;
+    }
+
+    if (!found) {
+        //NOTE: no startcodes, the whole buffer is considered a single NALU
+        manageNal(data, length, vFrame);
+        return;
+    }
+
+    if (length > nalStart) {
+        manageNal(data + nalStart, length - nalStart, vFrame);
+    }
+}
+
+void VideoThumbnailer::manageNal(unsigned char* nal, unsigned size, VideoFrame *vFrame)
+{
+    if (size == 0) {
+        return;
+    }
+
+    if (isParameterSetNal(fCodec, nal[0])) {
+        storeParameterSet(nal, size);
+        return;
+    }
+
+    if (!isRandomAccessNal(fCodec, nal[0])) {
+        discardedNals++;
+        return;
+    }
+
+    if (!collecting) {
+        if (!firstThumbnail && vFrame->getPresentationTime() - lastThumbnailPts < interval) {
+            discardedNals++;
+            return;
+        }
+
+        collecting = true;
+        auPts = vFrame->getPresentationTime();
+        auOriginTime = vFrame->getOriginTime();
+        auSeqNum = vFrame->getSequenceNumber();
+
+        accessUnit.clear();
+        accessUnit.insert(accessUnit.end(), vps.begin(), vps.end());
+        accessUnit.insert(accessUnit.end(), sps.begin(), sps.end());
+        accessUnit.insert(accessUnit.end(), pps.begin(), pps.end());
+    }
+
+    accessUnit.insert(accessUnit.end(), startCode, startCode + sizeof(startCode));
+    accessUnit.insert(accessUnit.end(), nal, nal + size);
+}
+
+void VideoThumbnailer::storeParameterSet(unsigned char* nal, unsigned size)
+{
+    std::vector<unsigned char> *paramSet;
+    unsigned char type;
+
+    if (fCodec == H264) {
+        type = nal[0] & H264_NALU_TYPE_MASK;
+        paramSet = type == H264_SPS ? &sps : &pps;
+    } else {
+        type = (nal[0] & H265_NALU_TYPE_MASK) >> 1;
+        if (type == H265_VPS) {
+            paramSet = &vps;
+        } else if (type == H265_SPS) {
+            paramSet = &sps;
+        } else {
+            paramSet = &pps;
+        }
+    }
+
+    paramSet->assign(startCode, startCode + sizeof(startCode));
+    paramSet->insert(paramSet->end(), nal, nal + size);
+}
+
+bool VideoThumbnailer::decodeAccessUnit(VideoFrame *dst)
+{
+    int len, gotFrame = 0;
+
+    if (accessUnit.empty() || !codecCtx) {
+        return false;
+    }
+
+    pkt.data = accessUnit.data();
+    pkt.size = accessUnit.size();
+    pkt.pts = auPts.count();
+
+    len = avcodec_decode_video2(codecCtx, frame, &gotFrame, &pkt);
+
+    if (len < 0) {
+        utils::warningMsg("[VideoThumbnailer] Could not decode key frame, reconfiguring decoder");
+        inputConfig();
+        return false;
+    }
+
+    if (!gotFrame || !scaleFrame(frame, dst)) {
+        return false;
+    }
+
+    firstThumbnail = false;
+    lastThumbnailPts = auPts;
+    thumbnails++;
+
+    dst->setConsumed(true);
+    dst->setPresentationTime(auPts);
+    dst->setDecodeTime(auPts);
+    dst->setOriginTime(auOriginTime);
+    dst->setSequenceNumber(auSeqNum);
+
+    return true;
+}
+
+bool VideoThumbnailer::scaleFrame(AVFrame *src, VideoFrame *dst)
+{
+    int width = outWidth;
+    int height = outHeight;
+
+    if (width <= 0) {
+        width = std::min(src->width, MAX_THUMBNAIL_WIDTH);
+    }
+
+    if (height <= 0) {
+        height = ((width * src->height / src->width) + 1) & ~1;
+    }
+
+    //NOTE: tall inputs keeping their size or aspect ratio are reduced to fit the height too
+    if (height > MAX_THUMBNAIL_HEIGHT && outHeight <= 0) {
+        height = MAX_THUMBNAIL_HEIGHT;
+        width = outWidth > 0 ? width : ((height * src->width / src->height) + 1) & ~1;
+    }
+
+    if (av_image_get_buffer_size(AV_PIX_FMT_RGB24, width, height, 1) > (int) dst->getMaxLength()) {
+        utils::errorMsg("[VideoThumbnailer] Thumbnail size exceeds the output frame buffer");
+        return false;
+    }
+
+    swsCtx = sws_getCachedContext(swsCtx, src->width, src->height, (AVPixelFormat) src->format,
+                                  width, height, AV_PIX_FMT_RGB24, SWS_FAST_BILINEAR, NULL, NULL, NULL);
+    if (!swsCtx) {
+        utils::errorMsg("[VideoThumbnailer] Could not get the swscale context");
+        return false;
+    }
+
+    if (av_image_fill_arrays(outFrame->data, outFrame->linesize, dst->getDataBuf(),
+                             AV_PIX_FMT_RGB24, width, height, 1) <= 0) {
+        utils::errorMsg("[VideoThumbnailer] Could not fill thumbnail frame");
+        return false;
+    }
+
+    if (sws_scale(swsCtx, src->data, src->linesize, 0, src->height,
+                  outFrame->data, outFrame->linesize) <= 0) {
+        utils::errorMsg("[VideoThumbnailer] Could not scale decoded frame");
+        return false;
+    }
+
+    dst->setLength(av_image_get_buffer_size(AV_PIX_FMT_RGB24, width, height, 1));
+    dst->setSize(width, height);
+    dst->setPixelFormat(RGB24);
+
+    return true;
+}
+
+bool VideoThumbnailer::reconfigure(VCodecType codec)
+{
+    if (fCodec == codec && !needsConfig) {
+        return true;
+    }
+
+    if (codec != H264 && codec != H265) {
+        utils::errorMsg("[VideoThumbnailer] Only H264 and H265 inputs are supported");
+        return false;
+    }
+
+    fCodec = codec;
+    needsConfig = false;
+    collecting = false;
+    accessUnit.clear();
+    vps.clear();
+    sps.clear();
+    pps.clear();
+
+    if (!inputConfig()) {
+        utils::errorMsg("[VideoThumbnailer] Configuring decoder");
+        return false;
+    }
+
+    return true;
+}
+
+bool VideoThumbnailer::inputConfig()
+{
+    AVCodecID libavCodecId = fCodec == H264 ? AV_CODEC_ID_H264 : AV_CODEC_ID_HEVC;
+
+    if (codecCtx != NULL) {
+        avcodec_close(codecCtx);
+        av_free(codecCtx);
+        codecCtx = NULL;
+    }
+
+    codec = avcodec_find_decoder(libavCodecId);
+    if (codec == NULL) {
+        utils::errorMsg("[VideoThumbnailer] Required codec not found");
+        return false;
+    }
+
+    codecCtx = avcodec_alloc_context3(codec);
+    if (codecCtx == NULL) {
+        return false;
+    }
+
+    //NOTE: a single thread per instance, the point is running lots of them
+    codecCtx->thread_count = 1;
+    codecCtx->flags |= CODEC_FLAG_LOW_DELAY;
+    codecCtx->skip_frame = AVDISCARD_NONKEY;
+
+    if (skipLoopFilter) {
+        codecCtx->skip_loop_filter = AVDISCARD_ALL;
+        codecCtx->flags2 |= CODEC_FLAG2_FAST;
+    }
+
+    if (lowres > 0) {
+        codecCtx->lowres = std::min(lowres, (int) av_codec_get_max_lowres(codec));
+    }
+
+    FrameQueue *inQueue = getReader(DEFAULT_ID) ? getReader(DEFAULT_ID)->getQueue() : NULL;
+    if (inQueue && inQueue->getStreamInfo()->extradata_size > 0) {
+        codecCtx->extradata = inQueue->getStreamInfo()->extradata;
+        codecCtx->extradata_size = inQueue->getStreamInfo()->extradata_size;
+    }
+
+    if (avcodec_open2(codecCtx, codec, NULL) < 0) {
+        utils::errorMsg("[VideoThumbnailer] Could not open required codec");
+        return false;
+    }
+
+    return true;
+}
+
+bool VideoThumbnailer::configure0(int interval_, int width, int height, int lowres_, bool skipLoopFilter_)
+{
+    if (interval_ < 0 || width < 0 || height < 0 || lowres_ < 0) {
+        utils::errorMsg("[VideoThumbnailer] Invalid configuration values");
+        return false;
+    }
+
+    if (width > MAX_THUMBNAIL_WIDTH || height > MAX_THUMBNAIL_HEIGHT) {
+        utils::errorMsg("[VideoThumbnailer] Thumbnail size exceeds the maximum frame size");
+        return false;
+    }
+
+    interval = std::chrono::milliseconds(interval_);
+    outWidth = width;
+    outHeight = height;
+
+    if (lowres != lowres_ || skipLoopFilter != skipLoopFilter_) {
+        lowres = lowres_;
+        skipLoopFilter = skipLoopFilter_;
+        needsConfig = fCodec != VC_NONE;
+    }
+
+    return true;
+}
+
+bool VideoThumbnailer::configEvent(Jzon::Node* params)
+{
+    int interval_, width, height, lowres_;
+    bool skipLoopFilter_;
+
+    if (!params) {
+        return false;
+    }
+
+    interval_ = std::chrono::duration_cast<std::chrono::milliseconds>(interval).count();
+    width = outWidth;
+    height = outHeight;
+    lowres_ = lowres;
+    skipLoopFilter_ = skipLoopFilter;
+
+    if (params->Has("interval") && params->Get("interval").IsNumber()) {
+        interval_ = params->Get("interval").ToInt();
+    }
+
+    if (params->Has("width") && params->Get("width").IsNumber()) {
+        width = params->Get("width").ToInt();
+    }
+
+    if (params->Has("height") && params->Get("height").IsNumber()) {
+        height = params->Get("height").ToInt();
+    }
+
+    if (params->Has("lowres") && params->Get("lowres").IsNumber()) {
+        lowres_ = params->Get("lowres").ToInt();
+    }
+
+    if (params->Has("skipLoopFilter") && params->Get("skipLoopFilter").IsBool()) {
+        skipLoopFilter_ = params->Get("skipLoopFilter").ToBool();
+    }
+
+    return configure0(interval_, width, height, lowres_, skipLoopFilter_);
+}
+
+void VideoThumbnailer::initializeEventMap()
+{
+    eventMap["configure"] = std::bind(&VideoThumbnailer::configEvent, this, std::placeholders::_1);
+}
+
+void VideoThumbnailer::doGetState(Jzon::Object &filterNode)
+{
+    filterNode.Add("codec", utils::getVideoCodecAsString(fCodec));
+    filterNode.Add("interval", (int) std::chrono::duration_cast<std::chrono::milliseconds>(interval).count());
+    filterNode.Add("width", outWidth);
+    filterNode.Add("height", outHeight);
+    filterNode.Add("lowres", lowres);
+    filterNode.Add("skipLoopFilter", skipLoopFilter);
+    filterNode.Add("thumbnails", (int) thumbnails);
+    filterNode.Add("discardedNals", (int) discardedNals);
+}
+
+bool VideoThumbnailer::configure(int interval, int width, int height, int lowres, bool skipLoopFilter)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configure");
+    params.Add("interval", interval);
+    params.Add("width", width);
+    params.Add("height", height);
+    params.Add("lowres", lowres);
+    params.Add("skipLoopFilter", skipLoopFilter);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
@@ -0,0 +1,143 @@
+/*
+ *  VideoThumbnailer.hh - A keyframe-only H264/H265 thumbnail extractor
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _VIDEO_THUMBNAILER_HH
+#define _VIDEO_THUMBNAILER_HH
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libswscale/swscale.h>
+    #include <libavutil/imgutils.h>
+}
+
+#include <vector>
+
+#include "../../VideoFrame.hh"
+#include "../../FrameQueue.hh"
+#include "../../Filter.hh"
+#include "../../StreamInfo.hh"
+
+#define DEFAULT_THUMBNAIL_INTERVAL 5000 //ms
+#define DEFAULT_THUMBNAIL_WIDTH 160
+#define DEFAULT_THUMBNAIL_HEIGHT 0 //0 keeps input aspect ratio
+#define MAX_THUMBNAIL_WIDTH DEFAULT_WIDTH //output frames are allocated with the default size
+#define MAX_THUMBNAIL_HEIGHT DEFAULT_HEIGHT
+#define THUMBNAIL_QUEUE_FRAMES 2
+
+/*! Lightweight alternative to a VideoDecoderLibav + VideoResampler chain used to
+    generate channel previews. Incoming H264/H265 NALUs are inspected and only the
+    random access pictures (IDR for H264, IRAP for H265) separated at least by
+    the configured interval are decoded. The rest of the stream is discarded
+    without reaching libav. Decoded pictures are scaled to a small RGB24 frame.
+*/
+
+class VideoThumbnailer : public OneToOneFilter {
+
+public:
+    /**
+    * Class constructor
+    */
+    VideoThumbnailer();
+    ~VideoThumbnailer();
+
+    /**
+    * Configures the thumbnailer
+    * @param interval Minimum time between thumbnails in milliseconds
+    * @param width Thumbnail width, 0 to keep the input width (up to MAX_THUMBNAIL_WIDTH)
+    * @param height Thumbnail height, 0 to keep the input aspect ratio (up to MAX_THUMBNAIL_HEIGHT)
+    * @param lowres Decoder lowres factor (only used if the codec supports it)
+    * @param skipLoopFilter If true, the deblocking filter is skipped while decoding
+    * @return true if configuration succeeded and false if not
+    */
+    bool configure(int interval, int width, int height, int lowres = 0, bool skipLoopFilter = true);
+
+    /**
+    * Checks if a NALU header corresponds to a random access picture slice
+    * @param codec Input codec (H264 or H265)
+    * @param nalHeader First byte of the NALU (after the startcode)
+    * @return true if the slice can be decoded without previous pictures
+    */
+    static bool isRandomAccessNal(VCodecType codec, unsigned char nalHeader);
+
+    /**
+    * Checks if a NALU header corresponds to a parameter set (VPS, SPS or PPS)
+    * @param codec Input codec (H264 or H265)
+    * @param nalHeader First byte of the NALU (after the startcode)
+    * @return true if the NALU is a parameter set
+    */
+    static bool isParameterSetNal(VCodecType codec, unsigned char nalHeader);
+
+protected:
+    bool configure0(int interval, int width, int height, int lowres, bool skipLoopFilter);
+    bool doProcessFrame(Frame *org, Frame *dst);
+    bool scaleFrame(AVFrame *src, VideoFrame *dst);
+
+private:
+    void initializeEventMap();
+    FrameQueue* allocQueue(ConnectionData cData);
+    bool configEvent(Jzon::Node* params);
+    void doGetState(Jzon::Object &filterNode);
+    bool reconfigure(VCodecType codec);
+    bool inputConfig();
+    void parseNals(VideoFrame *vFrame);
+    void manageNal(unsigned char* nal, unsigned size, VideoFrame *vFrame);
+    void storeParameterSet(unsigned char* nal, unsigned size);
+    bool decodeAccessUnit(VideoFrame *dst);
+
+    //There is no need of specific reader configuration
+    bool specificReaderConfig(int /*readerID*/, FrameQueue* /*queue*/)  {return true;};
+    bool specificReaderDelete(int /*readerID*/) {return true;};
+
+    //NOTE: There is no need of specific writer configuration
+    bool specificWriterConfig(int /*writerID*/) {return true;};
+    bool specificWriterDelete(int /*writerID*/) {return true;};
+
+    AVCodec             *codec;
+    AVCodecContext      *codecCtx;
+    AVFrame             *frame, *outFrame;
+    AVPacket            pkt;
+    struct SwsContext   *swsCtx;
+
+    StreamInfo          *outputStreamInfo;
+    VCodecType          fCodec;
+
+    std::vector<unsigned char>      vps, sps, pps;
+    std::vector<unsigned char>      accessUnit;
+    bool                            collecting;
+    std::chrono::microseconds       auPts;
+    std::chrono::system_clock::time_point auOriginTime;
+    size_t                          auSeqNum;
+
+    std::chrono::microseconds       interval;
+    std::chrono::microseconds       lastThumbnailPts;
+    bool                            firstThumbnail;
+    int                             outWidth;
+    int                             outHeight;
+    int                             lowres;
+    bool                            skipLoopFilter;
+    bool                            needsConfig;
+
+    unsigned                        thumbnails;
+    unsigned                        discardedNals;
+};
+
+#endif
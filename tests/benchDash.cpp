@@ -0,0 +1,576 @@
+#include "../src/modules/dasher/Dasher.hh"
+#include "../src/AVFramedQueue.hh"
+#include "../src/VideoFrame.hh"
+#include "../src/AudioFrame.hh"
+#include "../src/Utils.hh"
+
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+#include <string>
+
+#define BASE_FOLDER "/tmp/benchdash"
+#define BASE_NAME "bench"
+#define V_READER_ID 1
+#define A_READER_ID 2
+#define MAX_SEGMENTS 6
+#define MIN_BUFFER 4
+#define SEG_DURATION 2 //sec
+#define MEDIA_DURATION 60 //sec of media per dasher
+#define FRAME_RATE 25
+#define V_WIDTH 1280
+#define V_HEIGHT 720
+#define V_BITRATE 2000 //kbps, synthetic streams
+#define A_BITRATE 128 //kbps, synthetic streams
+#define A_SAMPLE_RATE 48000
+#define A_CHANNELS 2
+#define AAC_FRAME_SAMPLES 1024
+#define ADTS_HEADER_LENGTH 7
+#define TIME_OFFSET 1000000 //us, frame times start after 0
+#define MAX_DASHERS 32
+
+/*! Access unit of an elementary stream: the NALs of a video frame or an ADTS frame */
+
+struct AccessUnit {
+    std::vector<std::vector<unsigned char>> units;
+    unsigned char intra;
+};
+
+/*! Head filter which writes the access units of an elementary stream one by one, a NAL or an ADTS
+    frame each time it is processed. Timestamps are generated from the frame rate (or the AAC frame
+    duration), so files are looped to reach any media duration */
+
+class StreamSource : public HeadFilter {
+
+public:
+    StreamSource(StreamInfo* info, std::vector<AccessUnit>& aus, std::chrono::microseconds auDuration) :
+        HeadFilter(1), info(info), aus(aus), auDuration(auDuration), au(0), unit(0), pushed(0) {};
+
+    ~StreamSource() {delete info;};
+
+    std::chrono::microseconds getNextTime() {return std::chrono::microseconds(TIME_OFFSET) + auDuration*au;};
+    size_t getPushed() {return pushed;};
+
+protected:
+    bool doProcessFrame(std::map<int, Frame*> &dstFrames, int& ret)
+    {
+        const std::vector<unsigned char>& data = aus[au % aus.size()].units[unit];
+        Frame* frame = dstFrames.begin()->second;
+        VideoFrame* vFrame;
+        AudioFrame* aFrame;
+
+        if (data.size() > frame->getMaxLength()) {
+            utils::errorMsg("Access unit bigger than the frame buffer, skipped");
+            return false;
+        }
+
+        memcpy(frame->getDataBuf(), data.data(), data.size());
+        frame->setLength(data.size());
+        frame->setPresentationTime(getNextTime());
+        frame->setDecodeTime(getNextTime());
+        frame->setConsumed(true);
+
+        if ((vFrame = dynamic_cast<VideoFrame*>(frame)) != NULL) {
+            vFrame->setSize(V_WIDTH, V_HEIGHT);
+        }
+
+        if ((aFrame = dynamic_cast<AudioFrame*>(frame)) != NULL) {
+            aFrame->setChannels(info->audio.channels);
+            aFrame->setSampleRate(info->audio.sampleRate);
+            aFrame->setSamples(AAC_FRAME_SAMPLES);
+        }
+
+        if (++unit >= aus[au % aus.size()].units.size()) {
+            unit = 0;
+            au++;
+        }
+
+        pushed++;
+        ret = 0;
+        return true;
+    }
+
+    void doGetState(Jzon::Object &filterNode) {};
+
+private:
+    FrameQueue *allocQueue(ConnectionData cData)
+    {
+        if (info->type == VIDEO) {
+            return VideoFrameQueue::createNew(cData, info, DEFAULT_VIDEO_FRAMES);
+        }
+
+        return AudioFrameQueue::createNew(cData, info, DEFAULT_AUDIO_FRAMES);
+    };
+
+    bool specificWriterConfig(int /*writerID*/) {return true;};
+    bool specificWriterDelete(int /*writerID*/) {return true;};
+
+    StreamInfo* info;
+    std::vector<AccessUnit>& aus;
+    std::chrono::microseconds auDuration;
+    size_t au;
+    size_t unit;
+    size_t pushed;
+};
+
+struct BenchConfig {
+    std::string folder;
+    std::vector<AccessUnit> video;
+    std::vector<AccessUnit> audio;
+    VCodecType vCodec;
+    unsigned mediaDuration;
+    unsigned segDuration;
+    unsigned chunkFrames;
+    bool byteRange;
+    bool serial;
+    bool realTime;
+};
+
+struct BenchResult {
+    size_t frames;
+    uint64_t segments;
+    uint64_t appendTime;     //us
+    uint64_t maxAppendTime;  //us
+    uint64_t segmenterMemory;
+    float avgWriteLatency;   //ms
+    float maxWriteLatency;   //ms
+    uint64_t writeStalls;
+    bool failed;
+};
+
+bool isVideoVcl(VCodecType codec, unsigned char* nal)
+{
+    unsigned char type = codec == H264 ? nal[0] & 0x1F : (nal[0] >> 1) & 0x3F;
+
+    return codec == H264 ? (type == 1 || type == 5) : type < 32;
+}
+
+bool isVideoIntra(VCodecType codec, unsigned char* nal)
+{
+    unsigned char type = codec == H264 ? nal[0] & 0x1F : (nal[0] >> 1) & 0x3F;
+
+    return codec == H264 ? type == 5 : (type >= 16 && type <= 21);
+}
+
+//NOTE: a VCL NAL starts a new frame if its first slice flag (first bit after the NAL header) is set,
+//      non-VCL NALs after a VCL one always start it
+void parseAnnexB(std::vector<unsigned char>& data, VCodecType codec, std::vector<AccessUnit>& aus)
+{
+    size_t headerLength = codec == H264 ? 1 : 2;
+    size_t pos = 0;
+    size_t start;
+    size_t next;
+    bool vcl = false;
+    unsigned char* nal;
+
+    while (pos + 3 < data.size() && !(data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 1)) {
+        pos++;
+    }
+
+    while (pos + 3 < data.size()) {
+        start = pos;
+        next = pos + 3;
+
+        while (next + 3 <= data.size() && !(data[next] == 0 && data[next + 1] == 0 && data[next + 2] == 1)) {
+            next++;
+        }
+
+        next = next + 3 > data.size() ? data.size() : next;
+        nal = data.data() + start + 3;
+        pos = next;
+
+        //NOTE: trailing zeros belong to the next start code
+        while (next > start + 3 && data[next - 1] == 0 && next < data.size()) {
+            next--;
+        }
+
+        if (next <= start + 3 + headerLength) {
+            continue;
+        }
+
+        if (aus.empty() || (vcl && !isVideoVcl(codec, nal)) ||
+            (isVideoVcl(codec, nal) && (nal[headerLength] & 0x80) && vcl)) {
+            aus.push_back(AccessUnit());
+            aus.back().intra = 0;
+            vcl = false;
+        }
+
+        vcl |= isVideoVcl(codec, nal);
+        aus.back().intra |= isVideoIntra(codec, nal);
+        aus.back().units.push_back(std::vector<unsigned char>(data.begin() + start, data.begin() + next));
+    }
+}
+
+void parseADTS(std::vector<unsigned char>& data, std::vector<AccessUnit>& aus)
+{
+    size_t pos = 0;
+    size_t length;
+
+    while (pos + ADTS_HEADER_LENGTH <= data.size()) {
+        if (data[pos] != 0xFF || (data[pos + 1] & 0xF6) != 0xF0) {
+            pos++;
+            continue;
+        }
+
+        length = ((data[pos + 3] & 0x03) << 11) | (data[pos + 4] << 3) | (data[pos + 5] >> 5);
+
+        if (length < ADTS_HEADER_LENGTH || pos + length > data.size()) {
+            break;
+        }
+
+        aus.push_back(AccessUnit());
+        aus.back().intra = 1;
+        aus.back().units.push_back(std::vector<unsigned char>(data.begin() + pos, data.begin() + pos + length));
+        pos += length;
+    }
+}
+
+bool readFile(std::string name, std::vector<unsigned char>& data)
+{
+    std::ifstream file(name, std::ifstream::binary);
+
+    if (!file) {
+        return false;
+    }
+
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !data.empty();
+}
+
+std::vector<unsigned char> syntheticNal(std::vector<unsigned char> header, size_t length, unsigned seed)
+{
+    std::vector<unsigned char> nal = {0, 0, 0, 1};
+
+    nal.insert(nal.end(), header.begin(), header.end());
+
+    //NOTE: no emulation prevention is needed, the payload never has two zero bytes
+    for (size_t i = nal.size(); i < length; i++) {
+        nal.push_back((unsigned char) ((i*31 + seed) % 255 + 1));
+    }
+
+    return nal;
+}
+
+//NOTE: the segmenters do not parse parameter sets, only the NAL types and the first slice flag matter
+void syntheticVideo(VCodecType codec, unsigned frames, unsigned gop, std::vector<AccessUnit>& aus)
+{
+    size_t frameSize = V_BITRATE*1000/8/FRAME_RATE;
+    bool h264 = codec == H264;
+
+    for (unsigned i = 0; i < frames; i++) {
+        aus.push_back(AccessUnit());
+        aus.back().intra = i % gop == 0;
+
+        if (i % gop == 0 && h264) {
+            aus.back().units.push_back(syntheticNal({0x67, 0x42, 0xC0, 0x1E, 0xDA}, 12, i));
+            aus.back().units.push_back(syntheticNal({0x68, 0xCE, 0x3C, 0x80}, 8, i));
+        } else if (i % gop == 0) {
+            aus.back().units.push_back(syntheticNal({0x40, 0x01, 0x0C}, 24, i));
+            aus.back().units.push_back(syntheticNal({0x42, 0x01, 0x01}, 40, i));
+            aus.back().units.push_back(syntheticNal({0x44, 0x01, 0xC1}, 10, i));
+        }
+
+        //NOTE: intra frames are 4 times bigger than the rest
+        if (h264) {
+            aus.back().units.push_back(syntheticNal({(unsigned char) (i % gop == 0 ? 0x65 : 0x41), 0x88},
+                                                    i % gop == 0 ? frameSize*4 : frameSize, i));
+        } else {
+            aus.back().units.push_back(syntheticNal({(unsigned char) (i % gop == 0 ? 0x26 : 0x02), 0x01, 0x80},
+                                                    i % gop == 0 ? frameSize*4 : frameSize, i));
+        }
+    }
+}
+
+void syntheticAudio(unsigned frames, std::vector<AccessUnit>& aus)
+{
+    size_t length = A_BITRATE*1000/8*AAC_FRAME_SAMPLES/A_SAMPLE_RATE;
+    std::vector<unsigned char> frame;
+
+    for (unsigned i = 0; i < frames; i++) {
+        //NOTE: ADTS header of AAC LC, 48 kHz (index 3), stereo, without CRC
+        frame = {0xFF, 0xF1, 0x4C, 0x80, (unsigned char) ((length >> 3) & 0xFF),
+                 (unsigned char) (((length & 0x07) << 5) | 0x1F), 0xFC};
+
+        for (size_t j = frame.size(); j < length; j++) {
+            frame.push_back((unsigned char) (j*17 + i));
+        }
+
+        aus.push_back(AccessUnit());
+        aus.back().intra = 1;
+        aus.back().units.push_back(frame);
+    }
+}
+
+//NOTE: sources are processed in timestamp order and the dasher after each written frame,
+//      so the dasher consumes the frames exactly as they are produced. Dasher hides the
+//      public processFrame, hence it is called through BaseFilter
+void runDasher(BenchConfig* cfg, unsigned index, BenchResult* result)
+{
+    Dasher* dasher = new Dasher();
+    BaseFilter* filter = dasher;
+    StreamSource* vSource = NULL;
+    StreamSource* aSource = NULL;
+    StreamSource* source;
+    StreamInfo* info;
+    Jzon::Object state;
+    std::string folder = cfg->folder + "/" + std::to_string(index);
+    std::chrono::microseconds end = std::chrono::microseconds(TIME_OFFSET) + std::chrono::seconds(cfg->mediaDuration);
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point t0;
+    uint64_t elapsed;
+    int ret;
+
+    memset(result, 0, sizeof(BenchResult));
+    mkdir(folder.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+
+    if (!dasher->configure(folder, BASE_NAME, cfg->segDuration, MAX_SEGMENTS, MIN_BUFFER, 0,
+                           cfg->chunkFrames, false, cfg->byteRange)) {
+        result->failed = true;
+        delete dasher;
+        return;
+    }
+
+    dasher->setParallel(!cfg->serial);
+
+    if (!cfg->video.empty()) {
+        info = new StreamInfo(VIDEO);
+        info->video.codec = cfg->vCodec;
+        info->setCodecDefaults();
+        vSource = new StreamSource(info, cfg->video, std::chrono::microseconds(1000000/FRAME_RATE));
+        result->failed |= !vSource->connectOneToMany(dasher, V_READER_ID);
+    }
+
+    if (!cfg->audio.empty()) {
+        info = new StreamInfo(AUDIO);
+        info->audio.codec = AAC;
+        info->audio.sampleRate = A_SAMPLE_RATE;
+        info->audio.channels = A_CHANNELS;
+        info->setCodecDefaults();
+        aSource = new StreamSource(info, cfg->audio, std::chrono::microseconds(1000000*AAC_FRAME_SAMPLES/A_SAMPLE_RATE));
+        result->failed |= !aSource->connectOneToMany(dasher, A_READER_ID);
+    }
+
+    start = std::chrono::steady_clock::now();
+
+    while (!result->failed) {
+        source = !aSource || (vSource && vSource->getNextTime() <= aSource->getNextTime()) ? vSource : aSource;
+
+        if (source->getNextTime() >= end) {
+            break;
+        }
+
+        if (cfg->realTime) {
+            std::this_thread::sleep_until(start + source->getNextTime() - std::chrono::microseconds(TIME_OFFSET));
+        }
+
+        source->processFrame(ret);
+
+        //NOTE: frames of several readers can be consumed in a single call
+        do {
+            t0 = std::chrono::steady_clock::now();
+            filter->processFrame(ret);
+            elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+            result->appendTime += elapsed;
+            result->maxAppendTime = std::max(result->maxAppendTime, elapsed);
+        } while (ret != WAIT);
+    }
+
+    dasher->getState(state);
+    result->frames = (vSource ? vSource->getPushed() : 0) + (aSource ? aSource->getPushed() : 0);
+    result->segments = std::stoull(state.Get("writtenSegments").ToString());
+    result->segmenterMemory = std::stoull(state.Get("segmenterMemory").ToString());
+    result->avgWriteLatency = state.Get("ioAvgLatencyMs").ToFloat();
+    result->maxWriteLatency = state.Get("ioMaxLatencyMs").ToFloat();
+    result->writeStalls = std::stoull(state.Get("ioStalls").ToString());
+
+    delete vSource;
+    delete aSource;
+    delete dasher;
+}
+
+void usage() {
+    utils::infoMsg("Usage:\n"
+        "-v <H.264 or H.265 Annex B file, synthetic H.264 if not set>\n"
+        "-vcodec <h264|h265, video codec of the file or the synthetic stream>\n"
+        "-a <AAC ADTS file, synthetic AAC if not set>\n"
+        "-novideo | -noaudio\n"
+        "-f <dash folder>\n"
+        "-n <max number of dashers>\n"
+        "-d <seconds of media per dasher>\n"
+        "-s <segment duration in seconds>\n"
+        "-chunkFrames <frames per chunk, low latency mode>\n"
+        "-byteRange\n"
+        "-realtime\n"
+        "-serial (segment every representation in the dasher thread instead of in the JobsPool)\n"
+        "-statsfile <output statistics filename>\n"
+        "\n"
+        "benchdash runs from 1 to <max number of dashers> dashers simultaneously, each one in its own\n"
+        "thread and fed with the same elementary streams at max speed (or real-time pace), and\n"
+        "outputs segments/s, per-frame processing cost, peak memory and write latency of each run.\n"
+        "Files are looped to reach the media duration, synthetic streams have an intra frame at\n"
+        "the start of every segment. Subfolders are created inside <dash folder> to avoid collisions.\n");
+}
+
+int main (int argc, char *argv[]) {
+    BenchConfig cfg;
+    BenchResult results[MAX_DASHERS];
+    std::vector<std::thread> threads;
+    std::vector<unsigned char> data;
+    std::string vFile, aFile, statsFilename;
+    unsigned maxDashers = 1;
+    bool noVideo = false, noAudio = false;
+    struct rusage resources;
+    FILE *f;
+
+    cfg.folder = BASE_FOLDER;
+    cfg.vCodec = H264;
+    cfg.mediaDuration = MEDIA_DURATION;
+    cfg.segDuration = SEG_DURATION;
+    cfg.chunkFrames = 0;
+    cfg.byteRange = false;
+    cfg.serial = false;
+    cfg.realTime = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i],"-v")==0 && i + 1 < argc) {
+            vFile = argv[++i];
+        } else if (strcmp(argv[i],"-vcodec")==0 && i + 1 < argc) {
+            cfg.vCodec = strcmp(argv[++i],"h265")==0 ? H265 : H264;
+        } else if (strcmp(argv[i],"-a")==0 && i + 1 < argc) {
+            aFile = argv[++i];
+        } else if (strcmp(argv[i],"-novideo")==0) {
+            noVideo = true;
+        } else if (strcmp(argv[i],"-noaudio")==0) {
+            noAudio = true;
+        } else if (strcmp(argv[i],"-f")==0 && i + 1 < argc) {
+            cfg.folder = argv[++i];
+        } else if (strcmp(argv[i],"-n")==0 && i + 1 < argc) {
+            maxDashers = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i],"-d")==0 && i + 1 < argc) {
+            cfg.mediaDuration = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i],"-s")==0 && i + 1 < argc) {
+            cfg.segDuration = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i],"-chunkFrames")==0 && i + 1 < argc) {
+            cfg.chunkFrames = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i],"-byteRange")==0) {
+            cfg.byteRange = true;
+        } else if (strcmp(argv[i],"-serial")==0) {
+            cfg.serial = true;
+        } else if (strcmp(argv[i],"-realtime")==0) {
+            cfg.realTime = true;
+        } else if (strcmp(argv[i],"-statsfile")==0 && i + 1 < argc) {
+            statsFilename = argv[++i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (maxDashers == 0 || maxDashers > MAX_DASHERS || cfg.mediaDuration == 0 || cfg.segDuration == 0 ||
+        (noVideo && noAudio)) {
+        usage();
+        return 1;
+    }
+
+    if (!noVideo && !vFile.empty()) {
+        if (!readFile(vFile, data)) {
+            utils::errorMsg("Error reading video file " + vFile);
+            return 1;
+        }
+
+        parseAnnexB(data, cfg.vCodec, cfg.video);
+    } else if (!noVideo) {
+        syntheticVideo(cfg.vCodec, FRAME_RATE*cfg.segDuration*MAX_SEGMENTS, FRAME_RATE*cfg.segDuration, cfg.video);
+    }
+
+    if (!noAudio && !aFile.empty()) {
+        if (!readFile(aFile, data)) {
+            utils::errorMsg("Error reading audio file " + aFile);
+            return 1;
+        }
+
+        parseADTS(data, cfg.audio);
+    } else if (!noAudio) {
+        syntheticAudio(A_SAMPLE_RATE/AAC_FRAME_SAMPLES*cfg.segDuration*MAX_SEGMENTS, cfg.audio);
+    }
+
+    if ((!noVideo && cfg.video.empty()) || (!noAudio && cfg.audio.empty())) {
+        utils::errorMsg("No access units found in the input files");
+        return 1;
+    }
+
+    utils::infoMsg("Video access units: " + std::to_string(cfg.video.size()) +
+                   ", audio access units: " + std::to_string(cfg.audio.size()));
+
+    mkdir(cfg.folder.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+
+    printf("Dashers\tWall s\tSegments\tSeg/s\tAvg frame us\tMax frame us\tPeak RSS MB\tSegmenter MB\t"
+           "Avg write ms\tMax write ms\tWrite stalls\n");
+
+    for (unsigned n = 1; n <= maxDashers; n++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        BenchResult total;
+        double wall;
+
+        memset(&total, 0, sizeof(total));
+        threads.clear();
+
+        for (unsigned i = 0; i < n; i++) {
+            threads.push_back(std::thread(runDasher, &cfg, i, &results[i]));
+        }
+
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (unsigned i = 0; i < n; i++) {
+            if (results[i].failed) {
+                utils::errorMsg("Dasher " + std::to_string(i) + " could not be configured");
+                return 1;
+            }
+
+            total.frames += results[i].frames;
+            total.segments += results[i].segments;
+            total.appendTime += results[i].appendTime;
+            total.maxAppendTime = std::max(total.maxAppendTime, results[i].maxAppendTime);
+            total.segmenterMemory += results[i].segmenterMemory;
+            total.avgWriteLatency += results[i].avgWriteLatency/n;
+            total.maxWriteLatency = std::max(total.maxWriteLatency, results[i].maxWriteLatency);
+            total.writeStalls += results[i].writeStalls;
+        }
+
+        //NOTE: peak resident memory of the whole process, it includes the previous runs
+        getrusage(RUSAGE_SELF, &resources);
+
+        printf("%u\t%.3f\t%lu\t%.2f\t%.2f\t%lu\t%.1f\t%.1f\t%.3f\t%.3f\t%lu\n", n, wall,
+               (unsigned long) total.segments, total.segments/wall,
+               total.frames > 0 ? (double) total.appendTime/total.frames : 0, (unsigned long) total.maxAppendTime,
+               resources.ru_maxrss/1024.0, total.segmenterMemory/(1024.0*1024.0),
+               total.avgWriteLatency, total.maxWriteLatency, (unsigned long) total.writeStalls);
+        fflush(stdout);
+
+        if (statsFilename.empty()) {
+            continue;
+        }
+
+        if (!(f = fopen(statsFilename.c_str(), "a+t"))) {
+            utils::errorMsg("Could not open result statsfile: " + statsFilename);
+            return 1;
+        }
+
+        fprintf(f, "%u\t%f\t%lu\t%f\t%f\t%lu\t%ld\t%lu\t%f\t%f\t%lu\n", n, wall, (unsigned long) total.segments,
+                total.segments/wall, total.frames > 0 ? (double) total.appendTime/total.frames : 0,
+                (unsigned long) total.maxAppendTime, resources.ru_maxrss, (unsigned long) total.segmenterMemory,
+                total.avgWriteLatency, total.maxWriteLatency, (unsigned long) total.writeStalls);
+        fclose(f);
+    }
+
+    return 0;
+}
@@ -0,0 +1,255 @@
+#include "../src/modules/videoEncoder/VideoEncoderX264.hh"
+#include "../src/modules/videoEncoder/VideoEncoderX264Ladder.hh"
+#include "../src/VideoFrame.hh"
+#include "../src/Utils.hh"
+
+extern "C" {
+    #include <libswscale/swscale.h>
+    #include <libavutil/imgutils.h>
+}
+
+#include <sys/resource.h>
+#include <string.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <map>
+
+#define IN_WIDTH 1280
+#define IN_HEIGHT 720
+#define FRAME_RATE 25
+#define GOP 50
+#define LOOKAHEAD 0
+#define B_FRAMES 0
+#define THREADS 1
+#define PRESET "veryfast"
+#define FRAMES 500
+#define PATTERN_FRAMES 100
+
+/*! Exposes the protected methods used to step the encoders without queues nor workers */
+
+class LadderBench : public VideoEncoderX264Ladder {
+public:
+    using VideoEncoderX264Ladder::configure0;
+    using VideoEncoderX264Ladder::configRendition0;
+    using VideoEncoderX264Ladder::specificWriterConfig;
+    using VideoEncoderX264Ladder::doProcessFrame;
+};
+
+class EncoderBench : public VideoEncoderX264 {
+public:
+    using VideoEncoderX264::configure0;
+    using VideoEncoderX264::doProcessFrame;
+};
+
+struct Rendition {
+    int width;
+    int height;
+    int bitrate;
+};
+
+struct BenchResult {
+    double cpu;
+    double wall;
+    size_t frames;
+};
+
+double cpuSeconds()
+{
+    struct rusage resources;
+
+    getrusage(RUSAGE_SELF, &resources);
+    return resources.ru_utime.tv_sec + resources.ru_stime.tv_sec +
+           (resources.ru_utime.tv_usec + resources.ru_stime.tv_usec)/1000000.0;
+}
+
+//NOTE: moving gradients with a scene change every 4 seconds, so that encoders have real work to do
+void syntheticFrames(std::vector<InterleavedVideoFrame*>& frames)
+{
+    for (int i = 0; i < PATTERN_FRAMES; i++) {
+        InterleavedVideoFrame* frame = InterleavedVideoFrame::createNew(RAW, IN_WIDTH, IN_HEIGHT, YUV420P);
+        unsigned char* data = frame->getDataBuf();
+        int scene = i/(FRAME_RATE*4);
+
+        for (int y = 0; y < IN_HEIGHT; y++) {
+            for (int x = 0; x < IN_WIDTH; x++) {
+                data[y*IN_WIDTH + x] = (x*(scene + 1) + y*(3 - scene % 3) + i*4) & 0xFF;
+            }
+        }
+
+        memset(data + IN_WIDTH*IN_HEIGHT, 128 + scene*16, IN_WIDTH*IN_HEIGHT/2);
+        frame->setLength(IN_WIDTH*IN_HEIGHT*3/2);
+        frames.push_back(frame);
+    }
+}
+
+void prepareFrame(InterleavedVideoFrame* frame, int i)
+{
+    frame->setPresentationTime(std::chrono::microseconds(i*1000000/FRAME_RATE));
+    frame->setSequenceNumber(i);
+}
+
+bool runLadder(std::vector<Rendition>& ladder, std::vector<InterleavedVideoFrame*>& frames, BenchResult* result)
+{
+    LadderBench encoder;
+    std::map<int, Frame*> dstFrames;
+    std::chrono::steady_clock::time_point start;
+    double cpu;
+
+    if (!encoder.configure0(FRAME_RATE, GOP, LOOKAHEAD, B_FRAMES, THREADS, true, PRESET)) {
+        return false;
+    }
+
+    for (size_t id = 0; id < ladder.size(); id++) {
+        if (!encoder.specificWriterConfig(id) ||
+            !encoder.configRendition0(id, ladder[id].width, ladder[id].height, ladder[id].bitrate)) {
+            return false;
+        }
+        dstFrames[id] = SlicedVideoFrame::createNew(H264);
+    }
+
+    cpu = cpuSeconds();
+    start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < FRAMES; i++) {
+        for (auto d : dstFrames) {
+            dynamic_cast<SlicedVideoFrame*>(d.second)->clear();
+        }
+
+        prepareFrame(frames[i % frames.size()], i);
+        if (encoder.doProcessFrame(frames[i % frames.size()], dstFrames)) {
+            result->frames++;
+        }
+    }
+
+    result->wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result->cpu = cpuSeconds() - cpu;
+
+    for (auto d : dstFrames) {
+        delete d.second;
+    }
+
+    return true;
+}
+
+//NOTE: one VideoResampler (swscale from the input picture) and one VideoEncoderX264 per rendition,
+//      as in a pipeline with a filter chain for each rendition
+bool runSeparate(std::vector<Rendition>& ladder, std::vector<InterleavedVideoFrame*>& frames, BenchResult* result)
+{
+    std::vector<EncoderBench*> encoders;
+    std::vector<InterleavedVideoFrame*> scaled;
+    std::vector<struct SwsContext*> contexts;
+    SlicedVideoFrame* codedFrame = SlicedVideoFrame::createNew(H264);
+    std::chrono::steady_clock::time_point start;
+    unsigned char* inData[4];
+    int inLinesize[4];
+    unsigned char* outData[4];
+    int outLinesize[4];
+    bool ok = true;
+    double cpu;
+
+    for (auto r : ladder) {
+        int height = r.height > 0 ? r.height : ((r.width * IN_HEIGHT / IN_WIDTH) & ~1);
+
+        encoders.push_back(new EncoderBench());
+        scaled.push_back(InterleavedVideoFrame::createNew(RAW, r.width, height, YUV420P));
+        scaled.back()->setSize(r.width, height);
+        scaled.back()->setLength(r.width*height*3/2);
+        contexts.push_back(sws_getContext(IN_WIDTH, IN_HEIGHT, AV_PIX_FMT_YUV420P, r.width, height,
+                                          AV_PIX_FMT_YUV420P, SWS_FAST_BILINEAR, 0, 0, 0));
+
+        ok &= contexts.back() != NULL &&
+              encoders.back()->configure0(r.bitrate, FRAME_RATE, GOP, LOOKAHEAD, B_FRAMES, THREADS, true, PRESET, 0);
+    }
+
+    cpu = cpuSeconds();
+    start = std::chrono::steady_clock::now();
+
+    for (int i = 0; ok && i < FRAMES; i++) {
+        InterleavedVideoFrame* frame = frames[i % frames.size()];
+
+        prepareFrame(frame, i);
+        av_image_fill_arrays(inData, inLinesize, frame->getDataBuf(), AV_PIX_FMT_YUV420P, IN_WIDTH, IN_HEIGHT, 1);
+
+        for (size_t n = 0; n < encoders.size(); n++) {
+            av_image_fill_arrays(outData, outLinesize, scaled[n]->getDataBuf(), AV_PIX_FMT_YUV420P,
+                                 scaled[n]->getWidth(), scaled[n]->getHeight(), 1);
+            sws_scale(contexts[n], inData, inLinesize, 0, IN_HEIGHT, outData, outLinesize);
+            prepareFrame(scaled[n], i);
+
+            codedFrame->clear();
+            if (encoders[n]->doProcessFrame(scaled[n], codedFrame) && n == 0) {
+                result->frames++;
+            }
+        }
+    }
+
+    result->wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result->cpu = cpuSeconds() - cpu;
+
+    for (size_t n = 0; n < encoders.size(); n++) {
+        sws_freeContext(contexts[n]);
+        delete encoders[n];
+        delete scaled[n];
+    }
+
+    delete codedFrame;
+    return ok;
+}
+
+void usage() {
+    utils::infoMsg("Usage:\n"
+        "-r <width>x<height>:<kbps> (rendition, height 0 keeps the input aspect ratio, repeat for each one)\n"
+        "\n"
+        "benchladder encodes the same synthetic 1280x720 input into an ABR ladder, first with one\n"
+        "VideoEncoderX264Ladder and then with one swscale + VideoEncoderX264 chain per rendition, and\n"
+        "outputs the process CPU time and the wall time of each run. Both runs use the same preset,\n"
+        "GOP, lookahead, B-frames and threads per rendition.\n");
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<Rendition> ladder;
+    std::vector<InterleavedVideoFrame*> frames;
+    BenchResult ladderResult = {0, 0, 0};
+    BenchResult separateResult = {0, 0, 0};
+    Rendition r;
+
+    utils::setLogLevel(ERROR);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i],"-r")==0 && i + 1 < argc &&
+            sscanf(argv[++i], "%dx%d:%d", &r.width, &r.height, &r.bitrate) == 3 &&
+            r.width > 0 && r.height >= 0 && r.bitrate > 0) {
+            ladder.push_back(r);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (ladder.empty()) {
+        ladder = {{1280, 720, 3000}, {854, 480, 1500}, {640, 360, 800}, {320, 180, 300}};
+    }
+
+    syntheticFrames(frames);
+
+    if (!runLadder(ladder, frames, &ladderResult) || !runSeparate(ladder, frames, &separateResult)) {
+        utils::errorMsg("Could not configure the encoders");
+        return 1;
+    }
+
+    printf("Mode\tRenditions\tFrames\tCPU s\tWall s\tCPU ms/frame\n");
+    printf("ladder\t%lu\t%lu\t%.3f\t%.3f\t%.2f\n", (unsigned long) ladder.size(), (unsigned long) ladderResult.frames,
+           ladderResult.cpu, ladderResult.wall, ladderResult.cpu*1000/FRAMES);
+    printf("separate\t%lu\t%lu\t%.3f\t%.3f\t%.2f\n", (unsigned long) ladder.size(), (unsigned long) separateResult.frames,
+           separateResult.cpu, separateResult.wall, separateResult.cpu*1000/FRAMES);
+    printf("Ladder CPU saving: %.1f%%\n", separateResult.cpu > 0 ?
+           100*(1 - ladderResult.cpu/separateResult.cpu) : 0);
+
+    for (auto f : frames) {
+        delete f;
+    }
+
+    return 0;
+}
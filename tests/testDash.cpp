@@ -66,7 +66,7 @@ void signalHandler( int signum )
     run = false;
 }
 
-Dasher* setupDasher(int dasherId, std::string dash_folder, int segDuration, std::string basename)
+Dasher* setupDasher(int dasherId, std::string dash_folder, int segDuration, std::string basename, int httpPort)
 {
     Dasher* dasher = NULL;
 
@@ -79,7 +79,7 @@ Dasher* setupDasher(int dasherId, std::string dash_folder, int segDuration, std:
         exit(1);
     }
 
-    if(!dasher->configure(dash_folder, basename, segDuration, 30, 16)){
+    if(!dasher->configure(dash_folder, basename, segDuration, 30, 16, httpPort)){
         utils::errorMsg("Error configuring dasher: exit");
         exit(1);        
     }
@@ -364,9 +364,10 @@ bool addRTSPsession(std::string rtspUri, Dasher* dasher, int dasherId,
 
 void usage(){
     utils::infoMsg("usage: \n\r \
-        testdash -v <RTP input video port> -a <RTP input audio port> -r <input RTSP URI> -c <socket control port> -f <dash folder> -s <segment duration> -statsfile <output statistics filename> -timeout <secons to wait before closing. 0 means forever> -configfile <configuration file>\
+        testdash -v <RTP input video port> -a <RTP input audio port> -r <input RTSP URI> -c <socket control port> -f <dash folder> -s <segment duration> -statsfile <output statistics filename> -timeout <secons to wait before closing. 0 means forever> -configfile <configuration file> -httpport <HTTP origin port>\
         \n INPUTS: RTP or RTSP \n QUALITIES: from 1 to "+std::to_string(MAX_VIDEO_QUALITIES)+"                      \
         \n FOLDER: specify system folder where to write DASH MPD, INIT and SEGMENTS files.                          \
+        \n HTTPPORT: if set, files are kept in memory and served at this port instead of written to FOLDER.       \
         \n Each line in the configuration file must contain 'width, height, bitrate (kbps), codec (0:H264 1:H265)'  \
     ");
 }
@@ -388,6 +389,7 @@ int main(int argc, char* argv[])
     int dasherId = 4000;
     std::vector<int> readers;
     std::string basename = BASE_NAME;
+    int httpPort = 0;
 
     int receiverID = 10000;
 
@@ -432,6 +434,9 @@ int main(int argc, char* argv[])
         } else if (strcmp(argv[i],"-basename")==0) {
             basename = argv[i+1];
             utils::infoMsg("basename: " + basename);
+        } else if (strcmp(argv[i],"-httpport")==0) {
+            httpPort = std::stoi(argv[i+1]);
+            utils::infoMsg("configuring HTTP origin port: " + std::to_string(httpPort));
         }
     }
 
@@ -495,7 +500,7 @@ int main(int argc, char* argv[])
     receiver = new SourceManager();
     pipe->addFilter(receiverID, receiver);
     
-    dasher = setupDasher(dasherId, dFolder, segDuration, basename);
+    dasher = setupDasher(dasherId, dFolder, segDuration, basename, httpPort);
     
     signal(SIGINT, signalHandler);
 
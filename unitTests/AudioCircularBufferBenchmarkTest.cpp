@@ -0,0 +1,265 @@
+/*
+ *  AudioCircularBufferBenchmarkTest.cpp - AudioCircularBuffer producer/consumer benchmark
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ *
+ */
+
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <string.h>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "AudioCircularBuffer.hh"
+#include "Utils.hh"
+
+#define BENCHMARK_SECONDS 600
+#define INPUT_FRAME_SAMPLES 1024
+#define OPUS_FRAME_SAMPLES 960
+#define AAC_FRAME_SAMPLES 1024
+
+//NOTE: planar ring protected by a mutex on both sides, as the AudioCircularBuffer was
+//      before being lock-free, used as reference
+class LockedAudioRing {
+public:
+    LockedAudioRing(unsigned ch, unsigned length) : channels(ch), maxLength(length),
+        front(0), rear(0), elements(0)
+    {
+        for (unsigned i = 0; i < channels; i++) {
+            data[i] = new unsigned char[maxLength]();
+        }
+    }
+
+    ~LockedAudioRing()
+    {
+        for (unsigned i = 0; i < channels; i++) {
+            delete[] data[i];
+        }
+    }
+
+    bool push(unsigned char** buffer, unsigned bytes)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        unsigned rearMod = rear % maxLength;
+        unsigned firstBytes = std::min(bytes, maxLength - rearMod);
+
+        if (bytes > maxLength - elements) {
+            return false;
+        }
+
+        for (unsigned i = 0; i < channels; i++) {
+            memcpy(data[i] + rearMod, buffer[i], firstBytes);
+            memcpy(data[i], buffer[i] + firstBytes, bytes - firstBytes);
+        }
+
+        rear += bytes;
+        elements += bytes;
+        return true;
+    }
+
+    bool pop(unsigned char** buffer, unsigned bytes)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        unsigned frontMod = front % maxLength;
+        unsigned firstBytes = std::min(bytes, maxLength - frontMod);
+
+        if (elements < bytes) {
+            return false;
+        }
+
+        for (unsigned i = 0; i < channels; i++) {
+            memcpy(buffer[i], data[i] + frontMod, firstBytes);
+            memcpy(buffer[i] + firstBytes, data[i], bytes - firstBytes);
+        }
+
+        front += bytes;
+        elements -= bytes;
+        return true;
+    }
+
+private:
+    unsigned channels;
+    unsigned maxLength;
+    unsigned char* data[MAX_CHANNELS];
+    size_t front;
+    size_t rear;
+    unsigned elements;
+    std::mutex mtx;
+};
+
+class AudioCircularBufferBenchmarkTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(AudioCircularBufferBenchmarkTest);
+    CPPUNIT_TEST(lockedTest);
+    CPPUNIT_TEST(lockFreeTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void lockedTest();
+    void lockFreeTest();
+    void lockFreeBenchmark(unsigned outputSamples);
+
+    struct ConnectionData cData;
+    const unsigned channels = 2;
+    const unsigned sampleRate = 48000;
+    const SampleFmt format = FLTP;
+    const unsigned bytesPerSample = 4;
+    unsigned totalSamples;
+};
+
+void AudioCircularBufferBenchmarkTest::setUp()
+{
+    totalSamples = BENCHMARK_SECONDS*sampleRate;
+}
+
+void AudioCircularBufferBenchmarkTest::tearDown()
+{
+}
+
+void AudioCircularBufferBenchmarkTest::lockedTest()
+{
+    LockedAudioRing ring(channels, DEFAULT_BUFFER_SIZE*bytesPerSample);
+    PlanarAudioFrame* inFrame;
+    PlanarAudioFrame* outFrame;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::microseconds elapsed;
+    unsigned consumed = 0;
+
+    inFrame = PlanarAudioFrame::createNew(channels, sampleRate, AudioFrame::getMaxSamples(sampleRate), PCM, format);
+    outFrame = PlanarAudioFrame::createNew(channels, sampleRate, AudioFrame::getMaxSamples(sampleRate), PCM, format);
+
+    start = std::chrono::steady_clock::now();
+
+    std::thread producer([&](){
+        for (unsigned pos = 0; pos < totalSamples; pos += INPUT_FRAME_SAMPLES) {
+            while (!ring.push(inFrame->getPlanarDataBuf(), INPUT_FRAME_SAMPLES*bytesPerSample)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    while (consumed + OPUS_FRAME_SAMPLES <= totalSamples - totalSamples % INPUT_FRAME_SAMPLES) {
+        if (!ring.pop(outFrame->getPlanarDataBuf(), OPUS_FRAME_SAMPLES*bytesPerSample)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        consumed += OPUS_FRAME_SAMPLES;
+    }
+
+    producer.join();
+    elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    std::cout << std::endl << "Mutex based ring, " << OPUS_FRAME_SAMPLES << " samples output frames: "
+        << elapsed.count()*1000/(totalSamples/OPUS_FRAME_SAMPLES) << " ns per frame" << std::endl;
+
+    delete inFrame;
+    delete outFrame;
+}
+
+void AudioCircularBufferBenchmarkTest::lockFreeBenchmark(unsigned outputSamples)
+{
+    AudioCircularBuffer* buffer;
+    AudioFrame* aFrame;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::microseconds elapsed;
+    unsigned inputSamples = totalSamples - totalSamples % INPUT_FRAME_SAMPLES;
+    unsigned consumed = 0;
+    bool timingOk = true;
+
+    buffer = AudioCircularBuffer::createNew(cData, channels, sampleRate, DEFAULT_BUFFER_SIZE, format);
+    CPPUNIT_ASSERT(buffer);
+    CPPUNIT_ASSERT(buffer->setOutputFrameSamples(outputSamples));
+
+    start = std::chrono::steady_clock::now();
+
+    std::thread producer([&](){
+        AudioFrame* inFrame;
+
+        for (unsigned pos = 0; pos < inputSamples; pos += INPUT_FRAME_SAMPLES) {
+            while (buffer->getFreeSamples() < INPUT_FRAME_SAMPLES) {
+                std::this_thread::yield();
+            }
+
+            inFrame = dynamic_cast<AudioFrame*>(buffer->getRear());
+            inFrame->setSamples(INPUT_FRAME_SAMPLES);
+            inFrame->setPresentationTime(std::chrono::microseconds((int64_t) pos*std::micro::den/sampleRate));
+            buffer->addFrame();
+        }
+    });
+
+    while (consumed + outputSamples <= inputSamples) {
+        aFrame = dynamic_cast<AudioFrame*>(buffer->getFront());
+
+        if (!aFrame) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        timingOk &= aFrame->getPresentationTime() == std::chrono::microseconds((int64_t) consumed*std::micro::den/sampleRate);
+        buffer->removeFrame();
+        consumed += outputSamples;
+    }
+
+    producer.join();
+    elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    CPPUNIT_ASSERT(timingOk);
+
+    std::cout << std::endl << "Lock-free AudioCircularBuffer, " << outputSamples << " samples output frames: "
+        << elapsed.count()*1000/(totalSamples/outputSamples) << " ns per frame" << std::endl;
+
+    delete buffer;
+}
+
+void AudioCircularBufferBenchmarkTest::lockFreeTest()
+{
+    lockFreeBenchmark(OPUS_FRAME_SAMPLES);
+    lockFreeBenchmark(AAC_FRAME_SAMPLES);
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AudioCircularBufferBenchmarkTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("AudioCircularBufferBenchmarkTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest( CppUnit::TestFactoryRegistry::getRegistry().makeTest() );
+    runner.run( "", false );
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -23,6 +23,8 @@
 #include <iostream>
 #include <fstream>
 #include <string.h>
+#include <thread>
+#include <cmath>
 
 #include <cppunit/extensions/TestFactoryRegistry.h>
 #include <cppunit/extensions/HelperMacros.h>
@@ -47,6 +49,10 @@ class AudioCircularBufferTest : public CppUnit::TestFixture
     CPPUNIT_TEST(timestampGap);
     CPPUNIT_TEST(timestampOverlapping);
     CPPUNIT_TEST(flushBecauseOfDeviation);
+    CPPUNIT_TEST(variableOutputSize);
+    CPPUNIT_TEST(concurrentAccess);
+    CPPUNIT_TEST(driftCompensation);
+    CPPUNIT_TEST(multichannel);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -59,6 +65,12 @@ protected:
     void timestampGap();
     void timestampOverlapping();
     void flushBecauseOfDeviation();
+    void variableOutputSize();
+    void concurrentAccess();
+    void driftCompensation();
+    void multichannel();
+    unsigned simulateDrift(bool compensate, double drift, unsigned seconds, int &correction, size_t &lost,
+                           unsigned retargetLatency = 0);
 
     struct ConnectionData cData;
 
@@ -326,6 +338,258 @@ void AudioCircularBufferTest::flushBecauseOfDeviation()
     buffer->removeFrame();
 }
 
+void AudioCircularBufferTest::variableOutputSize()
+{
+    Frame* inFrame;
+    Frame* outFrame;
+    AudioFrame* aFrame;
+    std::chrono::microseconds syncTime = std::chrono::microseconds(0);
+    const unsigned samplesPerFrame = 100;
+    const unsigned firstOutputSamples = 96;
+    const unsigned secondOutputSamples = 64;
+
+    CPPUNIT_ASSERT(!buffer->setOutputFrameSamples(0));
+    CPPUNIT_ASSERT(!buffer->setOutputFrameSamples(AudioFrame::getMaxSamples(sampleRate) + 1));
+    CPPUNIT_ASSERT(buffer->setOutputFrameSamples(firstOutputSamples));
+
+    for (unsigned i = 0; i < 2; i++) {
+        inFrame = buffer->getRear();
+        aFrame = dynamic_cast<AudioFrame*>(inFrame);
+
+        aFrame->fillWithValue(i + 1);
+        aFrame->setSamples(samplesPerFrame);
+        aFrame->setPresentationTime(syncTime + std::chrono::microseconds(i*samplesPerFrame*std::micro::den/sampleRate));
+        buffer->addFrame();
+    }
+
+    outFrame = buffer->getFront();
+    CPPUNIT_ASSERT(outFrame);
+    aFrame = dynamic_cast<AudioFrame*>(outFrame);
+    CPPUNIT_ASSERT(aFrame->getSamples() == firstOutputSamples);
+    CPPUNIT_ASSERT(outFrame->getLength() == firstOutputSamples*bytesPerSample);
+
+    //NOTE: the new size is applied to the next frame
+    CPPUNIT_ASSERT(buffer->setOutputFrameSamples(secondOutputSamples));
+    CPPUNIT_ASSERT(aFrame->getSamples() == firstOutputSamples);
+    buffer->removeFrame();
+
+    outFrame = buffer->getFront();
+    CPPUNIT_ASSERT(outFrame);
+    aFrame = dynamic_cast<AudioFrame*>(outFrame);
+    CPPUNIT_ASSERT(aFrame->getSamples() == secondOutputSamples);
+    CPPUNIT_ASSERT(outFrame->getPresentationTime() == syncTime + std::chrono::microseconds(firstOutputSamples*std::micro::den/sampleRate));
+
+    //NOTE: the frame takes the 4 last samples of the first input frame and 60 of the second one
+    CPPUNIT_ASSERT(aFrame->getPlanarDataBuf()[0][0] == 1);
+    CPPUNIT_ASSERT(aFrame->getPlanarDataBuf()[0][(samplesPerFrame - firstOutputSamples)*bytesPerSample] == 2);
+    buffer->removeFrame();
+
+    CPPUNIT_ASSERT(buffer->getElements() == 0);
+    CPPUNIT_ASSERT(!buffer->getFront());
+}
+
+void AudioCircularBufferTest::concurrentAccess()
+{
+    const unsigned samplesPerFrame = 40;
+    const unsigned outputSamples = 96;
+    const unsigned totalSamples = samplesPerFrame*5000;
+    bool sequenceOk = true;
+
+    buffer->setOutputFrameSamples(outputSamples);
+
+    //NOTE: each sample value is its position, so any lost or repeated block is detected
+    std::thread producer([&](){
+        AudioFrame* aFrame;
+        int16_t* samples;
+
+        for (unsigned pos = 0; pos < totalSamples; pos += samplesPerFrame) {
+            while (buffer->getFreeSamples() < (int) samplesPerFrame) {
+                std::this_thread::yield();
+            }
+
+            aFrame = dynamic_cast<AudioFrame*>(buffer->getRear());
+
+            for (unsigned c = 0; c < channels; c++) {
+                samples = (int16_t*) aFrame->getPlanarDataBuf()[c];
+
+                for (unsigned i = 0; i < samplesPerFrame; i++) {
+                    samples[i] = (pos + i) % 32768;
+                }
+            }
+
+            aFrame->setSamples(samplesPerFrame);
+            aFrame->setPresentationTime(std::chrono::microseconds((int64_t) pos*std::micro::den/sampleRate));
+            buffer->addFrame();
+        }
+    });
+
+    unsigned consumed = 0;
+    AudioFrame* aFrame;
+    int16_t* samples;
+
+    while (consumed + outputSamples <= totalSamples) {
+        aFrame = dynamic_cast<AudioFrame*>(buffer->getFront());
+
+        if (!aFrame) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        for (unsigned c = 0; c < channels; c++) {
+            samples = (int16_t*) aFrame->getPlanarDataBuf()[c];
+
+            for (unsigned i = 0; i < outputSamples; i++) {
+                sequenceOk &= samples[i] == (int16_t) ((consumed + i) % 32768);
+            }
+        }
+
+        sequenceOk &= aFrame->getPresentationTime() == std::chrono::microseconds((int64_t) consumed*std::micro::den/sampleRate);
+
+        buffer->removeFrame();
+        consumed += outputSamples;
+    }
+
+    producer.join();
+    CPPUNIT_ASSERT(sequenceOk);
+}
+
+//NOTE: producer and consumer run with their own clocks, time is simulated in 1 ms steps.
+//      It returns the fill level in samples at the end of the simulation. If retargetLatency
+//      is set, the target latency is changed to it halfway through the simulation
+unsigned AudioCircularBufferTest::simulateDrift(bool compensate, double drift, unsigned seconds, int &correction, size_t &lost,
+                                               unsigned retargetLatency)
+{
+    AudioCircularBuffer* driftBuffer;
+    AudioFrame* aFrame;
+    const unsigned inSamples = 960;
+    const unsigned outSamples = 1024;
+    const unsigned startupDelay = 100000; //us
+    unsigned fill;
+    uint64_t produced = 0;
+    uint64_t consumed = 0;
+    float* samples;
+
+    driftBuffer = AudioCircularBuffer::createNew(cData, 1, sampleRate, DEFAULT_BUFFER_SIZE, FLTP);
+    CPPUNIT_ASSERT(driftBuffer);
+    CPPUNIT_ASSERT(driftBuffer->setOutputFrameSamples(outSamples));
+    CPPUNIT_ASSERT(driftBuffer->setDriftCompensation(compensate));
+
+    for (uint64_t now = 0; now < (uint64_t) seconds*std::micro::den; now += 1000) {
+        if (retargetLatency > 0 && now == (uint64_t) seconds*std::micro::den/2) {
+            CPPUNIT_ASSERT(driftBuffer->setDriftCompensation(true, retargetLatency));
+        }
+
+        //NOTE: the producer timestamps samples with its own clock, which runs faster
+        while (produced*std::micro::den/sampleRate <= now*(1 + drift)) {
+            aFrame = dynamic_cast<AudioFrame*>(driftBuffer->getRear());
+            samples = (float*) aFrame->getPlanarDataBuf()[0];
+
+            for (unsigned i = 0; i < inSamples; i++) {
+                samples[i] = 0.5*sin(2*M_PI*440*(produced + i)/sampleRate);
+            }
+
+            aFrame->setSamples(inSamples);
+            aFrame->setPresentationTime(std::chrono::microseconds((int64_t) (produced*std::micro::den/sampleRate)));
+            driftBuffer->addFrame();
+            produced += inSamples;
+        }
+
+        while (now >= startupDelay && consumed*std::micro::den/sampleRate <= now - startupDelay) {
+            if (!driftBuffer->getFront()) {
+                break;
+            }
+
+            driftBuffer->removeFrame();
+            consumed += outSamples;
+        }
+    }
+
+    fill = driftBuffer->getChannelMaxSamples() - driftBuffer->getFreeSamples();
+    correction = driftBuffer->getDriftCorrection();
+    lost = driftBuffer->getLostBlocs();
+
+    delete driftBuffer;
+    return fill;
+}
+
+void AudioCircularBufferTest::driftCompensation()
+{
+    const double drift = 0.001;
+    const unsigned seconds = 300;
+    const unsigned initialFill = 0.1*sampleRate;
+    const unsigned maxError = 0.02*sampleRate;
+    const unsigned retargetLatency = 160; //ms
+    unsigned fill;
+    int correction;
+    size_t lost;
+
+    AudioCircularBuffer* u8Buffer;
+
+    u8Buffer = AudioCircularBuffer::createNew(cData, channels, sampleRate, maxSamples, U8P);
+    CPPUNIT_ASSERT(u8Buffer);
+    CPPUNIT_ASSERT(!u8Buffer->setDriftCompensation(true));
+    CPPUNIT_ASSERT(!u8Buffer->getDriftCompensation());
+    delete u8Buffer;
+
+    //NOTE: without compensation latency grows with the accumulated drift
+    fill = simulateDrift(false, drift, seconds, correction, lost);
+    CPPUNIT_ASSERT(fill > initialFill + drift*seconds*sampleRate/2);
+    CPPUNIT_ASSERT(correction == 0);
+
+    fill = simulateDrift(true, drift, seconds, correction, lost);
+    CPPUNIT_ASSERT(fill < initialFill + maxError);
+    CPPUNIT_ASSERT(fill + maxError > initialFill);
+    CPPUNIT_ASSERT(lost == 0);
+    CPPUNIT_ASSERT(std::abs(correction + drift*1000000) < 200);
+
+    //NOTE: a new target latency relocks the controller, while the drift is still compensated
+    fill = simulateDrift(true, drift, seconds, correction, lost, retargetLatency);
+    CPPUNIT_ASSERT(fill < retargetLatency*sampleRate/1000 + maxError);
+    CPPUNIT_ASSERT(fill + maxError > retargetLatency*sampleRate/1000);
+    CPPUNIT_ASSERT(lost == 0);
+    CPPUNIT_ASSERT(std::abs(correction + drift*1000000) < 200);
+}
+
+void AudioCircularBufferTest::multichannel()
+{
+    AudioCircularBuffer* mcBuffer;
+    AudioFrame* aFrame;
+    const unsigned mcChannels = 6;
+    const unsigned samplesPerFrame = 160;
+
+    mcBuffer = AudioCircularBuffer::createNew(cData, MAX_CHANNELS + 1, sampleRate, maxSamples, format);
+    CPPUNIT_ASSERT(!mcBuffer);
+
+    mcBuffer = AudioCircularBuffer::createNew(cData, mcChannels, sampleRate, maxSamples, format);
+    CPPUNIT_ASSERT(mcBuffer);
+    CPPUNIT_ASSERT(mcBuffer->setOutputFrameSamples(samplesPerFrame));
+
+    aFrame = dynamic_cast<AudioFrame*>(mcBuffer->getRear());
+    CPPUNIT_ASSERT(aFrame->getChannels() == mcChannels);
+
+    //NOTE: each channel is filled with its own value to check that planes are not mixed up
+    for (unsigned i = 0; i < mcChannels; i++) {
+        memset(aFrame->getPlanarDataBuf()[i], i + 1, samplesPerFrame*bytesPerSample);
+    }
+
+    aFrame->setSamples(samplesPerFrame);
+    aFrame->setPresentationTime(std::chrono::microseconds(0));
+    mcBuffer->addFrame();
+
+    aFrame = dynamic_cast<AudioFrame*>(mcBuffer->getFront());
+    CPPUNIT_ASSERT(aFrame);
+    CPPUNIT_ASSERT(aFrame->getChannels() == mcChannels);
+    CPPUNIT_ASSERT(aFrame->getSamples() == samplesPerFrame);
+
+    for (unsigned i = 0; i < mcChannels; i++) {
+        CPPUNIT_ASSERT(aFrame->getPlanarDataBuf()[i][0] == i + 1);
+        CPPUNIT_ASSERT(aFrame->getPlanarDataBuf()[i][samplesPerFrame*bytesPerSample - 1] == i + 1);
+    }
+
+    mcBuffer->removeFrame();
+    delete mcBuffer;
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(AudioCircularBufferTest);
 
 int main(int argc, char* argv[])
@@ -0,0 +1,242 @@
+/*
+ *  AudioKernelsTest.cpp - Audio sample processing kernels test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ *
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "AudioKernels.hh"
+#include "Utils.hh"
+
+//NOTE: odd number of samples, so both the vectorized and the remaining samples loops are used
+#define KERNEL_TEST_SAMPLES 1027
+#define KERNEL_TEST_CHANNELS 6
+
+class AudioKernelsTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(AudioKernelsTest);
+    CPPUNIT_TEST(interleaveS16Test);
+    CPPUNIT_TEST(deinterleaveS16Test);
+    CPPUNIT_TEST(interleaveFloatTest);
+    CPPUNIT_TEST(deinterleaveFloatTest);
+    CPPUNIT_TEST(peakSumSquaresTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void interleaveS16Test();
+    void deinterleaveS16Test();
+    void interleaveFloatTest();
+    void deinterleaveFloatTest();
+    void peakSumSquaresTest();
+
+    int16_t s16Sample(unsigned channel, unsigned sample);
+    float floatSample(unsigned channel, unsigned sample);
+};
+
+void AudioKernelsTest::setUp()
+{
+}
+
+void AudioKernelsTest::tearDown()
+{
+}
+
+int16_t AudioKernelsTest::s16Sample(unsigned channel, unsigned sample)
+{
+    //NOTE: negative values check sign extension in the S16 deinterleaving
+    return (int16_t) ((sample*7919 + channel*104729) % 65536 - 32768);
+}
+
+float AudioKernelsTest::floatSample(unsigned channel, unsigned sample)
+{
+    return s16Sample(channel, sample)/32768.0f;
+}
+
+void AudioKernelsTest::interleaveS16Test()
+{
+    std::vector<int16_t> planes[KERNEL_TEST_CHANNELS];
+    const int16_t* src[KERNEL_TEST_CHANNELS];
+    std::vector<int16_t> dst;
+
+    for (unsigned channels = 1; channels <= KERNEL_TEST_CHANNELS; channels++) {
+        for (unsigned c = 0; c < channels; c++) {
+            planes[c].resize(KERNEL_TEST_SAMPLES);
+
+            for (unsigned i = 0; i < KERNEL_TEST_SAMPLES; i++) {
+                planes[c][i] = s16Sample(c, i);
+            }
+
+            src[c] = planes[c].data();
+        }
+
+        dst.assign(channels*KERNEL_TEST_SAMPLES, 0);
+        audiokernels::interleaveS16(src, dst.data(), channels, KERNEL_TEST_SAMPLES);
+
+        for (unsigned i = 0; i < KERNEL_TEST_SAMPLES; i++) {
+            for (unsigned c = 0; c < channels; c++) {
+                CPPUNIT_ASSERT(dst[i*channels + c] == s16Sample(c, i));
+            }
+        }
+    }
+}
+
+void AudioKernelsTest::deinterleaveS16Test()
+{
+    std::vector<int16_t> planes[KERNEL_TEST_CHANNELS];
+    int16_t* dst[KERNEL_TEST_CHANNELS];
+    std::vector<int16_t> src;
+
+    for (unsigned channels = 1; channels <= KERNEL_TEST_CHANNELS; channels++) {
+        src.resize(channels*KERNEL_TEST_SAMPLES);
+
+        for (unsigned i = 0; i < KERNEL_TEST_SAMPLES; i++) {
+            for (unsigned c = 0; c < channels; c++) {
+                src[i*channels + c] = s16Sample(c, i);
+            }
+        }
+
+        for (unsigned c = 0; c < channels; c++) {
+            planes[c].assign(KERNEL_TEST_SAMPLES, 0);
+            dst[c] = planes[c].data();
+        }
+
+        audiokernels::deinterleaveS16(src.data(), dst, channels, KERNEL_TEST_SAMPLES);
+
+        for (unsigned c = 0; c < channels; c++) {
+            for (unsigned i = 0; i < KERNEL_TEST_SAMPLES; i++) {
+                CPPUNIT_ASSERT(planes[c][i] == s16Sample(c, i));
+            }
+        }
+    }
+}
+
+void AudioKernelsTest::interleaveFloatTest()
+{
+    std::vector<float> planes[KERNEL_TEST_CHANNELS];
+    const float* src[KERNEL_TEST_CHANNELS];
+    std::vector<float> dst;
+
+    for (unsigned channels = 1; channels <= KERNEL_TEST_CHANNELS; channels++) {
+        for (unsigned c = 0; c < channels; c++) {
+            planes[c].resize(KERNEL_TEST_SAMPLES);
+
+            for (unsigned i = 0; i < KERNEL_TEST_SAMPLES; i++) {
+                planes[c][i] = floatSample(c, i);
+            }
+
+            src[c] = planes[c].data();
+        }
+
+        dst.assign(channels*KERNEL_TEST_SAMPLES, 0);
+        audiokernels::interleaveFloat(src, dst.data(), channels, KERNEL_TEST_SAMPLES);
+
+        for (unsigned i = 0; i < KERNEL_TEST_SAMPLES; i++) {
+            for (unsigned c = 0; c < channels; c++) {
+                CPPUNIT_ASSERT(dst[i*channels + c] == floatSample(c, i));
+            }
+        }
+    }
+}
+
+void AudioKernelsTest::deinterleaveFloatTest()
+{
+    std::vector<float> planes[KERNEL_TEST_CHANNELS];
+    float* dst[KERNEL_TEST_CHANNELS];
+    std::vector<float> src;
+
+    for (unsigned channels = 1; channels <= KERNEL_TEST_CHANNELS; channels++) {
+        src.resize(channels*KERNEL_TEST_SAMPLES);
+
+        for (unsigned i = 0; i < KERNEL_TEST_SAMPLES; i++) {
+            for (unsigned c = 0; c < channels; c++) {
+                src[i*channels + c] = floatSample(c, i);
+            }
+        }
+
+        for (unsigned c = 0; c < channels; c++) {
+            planes[c].assign(KERNEL_TEST_SAMPLES, 0);
+            dst[c] = planes[c].data();
+        }
+
+        audiokernels::deinterleaveFloat(src.data(), dst, channels, KERNEL_TEST_SAMPLES);
+
+        for (unsigned c = 0; c < channels; c++) {
+            for (unsigned i = 0; i < KERNEL_TEST_SAMPLES; i++) {
+                CPPUNIT_ASSERT(planes[c][i] == floatSample(c, i));
+            }
+        }
+    }
+}
+
+void AudioKernelsTest::peakSumSquaresTest()
+{
+    std::vector<int16_t> s16(KERNEL_TEST_SAMPLES);
+    std::vector<float> flt(KERNEL_TEST_SAMPLES);
+    float sum;
+    float peak;
+
+    for (unsigned i = 0; i < KERNEL_TEST_SAMPLES; i++) {
+        s16[i] = s16Sample(0, i);
+        flt[i] = floatSample(0, i);
+    }
+
+    peak = audiokernels::peakSumSquares(flt.data(), KERNEL_TEST_SAMPLES, sum);
+    CPPUNIT_ASSERT(peak == audiokernels::peak(flt.data(), KERNEL_TEST_SAMPLES));
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(audiokernels::sumSquares(flt.data(), KERNEL_TEST_SAMPLES), sum, sum*1e-5);
+
+    //NOTE: S16 peak saturates at 32767 so it matches the float one at most by one step
+    peak = audiokernels::peakSumSquaresS16(s16.data(), KERNEL_TEST_SAMPLES, sum);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(audiokernels::peak(flt.data(), KERNEL_TEST_SAMPLES), peak, 1.0/32768);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(audiokernels::sumSquaresS16(s16.data(), KERNEL_TEST_SAMPLES), sum, sum*1e-5);
+
+    peak = audiokernels::peakSumSquares(flt.data(), 0, sum);
+    CPPUNIT_ASSERT(peak == 0 && sum == 0);
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AudioKernelsTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("AudioKernelsTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest( CppUnit::TestFactoryRegistry::getRegistry().makeTest() );
+    runner.run( "", false );
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
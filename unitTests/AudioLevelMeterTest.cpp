@@ -0,0 +1,265 @@
+/*
+ *  AudioLevelMeterTest.cpp - AudioLevelMeter class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ *
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <thread>
+#include <atomic>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "AudioLevelMeter.hh"
+#include "AudioCircularBuffer.hh"
+#include "Utils.hh"
+
+#define METER_TEST_RATE 48000
+#define METER_TEST_CHUNK 1000 //samples, not aligned to the meter windows
+#define SINE_FREQUENCY 997.0
+
+class AudioLevelMeterTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(AudioLevelMeterTest);
+    CPPUNIT_TEST(disabledTest);
+    CPPUNIT_TEST(floatLevelsTest);
+    CPPUNIT_TEST(s16LevelsTest);
+    CPPUNIT_TEST(loudnessTest);
+    CPPUNIT_TEST(queueMeteringTest);
+    CPPUNIT_TEST(layoutChangeTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void disabledTest();
+    void floatLevelsTest();
+    void s16LevelsTest();
+    void loudnessTest();
+    void queueMeteringTest();
+    void layoutChangeTest();
+
+    void fillSine(float* buffer, float amplitude, unsigned start, unsigned samples);
+    void feed(AudioLevelMeter& meter, SampleFmt fmt, float amplitude, unsigned channels, unsigned samples);
+};
+
+void AudioLevelMeterTest::setUp()
+{
+}
+
+void AudioLevelMeterTest::tearDown()
+{
+}
+
+void AudioLevelMeterTest::fillSine(float* buffer, float amplitude, unsigned start, unsigned samples)
+{
+    for (unsigned i = 0; i < samples; i++) {
+        buffer[i] = amplitude*std::sin(2*M_PI*SINE_FREQUENCY*(start + i)/METER_TEST_RATE);
+    }
+}
+
+//NOTE: the sine is only written to the first channel, the others are silent
+void AudioLevelMeterTest::feed(AudioLevelMeter& meter, SampleFmt fmt, float amplitude, unsigned channels, unsigned samples)
+{
+    std::vector<float> sine(METER_TEST_CHUNK);
+    std::vector<int16_t> s16(METER_TEST_CHUNK);
+    std::vector<float> silence(METER_TEST_CHUNK, 0);
+    unsigned char const* planes[MAX_CHANNELS];
+    unsigned len;
+
+    for (unsigned i = 1; i < channels; i++) {
+        planes[i] = (unsigned char const*) silence.data();
+    }
+
+    for (unsigned pos = 0; pos < samples; pos += len) {
+        len = std::min(samples - pos, (unsigned) METER_TEST_CHUNK);
+        fillSine(sine.data(), amplitude, pos, len);
+
+        if (fmt == S16P) {
+            for (unsigned i = 0; i < len; i++) {
+                s16[i] = (int16_t) std::lrint(sine[i]*32767);
+            }
+
+            planes[0] = (unsigned char const*) s16.data();
+        } else {
+            planes[0] = (unsigned char const*) sine.data();
+        }
+
+        meter.process(planes, fmt, 0, len);
+    }
+}
+
+void AudioLevelMeterTest::disabledTest()
+{
+    AudioLevelMeter meter(2, METER_TEST_RATE);
+
+    feed(meter, FLTP, 0.5, 2, METER_TEST_RATE);
+
+    CPPUNIT_ASSERT(!meter.isEnabled());
+    CPPUNIT_ASSERT(meter.getPeak(0) == METER_FLOOR);
+    CPPUNIT_ASSERT(meter.getRms(0) == METER_FLOOR);
+    CPPUNIT_ASSERT(meter.getLoudness() == METER_FLOOR);
+}
+
+void AudioLevelMeterTest::floatLevelsTest()
+{
+    AudioLevelMeter meter(2, METER_TEST_RATE);
+
+    meter.configure(true);
+    feed(meter, FLTP, 0.5, 2, METER_TEST_RATE);
+
+    //NOTE: a sine of amplitude A has a peak of 20*log10(A) and an RMS of 20*log10(A/sqrt(2))
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-6.02, meter.getPeak(0), 0.05);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-9.03, meter.getRms(0), 0.05);
+    CPPUNIT_ASSERT(meter.getPeak(1) == METER_FLOOR);
+    CPPUNIT_ASSERT(meter.getRms(1) == METER_FLOOR);
+    CPPUNIT_ASSERT(meter.getLoudness() == METER_FLOOR);
+
+    meter.configure(false);
+    feed(meter, FLTP, 0.1, 2, METER_TEST_RATE);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-6.02, meter.getPeak(0), 0.05);
+}
+
+void AudioLevelMeterTest::s16LevelsTest()
+{
+    AudioLevelMeter meter(6, METER_TEST_RATE);
+
+    meter.configure(true);
+    feed(meter, S16P, 0.25, 6, METER_TEST_RATE);
+
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-12.04, meter.getPeak(0), 0.05);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-15.05, meter.getRms(0), 0.05);
+
+    for (unsigned i = 1; i < 6; i++) {
+        CPPUNIT_ASSERT(meter.getPeak(i) == METER_FLOOR);
+    }
+}
+
+void AudioLevelMeterTest::loudnessTest()
+{
+    AudioLevelMeter meter(1, METER_TEST_RATE);
+
+    //NOTE: BS.1770 reference, a 0 dBFS 1KHz sine in one channel reads -3.01 LUFS
+    meter.configure(true, true);
+    feed(meter, FLTP, 1.0, 1, METER_TEST_RATE*LOUDNESS_WINDOW/1000);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-3.01, meter.getLoudness(), 0.1);
+
+    //NOTE: -20 dBFS sine, once the short-term window only contains it
+    meter.setup(1, METER_TEST_RATE);
+    feed(meter, FLTP, 0.1, 1, 2*METER_TEST_RATE*LOUDNESS_WINDOW/1000);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-23.01, meter.getLoudness(), 0.1);
+}
+
+void AudioLevelMeterTest::queueMeteringTest()
+{
+    struct ConnectionData cData;
+    AudioCircularBuffer* buffer;
+    AudioFrame* inFrame;
+    const unsigned frameSamples = 960;
+
+    buffer = AudioCircularBuffer::createNew(cData, 2, METER_TEST_RATE, DEFAULT_BUFFER_SIZE, FLTP);
+    CPPUNIT_ASSERT(buffer);
+    CPPUNIT_ASSERT(buffer->setOutputFrameSamples(frameSamples));
+
+    buffer->getLevelMeter().configure(true);
+
+    for (unsigned pos = 0; pos < 10*frameSamples; pos += frameSamples) {
+        inFrame = dynamic_cast<AudioFrame*>(buffer->getRear());
+        CPPUNIT_ASSERT(inFrame);
+
+        fillSine((float*) inFrame->getPlanarDataBuf()[0], 0.5, pos, frameSamples);
+        fillSine((float*) inFrame->getPlanarDataBuf()[1], 0.25, pos, frameSamples);
+        inFrame->setSamples(frameSamples);
+        inFrame->setLength(frameSamples*sizeof(float));
+        inFrame->setPresentationTime(std::chrono::microseconds((int64_t) pos*std::micro::den/METER_TEST_RATE));
+        buffer->addFrame();
+
+        if (buffer->getFront()) {
+            buffer->removeFrame();
+        }
+    }
+
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-6.02, buffer->getLevelMeter().getPeak(0), 0.05);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-12.04, buffer->getLevelMeter().getPeak(1), 0.05);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-15.05, buffer->getLevelMeter().getRms(1), 0.05);
+
+    delete buffer;
+}
+
+//NOTE: state is read from another thread while the measuring one changes the layout
+void AudioLevelMeterTest::layoutChangeTest()
+{
+    AudioLevelMeter meter(2, METER_TEST_RATE);
+    std::atomic<bool> done(false);
+    std::atomic<bool> consistent(true);
+
+    meter.configure(true);
+
+    std::thread reader([&] {
+        while (!done) {
+            Jzon::Object state;
+            meter.getState(state);
+
+            unsigned peaks = state.Get("peak").GetCount();
+
+            if ((peaks != 2 && peaks != 6) || peaks != state.Get("rms").GetCount()) {
+                consistent = false;
+            }
+        }
+    });
+
+    for (unsigned i = 0; i < 200; i++) {
+        meter.setup(i % 2 ? 6 : 2, METER_TEST_RATE);
+        feed(meter, FLTP, 0.5, meter.getChannels(), METER_TEST_RATE*METER_WINDOW/1000);
+    }
+
+    done = true;
+    reader.join();
+
+    CPPUNIT_ASSERT(consistent);
+    CPPUNIT_ASSERT_EQUAL(6u, meter.getChannels());
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AudioLevelMeterTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("AudioLevelMeterTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest( CppUnit::TestFactoryRegistry::getRegistry().makeTest() );
+    runner.run( "", false );
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+/*
+ *  AudioMixerBenchmarkTest.cpp - AudioMixer mixing kernels benchmark
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ *
+ */
+
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <fstream>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "FilterFunctionalMockup.hh"
+#include "AudioKernels.hh"
+#include "modules/audioMixer/AudioMixer.hh"
+
+#define PARTICIPANTS 64
+#define BENCHMARK_FRAMES 500
+#define MIX_BUFFER_FRAMES 5
+
+//NOTE: per sample mixing loop as it was done before block kernels, used as reference
+static void scalarMix(unsigned char* data, SampleFmt fmt, float* mixBuff, unsigned maxSamples,
+                      unsigned position, unsigned samples, float gain)
+{
+    float fSample;
+    unsigned bufferIdx = position % maxSamples;
+    int bytesPerSample = utils::getBytesPerSampleFromFormat(fmt);
+
+    for (unsigned j = 0; j < samples; j++) {
+        AudioMixer::bytesToFloat(data + j*bytesPerSample, fSample, fmt);
+        mixBuff[bufferIdx] += fSample*gain;
+        bufferIdx = (bufferIdx + 1) % maxSamples;
+    }
+}
+
+class AudioMixerBenchmarkTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(AudioMixerBenchmarkTest);
+    CPPUNIT_TEST(kernelsTest);
+    CPPUNIT_TEST(participantsTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void kernelsTest();
+    void participantsTest();
+    void kernelsBenchmark(SampleFmt fmt);
+
+    int channels = 2;
+    int sampleRate = 48000;
+    unsigned frameSamples;
+
+    PlanarAudioFrame* s16Frame;
+    PlanarAudioFrame* fltFrame;
+};
+
+void AudioMixerBenchmarkTest::setUp()
+{
+    float fValue;
+
+    frameSamples = AudioFrame::getDefaultSamples(sampleRate);
+
+    s16Frame = PlanarAudioFrame::createNew(channels, sampleRate, AudioFrame::getMaxSamples(sampleRate), PCM, S16P);
+    fltFrame = PlanarAudioFrame::createNew(channels, sampleRate, AudioFrame::getMaxSamples(sampleRate), PCM, FLTP);
+
+    for (int c = 0; c < channels; c++) {
+        for (unsigned i = 0; i < frameSamples; i++) {
+            fValue = 0.01*sin(2*M_PI*440*i/sampleRate);
+            AudioMixer::floatToBytes(s16Frame->getPlanarDataBuf()[c] + i*2, fValue, S16P);
+            AudioMixer::floatToBytes(fltFrame->getPlanarDataBuf()[c] + i*4, fValue, FLTP);
+        }
+    }
+
+    s16Frame->setSamples(frameSamples);
+    s16Frame->setLength(frameSamples*2);
+    fltFrame->setSamples(frameSamples);
+    fltFrame->setLength(frameSamples*4);
+}
+
+void AudioMixerBenchmarkTest::tearDown()
+{
+    delete s16Frame;
+    delete fltFrame;
+}
+
+void AudioMixerBenchmarkTest::kernelsBenchmark(SampleFmt fmt)
+{
+    PlanarAudioFrame* frame = fmt == S16P ? s16Frame : fltFrame;
+    unsigned maxSamples = frameSamples*MIX_BUFFER_FRAMES;
+    std::vector<float> scalarBuff(maxSamples);
+    std::vector<float> blockBuff(maxSamples);
+    std::chrono::microseconds scalarTime(0);
+    std::chrono::microseconds blockTime(0);
+    std::chrono::steady_clock::time_point start;
+    unsigned position;
+    unsigned firstSpan;
+    unsigned char* data;
+    float gain = 0.8;
+
+    for (unsigned f = 0; f < BENCHMARK_FRAMES; f++) {
+        //NOTE: odd offsets so that spans are not aligned and some of them wrap
+        position = (f*frameSamples + f%7) % maxSamples;
+
+        start = std::chrono::steady_clock::now();
+        for (int p = 0; p < PARTICIPANTS; p++) {
+            for (int c = 0; c < channels; c++) {
+                scalarMix(frame->getPlanarDataBuf()[c], fmt, scalarBuff.data(), maxSamples, position, frameSamples, gain);
+            }
+        }
+        scalarTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+        start = std::chrono::steady_clock::now();
+        firstSpan = std::min(frameSamples, maxSamples - position);
+        for (int p = 0; p < PARTICIPANTS; p++) {
+            for (int c = 0; c < channels; c++) {
+                data = frame->getPlanarDataBuf()[c];
+                if (fmt == S16P) {
+                    audiokernels::mulAddS16((int16_t*) data, blockBuff.data() + position, gain, firstSpan);
+                    audiokernels::mulAddS16((int16_t*) data + firstSpan, blockBuff.data(), gain, frameSamples - firstSpan);
+                } else {
+                    audiokernels::mulAdd((float*) data, blockBuff.data() + position, gain, firstSpan);
+                    audiokernels::mulAdd((float*) data + firstSpan, blockBuff.data(), gain, frameSamples - firstSpan);
+                }
+            }
+        }
+        blockTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+        for (unsigned i = 0; i < maxSamples; i++) {
+            CPPUNIT_ASSERT(fabs(scalarBuff[i] - blockBuff[i]) < 1e-3);
+        }
+        std::fill(scalarBuff.begin(), scalarBuff.end(), 0);
+        std::fill(blockBuff.begin(), blockBuff.end(), 0);
+    }
+
+    std::cout << std::endl << utils::getSampleFormatAsString(fmt) << " mixing of " << PARTICIPANTS
+        << " participants (us/frame): per sample " << scalarTime.count()/BENCHMARK_FRAMES
+        << ", block kernels " << blockTime.count()/BENCHMARK_FRAMES << std::endl;
+}
+
+void AudioMixerBenchmarkTest::kernelsTest()
+{
+    kernelsBenchmark(S16P);
+    kernelsBenchmark(FLTP);
+}
+
+void AudioMixerBenchmarkTest::participantsTest()
+{
+    AudioMixer* mixer;
+    ManyToOneAudioScenarioMockup* mixScenario;
+    PlanarAudioFrame* mixedFrame;
+    std::chrono::microseconds ts;
+    std::chrono::microseconds tsIncrement;
+    std::chrono::microseconds elapsed;
+    std::chrono::steady_clock::time_point start;
+    unsigned mixedFrames = 0;
+
+    mixer = new AudioMixer(PARTICIPANTS);
+    mixScenario = new ManyToOneAudioScenarioMockup(mixer);
+
+    for (int id = 1; id <= PARTICIPANTS; id++) {
+        CPPUNIT_ASSERT(mixScenario->addHeadFilter(id, channels, sampleRate, FLTP));
+    }
+
+    CPPUNIT_ASSERT(mixScenario->connectFilters());
+
+    ts = std::chrono::microseconds(0);
+    tsIncrement = std::chrono::microseconds(frameSamples*std::micro::den/sampleRate);
+    start = std::chrono::steady_clock::now();
+
+    for (unsigned f = 0; f < BENCHMARK_FRAMES; f++) {
+        fltFrame->setPresentationTime(ts);
+        mixScenario->processFrame(fltFrame);
+        ts += tsIncrement;
+
+        mixedFrame = mixScenario->extractFrame();
+        if (mixedFrame) {
+            mixedFrames++;
+        }
+    }
+
+    elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    CPPUNIT_ASSERT(mixedFrames > 0);
+
+    std::cout << std::endl << "AudioMixer with " << PARTICIPANTS << " participants: "
+        << elapsed.count()/BENCHMARK_FRAMES << " us per " << tsIncrement.count() << " us frame ("
+        << mixedFrames << " mixed frames)" << std::endl;
+
+    delete mixScenario;
+    delete mixer;
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AudioMixerBenchmarkTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("AudioMixerBenchmarkTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest( CppUnit::TestFactoryRegistry::getRegistry().makeTest() );
+    runner.run( "", false );
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
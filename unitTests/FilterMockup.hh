@@ -104,6 +104,40 @@ private:
     bool gotFrame;
 };
 
+class FlushFilterMockup : public OneToOneFilterMockup
+{
+public:
+    FlushFilterMockup(size_t queueSize_, unsigned extraFrames_, bool emptyLast_ = false) :
+        OneToOneFilterMockup(queueSize_, true, std::chrono::microseconds(0)),
+        extraFrames(extraFrames_), pending(0), seqNum(0), emptyLast(emptyLast_) {};
+
+protected:
+    bool doProcessFrame(Frame *org, Frame *dst) {
+        pending = extraFrames;
+        seqNum = org->getSequenceNumber();
+        return OneToOneFilterMockup::doProcessFrame(org, dst);
+    }
+
+    bool hasPendingFrames() {return pending > 0;};
+
+    bool flushFrame(Frame *dst) {
+        pending--;
+        //NOTE: like an encoder whose last pending samples do not produce a packet
+        if (emptyLast && pending == 0) {
+            return false;
+        }
+        dst->setSequenceNumber(seqNum);
+        dst->setConsumed(true);
+        return true;
+    }
+
+private:
+    unsigned extraFrames;
+    unsigned pending;
+    size_t seqNum;
+    bool emptyLast;
+};
+
 class OneToManyFilterMockup : public OneToManyFilter
 {
 public:
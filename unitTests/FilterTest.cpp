@@ -25,6 +25,7 @@
 #include <fstream>
 #include <chrono>
 #include <thread>
+#include <algorithm>
 #include <cppunit/extensions/TestFactoryRegistry.h>
 #include <cppunit/extensions/HelperMacros.h>
 #include <cppunit/ui/text/TextTestRunner.h>
@@ -43,6 +44,8 @@ class FilterUnitTest : public CppUnit::TestFixture
     CPPUNIT_TEST(connectOneToMany);
     CPPUNIT_TEST(connectManyToMany);
     CPPUNIT_TEST(shareReader);
+    CPPUNIT_TEST(flushFrames);
+    CPPUNIT_TEST(flushEnabledJobs);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -55,6 +58,8 @@ protected:
     void connectOneToMany();
     void connectManyToMany();
     void shareReader();
+    void flushFrames();
+    void flushEnabledJobs();
 };
 
 void FilterUnitTest::setUp()
@@ -179,6 +184,72 @@ void FilterUnitTest::shareReader()
     delete satelliteFilter2;
 }
 
+void FilterUnitTest::flushFrames()
+{
+    HeadFilterMockup* head = new HeadFilterMockup();
+    FlushFilterMockup* filterToTest = new FlushFilterMockup(8, 3);
+    TailFilterMockup* tail = new TailFilterMockup();
+    Frame* frame = FrameMock::createNew(0);
+    Frame* extracted;
+    int ret;
+
+    CPPUNIT_ASSERT(head->connectOneToOne(filterToTest));
+    CPPUNIT_ASSERT(filterToTest->connectOneToOne(tail));
+
+    frame->setConsumed(true);
+    CPPUNIT_ASSERT(head->inject(frame));
+    head->processFrame(ret);
+    filterToTest->processFrame(ret);
+
+    for (int i = 0; i < 8; i++) {
+        tail->processFrame(ret);
+
+        if ((extracted = tail->extract())) {
+            CPPUNIT_ASSERT(extracted->getSequenceNumber() == 0);
+        }
+    }
+
+    CPPUNIT_ASSERT(tail->getFrames() == 4);
+
+    delete head;
+    delete filterToTest;
+    delete tail;
+    delete frame;
+}
+
+void FilterUnitTest::flushEnabledJobs()
+{
+    HeadFilterMockup* head = new HeadFilterMockup();
+    FlushFilterMockup* filterToTest = new FlushFilterMockup(8, 3, true);
+    TailFilterMockup* tail = new TailFilterMockup();
+    Frame* frame = FrameMock::createNew(0);
+    std::vector<int> enabledJobs;
+    int ret;
+
+    CPPUNIT_ASSERT(head->connectOneToOne(filterToTest));
+    CPPUNIT_ASSERT(filterToTest->connectOneToOne(tail));
+
+    frame->setConsumed(true);
+    CPPUNIT_ASSERT(head->inject(frame));
+    head->processFrame(ret);
+
+    //NOTE: the last flush does not produce a frame, readers must be enabled by the previous ones
+    enabledJobs = filterToTest->processFrame(ret);
+    CPPUNIT_ASSERT(std::count(enabledJobs.begin(), enabledJobs.end(), tail->getId()) == 1);
+
+    for (int i = 0; i < 8; i++) {
+        tail->processFrame(ret);
+        tail->extract();
+    }
+
+    CPPUNIT_ASSERT(tail->getFrames() == 3);
+
+    delete head;
+    delete filterToTest;
+    delete tail;
+    delete frame;
+}
+
 class FilterFunctionalTest : public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE(FilterFunctionalTest);
@@ -0,0 +1,174 @@
+/*
+ *  FractionalResamplerTest.cpp - FractionalResampler class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cmath>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "FractionalResampler.hh"
+#include "Utils.hh"
+
+#define TEST_CHANNELS 2
+#define TEST_SAMPLE_RATE 48000
+#define TEST_BLOCK 960
+#define TEST_BLOCKS 500
+#define TEST_FREQUENCY 1000
+
+class FractionalResamplerTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(FractionalResamplerTest);
+    CPPUNIT_TEST(identityTest);
+    CPPUNIT_TEST(ratioTest);
+    CPPUNIT_TEST(qualityTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void identityTest();
+    void ratioTest();
+    void qualityTest();
+
+    unsigned run(FractionalResampler& resampler, std::vector<float>& output);
+
+    std::vector<float> input[TEST_CHANNELS];
+    std::vector<float> block[TEST_CHANNELS];
+};
+
+void FractionalResamplerTest::setUp()
+{
+    for (int c = 0; c < TEST_CHANNELS; c++) {
+        input[c].resize(TEST_BLOCK*TEST_BLOCKS);
+        block[c].resize(2*TEST_BLOCK);
+
+        for (unsigned i = 0; i < input[c].size(); i++) {
+            input[c][i] = 0.5*sin(2*M_PI*TEST_FREQUENCY*i/TEST_SAMPLE_RATE + c);
+        }
+    }
+}
+
+void FractionalResamplerTest::tearDown()
+{
+}
+
+//NOTE: it resamples the whole input in blocks and returns the first channel output
+unsigned FractionalResamplerTest::run(FractionalResampler& resampler, std::vector<float>& output)
+{
+    const float* in[TEST_CHANNELS];
+    float* out[TEST_CHANNELS];
+    unsigned produced;
+
+    for (int c = 0; c < TEST_CHANNELS; c++) {
+        out[c] = block[c].data();
+    }
+
+    for (unsigned b = 0; b < TEST_BLOCKS; b++) {
+        for (int c = 0; c < TEST_CHANNELS; c++) {
+            in[c] = input[c].data() + b*TEST_BLOCK;
+        }
+
+        produced = resampler.process(in, TEST_BLOCK, out, 2*TEST_BLOCK);
+        output.insert(output.end(), block[0].begin(), block[0].begin() + produced);
+    }
+
+    return output.size();
+}
+
+void FractionalResamplerTest::identityTest()
+{
+    FractionalResampler resampler(TEST_CHANNELS);
+    std::vector<float> output;
+    unsigned produced;
+
+    produced = run(resampler, output);
+
+    //NOTE: only the filter lookahead is kept buffered
+    CPPUNIT_ASSERT_EQUAL(TEST_BLOCK*TEST_BLOCKS - RESAMPLER_TAPS/2, produced);
+
+    for (unsigned i = 0; i < produced; i++) {
+        CPPUNIT_ASSERT_EQUAL(input[0][i], output[i]);
+    }
+}
+
+void FractionalResamplerTest::ratioTest()
+{
+    FractionalResampler faster(TEST_CHANNELS);
+    FractionalResampler slower(TEST_CHANNELS);
+    std::vector<float> output;
+    double expected;
+
+    faster.setRatio(1.002);
+    expected = TEST_BLOCK*TEST_BLOCKS*1.002;
+    CPPUNIT_ASSERT(std::fabs(run(faster, output) - expected) <= RESAMPLER_TAPS);
+
+    output.clear();
+    slower.setRatio(0.998);
+    expected = TEST_BLOCK*TEST_BLOCKS*0.998;
+    CPPUNIT_ASSERT(std::fabs(run(slower, output) - expected) <= RESAMPLER_TAPS);
+}
+
+void FractionalResamplerTest::qualityTest()
+{
+    FractionalResampler resampler(TEST_CHANNELS);
+    std::vector<float> output;
+    double ratio = 1.0015;
+    double expected;
+    double maxError = 0;
+    unsigned produced;
+
+    resampler.setRatio(ratio);
+    produced = run(resampler, output);
+
+    //NOTE: output sample j is the input signal at position j/ratio
+    for (unsigned j = RESAMPLER_TAPS; j < produced; j++) {
+        expected = 0.5*sin(2*M_PI*TEST_FREQUENCY*(j/ratio)/TEST_SAMPLE_RATE);
+        maxError = std::max(maxError, std::fabs(expected - output[j]));
+    }
+
+    CPPUNIT_ASSERT(maxError < 0.001);
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FractionalResamplerTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("FractionalResamplerTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("",false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+/*
+ *  AudioEncoderLibavTest.cpp - AudioEncoderLibav class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <vector>
+#include <cstring>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/audioEncoder/AudioEncoderLibav.hh"
+#include "AudioFrame.hh"
+#include "Utils.hh"
+
+#define TEST_CHANNELS 2
+#define TEST_SAMPLE_RATE 48000
+#define TEST_BYTES_PER_SAMPLE 2
+#define TEST_SMALL_FRAME 700 //samples, smaller than a codec frame
+#define TEST_BASE_PTS 1000000 //us
+#define TEST_JUMP 1000000 //us, far beyond PTS_RESYNC_THRESHOLD
+
+//NOTE: PCM is used, so the codec has no delay and the codec frame size is the default one
+
+class AudioEncoderLibavMock : public AudioEncoderLibav {
+public:
+    AudioEncoderLibavMock() : AudioEncoderLibav() {};
+    using AudioEncoderLibav::configure0;
+    using AudioEncoderLibav::doProcessFrame;
+    using AudioEncoderLibav::hasPendingFrames;
+    using AudioEncoderLibav::flushFrame;
+};
+
+class AudioEncoderLibavTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(AudioEncoderLibavTest);
+    CPPUNIT_TEST(fifoTest);
+    CPPUNIT_TEST(multiPacketTest);
+    CPPUNIT_TEST(timestampTest);
+    CPPUNIT_TEST(resyncTest);
+    CPPUNIT_TEST(backwardResyncTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void fifoTest();
+    void multiPacketTest();
+    void timestampTest();
+    void resyncTest();
+    void backwardResyncTest();
+
+    bool encode(unsigned samples, int64_t pts);
+    std::vector<int64_t> encodeAll(unsigned samples, int64_t pts);
+    int64_t duration(int64_t samples);
+
+    AudioEncoderLibavMock* encoder;
+    InterleavedAudioFrame* rawFrame;
+    InterleavedAudioFrame* codedFrame;
+    unsigned frameSamples;
+};
+
+void AudioEncoderLibavTest::setUp()
+{
+    encoder = new AudioEncoderLibavMock();
+    CPPUNIT_ASSERT(encoder->configure0(PCM, TEST_CHANNELS, TEST_SAMPLE_RATE, 0));
+    frameSamples = encoder->getSamplesPerFrame();
+
+    rawFrame = InterleavedAudioFrame::createNew(TEST_CHANNELS, TEST_SAMPLE_RATE, 
+                                                AudioFrame::getMaxSamples(TEST_SAMPLE_RATE), PCM, S16);
+    codedFrame = InterleavedAudioFrame::createNew(TEST_CHANNELS, TEST_SAMPLE_RATE, 
+                                                  AudioFrame::getMaxSamples(TEST_SAMPLE_RATE), PCM, S16);
+    memset(rawFrame->getDataBuf(), 0, rawFrame->getMaxLength());
+}
+
+void AudioEncoderLibavTest::tearDown()
+{
+    delete encoder;
+    delete rawFrame;
+    delete codedFrame;
+}
+
+int64_t AudioEncoderLibavTest::duration(int64_t samples)
+{
+    return samples*std::micro::den/TEST_SAMPLE_RATE;
+}
+
+bool AudioEncoderLibavTest::encode(unsigned samples, int64_t pts)
+{
+    rawFrame->setSamples(samples);
+    rawFrame->setLength(samples*TEST_CHANNELS*TEST_BYTES_PER_SAMPLE);
+    rawFrame->setPresentationTime(std::chrono::microseconds(pts));
+    codedFrame->setConsumed(false);
+
+    return encoder->doProcessFrame(rawFrame, codedFrame);
+}
+
+//NOTE: returns the pts of every packet delivered for an input frame, as the filter flush loop does
+std::vector<int64_t> AudioEncoderLibavTest::encodeAll(unsigned samples, int64_t pts)
+{
+    std::vector<int64_t> packets;
+
+    if (!encode(samples, pts)) {
+        return packets;
+    }
+
+    packets.push_back(codedFrame->getPresentationTime().count());
+
+    while (encoder->hasPendingFrames()) {
+        codedFrame->setConsumed(false);
+        CPPUNIT_ASSERT(encoder->flushFrame(codedFrame));
+        packets.push_back(codedFrame->getPresentationTime().count());
+    }
+
+    return packets;
+}
+
+void AudioEncoderLibavTest::fifoTest()
+{
+    unsigned queued = 0;
+    unsigned packets = 0;
+
+    for (int i = 0; i < 20; i++) {
+        queued += TEST_SMALL_FRAME;
+
+        if (encode(TEST_SMALL_FRAME, TEST_BASE_PTS + duration(i*TEST_SMALL_FRAME))) {
+            packets++;
+            queued -= frameSamples;
+            CPPUNIT_ASSERT_EQUAL(frameSamples, codedFrame->getSamples());
+            CPPUNIT_ASSERT_EQUAL(frameSamples*TEST_CHANNELS*TEST_BYTES_PER_SAMPLE, codedFrame->getLength());
+        }
+
+        //NOTE: frames smaller than the codec frame never leave a whole codec frame queued
+        CPPUNIT_ASSERT(!encoder->hasPendingFrames());
+        CPPUNIT_ASSERT(queued < frameSamples);
+    }
+
+    CPPUNIT_ASSERT_EQUAL(20*TEST_SMALL_FRAME/frameSamples, packets);
+}
+
+void AudioEncoderLibavTest::multiPacketTest()
+{
+    std::vector<int64_t> packets;
+
+    packets = encodeAll(3*frameSamples + TEST_SMALL_FRAME, TEST_BASE_PTS);
+    CPPUNIT_ASSERT_EQUAL((size_t) 3, packets.size());
+    CPPUNIT_ASSERT(!encoder->hasPendingFrames());
+
+    for (size_t i = 0; i < packets.size(); i++) {
+        CPPUNIT_ASSERT_EQUAL(TEST_BASE_PTS + duration(i*frameSamples), packets[i]);
+    }
+
+    //NOTE: the remaining samples complete the next packet
+    packets = encodeAll(frameSamples - TEST_SMALL_FRAME, TEST_BASE_PTS + duration(3*frameSamples + TEST_SMALL_FRAME));
+    CPPUNIT_ASSERT_EQUAL((size_t) 1, packets.size());
+    CPPUNIT_ASSERT_EQUAL(TEST_BASE_PTS + duration(3*frameSamples), packets[0]);
+}
+
+void AudioEncoderLibavTest::timestampTest()
+{
+    int64_t pts = TEST_BASE_PTS;
+    int64_t samples = 0;
+    int64_t packets = 0;
+
+    //NOTE: input timestamps jitter within the threshold, output ones follow the sample count
+    for (int i = 0; i < 20; i++) {
+        int64_t jitter = (i % 2) ? PTS_RESYNC_THRESHOLD/2 : -PTS_RESYNC_THRESHOLD/2;
+
+        for (int64_t p : encodeAll(TEST_SMALL_FRAME, pts + duration(samples) + (i > 0 ? jitter : 0))) {
+            CPPUNIT_ASSERT_EQUAL(pts + duration(packets*frameSamples), p);
+            packets++;
+        }
+
+        samples += TEST_SMALL_FRAME;
+    }
+
+    CPPUNIT_ASSERT(packets > 0);
+}
+
+void AudioEncoderLibavTest::resyncTest()
+{
+    std::vector<int64_t> packets;
+
+    CPPUNIT_ASSERT(encodeAll(TEST_SMALL_FRAME, TEST_BASE_PTS).empty());
+
+    //NOTE: the queued samples keep their timestamps, the new timeline starts with the new input frame
+    packets = encodeAll(TEST_SMALL_FRAME, TEST_BASE_PTS + TEST_JUMP);
+    CPPUNIT_ASSERT_EQUAL((size_t) 1, packets.size());
+    CPPUNIT_ASSERT_EQUAL((int64_t) TEST_BASE_PTS, packets[0]);
+
+    packets = encodeAll(frameSamples, TEST_BASE_PTS + TEST_JUMP + duration(TEST_SMALL_FRAME));
+    CPPUNIT_ASSERT_EQUAL((size_t) 1, packets.size());
+    CPPUNIT_ASSERT_EQUAL(TEST_BASE_PTS + TEST_JUMP + duration(frameSamples - TEST_SMALL_FRAME), packets[0]);
+}
+
+void AudioEncoderLibavTest::backwardResyncTest()
+{
+    std::vector<int64_t> packets;
+    int64_t last;
+    int64_t pts = TEST_BASE_PTS + TEST_JUMP;
+
+    packets = encodeAll(frameSamples, pts);
+    CPPUNIT_ASSERT_EQUAL((size_t) 1, packets.size());
+    last = packets[0];
+
+    CPPUNIT_ASSERT(encodeAll(TEST_SMALL_FRAME, pts + duration(frameSamples)).empty());
+
+    //NOTE: input jumps back, output timestamps never go backwards nor overlap the delivered packets
+    for (int i = 0; i < 10; i++) {
+        for (int64_t p : encodeAll(frameSamples, TEST_BASE_PTS + duration(i*frameSamples))) {
+            CPPUNIT_ASSERT(p >= last + duration(frameSamples));
+            last = p;
+        }
+    }
+
+    //NOTE: once a new timeline is ahead again it is followed, after the queued samples
+    packets = encodeAll(frameSamples, TEST_BASE_PTS + 2*TEST_JUMP);
+    CPPUNIT_ASSERT_EQUAL((size_t) 1, packets.size());
+    CPPUNIT_ASSERT(packets[0] >= last + duration(frameSamples));
+
+    packets = encodeAll(frameSamples, TEST_BASE_PTS + 2*TEST_JUMP + duration(frameSamples));
+    CPPUNIT_ASSERT_EQUAL((size_t) 1, packets.size());
+    CPPUNIT_ASSERT_EQUAL(TEST_BASE_PTS + 2*TEST_JUMP + duration(frameSamples - TEST_SMALL_FRAME), packets[0]);
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AudioEncoderLibavTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("AudioEncoderLibavTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("",false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/*
+ *  ActiveSpeakerSelectorTest.cpp - ActiveSpeakerSelector class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <cmath>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/audioMixer/ActiveSpeakerSelector.hh"
+#include "Utils.hh"
+
+#define TEST_CHANNELS 2
+#define TEST_SAMPLE_RATE 48000
+#define TEST_SAMPLES 960 //20 ms
+
+class ActiveSpeakerSelectorTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(ActiveSpeakerSelectorTest);
+    CPPUNIT_TEST(configureTest);
+    CPPUNIT_TEST(levelTest);
+    CPPUNIT_TEST(disabledTest);
+    CPPUNIT_TEST(selectionTest);
+    CPPUNIT_TEST(hangoverTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void configureTest();
+    void levelTest();
+    void disabledTest();
+    void selectionTest();
+    void hangoverTest();
+
+    void fillFrame(PlanarAudioFrame* frame, float amplitude);
+
+    PlanarAudioFrame* silence;
+    PlanarAudioFrame* low;
+    PlanarAudioFrame* high;
+};
+
+void ActiveSpeakerSelectorTest::setUp()
+{
+    silence = PlanarAudioFrame::createNew(TEST_CHANNELS, TEST_SAMPLE_RATE, AudioFrame::getMaxSamples(TEST_SAMPLE_RATE), PCM, FLTP);
+    low = PlanarAudioFrame::createNew(TEST_CHANNELS, TEST_SAMPLE_RATE, AudioFrame::getMaxSamples(TEST_SAMPLE_RATE), PCM, FLTP);
+    high = PlanarAudioFrame::createNew(TEST_CHANNELS, TEST_SAMPLE_RATE, AudioFrame::getMaxSamples(TEST_SAMPLE_RATE), PCM, FLTP);
+
+    fillFrame(silence, 0);
+    fillFrame(low, 0.05);
+    fillFrame(high, 0.5);
+}
+
+void ActiveSpeakerSelectorTest::tearDown()
+{
+    delete silence;
+    delete low;
+    delete high;
+}
+
+void ActiveSpeakerSelectorTest::fillFrame(PlanarAudioFrame* frame, float amplitude)
+{
+    float* samples;
+
+    for (unsigned c = 0; c < TEST_CHANNELS; c++) {
+        samples = (float*) frame->getPlanarDataBuf()[c];
+
+        for (unsigned i = 0; i < TEST_SAMPLES; i++) {
+            samples[i] = amplitude*sin(2*M_PI*440*i/TEST_SAMPLE_RATE);
+        }
+    }
+
+    frame->setSamples(TEST_SAMPLES);
+    frame->setLength(TEST_SAMPLES*sizeof(float));
+}
+
+void ActiveSpeakerSelectorTest::configureTest()
+{
+    ActiveSpeakerSelector selector;
+
+    CPPUNIT_ASSERT(!selector.isEnabled());
+    CPPUNIT_ASSERT(!selector.configure(true, 0, 500, -50));
+    CPPUNIT_ASSERT(!selector.configure(true, 3, 500, 10));
+    CPPUNIT_ASSERT(!selector.configure(true, 3, 500, SILENCE_LEVEL - 1));
+    CPPUNIT_ASSERT(selector.configure(true, 3, 200, -40));
+    CPPUNIT_ASSERT(selector.isEnabled());
+    CPPUNIT_ASSERT(selector.getSpeakers() == 3);
+    CPPUNIT_ASSERT(selector.getHangover() == 200);
+    CPPUNIT_ASSERT(selector.getThreshold() == -40);
+}
+
+void ActiveSpeakerSelectorTest::levelTest()
+{
+    ActiveSpeakerSelector selector;
+
+    //NOTE: RMS of a sine is amplitude/sqrt(2), -3 dB
+    CPPUNIT_ASSERT(fabs(ActiveSpeakerSelector::frameLevel(high) - (20*log10(0.5) - 3.01)) < 0.1);
+    CPPUNIT_ASSERT(ActiveSpeakerSelector::frameLevel(silence) == SILENCE_LEVEL);
+
+    CPPUNIT_ASSERT(!selector.update(1, high));
+    selector.addChannel(1);
+    CPPUNIT_ASSERT(selector.update(1, high));
+    selector.removeChannel(1);
+    CPPUNIT_ASSERT(!selector.update(1, high));
+}
+
+void ActiveSpeakerSelectorTest::disabledTest()
+{
+    ActiveSpeakerSelector selector;
+
+    for (int id = 1; id <= 4; id++) {
+        selector.addChannel(id);
+        selector.update(id, silence);
+    }
+
+    selector.select();
+
+    for (int id = 1; id <= 4; id++) {
+        CPPUNIT_ASSERT(selector.isSelected(id));
+    }
+
+    CPPUNIT_ASSERT(!selector.isSelected(5));
+}
+
+void ActiveSpeakerSelectorTest::selectionTest()
+{
+    ActiveSpeakerSelector selector;
+
+    CPPUNIT_ASSERT(selector.configure(true, 2, 0, -50));
+
+    for (int id = 1; id <= 4; id++) {
+        selector.addChannel(id);
+    }
+
+    selector.update(1, low);
+    selector.update(2, high);
+    selector.update(3, high);
+    selector.update(4, silence);
+    selector.select();
+
+    CPPUNIT_ASSERT(!selector.isSelected(1));
+    CPPUNIT_ASSERT(selector.isSelected(2));
+    CPPUNIT_ASSERT(selector.isSelected(3));
+    CPPUNIT_ASSERT(!selector.isSelected(4));
+
+    //NOTE: louder new speakers do not replace speakers that are still talking
+    selector.update(1, high);
+    selector.update(2, low);
+    selector.update(3, low);
+    selector.select();
+
+    CPPUNIT_ASSERT(!selector.isSelected(1));
+    CPPUNIT_ASSERT(selector.isSelected(2));
+    CPPUNIT_ASSERT(selector.isSelected(3));
+
+    selector.update(2, silence);
+    selector.select();
+
+    CPPUNIT_ASSERT(selector.isSelected(1));
+    CPPUNIT_ASSERT(!selector.isSelected(2));
+    CPPUNIT_ASSERT(selector.isSelected(3));
+}
+
+void ActiveSpeakerSelectorTest::hangoverTest()
+{
+    ActiveSpeakerSelector selector;
+    unsigned hangoverFrames = 5;
+
+    CPPUNIT_ASSERT(selector.configure(true, 1, hangoverFrames*TEST_SAMPLES*1000/TEST_SAMPLE_RATE, -50));
+
+    selector.addChannel(1);
+    selector.addChannel(2);
+
+    selector.update(1, high);
+    selector.select();
+    CPPUNIT_ASSERT(selector.isSelected(1));
+
+    for (unsigned i = 0; i < hangoverFrames - 1; i++) {
+        selector.update(1, silence);
+        selector.update(2, silence);
+        selector.select();
+        CPPUNIT_ASSERT(selector.isSelected(1));
+    }
+
+    selector.update(1, silence);
+    selector.select();
+    CPPUNIT_ASSERT(!selector.isSelected(1));
+
+    //NOTE: a speaker in its hangover leaves the slot to a new speaker
+    selector.update(1, high);
+    selector.select();
+    selector.update(1, silence);
+    selector.update(2, low);
+    selector.select();
+    CPPUNIT_ASSERT(!selector.isSelected(1));
+    CPPUNIT_ASSERT(selector.isSelected(2));
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ActiveSpeakerSelectorTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("ActiveSpeakerSelectorTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("",false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+/*
+ *  AudioMixMinusTest.cpp - AudioMixMinus class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <cmath>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/audioMixer/AudioMixMinus.hh"
+#include "AudioCircularBuffer.hh"
+
+#define PARTICIPANTS 3
+#define FULL_MIX_ID 100
+
+class AudioMixMinusMock : public AudioMixMinus {
+public:
+    AudioMixMinusMock() : AudioMixMinus() {};
+    using AudioMixMinus::doProcessFrame;
+    using AudioMixMinus::specificReaderConfig;
+    using AudioMixMinus::specificReaderDelete;
+};
+
+class AudioMixMinusTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(AudioMixMinusTest);
+    CPPUNIT_TEST(participantsTest);
+    CPPUNIT_TEST(mixMinusTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void participantsTest();
+    void mixMinusTest();
+
+    AudioMixMinusMock* mixer;
+    AudioCircularBuffer* queues[PARTICIPANTS];
+    PlanarAudioFrame* inFrames[PARTICIPANTS];
+    std::map<int, Frame*> outFrames;
+    float values[PARTICIPANTS] = {0.1, 0.2, 0.4};
+};
+
+void AudioMixMinusTest::setUp()
+{
+    ConnectionData cData;
+    unsigned samples;
+    float* data;
+
+    mixer = new AudioMixMinusMock();
+    samples = mixer->getInputFrameSamples();
+
+    for (int p = 0; p < PARTICIPANTS; p++) {
+        queues[p] = AudioCircularBuffer::createNew(cData, DEFAULT_CHANNELS, DEFAULT_SAMPLE_RATE, DEFAULT_BUFFER_SIZE, FLTP);
+        inFrames[p] = PlanarAudioFrame::createNew(DEFAULT_CHANNELS, DEFAULT_SAMPLE_RATE, 
+                                                  AudioFrame::getMaxSamples(DEFAULT_SAMPLE_RATE), PCM, FLTP);
+
+        for (int c = 0; c < DEFAULT_CHANNELS; c++) {
+            data = (float*) inFrames[p]->getPlanarDataBuf()[c];
+            for (unsigned i = 0; i < samples; i++) {
+                data[i] = values[p];
+            }
+        }
+
+        inFrames[p]->setSamples(samples);
+        inFrames[p]->setLength(samples*sizeof(float));
+        outFrames[p + 1] = PlanarAudioFrame::createNew(DEFAULT_CHANNELS, DEFAULT_SAMPLE_RATE, 
+                                                       AudioFrame::getMaxSamples(DEFAULT_SAMPLE_RATE), PCM, FLTP);
+    }
+
+    outFrames[FULL_MIX_ID] = PlanarAudioFrame::createNew(DEFAULT_CHANNELS, DEFAULT_SAMPLE_RATE, 
+                                                         AudioFrame::getMaxSamples(DEFAULT_SAMPLE_RATE), PCM, FLTP);
+}
+
+void AudioMixMinusTest::tearDown()
+{
+    for (int p = 0; p < PARTICIPANTS; p++) {
+        delete queues[p];
+        delete inFrames[p];
+    }
+
+    for (auto it : outFrames) {
+        delete it.second;
+    }
+
+    outFrames.clear();
+    delete mixer;
+}
+
+void AudioMixMinusTest::participantsTest()
+{
+    CPPUNIT_ASSERT(!mixer->specificReaderDelete(1));
+    CPPUNIT_ASSERT(mixer->specificReaderConfig(1, queues[0]));
+    CPPUNIT_ASSERT(!mixer->specificReaderConfig(1, queues[0]));
+    CPPUNIT_ASSERT(mixer->specificReaderDelete(1));
+    CPPUNIT_ASSERT(!mixer->specificReaderDelete(1));
+}
+
+void AudioMixMinusTest::mixMinusTest()
+{
+    std::map<int, Frame*> orgFrames;
+    std::vector<int> newFrames;
+    std::chrono::microseconds ts(0);
+    std::chrono::microseconds tsIncrement;
+    float total = 0;
+    float expected;
+    float* data;
+    AudioFrame* out;
+    bool mixed = false;
+
+    tsIncrement = std::chrono::microseconds(mixer->getInputFrameSamples()*std::micro::den/DEFAULT_SAMPLE_RATE);
+
+    for (int p = 0; p < PARTICIPANTS; p++) {
+        CPPUNIT_ASSERT(mixer->specificReaderConfig(p + 1, queues[p]));
+        orgFrames[p + 1] = inFrames[p];
+        newFrames.push_back(p + 1);
+        total += values[p]*DEFAULT_CHANNEL_GAIN*DEFAULT_MASTER_GAIN;
+    }
+
+    for (unsigned i = 0; i*mixer->getInputFrameSamples() <= mixer->getMixingThreshold(); i++) {
+        for (int p = 0; p < PARTICIPANTS; p++) {
+            inFrames[p]->setPresentationTime(ts);
+        }
+
+        if (mixer->doProcessFrame(orgFrames, outFrames, newFrames)) {
+            mixed = true;
+            break;
+        }
+
+        ts += tsIncrement;
+    }
+
+    CPPUNIT_ASSERT(mixed);
+
+    for (auto it : outFrames) {
+        out = dynamic_cast<AudioFrame*>(it.second);
+        CPPUNIT_ASSERT(out->getConsumed());
+        CPPUNIT_ASSERT(out->getSamples() == mixer->getInputFrameSamples());
+        CPPUNIT_ASSERT(out->getPresentationTime() == std::chrono::microseconds(0));
+
+        if (it.first == FULL_MIX_ID) {
+            expected = total;
+        } else {
+            expected = total - values[it.first - 1]*DEFAULT_CHANNEL_GAIN*DEFAULT_MASTER_GAIN;
+        }
+
+        //NOTE: values are kept under the compression threshold
+        CPPUNIT_ASSERT(expected < COMPRESSION_THRESHOLD);
+
+        for (unsigned c = 0; c < out->getChannels(); c++) {
+            data = (float*) out->getPlanarDataBuf()[c];
+            for (unsigned i = 0; i < out->getSamples(); i++) {
+                CPPUNIT_ASSERT(fabs(data[i] - expected) < 1e-5);
+            }
+        }
+    }
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AudioMixMinusTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("AudioMixMinusTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("",false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,273 @@
+/*
+ *  AudioMixerTest.cpp - AudioMixer class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cmath>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/audioMixer/AudioMixer.hh"
+#include "AudioCircularBuffer.hh"
+#include "Utils.hh"
+
+#define SURROUND_CHANNELS 6
+#define DISCRETE_CHANNELS 16
+#define EPSILON 0.0001
+
+class AudioMixerMock : public AudioMixer {
+public:
+    AudioMixerMock() : AudioMixer() {};
+    using AudioMixer::doProcessFrame;
+    using AudioMixer::specificReaderConfig;
+    using AudioMixer::specificReaderDelete;
+    using AudioMixer::specificWriterConfig;
+};
+
+class AudioMixerTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(AudioMixerTest);
+    CPPUNIT_TEST(mixMatrixTest);
+    CPPUNIT_TEST(inputChannelsTest);
+    CPPUNIT_TEST(downmixTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void mixMatrixTest();
+    void inputChannelsTest();
+    void downmixTest();
+
+    AudioCircularBuffer* createQueue(unsigned channels);
+    int mixerChannels();
+    float gain(std::vector<float>& matrix, unsigned inChannels, unsigned out, unsigned in);
+
+    AudioMixerMock* mixer;
+    std::vector<AudioCircularBuffer*> queues;
+    std::vector<StreamInfo*> infos;
+};
+
+void AudioMixerTest::setUp()
+{
+    mixer = new AudioMixerMock();
+}
+
+void AudioMixerTest::tearDown()
+{
+    delete mixer;
+
+    for (auto q : queues) {
+        delete q;
+    }
+
+    for (auto si : infos) {
+        delete si;
+    }
+
+    queues.clear();
+    infos.clear();
+}
+
+//NOTE: queues as allocated by an upstream decoder, described by its StreamInfo
+AudioCircularBuffer* AudioMixerTest::createQueue(unsigned channels)
+{
+    ConnectionData cData;
+    StreamInfo* si = new StreamInfo(AUDIO);
+
+    si->audio.codec = PCM;
+    si->audio.channels = channels;
+    si->audio.sampleRate = DEFAULT_SAMPLE_RATE;
+    si->audio.sampleFormat = FLTP;
+    infos.push_back(si);
+
+    queues.push_back(AudioCircularBuffer::createNew(cData, channels, DEFAULT_SAMPLE_RATE, 
+                                                    DEFAULT_BUFFER_SIZE, FLTP, si));
+    return queues.back();
+}
+
+int AudioMixerTest::mixerChannels()
+{
+    Jzon::Object state;
+
+    mixer->getState(state);
+    return state.Get("channels").ToInt();
+}
+
+float AudioMixerTest::gain(std::vector<float>& matrix, unsigned inChannels, unsigned out, unsigned in)
+{
+    return matrix[out*inChannels + in];
+}
+
+void AudioMixerTest::mixMatrixTest()
+{
+    std::vector<float> m;
+
+    //NOTE: 5.1 (FL FR FC LFE BL BR) into stereo, centre and surrounds at -3 dB and no LFE
+    AudioMixer::getMixMatrix(SURROUND_CHANNELS, 2, m);
+    CPPUNIT_ASSERT_EQUAL(1.0f, gain(m, 6, 0, 0));
+    CPPUNIT_ASSERT_EQUAL(0.0f, gain(m, 6, 0, 1));
+    CPPUNIT_ASSERT(std::fabs(gain(m, 6, 0, 2) - M_SQRT1_2) < EPSILON);
+    CPPUNIT_ASSERT(std::fabs(gain(m, 6, 1, 2) - M_SQRT1_2) < EPSILON);
+    CPPUNIT_ASSERT_EQUAL(0.0f, gain(m, 6, 0, 3));
+    CPPUNIT_ASSERT_EQUAL(0.0f, gain(m, 6, 1, 3));
+    CPPUNIT_ASSERT(std::fabs(gain(m, 6, 0, 4) - M_SQRT1_2) < EPSILON);
+    CPPUNIT_ASSERT_EQUAL(0.0f, gain(m, 6, 1, 4));
+    CPPUNIT_ASSERT(std::fabs(gain(m, 6, 1, 5) - M_SQRT1_2) < EPSILON);
+
+    //NOTE: stereo into 5.1 only feeds the front speakers
+    AudioMixer::getMixMatrix(2, SURROUND_CHANNELS, m);
+    CPPUNIT_ASSERT_EQUAL(1.0f, gain(m, 2, 0, 0));
+    CPPUNIT_ASSERT_EQUAL(1.0f, gain(m, 2, 1, 1));
+    for (unsigned o = 2; o < SURROUND_CHANNELS; o++) {
+        CPPUNIT_ASSERT_EQUAL(0.0f, gain(m, 2, o, 0));
+        CPPUNIT_ASSERT_EQUAL(0.0f, gain(m, 2, o, 1));
+    }
+
+    //NOTE: mono keeps its level in both front speakers, or goes to the centre one
+    AudioMixer::getMixMatrix(1, 2, m);
+    CPPUNIT_ASSERT_EQUAL(1.0f, gain(m, 1, 0, 0));
+    CPPUNIT_ASSERT_EQUAL(1.0f, gain(m, 1, 1, 0));
+    AudioMixer::getMixMatrix(1, SURROUND_CHANNELS, m);
+    CPPUNIT_ASSERT_EQUAL(0.0f, gain(m, 1, 0, 0));
+    CPPUNIT_ASSERT_EQUAL(1.0f, gain(m, 1, 2, 0));
+
+    AudioMixer::getMixMatrix(2, 1, m);
+    CPPUNIT_ASSERT(std::fabs(gain(m, 2, 0, 0) - M_SQRT1_2) < EPSILON);
+    CPPUNIT_ASSERT(std::fabs(gain(m, 2, 0, 1) - M_SQRT1_2) < EPSILON);
+
+    //NOTE: channel counts without a known layout are mixed channel by channel
+    AudioMixer::getMixMatrix(DISCRETE_CHANNELS, 2, m);
+    CPPUNIT_ASSERT_EQUAL(1.0f, gain(m, DISCRETE_CHANNELS, 0, 0));
+    CPPUNIT_ASSERT_EQUAL(1.0f, gain(m, DISCRETE_CHANNELS, 1, 1));
+    CPPUNIT_ASSERT_EQUAL(0.0f, gain(m, DISCRETE_CHANNELS, 0, 2));
+
+    AudioMixer::getMixMatrix(DISCRETE_CHANNELS, DISCRETE_CHANNELS, m);
+    for (unsigned o = 0; o < DISCRETE_CHANNELS; o++) {
+        for (unsigned i = 0; i < DISCRETE_CHANNELS; i++) {
+            CPPUNIT_ASSERT_EQUAL(o == i ? 1.0f : 0.0f, gain(m, DISCRETE_CHANNELS, o, i));
+        }
+    }
+}
+
+void AudioMixerTest::inputChannelsTest()
+{
+    CPPUNIT_ASSERT_EQUAL(DEFAULT_CHANNELS, mixerChannels());
+
+    //NOTE: the output follows the widest input
+    CPPUNIT_ASSERT(mixer->specificReaderConfig(1, createQueue(1)));
+    CPPUNIT_ASSERT_EQUAL(1, mixerChannels());
+    CPPUNIT_ASSERT(mixer->specificReaderConfig(2, createQueue(SURROUND_CHANNELS)));
+    CPPUNIT_ASSERT_EQUAL(SURROUND_CHANNELS, mixerChannels());
+    CPPUNIT_ASSERT(mixer->specificReaderConfig(3, createQueue(2)));
+    CPPUNIT_ASSERT_EQUAL(SURROUND_CHANNELS, mixerChannels());
+    CPPUNIT_ASSERT(mixer->specificReaderDelete(2));
+    CPPUNIT_ASSERT_EQUAL(2, mixerChannels());
+
+    //NOTE: once the output is connected its layout is kept
+    CPPUNIT_ASSERT(mixer->specificWriterConfig(1));
+    CPPUNIT_ASSERT(mixer->specificReaderConfig(4, createQueue(SURROUND_CHANNELS)));
+    CPPUNIT_ASSERT_EQUAL(2, mixerChannels());
+    CPPUNIT_ASSERT(mixer->specificReaderDelete(3));
+    CPPUNIT_ASSERT_EQUAL(2, mixerChannels());
+}
+
+void AudioMixerTest::downmixTest()
+{
+    const float values[SURROUND_CHANNELS] = {0.1, 0.05, 0.2, 0.4, 0.1, 0};
+    std::map<int, Frame*> orgFrames;
+    std::vector<int> newFrames;
+    PlanarAudioFrame* inFrame;
+    PlanarAudioFrame* outFrame;
+    unsigned samples = mixer->getInputFrameSamples();
+    float expected[2];
+    bool mixed = false;
+    float* data;
+
+    CPPUNIT_ASSERT(mixer->specificReaderConfig(1, createQueue(2)));
+    CPPUNIT_ASSERT(mixer->specificWriterConfig(1));
+    CPPUNIT_ASSERT(mixer->specificReaderConfig(2, createQueue(SURROUND_CHANNELS)));
+    CPPUNIT_ASSERT(mixer->specificReaderDelete(1));
+    CPPUNIT_ASSERT_EQUAL(2, mixerChannels());
+
+    inFrame = PlanarAudioFrame::createNew(SURROUND_CHANNELS, DEFAULT_SAMPLE_RATE, 
+                                          AudioFrame::getMaxSamples(DEFAULT_SAMPLE_RATE), PCM, FLTP);
+    outFrame = PlanarAudioFrame::createNew(2, DEFAULT_SAMPLE_RATE, 
+                                           AudioFrame::getMaxSamples(DEFAULT_SAMPLE_RATE), PCM, FLTP);
+
+    for (int c = 0; c < SURROUND_CHANNELS; c++) {
+        data = (float*) inFrame->getPlanarDataBuf()[c];
+        for (unsigned i = 0; i < samples; i++) {
+            data[i] = values[c];
+        }
+    }
+
+    inFrame->setSamples(samples);
+    inFrame->setLength(samples*sizeof(float));
+    orgFrames[2] = inFrame;
+    newFrames.push_back(2);
+
+    for (int f = 0; f < 10 && !mixed; f++) {
+        inFrame->setPresentationTime(std::chrono::microseconds(f*samples*std::micro::den/DEFAULT_SAMPLE_RATE));
+        mixed = mixer->doProcessFrame(orgFrames, outFrame, newFrames);
+    }
+
+    CPPUNIT_ASSERT(mixed);
+    CPPUNIT_ASSERT_EQUAL(2u, outFrame->getChannels());
+
+    //NOTE: LFE is dropped, so its level does not reach the output
+    expected[0] = DEFAULT_MASTER_GAIN*(values[0] + M_SQRT1_2*values[2] + M_SQRT1_2*values[4]);
+    expected[1] = DEFAULT_MASTER_GAIN*(values[1] + M_SQRT1_2*values[2] + M_SQRT1_2*values[5]);
+
+    for (int c = 0; c < 2; c++) {
+        data = (float*) outFrame->getPlanarDataBuf()[c];
+        CPPUNIT_ASSERT(std::fabs(data[0] - expected[c]) < EPSILON);
+        CPPUNIT_ASSERT(std::fabs(data[samples - 1] - expected[c]) < EPSILON);
+    }
+
+    delete inFrame;
+    delete outFrame;
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AudioMixerTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("AudioMixerTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("",false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+/*
+ *  PeakLimiterTest.cpp - PeakLimiter class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <cmath>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/audioMixer/PeakLimiter.hh"
+#include "Utils.hh"
+
+#define TEST_CHANNELS 2
+#define TEST_SAMPLE_RATE 48000
+#define TEST_FRAME_SAMPLES 1024
+#define TEST_BUFFER_SAMPLES 5120
+#define TEST_BURST_START 2000
+#define TEST_BURST_END 2100
+#define TEST_LEVEL 0.5
+#define TEST_BURST_LEVEL 1.6
+
+class PeakLimiterTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(PeakLimiterTest);
+    CPPUNIT_TEST(configureTest);
+    CPPUNIT_TEST(transparentTest);
+    CPPUNIT_TEST(limitTest);
+    CPPUNIT_TEST(wrapTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void configureTest();
+    void transparentTest();
+    void limitTest();
+    void wrapTest();
+
+    void fill(float level, float burstLevel);
+    float maxAbs();
+
+    float* buffers[TEST_CHANNELS];
+};
+
+void PeakLimiterTest::setUp()
+{
+    for (int i = 0; i < TEST_CHANNELS; i++) {
+        buffers[i] = new float[TEST_BUFFER_SAMPLES];
+    }
+}
+
+void PeakLimiterTest::tearDown()
+{
+    for (int i = 0; i < TEST_CHANNELS; i++) {
+        delete[] buffers[i];
+    }
+}
+
+void PeakLimiterTest::fill(float level, float burstLevel)
+{
+    for (int i = 0; i < TEST_CHANNELS; i++) {
+        for (unsigned j = 0; j < TEST_BUFFER_SAMPLES; j++) {
+            buffers[i][j] = j % 2 ? level : -level;
+        }
+    }
+
+    //NOTE: the burst is only in one channel, gain is shared so both are attenuated
+    for (unsigned j = TEST_BURST_START; j < TEST_BURST_END; j++) {
+        buffers[1][j] = j % 2 ? burstLevel : -burstLevel;
+    }
+}
+
+float PeakLimiterTest::maxAbs()
+{
+    float max = 0;
+
+    for (int i = 0; i < TEST_CHANNELS; i++) {
+        for (unsigned j = 0; j < TEST_BUFFER_SAMPLES; j++) {
+            max = std::max(max, std::fabs(buffers[i][j]));
+        }
+    }
+
+    return max;
+}
+
+void PeakLimiterTest::configureTest()
+{
+    PeakLimiter limiter(TEST_SAMPLE_RATE);
+
+    CPPUNIT_ASSERT(!limiter.configure(0, 5, 50));
+    CPPUNIT_ASSERT(!limiter.configure(1.5, 5, 50));
+    CPPUNIT_ASSERT(limiter.configure(0.9, 10, 100));
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.9, limiter.getThreshold(), 0.0001);
+    CPPUNIT_ASSERT_EQUAL(10U, limiter.getAttack());
+    CPPUNIT_ASSERT_EQUAL(100U, limiter.getRelease());
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0, limiter.getGainReduction(), 0.0001);
+}
+
+void PeakLimiterTest::transparentTest()
+{
+    PeakLimiter limiter(TEST_SAMPLE_RATE);
+
+    fill(TEST_LEVEL, TEST_LEVEL);
+
+    for (unsigned pos = 0; pos < TEST_BUFFER_SAMPLES; pos += TEST_FRAME_SAMPLES) {
+        limiter.process(buffers, TEST_CHANNELS, TEST_BUFFER_SAMPLES, pos, TEST_FRAME_SAMPLES,
+                        TEST_BUFFER_SAMPLES - pos);
+    }
+
+    //NOTE: below the threshold samples must not be modified at all
+    for (int i = 0; i < TEST_CHANNELS; i++) {
+        for (unsigned j = 0; j < TEST_BUFFER_SAMPLES; j++) {
+            CPPUNIT_ASSERT_EQUAL((float) (j % 2 ? TEST_LEVEL : -TEST_LEVEL), buffers[i][j]);
+        }
+    }
+
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0, limiter.getMaxGainReduction(), 0.0001);
+}
+
+void PeakLimiterTest::limitTest()
+{
+    PeakLimiter limiter(TEST_SAMPLE_RATE);
+    float threshold = DEFAULT_LIMITER_THRESHOLD;
+    unsigned attackSamples = DEFAULT_LIMITER_ATTACK*TEST_SAMPLE_RATE/1000;
+
+    fill(TEST_LEVEL, TEST_BURST_LEVEL);
+
+    limiter.process(buffers, TEST_CHANNELS, TEST_BUFFER_SAMPLES, 0, TEST_FRAME_SAMPLES, TEST_BUFFER_SAMPLES);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0, limiter.getMaxGainReduction(), 0.0001);
+
+    limiter.process(buffers, TEST_CHANNELS, TEST_BUFFER_SAMPLES, TEST_FRAME_SAMPLES,
+                    TEST_FRAME_SAMPLES, TEST_BUFFER_SAMPLES - TEST_FRAME_SAMPLES);
+    CPPUNIT_ASSERT(limiter.getMaxGainReduction() > 0);
+    CPPUNIT_ASSERT(limiter.getGainReduction() > 0);
+
+    for (unsigned pos = 2*TEST_FRAME_SAMPLES; pos < TEST_BUFFER_SAMPLES; pos += TEST_FRAME_SAMPLES) {
+        limiter.process(buffers, TEST_CHANNELS, TEST_BUFFER_SAMPLES, pos, TEST_FRAME_SAMPLES,
+                        TEST_BUFFER_SAMPLES - pos);
+    }
+
+    CPPUNIT_ASSERT(maxAbs() <= threshold + 0.0001);
+
+    //NOTE: attenuation starts before the burst (lookahead) and not before the attack time
+    CPPUNIT_ASSERT(std::fabs(buffers[0][TEST_BURST_START - 1]) < TEST_LEVEL*threshold/TEST_BURST_LEVEL + 0.0001);
+    CPPUNIT_ASSERT(std::fabs(buffers[0][TEST_BURST_START - LIMITER_BLOCK]) < TEST_LEVEL);
+    CPPUNIT_ASSERT_EQUAL((float) TEST_LEVEL, std::fabs(buffers[0][TEST_BURST_START - attackSamples - 2*LIMITER_BLOCK]));
+
+    //NOTE: gain is recovered progressively after the burst
+    CPPUNIT_ASSERT(std::fabs(buffers[0][TEST_BURST_END + 100]) < std::fabs(buffers[0][TEST_BURST_END + 1000]));
+    CPPUNIT_ASSERT(std::fabs(buffers[0][TEST_BURST_END + 1000]) < std::fabs(buffers[0][TEST_BUFFER_SAMPLES - 1]));
+    CPPUNIT_ASSERT(std::fabs(buffers[0][TEST_BUFFER_SAMPLES - 1]) <= TEST_LEVEL);
+}
+
+void PeakLimiterTest::wrapTest()
+{
+    PeakLimiter limiter(TEST_SAMPLE_RATE);
+    unsigned pos = TEST_BUFFER_SAMPLES - TEST_FRAME_SAMPLES/2;
+
+    fill(TEST_LEVEL, TEST_LEVEL);
+
+    for (int i = 0; i < TEST_CHANNELS; i++) {
+        buffers[i][10] = TEST_BURST_LEVEL;
+        buffers[i][TEST_BUFFER_SAMPLES - 10] = -TEST_BURST_LEVEL;
+    }
+
+    //NOTE: processed span and lookahead go through the end of the circular buffer
+    limiter.process(buffers, TEST_CHANNELS, TEST_BUFFER_SAMPLES, pos, TEST_FRAME_SAMPLES, 2*TEST_FRAME_SAMPLES);
+
+    for (int i = 0; i < TEST_CHANNELS; i++) {
+        CPPUNIT_ASSERT(std::fabs(buffers[i][10]) <= DEFAULT_LIMITER_THRESHOLD + 0.0001);
+        CPPUNIT_ASSERT(std::fabs(buffers[i][TEST_BUFFER_SAMPLES - 10]) <= DEFAULT_LIMITER_THRESHOLD + 0.0001);
+    }
+
+    //NOTE: samples out of the processed span are not modified
+    CPPUNIT_ASSERT_EQUAL((float) TEST_LEVEL, std::fabs(buffers[0][TEST_FRAME_SAMPLES]));
+    CPPUNIT_ASSERT_EQUAL((float) TEST_LEVEL, std::fabs(buffers[0][pos - 1]));
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PeakLimiterTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("PeakLimiterTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("",false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
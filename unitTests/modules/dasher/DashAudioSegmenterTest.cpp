@@ -37,6 +37,7 @@
 #define CHANNELS 2
 #define SAMPLE_RATE 48000
 #define AAC_FRAME_SAMPLES 1024
+#define CHUNK_FRAMES 10
 
 size_t readFile(char const* fileName, char* dstBuffer)
 {
@@ -63,6 +64,7 @@ class DashAudioSegmenterTest : public CppUnit::TestFixture
     CPPUNIT_TEST(generateInitSegment);
     CPPUNIT_TEST(appendFrameToDashSegment);
     CPPUNIT_TEST(generateSegment);
+    CPPUNIT_TEST(generateChunkedSegment);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -74,6 +76,7 @@ protected:
     void generateInitSegment();
     void appendFrameToDashSegment();
     void generateSegment();
+    void generateChunkedSegment();
 
     bool newFrame;
     DashAudioSegmenter* segmenter;
@@ -182,6 +185,55 @@ void DashAudioSegmenterTest::generateSegment()
     CPPUNIT_ASSERT(segmentModelLength == segment->getDataLength());
 }
 
+void DashAudioSegmenterTest::generateChunkedSegment()
+{
+    DashSegment* segment = new DashSegment();
+    Frame* frame;
+    size_t samples = 0;
+    unsigned chunks = 0;
+    unsigned chunkLength = 0;
+    uint64_t chunkTimestamp = 0;
+    std::chrono::microseconds originTs(1000);
+
+    segmenter->setChunkFrames(CHUNK_FRAMES);
+    modelFrame->setSamples(AAC_FRAME_SAMPLES);
+
+    CPPUNIT_ASSERT(!segmenter->generateChunk(segment));
+
+    while (true) {
+        modelFrame->setPresentationTime(std::chrono::microseconds(samples*std::micro::den/SAMPLE_RATE) + originTs);
+        frame = segmenter->manageFrame(modelFrame);
+
+        CPPUNIT_ASSERT(frame);
+        samples += AAC_FRAME_SAMPLES;
+
+        if (segmenter->generateSegment(segment, frame)) {
+            break;
+        }
+
+        CPPUNIT_ASSERT(segmenter->appendFrameToDashSegment(frame));
+
+        if (segmenter->generateChunk(segment)) {
+            CPPUNIT_ASSERT(segment->getDataLength() > chunkLength);
+            //NOTE: timestamps are rounded to the time base
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(CHUNK_FRAMES*segmenter->getFrameDuration(), segmenter->getChunkDuration(), 1);
+            chunkLength = segment->getDataLength();
+            chunkTimestamp = segment->getTimestamp();
+            chunks++;
+        }
+    }
+
+    //NOTE: the last chunk is generated with the segment, which keeps the previous ones
+    CPPUNIT_ASSERT(chunks > 0);
+    CPPUNIT_ASSERT(segment->isComplete());
+    CPPUNIT_ASSERT(segment->getDataLength() > chunkLength);
+    CPPUNIT_ASSERT(segment->getTimestamp() == chunkTimestamp);
+    CPPUNIT_ASSERT(memcmp(segment->getDataBuffer() + 4, "styp", 4) == 0);
+    CPPUNIT_ASSERT(!segmenter->generateChunk(segment));
+
+    delete segment;
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(DashAudioSegmenterTest);
 
 int main(int argc, char* argv[])
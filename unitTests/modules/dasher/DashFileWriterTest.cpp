@@ -0,0 +1,261 @@
+/*
+ *  DashFileWriterTest.cpp - DashFileWriter test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <string.h>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/dasher/DashFileWriter.hh"
+#include "Utils.hh"
+
+#define SEGMENT_SIZE 100000 //bytes
+#define SEGMENTS 10
+
+class DashFileWriterTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(DashFileWriterTest);
+    CPPUNIT_TEST(writeAndRemove);
+    CPPUNIT_TEST(overwrite);
+    CPPUNIT_TEST(boundedQueue);
+    CPPUNIT_TEST(invalidPath);
+    CPPUNIT_TEST(appendChunks);
+    CPPUNIT_TEST(removeAndWrite);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void writeAndRemove();
+    void overwrite();
+    void boundedQueue();
+    void invalidPath();
+    void appendChunks();
+    void removeAndWrite();
+
+    std::string readFile(std::string path);
+    std::string segmentPath(unsigned i);
+
+    std::string folder;
+    std::vector<unsigned char> segment;
+};
+
+void DashFileWriterTest::setUp()
+{
+    char tmpl[] = "/tmp/dashFileWriterTestXXXXXX";
+
+    CPPUNIT_ASSERT(mkdtemp(tmpl) != NULL);
+    folder = std::string(tmpl) + "/";
+
+    segment.resize(SEGMENT_SIZE);
+
+    for (unsigned i = 0; i < SEGMENT_SIZE; i++) {
+        segment[i] = (unsigned char) (i*31 + 7);
+    }
+}
+
+void DashFileWriterTest::tearDown()
+{
+    for (unsigned i = 0; i < SEGMENTS; i++) {
+        unlink(segmentPath(i).c_str());
+    }
+
+    unlink((folder + "test.mpd").c_str());
+    rmdir(folder.c_str());
+}
+
+std::string DashFileWriterTest::readFile(std::string path)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file.is_open()) {
+        return "";
+    }
+
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+std::string DashFileWriterTest::segmentPath(unsigned i)
+{
+    return folder + "test_" + std::to_string(i) + ".m4v";
+}
+
+void DashFileWriterTest::writeAndRemove()
+{
+    DashFileWriter writer;
+    std::string content;
+
+    for (unsigned i = 0; i < SEGMENTS; i++) {
+        writer.write(segmentPath(i), segment.data(), segment.size());
+    }
+
+    for (unsigned i = 0; i < SEGMENTS/2; i++) {
+        writer.remove(segmentPath(i));
+    }
+
+    writer.flush();
+
+    CPPUNIT_ASSERT(writer.getWrites() == SEGMENTS);
+    CPPUNIT_ASSERT(writer.getWrittenBytes() == SEGMENTS*SEGMENT_SIZE);
+    CPPUNIT_ASSERT(writer.getRemoves() == SEGMENTS/2);
+    CPPUNIT_ASSERT(writer.getErrors() == 0);
+    CPPUNIT_ASSERT(writer.getPendingBytes() == 0);
+    CPPUNIT_ASSERT(writer.getMaxLatency() >= writer.getAvgLatency());
+
+    for (unsigned i = 0; i < SEGMENTS; i++) {
+        CPPUNIT_ASSERT(access((segmentPath(i) + WRITER_TMP_EXT).c_str(), F_OK) != 0);
+
+        if (i < SEGMENTS/2) {
+            CPPUNIT_ASSERT(access(segmentPath(i).c_str(), F_OK) != 0);
+            continue;
+        }
+
+        content = readFile(segmentPath(i));
+        CPPUNIT_ASSERT(content.size() == SEGMENT_SIZE);
+        CPPUNIT_ASSERT(memcmp(content.data(), segment.data(), SEGMENT_SIZE) == 0);
+    }
+}
+
+void DashFileWriterTest::overwrite()
+{
+    std::string first("<MPD>first</MPD>");
+    std::string second("<MPD/>");
+
+    //NOTE: the destructor writes the queued files
+    {
+        DashFileWriter writer;
+        writer.write(folder + "test.mpd", (const unsigned char*) first.data(), first.size());
+        writer.write(folder + "test.mpd", (const unsigned char*) second.data(), second.size());
+    }
+
+    CPPUNIT_ASSERT(readFile(folder + "test.mpd") == second);
+}
+
+void DashFileWriterTest::boundedQueue()
+{
+    DashFileWriter writer(SEGMENT_SIZE);
+
+    for (unsigned i = 0; i < SEGMENTS; i++) {
+        writer.write(segmentPath(i), segment.data(), segment.size());
+        CPPUNIT_ASSERT(writer.getPendingBytes() <= SEGMENT_SIZE);
+    }
+
+    writer.flush();
+
+    CPPUNIT_ASSERT(writer.getWrites() == SEGMENTS);
+    CPPUNIT_ASSERT(writer.getErrors() == 0);
+}
+
+void DashFileWriterTest::invalidPath()
+{
+    DashFileWriter writer;
+
+    writer.write(folder + "missing/test_0.m4v", segment.data(), segment.size());
+    writer.remove(folder + "missing.m4v");
+    writer.flush();
+
+    CPPUNIT_ASSERT(writer.getWrites() == 0);
+    CPPUNIT_ASSERT(writer.getRemoves() == 0);
+    CPPUNIT_ASSERT(writer.getErrors() == 2);
+}
+
+void DashFileWriterTest::appendChunks()
+{
+    DashFileWriter writer;
+    std::string content;
+
+    //NOTE: the first chunk is written as a whole file, the next ones are appended in place
+    writer.write(segmentPath(0), segment.data(), SEGMENT_SIZE/4);
+
+    for (unsigned i = 1; i < 4; i++) {
+        writer.append(segmentPath(0), segment.data() + i*SEGMENT_SIZE/4, SEGMENT_SIZE/4);
+    }
+
+    writer.flush();
+
+    CPPUNIT_ASSERT(writer.getWrites() == 4);
+    CPPUNIT_ASSERT(writer.getWrittenBytes() == SEGMENT_SIZE);
+    CPPUNIT_ASSERT(writer.getErrors() == 0);
+    CPPUNIT_ASSERT(access((segmentPath(0) + WRITER_TMP_EXT).c_str(), F_OK) != 0);
+
+    content = readFile(segmentPath(0));
+    CPPUNIT_ASSERT(content.size() == SEGMENT_SIZE);
+    CPPUNIT_ASSERT(memcmp(content.data(), segment.data(), SEGMENT_SIZE) == 0);
+}
+
+void DashFileWriterTest::removeAndWrite()
+{
+    DashFileWriter writer;
+    std::string content;
+
+    writer.write(segmentPath(0), segment.data(), SEGMENT_SIZE/2);
+    writer.write(segmentPath(1), segment.data(), SEGMENT_SIZE/2);
+    writer.flush();
+
+    //NOTE: like ring files removed and started again with the same names
+    writer.remove(segmentPath(0));
+    writer.remove(segmentPath(1));
+    writer.write(segmentPath(0), segment.data(), SEGMENT_SIZE);
+    writer.append(segmentPath(1), segment.data(), SEGMENT_SIZE);
+    writer.flush();
+
+    CPPUNIT_ASSERT(writer.getRemoves() == 2);
+    CPPUNIT_ASSERT(writer.getErrors() == 0);
+
+    for (unsigned i = 0; i < 2; i++) {
+        content = readFile(segmentPath(i));
+        CPPUNIT_ASSERT(content.size() == SEGMENT_SIZE);
+        CPPUNIT_ASSERT(memcmp(content.data(), segment.data(), SEGMENT_SIZE) == 0);
+    }
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DashFileWriterTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("DashFileWriterTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest( CppUnit::TestFactoryRegistry::getRegistry().makeTest() );
+    runner.run( "", false );
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,579 @@
+/*
+ *  DashHttpServerTest.cpp - DashHttpServer and DashSegmentStore test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/dasher/DashSegmentStore.hh"
+#include "modules/dasher/DashHttpServer.hh"
+#include "Utils.hh"
+
+#define SEGMENT_SIZE 1000000 //bytes, bigger than the socket buffers
+#define MPD_CONTENT "<MPD></MPD>"
+#define CLIENT_TIMEOUT 2 //s
+#define CHUNK_SIZE 1000 //bytes
+#define CHUNKS 3
+#define IDLE_TIMEOUT 300 //ms
+
+class DashHttpServerTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(DashHttpServerTest);
+    CPPUNIT_TEST(store);
+    CPPUNIT_TEST(getAndHead);
+    CPPUNIT_TEST(notFound);
+    CPPUNIT_TEST(pipelining);
+    CPPUNIT_TEST(removedWhileSending);
+    CPPUNIT_TEST(appendedFile);
+    CPPUNIT_TEST(streaming);
+    CPPUNIT_TEST(byteRanges);
+    CPPUNIT_TEST(idleConnections);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void store();
+    void getAndHead();
+    void notFound();
+    void pipelining();
+    void removedWhileSending();
+    void appendedFile();
+    void streaming();
+    void byteRanges();
+    void idleConnections();
+
+    int connectClient();
+    std::string request(int fd, std::string req, size_t expected);
+    std::string readBody(int fd, std::string response, size_t expected);
+    std::string getBody(std::string response);
+    std::string decodeChunked(std::string body);
+
+    DashSegmentStore* segStore;
+    DashHttpServer* server;
+    std::vector<unsigned char> segment;
+};
+
+void DashHttpServerTest::setUp()
+{
+    std::string mpd(MPD_CONTENT);
+
+    segment.resize(SEGMENT_SIZE);
+
+    for (unsigned i = 0; i < SEGMENT_SIZE; i++) {
+        segment[i] = (unsigned char) (i*31 + 7);
+    }
+
+    segStore = new DashSegmentStore();
+    segStore->put("/test_0_1000.m4v", segment.data(), segment.size());
+    segStore->put("/test.mpd", (const unsigned char*) mpd.data(), mpd.size());
+
+    server = new DashHttpServer(segStore);
+    CPPUNIT_ASSERT(server->start(0));
+    CPPUNIT_ASSERT(server->isRunning());
+    CPPUNIT_ASSERT(server->getPort() > 0);
+}
+
+void DashHttpServerTest::tearDown()
+{
+    delete server;
+    delete segStore;
+}
+
+int DashHttpServerTest::connectClient()
+{
+    struct sockaddr_in addr;
+    struct timeval tv;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    tv.tv_sec = CLIENT_TIMEOUT;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(server->getPort());
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+//NOTE: reads until the expected length is received or the server closes the connection
+std::string DashHttpServerTest::request(int fd, std::string req, size_t expected)
+{
+    std::string response;
+    char buffer[65536];
+    ssize_t len;
+
+    if (!req.empty() && write(fd, req.data(), req.size()) != (ssize_t) req.size()) {
+        return response;
+    }
+
+    while (response.size() < expected && (len = read(fd, buffer, sizeof(buffer))) > 0) {
+        response.append(buffer, len);
+    }
+
+    return response;
+}
+
+//NOTE: reads until the body has the expected length or nothing else is received
+std::string DashHttpServerTest::readBody(int fd, std::string response, size_t expected)
+{
+    std::string data;
+
+    while (getBody(response).size() < expected) {
+        data = request(fd, "", 1);
+
+        if (data.empty()) {
+            break;
+        }
+
+        response += data;
+    }
+
+    return response;
+}
+
+std::string DashHttpServerTest::getBody(std::string response)
+{
+    size_t pos = response.find("\r\n\r\n");
+
+    return pos == std::string::npos ? "" : response.substr(pos + 4);
+}
+
+std::string DashHttpServerTest::decodeChunked(std::string body)
+{
+    std::string decoded;
+    size_t pos = 0;
+    size_t lineEnd;
+    size_t size;
+
+    while ((lineEnd = body.find("\r\n", pos)) != std::string::npos) {
+        size = std::stoul(body.substr(pos, lineEnd - pos), NULL, 16);
+
+        if (size == 0) {
+            break;
+        }
+
+        decoded += body.substr(lineEnd + 2, size);
+        pos = lineEnd + 2 + size + 2;
+    }
+
+    return decoded;
+}
+
+void DashHttpServerTest::store()
+{
+    std::string mpd(MPD_CONTENT);
+    StoredData data;
+
+    CPPUNIT_ASSERT(segStore->getFiles() == 2);
+    CPPUNIT_ASSERT(segStore->getBytes() == SEGMENT_SIZE + mpd.size());
+
+    data = segStore->get("/test_0_1000.m4v");
+    CPPUNIT_ASSERT(data && data->size() == SEGMENT_SIZE);
+    CPPUNIT_ASSERT(memcmp(data->data(), segment.data(), SEGMENT_SIZE) == 0);
+
+    segStore->put("/test.mpd", (const unsigned char*) "<MPD/>", 6);
+    CPPUNIT_ASSERT(segStore->getFiles() == 2);
+    CPPUNIT_ASSERT(segStore->getBytes() == SEGMENT_SIZE + 6);
+
+    CPPUNIT_ASSERT(segStore->remove("/test_0_1000.m4v"));
+    CPPUNIT_ASSERT(!segStore->remove("/test_0_1000.m4v"));
+    CPPUNIT_ASSERT(!segStore->get("/test_0_1000.m4v"));
+    CPPUNIT_ASSERT(segStore->getBytes() == 6);
+
+    //NOTE: removed content is kept alive by its users
+    CPPUNIT_ASSERT(data->size() == SEGMENT_SIZE);
+}
+
+void DashHttpServerTest::getAndHead()
+{
+    std::string response;
+    std::string body;
+    int fd;
+
+    fd = connectClient();
+    CPPUNIT_ASSERT(fd >= 0);
+
+    response = request(fd, "GET /test.mpd HTTP/1.1\r\nHost: localhost\r\n\r\n", 0);
+    response += request(fd, "", response.find("\r\n\r\n") + 4 + strlen(MPD_CONTENT));
+    CPPUNIT_ASSERT(response.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+    CPPUNIT_ASSERT(response.find("Content-Type: application/dash+xml") != std::string::npos);
+    CPPUNIT_ASSERT(getBody(response) == MPD_CONTENT);
+
+    //NOTE: same connection, keep-alive is the default in HTTP/1.1
+    response = request(fd, "GET /test_0_1000.m4v?t=1 HTTP/1.1\r\nHost: localhost\r\n\r\n", SEGMENT_SIZE);
+
+    while (getBody(response).size() < SEGMENT_SIZE) {
+        body = request(fd, "", SEGMENT_SIZE);
+
+        if (body.empty()) {
+            break;
+        }
+
+        response += body;
+    }
+
+    body = getBody(response);
+    CPPUNIT_ASSERT(response.find("Content-Length: " + std::to_string(SEGMENT_SIZE)) != std::string::npos);
+    CPPUNIT_ASSERT(response.find("Content-Type: video/mp4") != std::string::npos);
+    CPPUNIT_ASSERT(body.size() == SEGMENT_SIZE);
+    CPPUNIT_ASSERT(memcmp(body.data(), segment.data(), SEGMENT_SIZE) == 0);
+
+    close(fd);
+
+    fd = connectClient();
+    CPPUNIT_ASSERT(fd >= 0);
+
+    //NOTE: HEAD has no body and the connection is closed after the response
+    response = request(fd, "HEAD /test_0_1000.m4v HTTP/1.1\r\nConnection: close\r\n\r\n", SEGMENT_SIZE);
+    CPPUNIT_ASSERT(response.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+    CPPUNIT_ASSERT(response.find("Content-Length: " + std::to_string(SEGMENT_SIZE)) != std::string::npos);
+    CPPUNIT_ASSERT(getBody(response).empty());
+
+    close(fd);
+    CPPUNIT_ASSERT(server->getRequests() == 3);
+}
+
+void DashHttpServerTest::notFound()
+{
+    std::string response;
+    int fd;
+
+    fd = connectClient();
+    CPPUNIT_ASSERT(fd >= 0);
+    response = request(fd, "GET /missing.m4v HTTP/1.0\r\n\r\n", SEGMENT_SIZE);
+    CPPUNIT_ASSERT(response.compare(0, 22, "HTTP/1.1 404 Not Found") == 0);
+    CPPUNIT_ASSERT(response.find("Connection: close") != std::string::npos);
+    close(fd);
+
+    fd = connectClient();
+    CPPUNIT_ASSERT(fd >= 0);
+    response = request(fd, "POST /test.mpd HTTP/1.1\r\n\r\n", SEGMENT_SIZE);
+    CPPUNIT_ASSERT(response.compare(0, 31, "HTTP/1.1 405 Method Not Allowed") == 0);
+    close(fd);
+}
+
+void DashHttpServerTest::pipelining()
+{
+    std::string response;
+    std::string one;
+    size_t pos;
+    int fd;
+
+    fd = connectClient();
+    CPPUNIT_ASSERT(fd >= 0);
+
+    response = request(fd, "GET /test.mpd HTTP/1.1\r\n\r\nGET /test.mpd HTTP/1.1\r\nConnection: close\r\n\r\n", SEGMENT_SIZE);
+
+    pos = response.find(MPD_CONTENT);
+    CPPUNIT_ASSERT(pos != std::string::npos);
+    one = response.substr(0, pos + strlen(MPD_CONTENT));
+    CPPUNIT_ASSERT(response.size() > one.size());
+    CPPUNIT_ASSERT(response.find(MPD_CONTENT, pos + 1) != std::string::npos);
+    CPPUNIT_ASSERT(response.find("Connection: close") != std::string::npos);
+
+    close(fd);
+}
+
+void DashHttpServerTest::removedWhileSending()
+{
+    std::string response;
+    std::string body;
+    int fd;
+
+    fd = connectClient();
+    CPPUNIT_ASSERT(fd >= 0);
+
+    //NOTE: the segment does not fit in the socket buffers, so it is still being sent
+    //      when it is removed from the store
+    response = request(fd, "GET /test_0_1000.m4v HTTP/1.1\r\nConnection: close\r\n\r\n", 1);
+    CPPUNIT_ASSERT(segStore->remove("/test_0_1000.m4v"));
+    response += request(fd, "", 2*SEGMENT_SIZE);
+
+    body = getBody(response);
+    CPPUNIT_ASSERT(body.size() == SEGMENT_SIZE);
+    CPPUNIT_ASSERT(memcmp(body.data(), segment.data(), SEGMENT_SIZE) == 0);
+
+    close(fd);
+}
+
+void DashHttpServerTest::appendedFile()
+{
+    StoredFileRef file;
+    StoredData data;
+    bool complete;
+
+    segStore->append("/test_0_2000.m4v", NULL, 0, false);
+    CPPUNIT_ASSERT(segStore->getFiles() == 3);
+    CPPUNIT_ASSERT(!segStore->get("/test_0_2000.m4v"));
+
+    file = segStore->open("/test_0_2000.m4v");
+    CPPUNIT_ASSERT(file);
+    CPPUNIT_ASSERT(!segStore->readPart(file, 0, data, complete) && !complete);
+
+    for (unsigned i = 0; i < CHUNKS; i++) {
+        segStore->append("/test_0_2000.m4v", segment.data() + i*CHUNK_SIZE, CHUNK_SIZE, i == CHUNKS - 1);
+        CPPUNIT_ASSERT(segStore->readPart(file, i, data, complete));
+        CPPUNIT_ASSERT(data->size() == CHUNK_SIZE && complete == (i == CHUNKS - 1));
+    }
+
+    CPPUNIT_ASSERT(segStore->getLength(file, complete) == CHUNKS*CHUNK_SIZE && complete);
+
+    data = segStore->get("/test_0_2000.m4v");
+    CPPUNIT_ASSERT(data && data->size() == CHUNKS*CHUNK_SIZE);
+    CPPUNIT_ASSERT(memcmp(data->data(), segment.data(), CHUNKS*CHUNK_SIZE) == 0);
+
+    //NOTE: an incomplete file is completed when it is removed
+    segStore->append("/test_0_4000.m4v", segment.data(), CHUNK_SIZE, false);
+    file = segStore->open("/test_0_4000.m4v");
+    CPPUNIT_ASSERT(segStore->remove("/test_0_4000.m4v"));
+    CPPUNIT_ASSERT(segStore->readPart(file, 0, data, complete) && complete);
+    CPPUNIT_ASSERT(!segStore->readPart(file, 1, data, complete));
+}
+
+void DashHttpServerTest::streaming()
+{
+    std::string response;
+    std::string body;
+    size_t chunkLength = std::string("3e8\r\n").size() + CHUNK_SIZE + 2;
+    int fd;
+
+    segStore->append("/test_0_2000.m4v", segment.data(), CHUNK_SIZE, false);
+
+    fd = connectClient();
+    CPPUNIT_ASSERT(fd >= 0);
+
+    //NOTE: each chunk is received as soon as it is appended
+    response = request(fd, "GET /test_0_2000.m4v HTTP/1.1\r\nHost: localhost\r\n\r\n", 1);
+    response = readBody(fd, response, chunkLength);
+    CPPUNIT_ASSERT(response.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+    CPPUNIT_ASSERT(response.find("Transfer-Encoding: chunked") != std::string::npos);
+    CPPUNIT_ASSERT(response.find("Content-Length") == std::string::npos);
+    CPPUNIT_ASSERT(getBody(response).size() == chunkLength);
+
+    for (unsigned i = 1; i < CHUNKS; i++) {
+        segStore->append("/test_0_2000.m4v", segment.data() + i*CHUNK_SIZE, CHUNK_SIZE, i == CHUNKS - 1);
+        response = readBody(fd, response, (i + 1)*chunkLength);
+        CPPUNIT_ASSERT(getBody(response).size() >= (i + 1)*chunkLength);
+    }
+
+    response = readBody(fd, response, CHUNKS*chunkLength + 5);
+    body = getBody(response);
+    CPPUNIT_ASSERT(body.size() == CHUNKS*chunkLength + 5);
+    CPPUNIT_ASSERT(body.compare(body.size() - 5, 5, "0\r\n\r\n") == 0);
+    body = decodeChunked(body);
+    CPPUNIT_ASSERT(body.size() == CHUNKS*CHUNK_SIZE);
+    CPPUNIT_ASSERT(memcmp(body.data(), segment.data(), CHUNKS*CHUNK_SIZE) == 0);
+
+    //NOTE: the connection is still usable and the complete file has a known length
+    response = request(fd, "GET /test_0_2000.m4v HTTP/1.1\r\nHost: localhost\r\n\r\n", 1);
+    response = readBody(fd, response, CHUNKS*CHUNK_SIZE);
+    CPPUNIT_ASSERT(response.find("Content-Length: " + std::to_string(CHUNKS*CHUNK_SIZE)) != std::string::npos);
+    body = getBody(response);
+    CPPUNIT_ASSERT(body.size() == CHUNKS*CHUNK_SIZE);
+    CPPUNIT_ASSERT(memcmp(body.data(), segment.data(), CHUNKS*CHUNK_SIZE) == 0);
+
+    close(fd);
+
+    //NOTE: HTTP/1.0 clients get the growing file until the connection is closed
+    segStore->append("/test_0_4000.m4v", segment.data(), CHUNK_SIZE, false);
+
+    fd = connectClient();
+    CPPUNIT_ASSERT(fd >= 0);
+
+    response = request(fd, "GET /test_0_4000.m4v HTTP/1.0\r\n\r\n", 1);
+    response = readBody(fd, response, CHUNK_SIZE);
+    segStore->append("/test_0_4000.m4v", segment.data() + CHUNK_SIZE, CHUNK_SIZE, true);
+    response += request(fd, "", SEGMENT_SIZE);
+
+    CPPUNIT_ASSERT(response.find("Connection: close") != std::string::npos);
+    body = getBody(response);
+    CPPUNIT_ASSERT(body.size() == 2*CHUNK_SIZE);
+    CPPUNIT_ASSERT(memcmp(body.data(), segment.data(), 2*CHUNK_SIZE) == 0);
+
+    close(fd);
+}
+
+void DashHttpServerTest::byteRanges()
+{
+    std::string response;
+    std::string body;
+    StoredFileRef file;
+    StoredData data;
+    int fd;
+
+    //NOTE: ring files of the byte-range mode are never completed
+    for (unsigned i = 0; i < CHUNKS; i++) {
+        segStore->append("/test_0_r0.m4v", segment.data() + i*CHUNK_SIZE, CHUNK_SIZE, false);
+    }
+
+    file = segStore->open("/test_0_r0.m4v");
+    CPPUNIT_ASSERT(file);
+
+    data = segStore->readRange(file, CHUNK_SIZE/2, CHUNK_SIZE*2);
+    CPPUNIT_ASSERT(data && data->size() == CHUNK_SIZE*2);
+    CPPUNIT_ASSERT(memcmp(data->data(), segment.data() + CHUNK_SIZE/2, CHUNK_SIZE*2) == 0);
+    CPPUNIT_ASSERT(!segStore->readRange(file, CHUNK_SIZE, CHUNKS*CHUNK_SIZE));
+
+    fd = connectClient();
+    CPPUNIT_ASSERT(fd >= 0);
+
+    response = request(fd, "GET /test_0_r0.m4v HTTP/1.1\r\nRange: bytes=" + std::to_string(CHUNK_SIZE/2) + "-" + 
+                       std::to_string(CHUNK_SIZE*5/2 - 1) + "\r\n\r\n", 1);
+    response = readBody(fd, response, CHUNK_SIZE*2);
+    body = getBody(response);
+    CPPUNIT_ASSERT(response.compare(0, 28, "HTTP/1.1 206 Partial Content") == 0);
+    CPPUNIT_ASSERT(response.find("Content-Range: bytes " + std::to_string(CHUNK_SIZE/2) + "-" + 
+                                 std::to_string(CHUNK_SIZE*5/2 - 1) + "/*") != std::string::npos);
+    CPPUNIT_ASSERT(body.size() == CHUNK_SIZE*2);
+    CPPUNIT_ASSERT(memcmp(body.data(), segment.data() + CHUNK_SIZE/2, CHUNK_SIZE*2) == 0);
+
+    //NOTE: same connection, an open range ends at the current file length
+    response = request(fd, "GET /test_0_1000.m4v HTTP/1.1\r\nRange: bytes=" + std::to_string(SEGMENT_SIZE - 10) + "-\r\n\r\n", 1);
+    response = readBody(fd, response, 10);
+    body = getBody(response);
+    CPPUNIT_ASSERT(response.find("Content-Range: bytes " + std::to_string(SEGMENT_SIZE - 10) + "-" + 
+                                 std::to_string(SEGMENT_SIZE - 1) + "/" + std::to_string(SEGMENT_SIZE)) != std::string::npos);
+    CPPUNIT_ASSERT(body.size() == 10);
+    CPPUNIT_ASSERT(memcmp(body.data(), segment.data() + SEGMENT_SIZE - 10, 10) == 0);
+
+    response = request(fd, "GET /test_0_r0.m4v HTTP/1.1\r\nRange: bytes=" + std::to_string(CHUNKS*CHUNK_SIZE) + "-\r\n\r\n", 1);
+    CPPUNIT_ASSERT(response.compare(0, 34, "HTTP/1.1 416 Range Not Satisfiable") == 0);
+    CPPUNIT_ASSERT(response.find("Content-Range: bytes */" + std::to_string(CHUNKS*CHUNK_SIZE)) != std::string::npos);
+
+    //NOTE: suffix ranges are the last bytes of the current file length
+    response = request(fd, "GET /test_0_1000.m4v HTTP/1.1\r\nRange: bytes=-10\r\n\r\n", 1);
+    response = readBody(fd, response, 10);
+    body = getBody(response);
+    CPPUNIT_ASSERT(response.compare(0, 28, "HTTP/1.1 206 Partial Content") == 0);
+    CPPUNIT_ASSERT(response.find("Content-Range: bytes " + std::to_string(SEGMENT_SIZE - 10) + "-" + 
+                                 std::to_string(SEGMENT_SIZE - 1) + "/" + std::to_string(SEGMENT_SIZE)) != std::string::npos);
+    CPPUNIT_ASSERT(body.size() == 10);
+    CPPUNIT_ASSERT(memcmp(body.data(), segment.data() + SEGMENT_SIZE - 10, 10) == 0);
+
+    response = request(fd, "GET /test_0_r0.m4v HTTP/1.1\r\nRange: bytes=-" + std::to_string(CHUNK_SIZE) + "\r\n\r\n", 1);
+    response = readBody(fd, response, CHUNK_SIZE);
+    body = getBody(response);
+    CPPUNIT_ASSERT(response.find("Content-Range: bytes " + std::to_string((CHUNKS - 1)*CHUNK_SIZE) + "-" + 
+                                 std::to_string(CHUNKS*CHUNK_SIZE - 1) + "/*") != std::string::npos);
+    CPPUNIT_ASSERT(body.size() == CHUNK_SIZE);
+    CPPUNIT_ASSERT(memcmp(body.data(), segment.data() + (CHUNKS - 1)*CHUNK_SIZE, CHUNK_SIZE) == 0);
+
+    response = request(fd, "GET /test_0_1000.m4v HTTP/1.1\r\nRange: bytes=-" + std::to_string(SEGMENT_SIZE*2) + "\r\n\r\n", 1);
+    response = readBody(fd, response, SEGMENT_SIZE);
+    CPPUNIT_ASSERT(response.find("Content-Range: bytes 0-" + std::to_string(SEGMENT_SIZE - 1) + "/" + 
+                                 std::to_string(SEGMENT_SIZE)) != std::string::npos);
+    CPPUNIT_ASSERT(getBody(response).size() == SEGMENT_SIZE);
+
+    response = request(fd, "GET /test_0_1000.m4v HTTP/1.1\r\nRange: bytes=-0\r\n\r\n", 1);
+    CPPUNIT_ASSERT(response.compare(0, 34, "HTTP/1.1 416 Range Not Satisfiable") == 0);
+
+    //NOTE: malformed ranges are ignored, the whole file is sent
+    for (std::string range : {"bytes=a-b", "bytes=20-10", "bytes=-", "items=0-10", "bytes=0-1,4-5"}) {
+        response = request(fd, "GET /test_0_1000.m4v HTTP/1.1\r\nRange: " + range + "\r\n\r\n", 1);
+        response = readBody(fd, response, SEGMENT_SIZE);
+        body = getBody(response);
+        CPPUNIT_ASSERT(response.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+        CPPUNIT_ASSERT(body.size() == SEGMENT_SIZE);
+        CPPUNIT_ASSERT(memcmp(body.data(), segment.data(), SEGMENT_SIZE) == 0);
+    }
+
+    close(fd);
+}
+
+void DashHttpServerTest::idleConnections()
+{
+    std::string response;
+    int active;
+    int idle;
+
+    delete server;
+    server = new DashHttpServer(segStore, IDLE_TIMEOUT);
+    CPPUNIT_ASSERT(server->start(0));
+
+    active = connectClient();
+    idle = connectClient();
+    CPPUNIT_ASSERT(active >= 0 && idle >= 0);
+
+    //NOTE: requests keep the connection alive for longer than the timeout
+    for (int i = 0; i < 6; i++) {
+        response = request(active, "GET /test.mpd HTTP/1.1\r\n\r\n", 1);
+        response = readBody(active, response, strlen(MPD_CONTENT));
+        CPPUNIT_ASSERT(response.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+        CPPUNIT_ASSERT(getBody(response) == MPD_CONTENT);
+        std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_TIMEOUT/3));
+    }
+
+    //NOTE: the peer gets the end of the stream, not a client timeout
+    CPPUNIT_ASSERT(request(idle, "", 1).empty());
+    CPPUNIT_ASSERT(server->getConnections() == 1);
+
+    CPPUNIT_ASSERT(request(active, "", 1).empty());
+    CPPUNIT_ASSERT(server->getConnections() == 0);
+
+    close(active);
+    close(idle);
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DashHttpServerTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("DashHttpServerTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest( CppUnit::TestFactoryRegistry::getRegistry().makeTest() );
+    runner.run( "", false );
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -23,6 +23,7 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 #include <cppunit/extensions/TestFactoryRegistry.h>
 #include <cppunit/extensions/HelperMacros.h>
@@ -41,6 +42,7 @@
 #define WIDTH 1280
 #define HEIGHT 534
 #define FRAMERATE 25
+#define BITRATE 1000000 //bps
 
 size_t readFile(char const* fileName, char* dstBuffer)
 {
@@ -72,6 +74,8 @@ class DashVideoSegmenterAVCTest : public CppUnit::TestFixture
     CPPUNIT_TEST(generateInitSegment);
     CPPUNIT_TEST(appendFrameToDashSegment);
     CPPUNIT_TEST(generateSegment);
+    CPPUNIT_TEST(contextMemory);
+    CPPUNIT_TEST(pendingNals);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -86,6 +90,8 @@ protected:
     void generateInitSegment();
     void appendFrameToDashSegment();
     void generateSegment();
+    void contextMemory();
+    void pendingNals();
 
     DashVideoSegmenterAVC* segmenter;
     AudioFrame* aFrame;
@@ -107,6 +113,7 @@ void DashVideoSegmenterAVCTest::setUp()
     frameTime = std::chrono::microseconds(40000);
 
     segmenter = new DashVideoSegmenterAVC(std::chrono::seconds(SEG_DURATION), timestamp);
+    aFrame = InterleavedAudioFrame::createNew(2, 48000, AudioFrame::getMaxSamples(48000), AAC, S16);
     dummyNal = InterleavedVideoFrame::createNew(H264, MAX_H264_OR_5_NAL_SIZE);
 
     spsNal = InterleavedVideoFrame::createNew(H264, MAX_H264_OR_5_NAL_SIZE);
@@ -133,6 +140,7 @@ void DashVideoSegmenterAVCTest::setUp()
 void DashVideoSegmenterAVCTest::tearDown()
 {
     delete segmenter;
+    delete aFrame;
     delete spsNal;
     delete ppsNal;
     delete seiNal;
@@ -358,6 +366,98 @@ void DashVideoSegmenterAVCTest::generateSegment()
     CPPUNIT_ASSERT(segmentModelLength == segment->getDataLength());
 }
 
+void DashVideoSegmenterAVCTest::contextMemory()
+{
+    i2ctx* context = NULL;
+    DashSegment* segment = new DashSegment();
+    unsigned frameBytes = BITRATE/BYTE_TO_BIT/FRAMERATE;
+    unsigned frameDuration = DASH_VIDEO_TIME_BASE/FRAMERATE;
+    std::vector<unsigned char> frame(frameBytes, 0x5A);
+    uint64_t segTimestamp;
+    uint32_t segDuration;
+    uint32_t segLength;
+    size_t fixedMemory;
+    size_t usedMemory;
+
+    //NOTE: what the fixed size segment data, sample table and DashSegment buffer used to cost
+    fixedMemory = MAX_DAT + MAX_MDAT_SAMPLE*sizeof(mdat_sample) + MAX_DAT;
+
+    CPPUNIT_ASSERT(generate_context(&context, VIDEO_TYPE_AVC) == I2OK);
+    CPPUNIT_ASSERT(fill_video_context(&context, WIDTH, HEIGHT, DASH_VIDEO_TIME_BASE) == I2OK);
+    set_segment_duration(SEG_DURATION*DASH_VIDEO_TIME_BASE, &context);
+
+    for (unsigned i = 0; i < SEG_DURATION*FRAMERATE; i++) {
+        CPPUNIT_ASSERT(add_video_sample(frame.data(), frameBytes, i*frameDuration, i*frameDuration, 
+                                        0, i == 0, &context) == I2OK);
+    }
+
+    CPPUNIT_ASSERT(segment->reserve(get_segment_max_size(context)));
+    segLength = generate_video_segment(TRUE, SEG_DURATION*FRAMERATE*frameDuration, segment->getDataBuffer(), 
+                                       &context, &segTimestamp, &segDuration);
+
+    CPPUNIT_ASSERT(segLength > SEG_DURATION*FRAMERATE*frameBytes);
+    CPPUNIT_ASSERT(segLength <= segment->getCapacity());
+    CPPUNIT_ASSERT(segDuration == SEG_DURATION*DASH_VIDEO_TIME_BASE);
+
+    usedMemory = get_context_memory(context) + segment->getCapacity();
+    utils::infoMsg("Segmenter memory at 1 Mbps: " + std::to_string(usedMemory) + 
+                   " bytes, with fixed buffers: " + std::to_string(fixedMemory) + " bytes");
+
+    CPPUNIT_ASSERT(usedMemory*10 < fixedMemory);
+
+    free_context(&context);
+    CPPUNIT_ASSERT(!context);
+    delete segment;
+}
+
+void DashVideoSegmenterAVCTest::pendingNals()
+{
+    i2ctx* context = NULL;
+    DashSegment* segment = new DashSegment();
+    unsigned char nal[] = {0x65, 0x88, 0x84, 0x00};
+    unsigned char avcc[] = {0x00, 0x00, 0x00, 0x04, 0x65, 0x88, 0x84, 0x00};
+    unsigned frameDuration = DASH_VIDEO_TIME_BASE/FRAMERATE;
+    unsigned sampleLength = 2*sizeof(avcc);
+    uint64_t segTimestamp;
+    uint32_t segDuration;
+
+    CPPUNIT_ASSERT(generate_context(&context, VIDEO_TYPE_AVC) == I2OK);
+    CPPUNIT_ASSERT(fill_video_context(&context, WIDTH, HEIGHT, DASH_VIDEO_TIME_BASE) == I2OK);
+    set_segment_duration(frameDuration, &context);
+
+    CPPUNIT_ASSERT(add_pending_video_sample(sampleLength, 0, 0, 0, TRUE, &context) == I2ERROR_SIZE_ZERO);
+
+    //NOTE: a two NAL intra frame, with a NAL of the next one already pending
+    for (unsigned i = 0; i < 3; i++) {
+        CPPUNIT_ASSERT(append_video_nal(nal, sizeof(nal), &context) == I2OK);
+    }
+
+    CPPUNIT_ASSERT(context->ctxvideo->pending_data_size == 3*sizeof(avcc));
+    CPPUNIT_ASSERT(memcmp(context->ctxvideo->segment_data, avcc, sizeof(avcc)) == 0);
+    CPPUNIT_ASSERT(memcmp(context->ctxvideo->segment_data + sizeof(avcc), avcc, sizeof(avcc)) == 0);
+
+    CPPUNIT_ASSERT(add_pending_video_sample(sampleLength, 0, 0, 0, TRUE, &context) == I2OK);
+    CPPUNIT_ASSERT(context->ctxvideo->segment_data_size == sampleLength);
+    CPPUNIT_ASSERT(context->ctxvideo->pending_data_size == sizeof(avcc));
+
+    CPPUNIT_ASSERT(segment->reserve(get_segment_max_size(context)));
+    CPPUNIT_ASSERT(generate_video_segment(TRUE, frameDuration, segment->getDataBuffer(), 
+                                          &context, &segTimestamp, &segDuration) > I2ERROR_MAX);
+
+    //NOTE: the pending NAL is kept for the next segment
+    CPPUNIT_ASSERT(context->ctxvideo->segment_data_size == 0);
+    CPPUNIT_ASSERT(context->ctxvideo->pending_data_size == sizeof(avcc));
+    CPPUNIT_ASSERT(memcmp(context->ctxvideo->segment_data, avcc, sizeof(avcc)) == 0);
+
+    //NOTE: the first sample of a segment must be intra, otherwise it is discarded
+    CPPUNIT_ASSERT(add_pending_video_sample(sizeof(avcc), frameDuration, frameDuration, 1, FALSE, &context) == I2ERROR_IS_INTRA);
+    CPPUNIT_ASSERT(context->ctxvideo->pending_data_size == 0);
+    CPPUNIT_ASSERT(context->ctxvideo->ctxsample->mdat_sample_length == 0);
+
+    free_context(&context);
+    delete segment;
+}
+
 /*
 *   HEVC Test
 */
@@ -411,6 +511,7 @@ void DashVideoSegmenterHEVCTest::setUp()
     frameTime = std::chrono::microseconds(40000);
 
     segmenter = new DashVideoSegmenterHEVC(std::chrono::seconds(SEG_DURATION), timestamp);
+    aFrame = InterleavedAudioFrame::createNew(2, 48000, AudioFrame::getMaxSamples(48000), AAC, S16);
     dummyNal = InterleavedVideoFrame::createNew(H265, MAX_H264_OR_5_NAL_SIZE);
 
     vpsNal = InterleavedVideoFrame::createNew(H265, MAX_H264_OR_5_NAL_SIZE);
@@ -453,6 +554,7 @@ void DashVideoSegmenterHEVCTest::setUp()
 void DashVideoSegmenterHEVCTest::tearDown()
 {
     delete segmenter;
+    delete aFrame;
     delete vpsNal;
     delete spsNal;
     delete ppsNal;
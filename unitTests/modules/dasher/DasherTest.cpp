@@ -109,6 +109,16 @@ void DasherTest::configure()
     tmpDasher = new Dasher();
     CPPUNIT_ASSERT(!tmpDasher->configure(dashFolder, baseName, 0, 0, 0));
     
+    tmpDasher = new Dasher();
+    CPPUNIT_ASSERT(!tmpDasher->configure(dashFolder, baseName, SEG_DURATION, SEG_NUMBER, MIN_BUFFER, 0, 5, false, true));
+
+    tmpDasher = new Dasher();
+    CPPUNIT_ASSERT(!tmpDasher->configure(dashFolder, baseName, SEG_DURATION, SEG_NUMBER, MIN_BUFFER, 0, 0, true, true));
+
+    tmpDasher = new Dasher();
+    CPPUNIT_ASSERT(tmpDasher->configure(dashFolder, baseName, SEG_DURATION, SEG_NUMBER, MIN_BUFFER, 0, 0, false, true));
+    delete tmpDasher;
+    
     tmpDasher = new Dasher();
     CPPUNIT_ASSERT(tmpDasher->configure(dashFolder, baseName, SEG_DURATION, SEG_NUMBER, MIN_BUFFER));
     
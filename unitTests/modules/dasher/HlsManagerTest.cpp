@@ -0,0 +1,189 @@
+/*
+ *  HlsManagerTest.cpp - HlsManager test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <fstream>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/dasher/HlsManager.hh"
+#include "Utils.hh"
+
+#define BASE_NAME "test"
+#define MAX_SEGMENTS 3
+#define SEG_DURATION 2 //seconds
+#define V_TIMESCALE 12800
+#define A_TIMESCALE 48000
+
+class HlsManagerTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(HlsManagerTest);
+    CPPUNIT_TEST(masterPlaylist);
+    CPPUNIT_TEST(audioOnlyMasterPlaylist);
+    CPPUNIT_TEST(mediaPlaylist);
+    CPPUNIT_TEST(removeRepresentation);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void masterPlaylist();
+    void audioOnlyMasterPlaylist();
+    void mediaPlaylist();
+    void removeRepresentation();
+
+    bool contains(std::string playlist, std::string line);
+
+    HlsManager* manager;
+};
+
+void HlsManagerTest::setUp()
+{
+    manager = new HlsManager();
+    manager->configure(BASE_NAME, MAX_SEGMENTS, SEG_DURATION);
+    manager->updateGroup("0", true, V_TIMESCALE, "test_$RepresentationID$_$Time$.m4v", "test_$RepresentationID$_init.m4v");
+    manager->updateGroup("1", false, A_TIMESCALE, "test_$RepresentationID$_$Time$.m4a", "test_$RepresentationID$_init.m4a");
+}
+
+void HlsManagerTest::tearDown()
+{
+    delete manager;
+}
+
+bool HlsManagerTest::contains(std::string playlist, std::string line)
+{
+    return playlist.find("\n" + line + "\n") != std::string::npos;
+}
+
+void HlsManagerTest::masterPlaylist()
+{
+    std::string playlist;
+
+    CPPUNIT_ASSERT(manager->updateRepresentation("0", "1", "avc1.42c01e", 1280, 720, 2000000));
+    CPPUNIT_ASSERT(manager->updateRepresentation("0", "2", "avc1.42c01e", 640, 360, 500000));
+    CPPUNIT_ASSERT(manager->updateRepresentation("1", "3", "mp4a.40.2", 0, 0, 128000));
+    CPPUNIT_ASSERT(!manager->updateRepresentation("2", "4", "mp4a.40.2", 0, 0, 128000));
+
+    playlist = manager->getMasterPlaylist();
+
+    CPPUNIT_ASSERT(playlist.compare(0, 8, "#EXTM3U\n") == 0);
+    CPPUNIT_ASSERT(contains(playlist, "#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID=\"audio\",NAME=\"3\",LANGUAGE=\"eng\","
+                                      "AUTOSELECT=YES,DEFAULT=YES,URI=\"test_3.m3u8\""));
+    CPPUNIT_ASSERT(contains(playlist, "#EXT-X-STREAM-INF:BANDWIDTH=2128000,CODECS=\"avc1.42c01e,mp4a.40.2\","
+                                      "RESOLUTION=1280x720,AUDIO=\"audio\""));
+    CPPUNIT_ASSERT(contains(playlist, "#EXT-X-STREAM-INF:BANDWIDTH=628000,CODECS=\"avc1.42c01e,mp4a.40.2\","
+                                      "RESOLUTION=640x360,AUDIO=\"audio\""));
+    CPPUNIT_ASSERT(contains(playlist, "test_1.m3u8"));
+    CPPUNIT_ASSERT(contains(playlist, "test_2.m3u8"));
+    CPPUNIT_ASSERT(manager->getMasterPlaylistName() == "test.m3u8");
+    CPPUNIT_ASSERT(manager->getRepresentations().size() == 3);
+}
+
+void HlsManagerTest::audioOnlyMasterPlaylist()
+{
+    std::string playlist;
+
+    CPPUNIT_ASSERT(manager->updateRepresentation("1", "3", "mp4a.40.2", 0, 0, 128000));
+
+    playlist = manager->getMasterPlaylist();
+
+    CPPUNIT_ASSERT(playlist.find("#EXT-X-MEDIA") == std::string::npos);
+    CPPUNIT_ASSERT(contains(playlist, "#EXT-X-STREAM-INF:BANDWIDTH=128000,CODECS=\"mp4a.40.2\""));
+    CPPUNIT_ASSERT(contains(playlist, "test_3.m3u8"));
+}
+
+void HlsManagerTest::mediaPlaylist()
+{
+    std::string playlist;
+    const unsigned segments = MAX_SEGMENTS + 2;
+
+    CPPUNIT_ASSERT(manager->updateRepresentation("0", "1", "avc1.42c01e", 1280, 720, 2000000));
+    CPPUNIT_ASSERT(manager->getMediaPlaylist("5").empty());
+
+    for (unsigned i = 0; i < segments; i++) {
+        CPPUNIT_ASSERT(manager->updateGroupTimestamp("0", i*SEG_DURATION*V_TIMESCALE, SEG_DURATION*V_TIMESCALE));
+    }
+
+    //NOTE: a longer last segment raises the target duration
+    CPPUNIT_ASSERT(manager->updateGroupTimestamp("0", (segments - 1)*SEG_DURATION*V_TIMESCALE, 3*V_TIMESCALE));
+    CPPUNIT_ASSERT(!manager->updateGroupTimestamp("2", 0, SEG_DURATION*V_TIMESCALE));
+
+    playlist = manager->getMediaPlaylist("1");
+
+    CPPUNIT_ASSERT(contains(playlist, "#EXT-X-TARGETDURATION:3"));
+    CPPUNIT_ASSERT(contains(playlist, "#EXT-X-MEDIA-SEQUENCE:" + std::to_string(segments - MAX_SEGMENTS)));
+    CPPUNIT_ASSERT(contains(playlist, "#EXT-X-MAP:URI=\"test_1_init.m4v\""));
+    CPPUNIT_ASSERT(!contains(playlist, "test_1_" + std::to_string((segments - MAX_SEGMENTS - 1)*SEG_DURATION*V_TIMESCALE) + ".m4v"));
+
+    for (unsigned i = segments - MAX_SEGMENTS; i < segments - 1; i++) {
+        CPPUNIT_ASSERT(contains(playlist, "#EXTINF:2.000,\ntest_1_" + std::to_string(i*SEG_DURATION*V_TIMESCALE) + ".m4v"));
+    }
+
+    CPPUNIT_ASSERT(contains(playlist, "#EXTINF:3.000,\ntest_1_" + std::to_string((segments - 1)*SEG_DURATION*V_TIMESCALE) + ".m4v"));
+    CPPUNIT_ASSERT(manager->getMediaPlaylistName("1") == "test_1.m3u8");
+
+    //NOTE: the target duration does not decrease when the long segment leaves the window
+    for (unsigned i = segments; i < segments + MAX_SEGMENTS; i++) {
+        CPPUNIT_ASSERT(manager->updateGroupTimestamp("0", i*SEG_DURATION*V_TIMESCALE, SEG_DURATION*V_TIMESCALE));
+    }
+
+    playlist = manager->getMediaPlaylist("1");
+
+    CPPUNIT_ASSERT(!contains(playlist, "#EXTINF:3.000,\ntest_1_" + std::to_string((segments - 1)*SEG_DURATION*V_TIMESCALE) + ".m4v"));
+    CPPUNIT_ASSERT(contains(playlist, "#EXT-X-TARGETDURATION:3"));
+}
+
+void HlsManagerTest::removeRepresentation()
+{
+    CPPUNIT_ASSERT(manager->updateRepresentation("0", "1", "avc1.42c01e", 1280, 720, 2000000));
+    CPPUNIT_ASSERT(!manager->removeRepresentation("1", "1"));
+    CPPUNIT_ASSERT(manager->removeRepresentation("0", "1"));
+    CPPUNIT_ASSERT(!manager->removeRepresentation("0", "1"));
+    CPPUNIT_ASSERT(manager->getRepresentations().empty());
+    CPPUNIT_ASSERT(manager->getMediaPlaylist("1").empty());
+    CPPUNIT_ASSERT(manager->getMasterPlaylist().find("#EXT-X-STREAM-INF") == std::string::npos);
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(HlsManagerTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("HlsManagerTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest( CppUnit::TestFactoryRegistry::getRegistry().makeTest() );
+    runner.run( "", false );
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
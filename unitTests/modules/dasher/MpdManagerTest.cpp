@@ -44,6 +44,8 @@ class MpdManagerTest : public CppUnit::TestFixture
     CPPUNIT_TEST(updateVideoRepresentation);
     CPPUNIT_TEST(updateAudioRepresentation);
     CPPUNIT_TEST(removeRepresentation);
+    CPPUNIT_TEST(incrementalUpdate);
+    CPPUNIT_TEST(byteRange);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -59,6 +61,8 @@ protected:
     void updateVideoRepresentation();
     void updateAudioRepresentation();
     void removeRepresentation();
+    void incrementalUpdate();
+    void byteRange();
 
 protected:
     MpdManager* manager = NULL;
@@ -480,6 +484,118 @@ void MpdManagerTest::removeRepresentation()
     CPPUNIT_ASSERT(!manager->removeRepresentation(aAdSetId, audioReprId));
 }
 
+void MpdManagerTest::incrementalUpdate()
+{
+    tinyxml2::XMLDocument doc;
+    const tinyxml2::XMLElement *xmlElement;
+    const tinyxml2::XMLElement *xmlSegment;
+    const std::string id = "one-id";
+    const std::string reprId = "repr-id";
+    const int timescale = 1000;
+    const int duration = 2000;
+    std::string mpd;
+    int segments;
+
+    manager->configure(0, MAX_SEGMENTS, duration/timescale);
+    manager->updateVideoAdaptationSet(id, timescale, "a-segment", "the-init");
+    manager->updateVideoRepresentation(id, reprId, "my-codec", 1, 2, 3, 4);
+
+    for (int i = 0; i < 2*MAX_SEGMENTS; i++) {
+        manager->updateAdaptationSetTimestamp(id, i*duration, duration);
+        manager->updateVideoRepresentation(id, reprId, "my-codec", 1, 2, 3, 4);
+        mpd = manager->toString();
+
+        //NOTE: renders without changes are identical, publishTime included
+        CPPUNIT_ASSERT(manager->toString() == mpd);
+        CPPUNIT_ASSERT(mpd.find("t=\"" + std::to_string(i*duration) + "\"") != std::string::npos);
+    }
+
+    CPPUNIT_ASSERT(manager->writeToDisk(FILE_NAME));
+    CPPUNIT_ASSERT(manager->writeToDisk(FILE_NAME));
+    CPPUNIT_ASSERT(access((std::string(FILE_NAME) + ".tmp").c_str(), F_OK) != 0);
+    CPPUNIT_ASSERT(doc.LoadFile(FILE_NAME) == tinyxml2::XML_SUCCESS);
+
+    CPPUNIT_ASSERT((xmlElement = doc.FirstChildElement("MPD")) != NULL);
+    CPPUNIT_ASSERT(xmlElement->FindAttribute("publishTime") != NULL);
+    CPPUNIT_ASSERT((xmlElement = xmlElement->FirstChildElement("Period")) != NULL);
+    CPPUNIT_ASSERT((xmlElement = xmlElement->FirstChildElement("AdaptationSet")) != NULL);
+    CPPUNIT_ASSERT(xmlElement->FirstChildElement("Representation") != NULL);
+    CPPUNIT_ASSERT((xmlElement = xmlElement->FirstChildElement("SegmentTemplate")) != NULL);
+    CPPUNIT_ASSERT((xmlElement = xmlElement->FirstChildElement("SegmentTimeline")) != NULL);
+
+    segments = 0;
+
+    for (xmlSegment = xmlElement->FirstChildElement("S"); xmlSegment; xmlSegment = xmlSegment->NextSiblingElement("S")) {
+        CPPUNIT_ASSERT(xmlSegment->IntAttribute("t") == (MAX_SEGMENTS + segments)*duration);
+        segments++;
+    }
+
+    CPPUNIT_ASSERT(segments == MAX_SEGMENTS);
+
+    //NOTE: static content changes are rendered too
+    CPPUNIT_ASSERT(manager->removeRepresentation(id, reprId));
+    CPPUNIT_ASSERT(manager->toString().find(reprId) == std::string::npos);
+}
+
+void MpdManagerTest::byteRange()
+{
+    tinyxml2::XMLDocument doc;
+    const tinyxml2::XMLElement *xmlElement;
+    const tinyxml2::XMLElement *xmlSegment;
+    const std::string id = "one-id";
+    const std::string reprId = "repr-id";
+    const int timescale = 1000;
+    const int duration = 2000;
+    const size_t length = 5000;
+    const size_t indexLength = 44;
+    std::string mpd;
+    int segments;
+
+    manager->configure(0, MAX_SEGMENTS, duration/timescale);
+    manager->updateVideoAdaptationSet(id, timescale, "", "the-init-$RepresentationID$");
+    manager->updateVideoRepresentation(id, reprId, "my-codec", 1, 2, 3, 4);
+
+    CPPUNIT_ASSERT(!manager->updateRepresentationSegment("other-id", reprId, ByteRangeSegment{0, duration, "ring", 0, length, 20, indexLength}));
+
+    for (int i = 0; i < 2*MAX_SEGMENTS; i++) {
+        CPPUNIT_ASSERT(manager->updateRepresentationSegment(id, reprId, 
+            ByteRangeSegment{(uint64_t) i*duration, duration, "ring", i*length, length, i*length + 20, indexLength}));
+        mpd = manager->toString();
+
+        CPPUNIT_ASSERT(manager->toString() == mpd);
+        CPPUNIT_ASSERT(mpd.find("mediaRange=\"" + std::to_string(i*length) + "-" + std::to_string((i + 1)*length - 1) + "\"") != std::string::npos);
+    }
+
+    CPPUNIT_ASSERT(manager->writeToDisk(FILE_NAME));
+    CPPUNIT_ASSERT(doc.LoadFile(FILE_NAME) == tinyxml2::XML_SUCCESS);
+
+    CPPUNIT_ASSERT((xmlElement = doc.FirstChildElement("MPD")) != NULL);
+    CPPUNIT_ASSERT(std::string(xmlElement->Attribute("profiles")) == BYTE_RANGE_PROFILES);
+    CPPUNIT_ASSERT((xmlElement = xmlElement->FirstChildElement("Period")) != NULL);
+    CPPUNIT_ASSERT((xmlElement = xmlElement->FirstChildElement("AdaptationSet")) != NULL);
+    CPPUNIT_ASSERT(xmlElement->FirstChildElement("SegmentTemplate") == NULL);
+    CPPUNIT_ASSERT((xmlElement = xmlElement->FirstChildElement("Representation")) != NULL);
+    CPPUNIT_ASSERT((xmlElement = xmlElement->FirstChildElement("SegmentList")) != NULL);
+    CPPUNIT_ASSERT(xmlElement->IntAttribute("timescale") == timescale);
+    CPPUNIT_ASSERT(xmlElement->FirstChildElement("Initialization") != NULL);
+    CPPUNIT_ASSERT(std::string(xmlElement->FirstChildElement("Initialization")->Attribute("sourceURL")) == "the-init-" + reprId);
+    CPPUNIT_ASSERT(xmlElement->FirstChildElement("SegmentTimeline") != NULL);
+
+    segments = 0;
+
+    for (xmlSegment = xmlElement->FirstChildElement("SegmentURL"); xmlSegment; xmlSegment = xmlSegment->NextSiblingElement("SegmentURL")) {
+        CPPUNIT_ASSERT(std::string(xmlSegment->Attribute("media")) == "ring");
+        CPPUNIT_ASSERT(std::string(xmlSegment->Attribute("indexRange")) == std::to_string((MAX_SEGMENTS + segments)*length + 20) + 
+                                                                            "-" + std::to_string((MAX_SEGMENTS + segments)*length + 20 + indexLength - 1));
+        segments++;
+    }
+
+    CPPUNIT_ASSERT(segments == MAX_SEGMENTS);
+
+    CPPUNIT_ASSERT(manager->removeRepresentation(id, reprId));
+    CPPUNIT_ASSERT(manager->toString().find("SegmentURL") == std::string::npos);
+}
+
 class AdaptationSetTest : public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE(AdaptationSetTest);
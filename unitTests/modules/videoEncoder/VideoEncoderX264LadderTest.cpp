@@ -0,0 +1,338 @@
+/*
+ *  VideoEncoderX264LadderTest.cpp - VideoEncoderX264Ladder class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <set>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/videoEncoder/VideoEncoderX264Ladder.hh"
+
+#define IN_WIDTH 1280
+#define IN_HEIGHT 720
+#define LADDER_GOP 10
+#define LADDER_GOPS 3
+#define FRAME_DURATION 40000 //us
+#define H264_NAL_SLICE_IDR 5
+
+class VideoEncoderX264LadderMock : public VideoEncoderX264Ladder {
+public:
+    VideoEncoderX264LadderMock() : VideoEncoderX264Ladder() {};
+    using VideoEncoderX264Ladder::configure0;
+    using VideoEncoderX264Ladder::configRendition0;
+    using VideoEncoderX264Ladder::specificWriterConfig;
+    using VideoEncoderX264Ladder::specificWriterDelete;
+    using VideoEncoderX264Ladder::doProcessFrame;
+};
+
+class VideoEncoderX264LadderTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(VideoEncoderX264LadderTest);
+    CPPUNIT_TEST(configureTest);
+    CPPUNIT_TEST(renditionConfigTest);
+    CPPUNIT_TEST(alignedIdrTest);
+    CPPUNIT_TEST(sceneCutTest);
+    CPPUNIT_TEST(renditionReopenTest);
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    void configureTest();
+    void renditionConfigTest();
+    void alignedIdrTest();
+    void sceneCutTest();
+    void renditionReopenTest();
+
+    bool hasIdr(SlicedVideoFrame* frame);
+    std::map<int, std::set<int64_t>> encodeScenes(unsigned sceneCut, int cutFrame, int frames);
+    std::map<int, int> renditionOpens(VideoEncoderX264LadderMock* ladder);
+};
+
+void VideoEncoderX264LadderTest::configureTest()
+{
+    VideoEncoderX264LadderMock ladder;
+
+    CPPUNIT_ASSERT(ladder.configure0(25, 50, 0, 0, 2, true, "superfast"));
+    CPPUNIT_ASSERT(!ladder.configure0(25, 0, 0, 0, 2, true, "superfast"));
+    CPPUNIT_ASSERT(!ladder.configure0(25, 50, 0, 0, 0, true, "superfast"));
+    CPPUNIT_ASSERT(!ladder.configure0(25, 50, 0, 0, 2, true, ""));
+    CPPUNIT_ASSERT(ladder.configure0(25, 50, 0, 0, 2, true, "superfast", 0));
+}
+
+void VideoEncoderX264LadderTest::renditionConfigTest()
+{
+    VideoEncoderX264LadderMock ladder;
+    int id = 100;
+
+    CPPUNIT_ASSERT(!ladder.configRendition0(id, 1280, 720, 3000));
+
+    CPPUNIT_ASSERT(ladder.specificWriterConfig(id));
+    CPPUNIT_ASSERT(!ladder.specificWriterConfig(id));
+
+    CPPUNIT_ASSERT(ladder.configRendition0(id, 1280, 720, 3000));
+    CPPUNIT_ASSERT(ladder.configRendition0(id, 640, 0, 800));
+    CPPUNIT_ASSERT(ladder.configRendition0(id, 0, 0, 800));
+    CPPUNIT_ASSERT(!ladder.configRendition0(id, -1, 360, 800));
+    CPPUNIT_ASSERT(!ladder.configRendition0(id, 640, -1, 800));
+    CPPUNIT_ASSERT(!ladder.configRendition0(id, 640, 360, 0));
+
+    CPPUNIT_ASSERT(ladder.specificWriterDelete(id));
+    CPPUNIT_ASSERT(!ladder.specificWriterDelete(id));
+}
+
+bool VideoEncoderX264LadderTest::hasIdr(SlicedVideoFrame* frame)
+{
+    unsigned char* data;
+    unsigned i;
+
+    for (int n = 0; n < frame->getSliceNum(); n++) {
+        data = frame->getSlices()[n].getData();
+
+        //NOTE: Annex B output, NAL header follows the 3 or 4 bytes startcode
+        for (i = 0; i + 1 < frame->getSlices()[n].getDataSize() && data[i] == 0; i++) {}
+
+        if (data[i] == 1 && (data[i + 1] & 0x1F) == H264_NAL_SLICE_IDR) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void VideoEncoderX264LadderTest::alignedIdrTest()
+{
+    VideoEncoderX264LadderMock ladder;
+    InterleavedVideoFrame* rawFrame = InterleavedVideoFrame::createNew(RAW, IN_WIDTH, IN_HEIGHT, YUV420P);
+    std::map<int, Frame*> dstFrames;
+    std::map<int, std::set<int64_t>> idrs;
+    std::set<int64_t> expectedIdrs;
+    //NOTE: the upscaled rendition is the first of the cascade and the input sized one follows it
+    std::map<int, std::pair<int, int>> sizes = {{1, {1920, 1080}}, {2, {IN_WIDTH, IN_HEIGHT}},
+                                                {3, {640, 360}}, {4, {320, 180}}};
+
+    rawFrame->setLength(IN_WIDTH*IN_HEIGHT*3/2);
+
+    CPPUNIT_ASSERT(ladder.configure0(25, LADDER_GOP, 0, 0, 1, true, "ultrafast"));
+
+    for (auto s : sizes) {
+        CPPUNIT_ASSERT(ladder.specificWriterConfig(s.first));
+        CPPUNIT_ASSERT(ladder.configRendition0(s.first, s.first == 2 ? 0 : s.second.first, 0, 500));
+        dstFrames[s.first] = SlicedVideoFrame::createNew(H264);
+    }
+
+    for (int i = 0; i < LADDER_GOP*LADDER_GOPS; i++) {
+        //NOTE: changing content, so that x264 does not output empty frames
+        memset(rawFrame->getDataBuf(), (i*7) % 256, rawFrame->getLength());
+        rawFrame->setPresentationTime(std::chrono::microseconds(i*FRAME_DURATION));
+        rawFrame->setSequenceNumber(i);
+        rawFrame->setOriginTime(std::chrono::system_clock::time_point(std::chrono::microseconds(i)));
+
+        if (i % LADDER_GOP == 0) {
+            expectedIdrs.insert(i*FRAME_DURATION);
+        }
+
+        for (auto d : dstFrames) {
+            dynamic_cast<SlicedVideoFrame*>(d.second)->clear();
+            d.second->setConsumed(false);
+        }
+
+        //NOTE: no lookahead, B-frames nor frame threads, every frame is output in the same call
+        CPPUNIT_ASSERT(ladder.doProcessFrame(rawFrame, dstFrames));
+
+        for (auto d : dstFrames) {
+            SlicedVideoFrame* frame = dynamic_cast<SlicedVideoFrame*>(d.second);
+
+            CPPUNIT_ASSERT(frame->getConsumed());
+            CPPUNIT_ASSERT(frame->getWidth() == sizes[d.first].first);
+            CPPUNIT_ASSERT(frame->getHeight() == sizes[d.first].second);
+            CPPUNIT_ASSERT(frame->getSequenceNumber() == (size_t) i);
+            CPPUNIT_ASSERT(frame->getOriginTime() == rawFrame->getOriginTime());
+
+            if (hasIdr(frame)) {
+                idrs[d.first].insert(frame->getPresentationTime().count());
+            }
+        }
+    }
+
+    for (auto s : sizes) {
+        CPPUNIT_ASSERT(idrs[s.first] == expectedIdrs);
+    }
+
+    for (auto d : dstFrames) {
+        delete d.second;
+    }
+
+    delete rawFrame;
+}
+
+std::map<int, std::set<int64_t>> VideoEncoderX264LadderTest::encodeScenes(unsigned sceneCut, int cutFrame, int frames)
+{
+    VideoEncoderX264LadderMock ladder;
+    InterleavedVideoFrame* rawFrame = InterleavedVideoFrame::createNew(RAW, IN_WIDTH, IN_HEIGHT, YUV420P);
+    std::map<int, Frame*> dstFrames;
+    std::map<int, std::set<int64_t>> idrs;
+    std::map<int, int> widths = {{1, IN_WIDTH}, {2, 640}, {3, 320}};
+
+    rawFrame->setLength(IN_WIDTH*IN_HEIGHT*3/2);
+
+    CPPUNIT_ASSERT(ladder.configure0(25, LADDER_GOP*LADDER_GOPS, 0, 0, 1, true, "ultrafast", sceneCut));
+
+    for (auto w : widths) {
+        CPPUNIT_ASSERT(ladder.specificWriterConfig(w.first));
+        CPPUNIT_ASSERT(ladder.configRendition0(w.first, w.second, 0, 500));
+        dstFrames[w.first] = SlicedVideoFrame::createNew(H264);
+    }
+
+    for (int i = 0; i < frames; i++) {
+        //NOTE: slowly changing dark pictures, then a bright scene starting at cutFrame
+        memset(rawFrame->getDataBuf(), i < cutFrame ? 16 + i : 200 + i - cutFrame, rawFrame->getLength());
+        rawFrame->setPresentationTime(std::chrono::microseconds(i*FRAME_DURATION));
+
+        for (auto d : dstFrames) {
+            dynamic_cast<SlicedVideoFrame*>(d.second)->clear();
+            d.second->setConsumed(false);
+        }
+
+        CPPUNIT_ASSERT(ladder.doProcessFrame(rawFrame, dstFrames));
+
+        for (auto d : dstFrames) {
+            if (hasIdr(dynamic_cast<SlicedVideoFrame*>(d.second))) {
+                idrs[d.first].insert(i);
+            }
+        }
+    }
+
+    for (auto d : dstFrames) {
+        delete d.second;
+    }
+
+    delete rawFrame;
+    return idrs;
+}
+
+void VideoEncoderX264LadderTest::sceneCutTest()
+{
+    int cutFrame = LADDER_GOP + LADDER_GOP/2;
+    std::set<int64_t> sceneIdrs = {0, cutFrame};
+    std::set<int64_t> gopIdrs = {0};
+    std::map<int, std::set<int64_t>> idrs;
+
+    //NOTE: the GOP is longer than the test, so the only IDRs are the first frame and the scene cut
+    idrs = encodeScenes(DEFAULT_LADDER_SCENECUT, cutFrame, LADDER_GOP*2);
+    CPPUNIT_ASSERT(idrs.size() == 3);
+    for (auto r : idrs) {
+        CPPUNIT_ASSERT(r.second == sceneIdrs);
+    }
+
+    idrs = encodeScenes(0, cutFrame, LADDER_GOP*2);
+    CPPUNIT_ASSERT(idrs.size() == 3);
+    for (auto r : idrs) {
+        CPPUNIT_ASSERT(r.second == gopIdrs);
+    }
+}
+
+std::map<int, int> VideoEncoderX264LadderTest::renditionOpens(VideoEncoderX264LadderMock* ladder)
+{
+    Jzon::Object state;
+    std::map<int, int> opens;
+
+    ladder->getState(state);
+    Jzon::Array &array = state.Get("renditions").AsArray();
+
+    for (int i = 0; i < array.GetCount(); i++) {
+        opens[array.Get(i).Get("id").ToInt()] = array.Get(i).Get("opens").ToInt();
+    }
+
+    return opens;
+}
+
+void VideoEncoderX264LadderTest::renditionReopenTest()
+{
+    VideoEncoderX264LadderMock ladder;
+    InterleavedVideoFrame* rawFrame = InterleavedVideoFrame::createNew(RAW, IN_WIDTH, IN_HEIGHT, YUV420P);
+    std::map<int, Frame*> dstFrames;
+    std::map<int, int> expected = {{1, 1}, {2, 1}, {3, 1}};
+
+    rawFrame->setLength(IN_WIDTH*IN_HEIGHT*3/2);
+    memset(rawFrame->getDataBuf(), 128, rawFrame->getLength());
+
+    CPPUNIT_ASSERT(ladder.configure0(25, LADDER_GOP, 0, 0, 1, true, "ultrafast"));
+
+    for (auto e : expected) {
+        CPPUNIT_ASSERT(ladder.specificWriterConfig(e.first));
+        CPPUNIT_ASSERT(ladder.configRendition0(e.first, 0, 0, 500));
+        dstFrames[e.first] = SlicedVideoFrame::createNew(H264);
+    }
+
+    CPPUNIT_ASSERT(ladder.doProcessFrame(rawFrame, dstFrames));
+    CPPUNIT_ASSERT(renditionOpens(&ladder) == expected);
+
+    //NOTE: only the reconfigured rendition reopens its encoder
+    CPPUNIT_ASSERT(ladder.configRendition0(2, 640, 0, 800));
+    CPPUNIT_ASSERT(ladder.doProcessFrame(rawFrame, dstFrames));
+    expected[2]++;
+    CPPUNIT_ASSERT(renditionOpens(&ladder) == expected);
+
+    //NOTE: a new rendition does not reopen the existing ones
+    CPPUNIT_ASSERT(ladder.specificWriterConfig(4));
+    CPPUNIT_ASSERT(ladder.configRendition0(4, 320, 0, 300));
+    dstFrames[4] = SlicedVideoFrame::createNew(H264);
+    CPPUNIT_ASSERT(ladder.doProcessFrame(rawFrame, dstFrames));
+    expected[4] = 1;
+    CPPUNIT_ASSERT(renditionOpens(&ladder) == expected);
+
+    //NOTE: common configuration changes reopen all of them
+    CPPUNIT_ASSERT(ladder.configure0(25, LADDER_GOP*2, 0, 0, 1, true, "ultrafast"));
+    CPPUNIT_ASSERT(ladder.doProcessFrame(rawFrame, dstFrames));
+    for (auto& e : expected) {
+        e.second++;
+    }
+    CPPUNIT_ASSERT(renditionOpens(&ladder) == expected);
+
+    for (auto d : dstFrames) {
+        delete d.second;
+    }
+
+    delete rawFrame;
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(VideoEncoderX264LadderTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("VideoEncoderX264LadderTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("",false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,491 @@
+/*
+ *  VideoEncoderX264Test.cpp - VideoEncoderX264 class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/videoEncoder/VideoEncoderX264.hh"
+#include "modules/videoEncoder/X264EncoderPool.hh"
+#include "SlicedVideoFrameQueue.hh"
+
+#define TEST_WIDTH 1280
+#define TEST_HEIGHT 720
+#define MAX_TEST_FRAMES 50
+#define LOW_LATENCY_FRAMES 10
+#define LOW_LATENCY_THREADS 4
+#define LOW_LATENCY_MANY_THREADS 40 //more slices than LOW_LATENCY_NAL_BUFFERS
+#define NAL_SLICE 1
+#define NAL_SLICE_IDR 5
+#define SPEED_TEST_FPS 25
+#define SPEED_TEST_BUDGET 40000 //usec, frame time at SPEED_TEST_FPS
+
+class VideoEncoderX264Mock : public VideoEncoderX264 {
+public:
+    VideoEncoderX264Mock() : VideoEncoderX264() {};
+    using VideoEncoderX264::doProcessFrame;
+    using VideoEncoderX264::configure0;
+    using VideoEncoderX264::prepare0;
+    using VideoEncoderX264::allocQueue;
+    using VideoEncoderX264::lowLatencyEvent;
+
+    StreamInfo* getStreamInfo() {return outputStreamInfo;};
+
+    std::vector<x264_nal_t> pushedNals;
+
+protected:
+    //NOTE: called with the NAL mutex locked, right before the NAL is copied to the queue
+    void pushNal(x264_nal_t *nal) {
+        pushedNals.push_back(*nal);
+        VideoEncoderX264::pushNal(nal);
+    };
+};
+
+//NOTE: speed levels are recorded instead of applied, so the controller can be fed with fake encoding times
+
+class SpeedControlMock : public VideoEncoderX264Mock {
+public:
+    using VideoEncoderX264Mock::speedControlEvent;
+    using VideoEncoderX264Mock::updateSpeedControl;
+
+    std::vector<int> appliedLevels;
+
+private:
+    bool applySpeedLevel(int level) {
+        appliedLevels.push_back(level);
+        return true;
+    };
+};
+
+class VideoEncoderX264Test : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(VideoEncoderX264Test);
+    CPPUNIT_TEST(prepareTest);
+    CPPUNIT_TEST(concurrentPrepareTest);
+    CPPUNIT_TEST(firstFrameLatencyTest);
+    CPPUNIT_TEST(lowLatencySlicesTest);
+    CPPUNIT_TEST(lowLatencyManySlicesTest);
+    CPPUNIT_TEST(lowLatencyHeadersTest);
+    CPPUNIT_TEST(reconfigureTest);
+    CPPUNIT_TEST(speedStartLevelTest);
+    CPPUNIT_TEST(speedControlTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void prepareTest();
+    void concurrentPrepareTest();
+    void firstFrameLatencyTest();
+    void lowLatencySlicesTest();
+    void lowLatencyManySlicesTest();
+    void lowLatencyHeadersTest();
+    void reconfigureTest();
+    void speedStartLevelTest();
+    void speedControlTest();
+
+    std::chrono::microseconds firstFrameLatency(VideoEncoderX264Mock* encoder);
+    int coldOpens(VideoEncoderX264Mock* encoder);
+    int stateCounter(VideoEncoderX264Mock* encoder, std::string name);
+    void lowLatencySlices(unsigned threads);
+    VideoEncoderX264Mock* lowLatencyEncoder(unsigned bitrate, unsigned fps);
+    bool enableSpeedControl(SpeedControlMock* encoder, bool enable, int maxLevel);
+    void feedSpeedControl(SpeedControlMock* encoder, std::vector<int> encodeTimes);
+
+    InterleavedVideoFrame* rawFrame;
+    SlicedVideoFrame* codedFrame;
+};
+
+void VideoEncoderX264Test::setUp()
+{
+    X264EncoderPool::getInstance()->clear();
+
+    rawFrame = InterleavedVideoFrame::createNew(RAW, TEST_WIDTH, TEST_HEIGHT, YUV420P);
+    rawFrame->setLength(TEST_WIDTH*TEST_HEIGHT*3/2);
+    memset(rawFrame->getDataBuf(), 128, rawFrame->getLength());
+
+    codedFrame = SlicedVideoFrame::createNew(H264);
+}
+
+void VideoEncoderX264Test::tearDown()
+{
+    X264EncoderPool::getInstance()->clear();
+    delete rawFrame;
+    delete codedFrame;
+}
+
+std::chrono::microseconds VideoEncoderX264Test::firstFrameLatency(VideoEncoderX264Mock* encoder)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < MAX_TEST_FRAMES; i++) {
+        rawFrame->setPresentationTime(std::chrono::microseconds(i*40000));
+        rawFrame->setSequenceNumber(i);
+        codedFrame->clear();
+
+        if (encoder->doProcessFrame(rawFrame, codedFrame)) {
+            return std::chrono::duration_cast<std::chrono::microseconds>
+                (std::chrono::steady_clock::now() - start);
+        }
+    }
+
+    CPPUNIT_FAIL("Encoder did not output any frame");
+    return std::chrono::microseconds(0);
+}
+
+int VideoEncoderX264Test::coldOpens(VideoEncoderX264Mock* encoder)
+{
+    firstFrameLatency(encoder);
+    return stateCounter(encoder, "coldOpens");
+}
+
+int VideoEncoderX264Test::stateCounter(VideoEncoderX264Mock* encoder, std::string name)
+{
+    Jzon::Object state;
+
+    encoder->getState(state);
+    return state.Get(name).ToInt();
+}
+
+void VideoEncoderX264Test::prepareTest()
+{
+    VideoEncoderX264Mock encoder;
+
+    CPPUNIT_ASSERT(encoder.configure0(2000, 25, 25, 0, 0, 2, true, "ultrafast", 0));
+
+    CPPUNIT_ASSERT(!encoder.prepare0(0, TEST_HEIGHT, YUV420P, 1));
+    CPPUNIT_ASSERT(!encoder.prepare0(TEST_WIDTH, 0, YUV420P, 1));
+    CPPUNIT_ASSERT(!encoder.prepare0(TEST_WIDTH, TEST_HEIGHT, RGB24, 1));
+    CPPUNIT_ASSERT(!encoder.prepare0(TEST_WIDTH, TEST_HEIGHT, YUV420P, MAX_POOLED_ENCODERS + 1));
+    CPPUNIT_ASSERT(X264EncoderPool::getInstance()->size() == 0);
+
+    CPPUNIT_ASSERT(encoder.prepare0(TEST_WIDTH, TEST_HEIGHT, YUV420P, 2));
+    CPPUNIT_ASSERT(X264EncoderPool::getInstance()->size() == 2);
+
+    //NOTE: encoders already available for the same configuration are not opened again
+    CPPUNIT_ASSERT(encoder.prepare0(TEST_WIDTH, TEST_HEIGHT, YUV420P, 1));
+    CPPUNIT_ASSERT(X264EncoderPool::getInstance()->size() == 2);
+
+    CPPUNIT_ASSERT(encoder.prepare0(640, 360, YUV420P, 1));
+    CPPUNIT_ASSERT(X264EncoderPool::getInstance()->size() == 3);
+}
+
+void VideoEncoderX264Test::concurrentPrepareTest()
+{
+    VideoEncoderX264Mock encoders[4];
+    std::vector<std::thread> threads;
+
+    for (auto& encoder : encoders) {
+        CPPUNIT_ASSERT(encoder.configure0(2000, 25, 25, 0, 0, 2, true, "ultrafast", 0));
+    }
+
+    //NOTE: concurrent requests for the same configuration never exceed the requested count
+    for (auto& encoder : encoders) {
+        threads.push_back(std::thread([&encoder]{encoder.prepare0(TEST_WIDTH, TEST_HEIGHT, YUV420P, 2);}));
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    CPPUNIT_ASSERT(X264EncoderPool::getInstance()->size() == 2);
+}
+
+void VideoEncoderX264Test::firstFrameLatencyTest()
+{
+    VideoEncoderX264Mock coldEncoder;
+    VideoEncoderX264Mock warmEncoder;
+    VideoEncoderX264Mock otherEncoder;
+    std::chrono::microseconds coldLatency;
+    std::chrono::microseconds warmLatency;
+
+    CPPUNIT_ASSERT(coldEncoder.configure0(2000, 25, 25, 0, 0, 2, true, "ultrafast", 0));
+    CPPUNIT_ASSERT(warmEncoder.configure0(2000, 25, 25, 0, 0, 2, true, "ultrafast", 0));
+    CPPUNIT_ASSERT(otherEncoder.configure0(1000, 25, 25, 0, 0, 2, true, "ultrafast", 0));
+
+    coldLatency = firstFrameLatency(&coldEncoder);
+    CPPUNIT_ASSERT(X264EncoderPool::getInstance()->size() == 0);
+
+    CPPUNIT_ASSERT(warmEncoder.prepare0(TEST_WIDTH, TEST_HEIGHT, YUV420P, 1));
+    CPPUNIT_ASSERT(X264EncoderPool::getInstance()->size() == 1);
+
+    //NOTE: a different configuration must not take the prepared encoder
+    firstFrameLatency(&otherEncoder);
+    CPPUNIT_ASSERT(X264EncoderPool::getInstance()->size() == 1);
+
+    warmLatency = firstFrameLatency(&warmEncoder);
+    CPPUNIT_ASSERT(X264EncoderPool::getInstance()->size() == 0);
+
+    std::cout << std::endl << "First frame latency (" << TEST_WIDTH << "x" << TEST_HEIGHT << "): cold "
+        << coldLatency.count() << " us, prepared " << warmLatency.count() << " us" << std::endl;
+}
+
+void VideoEncoderX264Test::lowLatencySlicesTest()
+{
+    lowLatencySlices(LOW_LATENCY_THREADS);
+}
+
+void VideoEncoderX264Test::lowLatencyManySlicesTest()
+{
+    //NOTE: NAL buffers are added on demand, no slice can be dropped
+    lowLatencySlices(LOW_LATENCY_MANY_THREADS);
+}
+
+void VideoEncoderX264Test::lowLatencySlices(unsigned threads)
+{
+    VideoEncoderX264Mock encoder;
+    struct ConnectionData cData;
+    FrameQueue* queue;
+    Jzon::Object params;
+    Jzon::Object state;
+    unsigned slices = 0;
+    unsigned frameSlices;
+    int nextFirstMb;
+    int mbs = ((TEST_WIDTH + 15)/16)*((TEST_HEIGHT + 15)/16);
+
+    CPPUNIT_ASSERT(encoder.configure0(2000, 25, 25, 0, 0, threads, true, "ultrafast", 0));
+    params.Add("enable", true);
+    CPPUNIT_ASSERT(encoder.lowLatencyEvent(&params));
+
+    queue = encoder.allocQueue(cData);
+    CPPUNIT_ASSERT(queue);
+
+    for (int i = 0; i < LOW_LATENCY_FRAMES; i++) {
+        rawFrame->setPresentationTime(std::chrono::microseconds(i*40000));
+        rawFrame->setSequenceNumber(i);
+        codedFrame->clear();
+        encoder.pushedNals.clear();
+
+        //NOTE: no lookahead nor B-frames, every input frame is output in the same call
+        CPPUNIT_ASSERT(encoder.doProcessFrame(rawFrame, codedFrame));
+        CPPUNIT_ASSERT(queue->getElements() == encoder.pushedNals.size());
+
+        nextFirstMb = 0;
+        frameSlices = 0;
+
+        for (auto nal : encoder.pushedNals) {
+            if (nal.i_type != NAL_SLICE && nal.i_type != NAL_SLICE_IDR) {
+                continue;
+            }
+
+            CPPUNIT_ASSERT(nal.i_first_mb == nextFirstMb);
+            nextFirstMb = nal.i_last_mb + 1;
+            frameSlices++;
+        }
+
+        CPPUNIT_ASSERT(nextFirstMb == mbs);
+        CPPUNIT_ASSERT(frameSlices == threads);
+        slices += frameSlices;
+
+        while (queue->getElements() > 0) {
+            queue->removeFrame();
+        }
+    }
+
+    //NOTE: slices left for the flush after x264_encoder_encode returns are not counted as early
+    encoder.getState(state);
+    CPPUNIT_ASSERT(state.Get("earlySlices").ToInt() == (int) slices);
+
+    delete queue;
+}
+
+VideoEncoderX264Mock* VideoEncoderX264Test::lowLatencyEncoder(unsigned bitrate, unsigned fps)
+{
+    VideoEncoderX264Mock* encoder = new VideoEncoderX264Mock();
+    Jzon::Object params;
+
+    params.Add("enable", true);
+    CPPUNIT_ASSERT(encoder->configure0(bitrate, fps, 25, 0, 0, LOW_LATENCY_THREADS, true, "ultrafast", 0));
+    CPPUNIT_ASSERT(encoder->lowLatencyEvent(&params));
+
+    return encoder;
+}
+
+void VideoEncoderX264Test::lowLatencyHeadersTest()
+{
+    VideoEncoderX264Mock* encoder = lowLatencyEncoder(2000, 25);
+    VideoEncoderX264Mock* other;
+    std::vector<unsigned char> headers;
+    StreamInfo* si = encoder->getStreamInfo();
+
+    CPPUNIT_ASSERT(coldOpens(encoder) == 1);
+    CPPUNIT_ASSERT(stateCounter(encoder, "headerOpens") == 1);
+    CPPUNIT_ASSERT(si->extradata_size > 0);
+    headers.assign(si->extradata, si->extradata + si->extradata_size);
+
+    //NOTE: bitrate changes keep the encoder and its headers, no encoder is opened
+    CPPUNIT_ASSERT(encoder->configure0(1000, 25, 25, 0, 0, LOW_LATENCY_THREADS, true, "ultrafast", 0));
+    CPPUNIT_ASSERT(coldOpens(encoder) == 1);
+    CPPUNIT_ASSERT(stateCounter(encoder, "headerOpens") == 1);
+    CPPUNIT_ASSERT(std::vector<unsigned char>(si->extradata, si->extradata + si->extradata_size) == headers);
+
+    CPPUNIT_ASSERT(encoder->configure0(1000, 30, 25, 0, 0, LOW_LATENCY_THREADS, true, "ultrafast", 0));
+    CPPUNIT_ASSERT(coldOpens(encoder) == 2);
+    CPPUNIT_ASSERT(stateCounter(encoder, "headerOpens") == 2);
+    delete encoder;
+
+    //NOTE: headers are shared by the encoders with the same configuration
+    other = lowLatencyEncoder(2000, 30);
+    CPPUNIT_ASSERT(coldOpens(other) == 1);
+    CPPUNIT_ASSERT(stateCounter(other, "headerOpens") == 0);
+    delete other;
+
+    //NOTE: prepare gets the headers too, so the first frame does not wait for any open
+    other = lowLatencyEncoder(2000, 50);
+    CPPUNIT_ASSERT(other->prepare0(TEST_WIDTH, TEST_HEIGHT, YUV420P, 1));
+    CPPUNIT_ASSERT(stateCounter(other, "headerOpens") == 1);
+    CPPUNIT_ASSERT(coldOpens(other) == 0);
+    CPPUNIT_ASSERT(stateCounter(other, "pooledOpens") == 1);
+    CPPUNIT_ASSERT(stateCounter(other, "headerOpens") == 1);
+    delete other;
+}
+
+void VideoEncoderX264Test::reconfigureTest()
+{
+    VideoEncoderX264Mock encoder;
+
+    CPPUNIT_ASSERT(encoder.configure0(2000, 25, 25, 0, 0, 2, true, "ultrafast", 0));
+    CPPUNIT_ASSERT(coldOpens(&encoder) == 1);
+
+    //NOTE: bitrate changes are applied to the running encoder
+    CPPUNIT_ASSERT(encoder.configure0(1000, 25, 25, 0, 0, 2, true, "ultrafast", 0));
+    CPPUNIT_ASSERT(coldOpens(&encoder) == 1);
+
+    //NOTE: x264_encoder_reconfig ignores the rest of settings, the encoder is opened again
+    CPPUNIT_ASSERT(encoder.configure0(1000, 30, 25, 0, 0, 2, true, "ultrafast", 0));
+    CPPUNIT_ASSERT(coldOpens(&encoder) == 2);
+
+    CPPUNIT_ASSERT(encoder.configure0(1000, 30, 50, 0, 0, 2, true, "ultrafast", 0));
+    CPPUNIT_ASSERT(coldOpens(&encoder) == 3);
+
+    CPPUNIT_ASSERT(encoder.configure0(1000, 30, 50, 0, 0, 2, false, "ultrafast", 0));
+    CPPUNIT_ASSERT(coldOpens(&encoder) == 4);
+
+    CPPUNIT_ASSERT(encoder.configure0(1000, 30, 50, 0, 0, 2, false, "superfast", 0));
+    CPPUNIT_ASSERT(coldOpens(&encoder) == 5);
+}
+
+bool VideoEncoderX264Test::enableSpeedControl(SpeedControlMock* encoder, bool enable, int maxLevel)
+{
+    Jzon::Object params;
+
+    params.Add("enable", enable);
+    params.Add("maxLevel", maxLevel);
+    return encoder->speedControlEvent(&params);
+}
+
+//NOTE: encoding times are repeated until SPEED_CONTROL_HOLD_FRAMES frames are fed
+void VideoEncoderX264Test::feedSpeedControl(SpeedControlMock* encoder, std::vector<int> encodeTimes)
+{
+    for (int i = 0; i < SPEED_CONTROL_HOLD_FRAMES; i++) {
+        encoder->updateSpeedControl(std::chrono::microseconds(encodeTimes[i % encodeTimes.size()]));
+    }
+}
+
+void VideoEncoderX264Test::speedStartLevelTest()
+{
+    SpeedControlMock encoder;
+
+    CPPUNIT_ASSERT(encoder.configure0(2000, SPEED_TEST_FPS, 25, 0, 0, 2, true, "veryfast", 0));
+    CPPUNIT_ASSERT(enableSpeedControl(&encoder, true, SPEED_LEVELS - 1));
+    CPPUNIT_ASSERT(stateCounter(&encoder, "speedLevel") == 2);
+
+    CPPUNIT_ASSERT(encoder.configure0(2000, SPEED_TEST_FPS, 25, 0, 0, 2, true, "ultrafast", 0));
+    CPPUNIT_ASSERT(stateCounter(&encoder, "speedLevel") == 0);
+
+    CPPUNIT_ASSERT(encoder.configure0(2000, SPEED_TEST_FPS, 25, 0, 0, 2, true, "medium", 0));
+    CPPUNIT_ASSERT(stateCounter(&encoder, "speedLevel") == SPEED_LEVELS - 1);
+
+    //NOTE: the configured preset is capped by the maximum level
+    CPPUNIT_ASSERT(enableSpeedControl(&encoder, false, SPEED_LEVELS - 1));
+    CPPUNIT_ASSERT(enableSpeedControl(&encoder, true, 3));
+    CPPUNIT_ASSERT(stateCounter(&encoder, "speedLevel") == 3);
+
+    CPPUNIT_ASSERT(!enableSpeedControl(&encoder, true, SPEED_LEVELS));
+    CPPUNIT_ASSERT(encoder.appliedLevels.empty());
+}
+
+void VideoEncoderX264Test::speedControlTest()
+{
+    SpeedControlMock encoder;
+    int high = SPEED_TEST_BUDGET * (SPEED_CONTROL_HIGH_LOAD + 1) / 2;
+    int low = SPEED_TEST_BUDGET * SPEED_CONTROL_LOW_LOAD / 2;
+    int band = SPEED_TEST_BUDGET * (SPEED_CONTROL_HIGH_LOAD + SPEED_CONTROL_LOW_LOAD) / 2;
+
+    CPPUNIT_ASSERT(encoder.configure0(2000, SPEED_TEST_FPS, 25, 0, 0, 2, true, "fast", 0));
+    CPPUNIT_ASSERT(enableSpeedControl(&encoder, true, SPEED_LEVELS - 1));
+    CPPUNIT_ASSERT(stateCounter(&encoder, "speedLevel") == 4);
+
+    //NOTE: dead band, load between the low and high thresholds keeps the level
+    feedSpeedControl(&encoder, {band});
+    CPPUNIT_ASSERT(stateCounter(&encoder, "speedLevel") == 4);
+
+    //NOTE: frame threads make single calls return at once or block, only the window average counts
+    feedSpeedControl(&encoder, {0, 2*band});
+    CPPUNIT_ASSERT(stateCounter(&encoder, "speedLevel") == 4);
+    CPPUNIT_ASSERT(stateCounter(&encoder, "speedChanges") == 0);
+
+    //NOTE: step down, one level per hold period
+    feedSpeedControl(&encoder, {high});
+    CPPUNIT_ASSERT(stateCounter(&encoder, "speedLevel") == 3);
+    feedSpeedControl(&encoder, {high});
+    CPPUNIT_ASSERT(stateCounter(&encoder, "speedLevel") == 2);
+
+    //NOTE: step up, never beyond the maximum level
+    feedSpeedControl(&encoder, {low});
+    CPPUNIT_ASSERT(stateCounter(&encoder, "speedLevel") == 3);
+    for (int i = 0; i < SPEED_LEVELS; i++) {
+        feedSpeedControl(&encoder, {low});
+    }
+    CPPUNIT_ASSERT(stateCounter(&encoder, "speedLevel") == SPEED_LEVELS - 1);
+
+    CPPUNIT_ASSERT(stateCounter(&encoder, "speedChanges") == 5);
+    CPPUNIT_ASSERT((encoder.appliedLevels == std::vector<int>{3, 2, 3, 4, 5}));
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(VideoEncoderX264Test);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("VideoEncoderX264Test.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("",false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+/*
+ *  VideoThumbnailerTest.cpp - VideoThumbnailer class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/videoThumbnailer/VideoThumbnailer.hh"
+
+class VideoThumbnailerMock : public VideoThumbnailer {
+public:
+    VideoThumbnailerMock() : VideoThumbnailer() {};
+    using VideoThumbnailer::configure0;
+    using VideoThumbnailer::doProcessFrame;
+    using VideoThumbnailer::scaleFrame;
+};
+
+class VideoThumbnailerTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(VideoThumbnailerTest);
+    CPPUNIT_TEST(nalTypesTest);
+    CPPUNIT_TEST(configureTest);
+    CPPUNIT_TEST(discardNonKeyFramesTest);
+    CPPUNIT_TEST(scaleBigInputTest);
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    void nalTypesTest();
+    void configureTest();
+    void discardNonKeyFramesTest();
+    void scaleBigInputTest();
+};
+
+void VideoThumbnailerTest::nalTypesTest()
+{
+    //H264: IDR (5), non-IDR (1), SPS (7), PPS (8), SEI (6)
+    CPPUNIT_ASSERT(VideoThumbnailer::isRandomAccessNal(H264, 0x65));
+    CPPUNIT_ASSERT(!VideoThumbnailer::isRandomAccessNal(H264, 0x41));
+    CPPUNIT_ASSERT(VideoThumbnailer::isParameterSetNal(H264, 0x67));
+    CPPUNIT_ASSERT(VideoThumbnailer::isParameterSetNal(H264, 0x68));
+    CPPUNIT_ASSERT(!VideoThumbnailer::isParameterSetNal(H264, 0x06));
+
+    //H265: IDR_W_RADL (19), CRA (21), TRAIL_R (1), VPS (32), SPS (33), PPS (34), AUD (35)
+    CPPUNIT_ASSERT(VideoThumbnailer::isRandomAccessNal(H265, 19 << 1));
+    CPPUNIT_ASSERT(VideoThumbnailer::isRandomAccessNal(H265, 21 << 1));
+    CPPUNIT_ASSERT(!VideoThumbnailer::isRandomAccessNal(H265, 1 << 1));
+    CPPUNIT_ASSERT(VideoThumbnailer::isParameterSetNal(H265, 32 << 1));
+    CPPUNIT_ASSERT(VideoThumbnailer::isParameterSetNal(H265, 33 << 1));
+    CPPUNIT_ASSERT(VideoThumbnailer::isParameterSetNal(H265, 34 << 1));
+    CPPUNIT_ASSERT(!VideoThumbnailer::isParameterSetNal(H265, 35 << 1));
+
+    CPPUNIT_ASSERT(!VideoThumbnailer::isRandomAccessNal(VP8, 0x65));
+}
+
+void VideoThumbnailerTest::configureTest()
+{
+    VideoThumbnailerMock thumbnailer;
+
+    CPPUNIT_ASSERT(thumbnailer.configure0(1000, 160, 90, 0, true));
+    CPPUNIT_ASSERT(thumbnailer.configure0(0, 320, 0, 1, false));
+    CPPUNIT_ASSERT(!thumbnailer.configure0(-1, 160, 90, 0, true));
+    CPPUNIT_ASSERT(!thumbnailer.configure0(1000, -160, 90, 0, true));
+    CPPUNIT_ASSERT(!thumbnailer.configure0(1000, 160, -90, 0, true));
+    CPPUNIT_ASSERT(!thumbnailer.configure0(1000, 160, 90, -1, true));
+    CPPUNIT_ASSERT(!thumbnailer.configure0(1000, MAX_THUMBNAIL_WIDTH + 2, 0, 0, true));
+    CPPUNIT_ASSERT(!thumbnailer.configure0(1000, 0, MAX_THUMBNAIL_HEIGHT + 2, 0, true));
+}
+
+void VideoThumbnailerTest::discardNonKeyFramesTest()
+{
+    VideoThumbnailerMock thumbnailer;
+    InterleavedVideoFrame *org = InterleavedVideoFrame::createNew(H264, 1024);
+    InterleavedVideoFrame *dst = InterleavedVideoFrame::createNew(RAW, 160, 90, RGB24);
+    unsigned char nonIdr[] = {0x00, 0x00, 0x00, 0x01, 0x41, 0x9a, 0x02, 0x03};
+
+    memcpy(org->getDataBuf(), nonIdr, sizeof(nonIdr));
+    org->setLength(sizeof(nonIdr));
+
+    for (int i = 0; i < 10; i++) {
+        org->setPresentationTime(std::chrono::microseconds(i*40000));
+        CPPUNIT_ASSERT(!thumbnailer.doProcessFrame(org, dst));
+        CPPUNIT_ASSERT(!dst->getConsumed());
+    }
+
+    delete org;
+    delete dst;
+}
+
+void VideoThumbnailerTest::scaleBigInputTest()
+{
+    VideoThumbnailerMock thumbnailer;
+    InterleavedVideoFrame *dst = InterleavedVideoFrame::createNew(RAW, DEFAULT_WIDTH, DEFAULT_HEIGHT, RGB24);
+    InterleavedVideoFrame *small = InterleavedVideoFrame::createNew(RAW, 160, 90, RGB24);
+    AVFrame *src = av_frame_alloc();
+
+    src->width = 3840;
+    src->height = 2160;
+    src->format = AV_PIX_FMT_YUV420P;
+    CPPUNIT_ASSERT(av_frame_get_buffer(src, 32) == 0);
+
+    //NOTE: width 0 keeps the input width, which has to be reduced to the output frame size
+    CPPUNIT_ASSERT(thumbnailer.configure0(1000, 0, 0, 0, true));
+    CPPUNIT_ASSERT(thumbnailer.scaleFrame(src, dst));
+    CPPUNIT_ASSERT(dst->getWidth() == MAX_THUMBNAIL_WIDTH);
+    CPPUNIT_ASSERT(dst->getHeight() == MAX_THUMBNAIL_HEIGHT);
+    CPPUNIT_ASSERT(dst->getLength() <= dst->getMaxLength());
+
+    //NOTE: portrait inputs are bounded by the height
+    av_frame_free(&src);
+    src = av_frame_alloc();
+    src->width = 2160;
+    src->height = 3840;
+    src->format = AV_PIX_FMT_YUV420P;
+    CPPUNIT_ASSERT(av_frame_get_buffer(src, 32) == 0);
+    CPPUNIT_ASSERT(thumbnailer.scaleFrame(src, dst));
+    CPPUNIT_ASSERT(dst->getHeight() == MAX_THUMBNAIL_HEIGHT);
+    CPPUNIT_ASSERT(dst->getLength() <= dst->getMaxLength());
+
+    CPPUNIT_ASSERT(thumbnailer.configure0(1000, 320, 180, 0, true));
+    CPPUNIT_ASSERT(!thumbnailer.scaleFrame(src, small));
+
+    av_frame_free(&src);
+    delete dst;
+    delete small;
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(VideoThumbnailerTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("VideoThumbnailerTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("",false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}